@@ -39,6 +39,9 @@ set(APP_LINK_OPTIONS
 set(APP_COMMON_LINK_LIBRARIES
     rtos::freertos_usb
     lib_src
+    frame_pool
+    pipeline_timing
+    pipeline_builder
     xcore_iot::example::audio_mux::xcore_ai_explorer
 )
 
@@ -10,6 +10,7 @@
 #define appconfGPIO_T1_RPC_PORT        2
 #define appconfI2S_RPC_PORT            3
 #define appconfAUDIOPIPELINE_PORT      4
+#define appconfAUDIOPIPELINE_CREDIT_PORT 5
 
 /* Application tile specifiers */
 #include "platform/driver_instances.h"
@@ -23,6 +24,31 @@
 /* If in channel sample format, appconfAUDIO_PIPELINE_FRAME_ADVANCE == MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME*/
 #define appconfAUDIO_PIPELINE_FRAME_ADVANCE     MIC_ARRAY_CONFIG_SAMPLES_PER_FRAME
 
+/* Frames in each tile's pool of audio pipeline frames: one per stage, and
+ * two per queue between stages, as generic_pipeline makes them, and one more
+ * so that tile[1] has a credit to send the next frame to tile[0] while the
+ * last is output */
+#define appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES 2
+
+/* Frames tile[0] releases before returning their credits to tile[1] */
+#define appconfAUDIO_PIPELINE_CREDIT_BATCH      1
+
+/* Audio pipeline schedule, see modules/pipeline_builder. Each core's share
+ * of the 600 MHz tile clock, with every core busy, in cycles per frame. */
+#define appconfAUDIO_PIPELINE_FRAME_CYCLES      ((uint32_t)((600000000ull / configNUM_CORES) * appconfAUDIO_PIPELINE_FRAME_ADVANCE / appconfAUDIO_PIPELINE_SAMPLE_RATE))
+#if ON_TILE(0)
+#define appconfAUDIO_PIPELINE_CORE_MASK         ((1 << 2) | (1 << 3) | (1 << 4)) /* Kept off core 0 and the I/O cores */
+#else
+#define appconfAUDIO_PIPELINE_CORE_MASK         ((1 << 4) | (1 << 5)) /* Kept off core 0 and the I/O cores */
+#endif
+#define appconfAUDIO_PIPELINE_HEAVY_PERCENT     50
+
+/* Frames between reports of the pipeline's latency, from each frame's
+ * trail, printed by tile[0], or 0 for none */
+#ifndef appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES
+#define appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES 0
+#endif
+
 /* Input configuration */
 #ifndef appconfUSB_INPUT
 #define appconfUSB_INPUT           0
@@ -2,7 +2,6 @@
 // XMOS Public License: Version 1
 
 /* STD headers */
-#include <string.h>
 #include <stdint.h>
 #include <xcore/hwtimer.h>
 
@@ -14,6 +13,11 @@
 
 /* Library headers */
 #include "generic_pipeline.h"
+#include "pipeline_builder.h"
+#include "frame_pool.h"
+#include "frame_link.h"
+#include "frame_trail.h"
+
 /* App headers */
 #include "app_conf.h"
 #include "audio_pipeline.h"
@@ -23,32 +27,91 @@
  */
 typedef struct {
     int32_t samples[appconfAUDIO_PIPELINE_CHANNELS][appconfAUDIO_PIPELINE_FRAME_ADVANCE];
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+    frame_trail_t trail;
+#endif
 } frame_data_t;
 
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+/* The points each frame's trail marks, from input on tile[1] to output on
+ * tile[0]. The time to a stage's start is time queued, and the time to its
+ * end is time computing. */
+enum {
+    TRAIL_INPUT,
+    TRAIL_T1_STAGE_START,
+    TRAIL_T1_STAGE_END,
+    TRAIL_LINK_TX,
+    TRAIL_LINK_RX,
+    TRAIL_T0_STAGE_START,
+    TRAIL_T0_STAGE_END,
+    TRAIL_OUTPUT,
+    TRAIL_POINTS
+};
+#endif
+
 #if appconfAUDIO_PIPELINE_FRAME_ADVANCE != 240
 #error This pipeline is only configured for 240 frame advance
 #endif
 
+/* The only holder of this tile's frames */
+#define FRAME_OWNER_PIPELINE 1
+
+static FRAME_POOL_STORAGE(frame_pool_storage, sizeof(frame_data_t), appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES);
+static frame_pool_t frame_pool;
+
 #if ON_TILE(0)
-static void *audio_pipeline_input_i(void *input_app_data)
+/* Frames from tile[1], received straight into this tile's pool */
+static frame_link_rx_t frame_link;
+
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+#define TRAIL_STAGE_START TRAIL_T0_STAGE_START
+
+static const frame_trail_point_t trail_points[TRAIL_POINTS] = {
+    { "input", 1 },
+    { "stage start", 1 },
+    { "stage end", 1 },
+    { "frame link tx", 1 },
+    { "frame link rx", 0 },
+    { "stage start", 0 },
+    { "stage end", 0 },
+    { "output", 0 },
+};
+
+static frame_trail_collector_t trail_collector;
+
+static void audio_pipeline_trail_print(const stage_timing_t *t)
 {
-    frame_data_t *frame_data;
-
-    frame_data = pvPortMalloc(sizeof(frame_data_t));
-    memset(frame_data, 0x00, sizeof(frame_data_t));
+    rtos_printf("  %s (tile %u): mean %u, p99 %u, max %u\n",
+                t->name, t->tile,
+                stage_timing_mean(t) / (PLATFORM_REFERENCE_HZ / 1000000),
+                stage_timing_percentile(t, 990) / (PLATFORM_REFERENCE_HZ / 1000000),
+                t->max_ticks / (PLATFORM_REFERENCE_HZ / 1000000));
+}
 
-    size_t bytes_received = 0;
-    bytes_received = rtos_intertile_rx_len(
-            intertile_ctx,
-            appconfAUDIOPIPELINE_PORT,
-            portMAX_DELAY);
+static void audio_pipeline_trail_collect(frame_data_t *frame_data)
+{
+    frame_trail_collect(&trail_collector, &frame_data->trail);
+
+    if (trail_collector.end_to_end.count + trail_collector.dropped >= appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES) {
+        rtos_printf("Audio pipeline latency of %u frames, %u dropped, from the point before (microseconds):\n",
+                    trail_collector.end_to_end.count, trail_collector.dropped);
+        for (int i = 1; i < TRAIL_POINTS; i++) {
+            audio_pipeline_trail_print(&trail_collector.to_point[i]);
+        }
+        audio_pipeline_trail_print(&trail_collector.end_to_end);
+        frame_trail_collector_reset(&trail_collector);
+    }
+}
+#endif
 
-    xassert(bytes_received == sizeof(frame_data_t));
+static void *audio_pipeline_input_i(void *input_app_data)
+{
+    frame_data_t *frame_data;
 
-    rtos_intertile_rx_data(
-            intertile_ctx,
-            frame_data,
-            bytes_received);
+    frame_data = frame_link_rx(&frame_link);
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+    frame_trail_mark(&frame_data->trail, TRAIL_LINK_RX, get_reference_time());
+#endif
 
     return frame_data;
 }
@@ -56,35 +119,66 @@ static void *audio_pipeline_input_i(void *input_app_data)
 static int audio_pipeline_output_i(frame_data_t *frame_data,
                                    void *output_app_data)
 {
-    return audio_pipeline_output(output_app_data,
-                               (int32_t **)frame_data->samples,
-                               2,
-                               appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+    (void) audio_pipeline_output(output_app_data,
+                                 (int32_t **)frame_data->samples,
+                                 2,
+                                 appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+    frame_trail_mark(&frame_data->trail, TRAIL_OUTPUT, get_reference_time());
+    audio_pipeline_trail_collect(frame_data);
+#endif
+    frame_link_rx_release(&frame_link, frame_data, FRAME_OWNER_PIPELINE);
+    return AUDIO_PIPELINE_DONT_FREE_FRAME;
 }
 #endif
 
 #if ON_TILE(1)
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+#define TRAIL_STAGE_START TRAIL_T1_STAGE_START
+#endif
+
+/* Frames to tile[0], sent when its pool has a frame for them */
+static frame_link_tx_t frame_link;
+
+/* The pool is sized so that a frame is always free, but should one not be,
+ * wait for a frame to be released */
+static frame_data_t *audio_pipeline_frame_get(void)
+{
+    frame_data_t *frame_data;
+
+    while ((frame_data = frame_pool_get(&frame_pool, FRAME_OWNER_PIPELINE)) == NULL) {
+        vTaskDelay(1);
+    }
+
+    return frame_data;
+}
+
 static void *audio_pipeline_input_i(void *input_app_data)
 {
     frame_data_t *frame_data;
 
-    frame_data = pvPortMalloc(sizeof(frame_data_t));
+    frame_data = audio_pipeline_frame_get();
 
     audio_pipeline_input(input_app_data,
                        (int32_t **)frame_data->samples,
                        2,
                        appconfAUDIO_PIPELINE_FRAME_ADVANCE);
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+    frame_trail_start(&frame_data->trail);
+    frame_trail_mark(&frame_data->trail, TRAIL_INPUT, get_reference_time());
+#endif
     return frame_data;
 }
 
 static int audio_pipeline_output_i(frame_data_t *frame_data,
                                    void *output_app_data)
 {
-    rtos_intertile_tx(intertile_ctx,
-                      appconfAUDIOPIPELINE_PORT,
-                      frame_data,
-                      sizeof(frame_data_t));
-    return AUDIO_PIPELINE_FREE_FRAME;
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+    frame_trail_mark(&frame_data->trail, TRAIL_LINK_TX, get_reference_time());
+#endif
+    frame_link_tx(&frame_link, frame_data);
+    frame_pool_release(frame_data, FRAME_OWNER_PIPELINE);
+    return AUDIO_PIPELINE_DONT_FREE_FRAME;
 }
 #endif
 
@@ -93,26 +187,64 @@ static void stage_dummy(frame_data_t *frame_data)
     (void) frame_data;
 }
 
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+static void audio_pipeline_stage_mark(frame_data_t *frame_data, unsigned stage, int finished)
+{
+    frame_trail_mark(&frame_data->trail, TRAIL_STAGE_START + 2 * stage + (finished ? 1 : 0), get_reference_time());
+}
+#endif
+
 void audio_pipeline_init(
     void *input_app_data,
     void *output_app_data)
 {
     const int stage_count = 1;
 
-    const pipeline_stage_t stages[] = {
-        (pipeline_stage_t)stage_dummy,
+    frame_pool_init(&frame_pool, frame_pool_storage, sizeof(frame_data_t), appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES);
+#if ON_TILE(0)
+    frame_link_rx_init(&frame_link,
+                       intertile_ctx,
+                       appconfAUDIOPIPELINE_PORT,
+                       appconfAUDIOPIPELINE_CREDIT_PORT,
+                       sizeof(frame_data_t),
+                       &frame_pool,
+                       FRAME_OWNER_PIPELINE,
+                       appconfAUDIO_PIPELINE_CREDIT_BATCH);
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+    frame_trail_collector_init(&trail_collector, trail_points, TRAIL_POINTS);
+#endif
+#endif
+#if ON_TILE(1)
+    frame_link_tx_init(&frame_link,
+                       intertile_ctx,
+                       appconfAUDIOPIPELINE_PORT,
+                       appconfAUDIOPIPELINE_CREDIT_PORT,
+                       sizeof(frame_data_t),
+                       appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES,
+                       appconfAUDIO_PIPELINE_TASK_PRIORITY);
+#endif
+
+    /* stage_dummy does nothing, so takes no cycles to speak of */
+    const pipeline_builder_stage_t stages[] = {
+        { "stage_dummy", (pipeline_stage_t)stage_dummy, 0,
+          configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_dummy) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i) },
     };
 
-    const configSTACK_DEPTH_TYPE stage_stack_sizes[] = {
-        configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage_dummy) + RTOS_THREAD_STACK_SIZE(audio_pipeline_input_i) + RTOS_THREAD_STACK_SIZE(audio_pipeline_output_i),
+    const pipeline_builder_config_t config = {
+        .frame_cycles = appconfAUDIO_PIPELINE_FRAME_CYCLES,
+        .core_mask = appconfAUDIO_PIPELINE_CORE_MASK,
+        .heavy_percent = appconfAUDIO_PIPELINE_HEAVY_PERCENT,
+        .priority = appconfAUDIO_PIPELINE_TASK_PRIORITY,
+#if appconfAUDIO_PIPELINE_TRAIL_REPORT_FRAMES > 0
+        .stage_mark = (void (*)(void *, unsigned, int))audio_pipeline_stage_mark,
+#endif
     };
 
-    generic_pipeline_init((pipeline_input_t)audio_pipeline_input_i,
-                        (pipeline_output_t)audio_pipeline_output_i,
-                        input_app_data,
-                        output_app_data,
-                        stages,
-                        (const size_t*) stage_stack_sizes,
-                        appconfAUDIO_PIPELINE_TASK_PRIORITY,
-                        stage_count);
+    pipeline_builder_init((pipeline_input_t)audio_pipeline_input_i,
+                          (pipeline_output_t)audio_pipeline_output_i,
+                          input_app_data,
+                          output_app_data,
+                          stages,
+                          stage_count,
+                          &config);
 }
@@ -36,7 +36,19 @@
 #define appconfMIC_COUNT                        MIC_ARRAY_CONFIG_MIC_COUNT
 #define appconfPRINT_AUDIO_FRAME_POWER          0
 #define appconfFRAMES_IN_ALL_CHANS              (appconfAUDIO_FRAME_LENGTH * appconfMIC_COUNT)
+/* Frames in the pool of audio pipeline frames: one per stage, and two per
+ * queue between stages, as generic_pipeline makes them */
+#define appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES 4
 #define appconfPOWER_THRESHOLD                  (float)0.00001
+
+/* Audio pipeline schedule, see modules/pipeline_builder. Each core's share
+ * of the 600 MHz tile clock, with every core busy, in cycles per frame. */
+#define appconfAUDIO_PIPELINE_FRAME_CYCLES      ((uint32_t)((600000000ull / configNUM_CORES) * appconfAUDIO_FRAME_LENGTH / appconfPIPELINE_AUDIO_SAMPLE_RATE))
+#define appconfAUDIO_PIPELINE_CORE_MASK         ((1 << 3) | (1 << 4) | (1 << 6) | (1 << 7)) /* Kept off core 0 and the I/O cores */
+#define appconfAUDIO_PIPELINE_HEAVY_PERCENT     50
+/* Estimated cycles per frame of each stage */
+#define appconfAUDIO_PIPELINE_STAGE0_CYCLES     6000
+#define appconfAUDIO_PIPELINE_STAGE1_CYCLES     8000
 #define appconfEXP                              -31
 
 /* UART Configuration */
@@ -10,6 +10,8 @@
 /* App headers */
 #include "app_conf.h"
 #include "generic_pipeline.h"
+#include "pipeline_builder.h"
+#include "frame_pool.h"
 #include "example_pipeline.h"
 #include "platform/driver_instances.h"
 
@@ -17,6 +19,12 @@
 #error appconfMIC_COUNT must be 2
 #endif
 
+/* The only holder of the pipeline's frames */
+#define FRAME_OWNER_PIPELINE 1
+
+static FRAME_POOL_STORAGE(frame_pool_storage, appconfFRAMES_IN_ALL_CHANS * sizeof(int32_t), appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES);
+static frame_pool_t frame_pool;
+
 static BaseType_t xStage0_Gain = appconfAUDIO_PIPELINE_STAGE_ZERO_GAIN;
 
 BaseType_t audiopipeline_get_stage1_gain( void )
@@ -37,7 +45,11 @@ void *example_pipeline_input(void *data)
 
     int32_t * audio_frame;
 
-    audio_frame = pvPortMalloc(appconfFRAMES_IN_ALL_CHANS * sizeof(int32_t));
+    // The pool is sized so that a frame is always free, but should one not be,
+    // wait for a frame to be released
+    while ((audio_frame = frame_pool_get(&frame_pool, FRAME_OWNER_PIPELINE)) == NULL) {
+        vTaskDelay(1);
+    }
 
     rtos_mic_array_rx(
             mic_array_ctx,
@@ -65,7 +77,7 @@ int example_pipeline_output(void *audio_frame, void *data)
             appconfAUDIO_FRAME_LENGTH,
             portMAX_DELAY);
 
-    vPortFree(audio_frame);
+    frame_pool_release(audio_frame, FRAME_OWNER_PIPELINE);
 
     return 0;
 }
@@ -116,26 +128,34 @@ void example_pipeline_init(UBaseType_t priority)
 {
 	const int stage_count = 2;
     mic_array_ctx->format = RTOS_MIC_ARRAY_CHANNEL_SAMPLE;
-
-	const pipeline_stage_t stages[stage_count] = {
-			(pipeline_stage_t) stage0,
-			(pipeline_stage_t) stage1
+    frame_pool_init(&frame_pool, frame_pool_storage, appconfFRAMES_IN_ALL_CHANS * sizeof(int32_t), appconfAUDIO_PIPELINE_FRAME_POOL_FRAMES);
+
+	// stage0 runs after the mic array input and stage1 before the i2s output,
+	// both of which block, so neither is fused, to keep the two overlapped
+	const pipeline_builder_stage_t stages[stage_count] = {
+			{ "stage0", (pipeline_stage_t) stage0, appconfAUDIO_PIPELINE_STAGE0_CYCLES,
+			  configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage0) + RTOS_THREAD_STACK_SIZE(example_pipeline_input),
+			  1 },
+			{ "stage1", (pipeline_stage_t) stage1, appconfAUDIO_PIPELINE_STAGE1_CYCLES,
+			  configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage1) + RTOS_THREAD_STACK_SIZE(example_pipeline_output),
+			  1 }
 	};
 
-	const configSTACK_DEPTH_TYPE stage_stack_sizes[stage_count] = {
-			configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage0) + RTOS_THREAD_STACK_SIZE(example_pipeline_input),
-			configMINIMAL_STACK_SIZE + RTOS_THREAD_STACK_SIZE(stage1) + RTOS_THREAD_STACK_SIZE(example_pipeline_output)
+	const pipeline_builder_config_t config = {
+			.frame_cycles = appconfAUDIO_PIPELINE_FRAME_CYCLES,
+			.core_mask = appconfAUDIO_PIPELINE_CORE_MASK,
+			.heavy_percent = appconfAUDIO_PIPELINE_HEAVY_PERCENT,
+			.priority = priority,
 	};
 
-	generic_pipeline_init(
+	pipeline_builder_init(
 			example_pipeline_input,
 			example_pipeline_output,
             NULL,
             NULL,
 			stages,
-			(const size_t*) stage_stack_sizes,
-			priority,
-			stage_count);
+			stage_count,
+			&config);
 }
 
 #undef MIN
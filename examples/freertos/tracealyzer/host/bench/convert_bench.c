@@ -0,0 +1,165 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * End-to-end conversion benchmark for xscope2psf.
+ *
+ * A synthetic VCD file is generated with trace_gen, with events dropped at
+ * random, and converted by xscope2psf running as a child process. The
+ * benchmark reports the conversion throughput, the peak resident set size of
+ * xscope2psf and how many of the dropped events it reported as missing.
+ * Any additional arguments are passed on to xscope2psf, e.g. `-m` or `-j 2`.
+ *
+ * Usage: xscope2psf_convert_bench <XSCOPE2PSF> [<EVENTS> [<CORES> [<DROP_RATE>]]]
+ *                                 [ARGS...]
+ *        (defaults: 2000000 events on 2 cores, drop rate 0.0001)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "trace_gen.h"
+
+#define VCD_FILENAME        "convert_bench.vcd"
+#define PSF_FILENAME        "convert_bench.psf"
+#define MISSING_LOG_PREFIX  "WARNING: Detected "
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+    trace_gen_config_t config;
+    trace_gen_stats_t stats;
+    unsigned long long num_events;
+    int argi = 2;
+
+    trace_gen_default_config(&config);
+    config.num_events = 2000000;
+    config.drop_rate = 0.0001;
+
+    if (argc < 2) {
+        printf("Usage: %s <XSCOPE2PSF> [<EVENTS> [<CORES> [<DROP_RATE>]]] "
+               "[ARGS...]\n", argv[0]);
+        return 1;
+    }
+
+    if (argi < argc && sscanf(argv[argi], "%llu", &num_events) == 1) {
+        config.num_events = num_events;
+        argi++;
+    }
+    if (argi < argc && sscanf(argv[argi], "%u", &config.num_cores) == 1)
+        argi++;
+    if (argi < argc && sscanf(argv[argi], "%lf", &config.drop_rate) == 1)
+        argi++;
+
+    FILE *vcd = fopen(VCD_FILENAME, "w");
+    if (vcd == NULL)
+        return 1;
+    setvbuf(vcd, NULL, _IOFBF, 1024 * 1024);
+
+    bool ok = trace_gen_write_vcd(&config, vcd, &stats);
+    if (fclose(vcd) != 0 || !ok) {
+        printf("Failed to generate %s\n", VCD_FILENAME);
+        remove(VCD_FILENAME);
+        return 1;
+    }
+
+    char **child_argv = calloc(argc - argi + 6, sizeof(char *));
+    int n = 0;
+    child_argv[n++] = argv[1];
+    child_argv[n++] = "-i";
+    child_argv[n++] = VCD_FILENAME;
+    child_argv[n++] = "-o";
+    child_argv[n++] = PSF_FILENAME;
+    for (int i = argi; i < argc; i++)
+        child_argv[n++] = argv[i];
+
+    int log_pipe[2];
+    if (pipe(log_pipe) != 0)
+        return 1;
+
+    const double start = now_s();
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // The missing event warnings are counted from the log output
+        close(log_pipe[0]);
+        if (dup2(log_pipe[1], STDOUT_FILENO) < 0)
+            _exit(1);
+        execv(argv[1], child_argv);
+        _exit(127);
+    } else if (pid < 0) {
+        printf("Failed to start %s\n", argv[1]);
+        return 1;
+    }
+
+    close(log_pipe[1]);
+
+    FILE *log = fdopen(log_pipe[0], "r");
+    char line[256];
+    unsigned long long detected = 0;
+    unsigned long long warnings = 0;
+
+    while (fgets(line, sizeof(line), log) != NULL) {
+        unsigned missing;
+
+        if (0 == strncmp(line, MISSING_LOG_PREFIX, strlen(MISSING_LOG_PREFIX)) &&
+            sscanf(&line[strlen(MISSING_LOG_PREFIX)], "%u", &missing) == 1) {
+            detected += missing;
+            warnings++;
+        }
+    }
+    fclose(log);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return 1;
+
+    const double elapsed = now_s() - start;
+    const uint64_t expected = stats.events_dropped - stats.events_dropped_at_end;
+    const uint64_t error = (detected > expected) ? detected - expected :
+                                                  expected - detected;
+    const double accuracy = expected ? 100.0 * (1.0 - (double)error / expected) :
+                                       (detected ? 0.0 : 100.0);
+    const double mb = stats.bytes_written / (1024.0 * 1024.0);
+
+#if defined(__APPLE__)
+    const double peak_rss_mb = usage.ru_maxrss / (1024.0 * 1024.0);
+#else
+    const double peak_rss_mb = usage.ru_maxrss / 1024.0;
+#endif
+
+    remove(VCD_FILENAME);
+    remove(PSF_FILENAME);
+    free(child_argv);
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        printf("%s failed (status %d)\n", argv[1], status);
+        return 1;
+    }
+
+    printf("Converted %.1f MB, %llu events on %u cores in %.3f s\n", mb,
+           (unsigned long long)stats.events_written, config.num_cores, elapsed);
+    printf("Throughput: %.1f MB/s, %.2f Mevents/s\n", mb / elapsed,
+           stats.events_written / elapsed / 1e6);
+    printf("Peak RSS: %.1f MB\n", peak_rss_mb);
+    printf("Missing events: %llu reported in %llu warnings, %llu expected "
+           "(%.2f%% accuracy, %llu undetectable at end of trace)\n",
+           detected, warnings, (unsigned long long)expected, accuracy,
+           (unsigned long long)stats.events_dropped_at_end);
+
+    return (detected == expected) ? 0 : 1;
+}
@@ -0,0 +1,334 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Throughput benchmark for the VCD record decoder used by xscope2psf.
+ *
+ * A VCD file of synthetic records is written to disk, and then read and
+ * decoded end to end three times: by the legacy strtok()/sscanf() loop, and
+ * by vcd_parse_record() plus vcd_hex_decode() reading the file both through
+ * stdio and through a memory mapping, as xscope2psf does without and with
+ * -m. On Linux the file is dropped from the page cache before each pass, so
+ * that each reads it from disk. The decoders are first checked to produce
+ * identical bytes, and each pass to decode the same number of bytes.
+ *
+ * Usage: xscope2psf_decode_bench [<SIZE_MB> [<VCD_FILE>]]
+ *        (defaults: 2048 MB, decode_bench.vcd, removed when done)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+#include "vcd_decode.h"
+
+#define VCD_FILENAME        "decode_bench.vcd"
+#define CHECK_BYTES         (64 * 1024 * 1024)
+#define MAX_RECORD_BYTES    128
+#define MAX_LINE_BYTES      (2 * MAX_RECORD_BYTES + 64)
+
+typedef struct {
+    unsigned seed;
+    long long ts;
+} record_gen_t;
+
+typedef struct {
+    size_t vcd_bytes;
+    uint64_t decoded_bytes;
+} decode_result_t;
+
+typedef bool (*decode_file_fn_t)(const char *path, decode_result_t *result);
+
+static double now_s(void)
+{
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int generate_record(record_gen_t *gen, char *line)
+{
+    static const char hex_chars[] = "0123456789abcdef";
+
+    gen->seed = gen->seed * 1103515245 + 12345;
+    int num_bytes = 8 + 4 * ((gen->seed >> 16) % 8);
+    int n = sprintf(line, "#%lld\nl%d ", gen->ts += 10, num_bytes);
+
+    for (int i = 0; i < num_bytes * 2; i++) {
+        gen->seed = gen->seed * 1103515245 + 12345;
+        line[n++] = hex_chars[(gen->seed >> 16) & 0xF];
+    }
+    n += sprintf(&line[n], " 0\n");
+
+    return n;
+}
+
+/* The decode of one line used by xscope2psf 1.0.x */
+static size_t decode_legacy_line(char *line, uint8_t *out)
+{
+    const char delim[] = " \n\r";
+
+    if (line[0] != 'l')
+        return 0;
+
+    char *len_field = strtok(line, delim);
+    char *trace_data = strtok(NULL, delim);
+    char *scope_probe = strtok(NULL, delim);
+    int decoded_trace_len;
+
+    if (scope_probe == NULL || strcmp(scope_probe, "0") != 0 ||
+        sscanf(len_field, "l%d", &decoded_trace_len) != 1 ||
+        decoded_trace_len < 0 || decoded_trace_len > MAX_RECORD_BYTES)
+        return 0;
+
+    for (int i = 0; i < decoded_trace_len; i++)
+        sscanf(&trace_data[i << 1], "%02hhx", &out[i]);
+
+    return decoded_trace_len;
+}
+
+static size_t decode_table_line(const char *line, const char *eol, uint8_t *out)
+{
+    vcd_record_t record;
+
+    if (line[0] == 'l' && vcd_parse_record(line, eol, &record) &&
+        record.probe_id == 0 && record.num_bytes <= MAX_RECORD_BYTES &&
+        vcd_hex_decode(out, record.hex, record.num_bytes))
+        return record.num_bytes;
+
+    return 0;
+}
+
+/* Check both decoders agree, record by record, before timing anything */
+static bool check_decoders(void)
+{
+    record_gen_t gen = { 1, 0 };
+    size_t checked = 0;
+
+    while (checked < CHECK_BYTES) {
+        char block[MAX_LINE_BYTES];
+        uint8_t out_ref[MAX_RECORD_BYTES];
+        uint8_t out[MAX_RECORD_BYTES];
+        int n = generate_record(&gen, block);
+        char *line = block;
+
+        while (line < block + n) {
+            char *eol = memchr(line, '\n', block + n - line);
+            char legacy_line[MAX_LINE_BYTES];
+
+            memcpy(legacy_line, line, eol - line + 1);
+            legacy_line[eol - line + 1] = '\0';
+
+            size_t ref_len = decode_legacy_line(legacy_line, out_ref);
+            size_t new_len = decode_table_line(line, eol, out);
+
+            if (ref_len != new_len || memcmp(out_ref, out, ref_len) != 0)
+                return false;
+
+            line = eol + 1;
+        }
+
+        checked += n;
+    }
+
+    return true;
+}
+
+static bool write_vcd_file(const char *path, size_t target_bytes)
+{
+    FILE *file = fopen(path, "w");
+    record_gen_t gen = { 1, 0 };
+    size_t written = 0;
+    bool ok = true;
+
+    if (file == NULL)
+        return false;
+
+    // Large writes, the file is typically several GB
+    setvbuf(file, NULL, _IOFBF, 1024 * 1024);
+
+    while (ok && written < target_bytes) {
+        char line[MAX_LINE_BYTES];
+        int n = generate_record(&gen, line);
+
+        ok = fwrite(line, 1, n, file) == (size_t)n;
+        written += n;
+    }
+
+    ok = (fclose(file) == 0) && ok;
+
+#if defined(__linux__)
+    // Written back now, so that the passes can drop it from the page cache
+    int fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        ok = (fdatasync(fd) == 0) && ok;
+        close(fd);
+    }
+#endif
+
+    return ok;
+}
+
+static bool drop_cached(const char *path)
+{
+#if defined(__linux__)
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    bool ok = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    close(fd);
+    return ok;
+#else
+    (void) path;
+    return false;
+#endif
+}
+
+static bool decode_legacy_stdio(const char *path, decode_result_t *result)
+{
+    FILE *file = fopen(path, "r");
+    char line[MAX_LINE_BYTES];
+    uint8_t out[MAX_RECORD_BYTES];
+
+    if (file == NULL)
+        return false;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        result->vcd_bytes += strlen(line);
+        result->decoded_bytes += decode_legacy_line(line, out);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool decode_table_stdio(const char *path, decode_result_t *result)
+{
+    FILE *file = fopen(path, "r");
+    char line[MAX_LINE_BYTES];
+    uint8_t out[MAX_RECORD_BYTES];
+
+    if (file == NULL)
+        return false;
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        size_t line_len = strlen(line);
+
+        result->vcd_bytes += line_len;
+        result->decoded_bytes += decode_table_line(line, line + line_len, out);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool decode_table_mapped(const char *path, decode_result_t *result)
+{
+    mapped_file_t file;
+    uint8_t out[MAX_RECORD_BYTES];
+
+    if (!mapped_file_open(&file, path))
+        return false;
+
+    const char *p = file.data;
+    const char *end = file.data + file.size;
+
+    while (p < end) {
+        const char *eol = memchr(p, '\n', end - p);
+        if (eol == NULL)
+            eol = end;
+
+        result->decoded_bytes += decode_table_line(p, eol, out);
+        p = eol + 1;
+    }
+
+    result->vcd_bytes = file.size;
+    mapped_file_close(&file);
+    return true;
+}
+
+static double run(const char *name, decode_file_fn_t fn, const char *path,
+                  decode_result_t *result)
+{
+    memset(result, 0, sizeof(*result));
+    drop_cached(path);
+
+    double start = now_s();
+
+    if (!fn(path, result)) {
+        printf("%-8s failed to read %s\n", name, path);
+        return 0;
+    }
+
+    double elapsed = now_s() - start;
+    double mbps = (result->vcd_bytes / (1024.0 * 1024.0)) / elapsed;
+    printf("%-8s %8.1f MB/s (%.2f GB in %.2f s)\n", name, mbps,
+           result->vcd_bytes / (1024.0 * 1024.0 * 1024.0), elapsed);
+    return mbps;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t size_mb = 2048;
+    const char *path = VCD_FILENAME;
+
+    if ((argc > 1 && sscanf(argv[1], "%zu", &size_mb) != 1) || argc > 3) {
+        printf("Usage: %s [<SIZE_MB> [<VCD_FILE>]]\n", argv[0]);
+        return 1;
+    }
+    if (argc > 2)
+        path = argv[2];
+
+    if (!check_decoders()) {
+        printf("FAIL: decoder output mismatch\n");
+        return 1;
+    }
+
+    printf("Writing %zu MB of VCD records to %s\n", size_mb, path);
+
+    if (!write_vcd_file(path, size_mb * 1024 * 1024)) {
+        printf("Failed to write %s\n", path);
+        remove(path);
+        return 1;
+    }
+
+    printf("Decoding %s (kernel: %s, %s)\n", path, vcd_hex_decode_kernel(),
+           drop_cached(path) ? "read from disk" : "page cache not dropped");
+
+    decode_result_t legacy_result;
+    decode_result_t stdio_result;
+    decode_result_t mapped_result;
+
+    double legacy = run("legacy", decode_legacy_stdio, path, &legacy_result);
+    double table = run("table", decode_table_stdio, path, &stdio_result);
+    double mapped = run("mapped", decode_table_mapped, path, &mapped_result);
+
+    remove(path);
+
+    if (legacy == 0 || table == 0 || mapped == 0)
+        return 1;
+
+    if (stdio_result.decoded_bytes != legacy_result.decoded_bytes ||
+        mapped_result.decoded_bytes != legacy_result.decoded_bytes) {
+        printf("FAIL: decoded %llu, %llu and %llu bytes\n",
+               (unsigned long long)legacy_result.decoded_bytes,
+               (unsigned long long)stdio_result.decoded_bytes,
+               (unsigned long long)mapped_result.decoded_bytes);
+        return 1;
+    }
+
+    printf("Speedup: %.1fx (table), %.1fx (mapped)\n", table / legacy,
+           mapped / legacy);
+
+    return 0;
+}
@@ -0,0 +1,292 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Append-to-PSF latency benchmark for `xscope2psf --stream`.
+ *
+ * xscope2psf is started in stream mode on a VCD file that this benchmark
+ * appends to at a fixed rate, the way xgdb does during a live capture. Each
+ * event carries its sequence number as a parameter, so the time from the
+ * append to the event appearing in the PSF file can be measured per event.
+ * Any additional arguments are passed on to xscope2psf, e.g. `-d 10` or
+ * `-j 2`.
+ *
+ * Usage: xscope2psf_follow_bench <XSCOPE2PSF> [<EVENTS> [<RATE_HZ>]] [ARGS...]
+ *        (defaults: 500 events at 100 Hz)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#define VCD_FILENAME        "follow_bench.vcd"
+#define PSF_FILENAME        "follow_bench.psf"
+#define EVENT_BYTES         12
+#define EVENT_ID            0x1030  /* One parameter */
+#define NUM_CORES           1
+#define SETTLE_TIMEOUT_S    5.0
+
+typedef struct bench {
+    size_t num_events;
+    size_t preamble_bytes;
+    double *appended;               /* Time each event was appended */
+    double *latency;                /* Time until it was seen in the PSF */
+    volatile size_t num_appended;
+    volatile size_t num_seen;
+    volatile bool stop;
+} bench_t;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void append_record(FILE *vcd, const uint8_t *bytes, size_t len)
+{
+    static long long ts = 0;
+
+    fprintf(vcd, "#%lld\nl%zu ", ts += 10, len);
+    for (size_t i = 0; i < len; i++)
+        fprintf(vcd, "%02x", bytes[i]);
+    fprintf(vcd, " 0\n");
+    fflush(vcd);
+}
+
+static void put_u32(uint8_t *dst, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        dst[i] = (value >> (8 * i)) & 0xFF;
+}
+
+/* Writes the VCD header and a minimal PSF preamble, returning its size. */
+static size_t write_preamble(FILE *vcd)
+{
+    uint8_t header[32] = {0};
+    uint8_t timestamp[28] = {0};
+    uint8_t table[12] = {0};
+    uint8_t entry[20] = {0};
+
+    fprintf(vcd, "$date\n today\n$end\n$version\n xscope\n$end\n"
+                 "$timescale 1 ns $end\n$scope module xscope $end\n"
+                 "$var wire 64 0 freertos_trace $end\n$upscope $end\n"
+                 "$enddefinitions $end\n");
+
+    put_u32(&header[0], 0x50534600);
+    header[4] = 10;                     /* Format version */
+    header[6] = 0xA1;                   /* Platform */
+    header[7] = 0x1A;
+    put_u32(&header[12], NUM_CORES);
+    memcpy(&header[20], "FreeRTOS", 8);
+    header[31] = 1;
+    append_record(vcd, header, sizeof(header));
+
+    put_u32(&timestamp[0], 1);
+    put_u32(&timestamp[4], 100000000);  /* Frequency */
+    append_record(vcd, timestamp, sizeof(timestamp));
+
+    put_u32(&table[0], 1);              /* Slots */
+    put_u32(&table[4], 8);              /* Symbol length */
+    put_u32(&table[8], 1);              /* States */
+    append_record(vcd, table, sizeof(table));
+
+    put_u32(&entry[0], 0x1000);
+    memcpy(&entry[12], "bench", 5);
+    append_record(vcd, entry, sizeof(entry));
+
+    return sizeof(header) + sizeof(timestamp) + sizeof(table) + sizeof(entry);
+}
+
+/* Polls the PSF file and timestamps every event as soon as it appears. */
+static void *reader_thread(void *arg)
+{
+    bench_t *b = arg;
+    FILE *psf = NULL;
+    size_t offset = 0;
+    uint8_t buf[4096];
+    size_t len = 0;
+
+    while (!b->stop && b->num_seen < b->num_events) {
+        if (psf == NULL && (psf = fopen(PSF_FILENAME, "rb")) == NULL) {
+            usleep(100);
+            continue;
+        }
+
+        size_t n = fread(&buf[len], 1, sizeof(buf) - len, psf);
+        clearerr(psf);
+
+        if (n == 0) {
+            usleep(20);
+            continue;
+        }
+
+        double t = now_s();
+        len += n;
+
+        size_t pos = 0;
+        if (offset < b->preamble_bytes) {
+            size_t skip = b->preamble_bytes - offset;
+            pos = (skip < len) ? skip : len;
+            offset += pos;
+        }
+
+        for (; len - pos >= EVENT_BYTES; pos += EVENT_BYTES) {
+            uint32_t seq;
+            memcpy(&seq, &buf[pos + 8], sizeof(seq));
+
+            if (seq < b->num_events && seq < b->num_appended) {
+                b->latency[seq] = t - b->appended[seq];
+                b->num_seen++;
+            }
+            offset += EVENT_BYTES;
+        }
+
+        memmove(buf, &buf[pos], len - pos);
+        len -= pos;
+    }
+
+    if (psf != NULL)
+        fclose(psf);
+
+    return NULL;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[])
+{
+    bench_t b = {.num_events = 500};
+    double rate_hz = 100;
+    int argi = 2;
+
+    if (argc < 2) {
+        printf("Usage: %s <XSCOPE2PSF> [<EVENTS> [<RATE_HZ>]] [ARGS...]\n",
+               argv[0]);
+        return 1;
+    }
+
+    if (argi < argc && sscanf(argv[argi], "%zu", &b.num_events) == 1)
+        argi++;
+    if (argi < argc && sscanf(argv[argi], "%lf", &rate_hz) == 1)
+        argi++;
+
+    if (b.num_events == 0 || rate_hz <= 0) {
+        printf("Invalid arguments\n");
+        return 1;
+    }
+
+    b.appended = calloc(b.num_events, sizeof(double));
+    b.latency = calloc(b.num_events, sizeof(double));
+    if (b.appended == NULL || b.latency == NULL)
+        return 1;
+
+    remove(PSF_FILENAME);
+
+    FILE *vcd = fopen(VCD_FILENAME, "w");
+    if (vcd == NULL)
+        return 1;
+    b.preamble_bytes = write_preamble(vcd);
+
+    char **child_argv = calloc(argc - argi + 8, sizeof(char *));
+    int n = 0;
+    child_argv[n++] = argv[1];
+    child_argv[n++] = "-s";
+    child_argv[n++] = "-i";
+    child_argv[n++] = VCD_FILENAME;
+    child_argv[n++] = "-o";
+    child_argv[n++] = PSF_FILENAME;
+    for (int i = argi; i < argc; i++)
+        child_argv[n++] = argv[i];
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Keep the benchmark output readable
+        if (freopen("/dev/null", "w", stdout) == NULL)
+            _exit(1);
+        execv(argv[1], child_argv);
+        _exit(127);
+    } else if (pid < 0) {
+        printf("Failed to start %s\n", argv[1]);
+        return 1;
+    }
+
+    pthread_t reader;
+    pthread_create(&reader, NULL, reader_thread, &b);
+
+    // Let xscope2psf start up and consume the preamble
+    sleep(1);
+
+    const double period = 1.0 / rate_hz;
+    const double start = now_s();
+
+    for (size_t i = 0; i < b.num_events; i++) {
+        uint8_t event[EVENT_BYTES];
+        const double due = start + i * period;
+        double t;
+
+        while ((t = now_s()) < due)
+            usleep((useconds_t)((due - t) * 1e6));
+
+        event[0] = EVENT_ID & 0xFF;
+        event[1] = EVENT_ID >> 8;
+        event[2] = (i + 1) & 0xFF;
+        event[3] = ((i + 1) >> 8) & 0x0F;
+        put_u32(&event[4], (uint32_t)(i * 100));
+        put_u32(&event[8], (uint32_t)i);
+
+        b.appended[i] = now_s();
+        b.num_appended = i + 1;
+        append_record(vcd, event, sizeof(event));
+    }
+
+    const double deadline = now_s() + SETTLE_TIMEOUT_S;
+    while (b.num_seen < b.num_events && now_s() < deadline)
+        usleep(1000);
+
+    b.stop = true;
+    pthread_join(reader, NULL);
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    fclose(vcd);
+    free(child_argv);
+
+    printf("Appended %zu events at %.0f Hz, %zu converted\n", b.num_events,
+           rate_hz, b.num_seen);
+
+    if (b.num_seen > 0) {
+        double sum = 0;
+        size_t m = 0;
+
+        for (size_t i = 0; i < b.num_events; i++) {
+            if (b.latency[i] > 0) {
+                sum += b.latency[i];
+                b.latency[m++] = b.latency[i];
+            }
+        }
+        qsort(b.latency, m, sizeof(double), compare_double);
+
+        printf("Latency: mean %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+               1e3 * sum / m, 1e3 * b.latency[m / 2],
+               1e3 * b.latency[(m * 99) / 100], 1e3 * b.latency[m - 1]);
+    }
+
+    remove(VCD_FILENAME);
+    remove(PSF_FILENAME);
+    free(b.appended);
+    free(b.latency);
+
+    return (b.num_seen == b.num_events) ? 0 : 1;
+}
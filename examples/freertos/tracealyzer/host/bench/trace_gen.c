@@ -0,0 +1,305 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_gen.h"
+
+#define PSF_MAGIC                   0x50534600
+#define PSF_FORMAT_VERSION          10
+#define PSF_PLATFORM_ID             0x1AA1
+#define PSF_SYMBOL_BYTES            32
+#define PSF_STATES                  1
+#define PSF_MAX_CORES               15
+#define PSF_EVENT_COUNTER_MASK      0x0FFF
+
+#define PSF_EVENT_ISR_BEGIN         0x33
+#define PSF_EVENT_TS_RESUME         0x36
+#define PSF_EVENT_TASK_ACTIVATE     0x37
+#define PSF_EVENT_USER              0xA0
+#define PSF_EVENT_PARAM_SHIFT       12
+
+#define OBJECT_HANDLE_BASE          0x20000000
+#define OBJECT_HANDLE_STRIDE        0x100
+#define ENTRY_BYTES                 ((PSF_STATES + 2) * 4 + PSF_SYMBOL_BYTES)
+#define MAX_EVENT_BYTES             (8 + 4 * 4)
+#define MAX_RECORD_CHARS            (64 + 2 * ENTRY_BYTES)
+
+typedef bool (*emit_fn_t)(void *ctx, const uint8_t *bytes, size_t len);
+
+typedef struct writer {
+    FILE *file;
+    unsigned probe_id;
+    unsigned long long time;
+    uint64_t bytes;
+} writer_t;
+
+typedef struct core_state {
+    uint16_t counter;
+    bool started;
+    bool in_isr;
+    unsigned task;
+    unsigned drops_pending;
+    uint64_t drops_since_event;
+} core_state_t;
+
+void trace_gen_default_config(trace_gen_config_t *config)
+{
+    config->num_cores = 2;
+    config->num_events = 1000000;
+    config->frequency = 100000000;
+    config->event_rate_hz = 100000;
+    config->num_symbols = 32;
+    config->drop_rate = 0.0;
+    config->max_drop_burst = 8;
+    config->probe_id = 0;
+    config->seed = 1;
+}
+
+/* xorshift32: deterministic across platforms, unlike rand() */
+static uint32_t next_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static double next_uniform(uint32_t *state)
+{
+    return next_random(state) / 4294967296.0;
+}
+
+static void put_u16(uint8_t *dst, uint16_t value)
+{
+    dst[0] = value & 0xFF;
+    dst[1] = value >> 8;
+}
+
+static void put_u32(uint8_t *dst, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        dst[i] = (value >> (8 * i)) & 0xFF;
+}
+
+static unsigned num_isrs(const trace_gen_config_t *config)
+{
+    return config->num_symbols / 4;
+}
+
+static uint32_t task_handle(unsigned task)
+{
+    return OBJECT_HANDLE_BASE + task * OBJECT_HANDLE_STRIDE;
+}
+
+static uint32_t isr_handle(const trace_gen_config_t *config, unsigned isr)
+{
+    return task_handle(config->num_symbols - num_isrs(config) + isr);
+}
+
+static bool emit_preamble(const trace_gen_config_t *config, emit_fn_t emit,
+                          void *ctx)
+{
+    uint8_t header[32] = {0};
+    uint8_t timestamp[28] = {0};
+    uint8_t table[12] = {0};
+    uint8_t entry[ENTRY_BYTES];
+    const unsigned isrs = num_isrs(config);
+    const unsigned tasks = config->num_symbols - isrs;
+
+    put_u32(&header[0], PSF_MAGIC);
+    put_u16(&header[4], PSF_FORMAT_VERSION);
+    put_u16(&header[6], PSF_PLATFORM_ID);
+    put_u32(&header[12], config->num_cores);
+    memcpy(&header[20], "FreeRTOS", 8);
+    header[31] = 1;
+
+    put_u32(&timestamp[0], 1);
+    put_u32(&timestamp[4], config->frequency);
+    put_u32(&timestamp[16], 1000);      /* OS tick rate */
+
+    put_u32(&table[0], config->num_symbols);
+    put_u32(&table[4], PSF_SYMBOL_BYTES);
+    put_u32(&table[8], PSF_STATES);
+
+    if (!emit(ctx, header, sizeof(header)) ||
+        !emit(ctx, timestamp, sizeof(timestamp)) ||
+        !emit(ctx, table, sizeof(table)))
+        return false;
+
+    for (unsigned i = 0; i < config->num_symbols; i++) {
+        memset(entry, 0, sizeof(entry));
+        put_u32(&entry[0], task_handle(i));
+
+        // One idle task per core, so that utilisation is below 100%
+        char *symbol = (char *)&entry[(PSF_STATES + 2) * 4];
+        if (i < config->num_cores && i < tasks)
+            snprintf(symbol, PSF_SYMBOL_BYTES, "IDLE%u", i);
+        else if (i < tasks)
+            snprintf(symbol, PSF_SYMBOL_BYTES, "task%u", i);
+        else
+            snprintf(symbol, PSF_SYMBOL_BYTES, "isr%u", i - tasks);
+
+        if (!emit(ctx, entry, sizeof(entry)))
+            return false;
+    }
+
+    return true;
+}
+
+/* Fills `event` with the next event on `core`, returning its length. */
+static size_t make_event(const trace_gen_config_t *config, core_state_t *core,
+                         unsigned core_id, uint32_t timestamp, uint32_t *random,
+                         uint8_t event[MAX_EVENT_BYTES])
+{
+    const unsigned isrs = num_isrs(config);
+    const unsigned tasks = config->num_symbols - isrs;
+    const uint32_t kind = next_random(random) % 16;
+    uint16_t code;
+    unsigned num_params = 1;
+
+    if (core->in_isr) {
+        // Return from the ISR to the interrupted task
+        code = PSF_EVENT_TS_RESUME;
+        put_u32(&event[8], task_handle(core->task));
+        core->in_isr = false;
+    } else if (kind < 4 && isrs > 0) {
+        code = PSF_EVENT_ISR_BEGIN;
+        put_u32(&event[8], isr_handle(config, next_random(random) % isrs));
+        core->in_isr = true;
+    } else if (kind < 10 || !core->started) {
+        code = PSF_EVENT_TASK_ACTIVATE;
+        core->task = (core_id < tasks && next_random(random) % 4 == 0) ?
+                     core_id : next_random(random) % tasks;
+        put_u32(&event[8], task_handle(core->task));
+    } else {
+        code = PSF_EVENT_USER;
+        num_params = next_random(random) % 4;
+        for (unsigned i = 0; i < num_params; i++)
+            put_u32(&event[8 + 4 * i], next_random(random));
+    }
+
+    put_u16(&event[0], code | (num_params << PSF_EVENT_PARAM_SHIFT));
+    put_u16(&event[2], (core_id << 12) | core->counter);
+    put_u32(&event[4], timestamp);
+    core->started = true;
+
+    return 8 + 4 * num_params;
+}
+
+static bool generate(const trace_gen_config_t *config, emit_fn_t emit,
+                     void *ctx, trace_gen_stats_t *stats)
+{
+    memset(stats, 0, sizeof(*stats));
+
+    if (config->num_cores == 0 || config->num_cores > PSF_MAX_CORES ||
+        config->num_symbols == 0 || config->num_symbols - num_isrs(config) == 0 ||
+        config->frequency == 0 || config->event_rate_hz <= 0 ||
+        config->max_drop_burst == 0 ||
+        config->max_drop_burst >= PSF_EVENT_COUNTER_MASK)
+        return false;
+
+    core_state_t *cores = calloc(config->num_cores, sizeof(core_state_t));
+    if (cores == NULL)
+        return false;
+
+    bool ok = emit_preamble(config, emit, ctx);
+    uint32_t random = config->seed ? config->seed : 1;
+    const double ticks_per_event = config->frequency / config->event_rate_hz;
+    double now = 0;
+
+    for (uint64_t i = 0; ok && i < config->num_events; i++) {
+        const unsigned core_id = next_random(&random) % config->num_cores;
+        core_state_t *core = &cores[core_id];
+        uint8_t event[MAX_EVENT_BYTES];
+
+        // Uniformly distributed inter-event times with the requested mean
+        now += 2 * ticks_per_event * next_uniform(&random);
+        core->counter = (core->counter + 1) & PSF_EVENT_COUNTER_MASK;
+
+        /*
+         * Drops are only injected once a core has a counter to compare with
+         * and not while a previous drop is unresolved, so that every gap is
+         * below the 12-bit counter range and can be detected exactly.
+         */
+        if (core->drops_pending == 0 && core->started &&
+            core->drops_since_event == 0 &&
+            next_uniform(&random) < config->drop_rate)
+            core->drops_pending = 1 + next_random(&random) % config->max_drop_burst;
+
+        if (core->drops_pending > 0) {
+            core->drops_pending--;
+            core->drops_since_event++;
+            stats->events_dropped++;
+            continue;
+        }
+
+        size_t len = make_event(config, core, core_id, (uint32_t)(uint64_t)now,
+                                &random, event);
+        ok = emit(ctx, event, len);
+        core->drops_since_event = 0;
+        stats->events_written++;
+    }
+
+    // Events dropped after the last event on a core leave no gap to detect
+    for (unsigned c = 0; c < config->num_cores; c++)
+        stats->events_dropped_at_end += cores[c].drops_since_event;
+
+    free(cores);
+    return ok;
+}
+
+static bool emit_vcd_record(void *ctx, const uint8_t *bytes, size_t len)
+{
+    static const char hex_chars[] = "0123456789abcdef";
+    writer_t *writer = ctx;
+    char line[MAX_RECORD_CHARS];
+    int n = snprintf(line, sizeof(line), "#%llu\nl%zu ", writer->time, len);
+
+    for (size_t i = 0; i < len; i++) {
+        line[n++] = hex_chars[bytes[i] >> 4];
+        line[n++] = hex_chars[bytes[i] & 0xF];
+    }
+    n += snprintf(&line[n], sizeof(line) - n, " %u\n", writer->probe_id);
+    writer->time += 10;
+    writer->bytes += n;
+
+    return fwrite(line, 1, n, writer->file) == (size_t)n;
+}
+
+static bool emit_psf_bytes(void *ctx, const uint8_t *bytes, size_t len)
+{
+    writer_t *writer = ctx;
+
+    writer->bytes += len;
+    return fwrite(bytes, 1, len, writer->file) == len;
+}
+
+bool trace_gen_write_vcd(const trace_gen_config_t *config, FILE *file,
+                         trace_gen_stats_t *stats)
+{
+    writer_t writer = {.file = file, .probe_id = config->probe_id};
+
+    int n = fprintf(file, "$date\n today\n$end\n$version\n xscope\n$end\n"
+                  "$timescale 1 ns $end\n$scope module xscope $end\n"
+                  "$var wire 64 %u freertos_trace $end\n$upscope $end\n"
+                  "$enddefinitions $end\n", config->probe_id);
+
+    bool ok = generate(config, emit_vcd_record, &writer, stats);
+    stats->bytes_written = writer.bytes + (n > 0 ? n : 0);
+
+    return ok && !ferror(file);
+}
+
+bool trace_gen_write_psf(const trace_gen_config_t *config, FILE *file,
+                         trace_gen_stats_t *stats)
+{
+    writer_t writer = {.file = file};
+
+    bool ok = generate(config, emit_psf_bytes, &writer, stats);
+    stats->bytes_written = writer.bytes;
+
+    return ok && !ferror(file);
+}
@@ -0,0 +1,51 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef TRACE_GEN_H_
+#define TRACE_GEN_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Synthetic Tracealyzer trace generator, used to benchmark xscope2psf without
+ * hardware. The trace is a PSF preamble (header, timestamp configuration and
+ * symbol table) followed by a mix of task switch, ISR and user events spread
+ * over the configured cores. Events can be dropped at random to exercise
+ * missing event detection; the number dropped is reported so that detection
+ * can be checked exactly.
+ */
+
+typedef struct trace_gen_config {
+    unsigned num_cores;         /* 1 to 15 */
+    uint64_t num_events;        /* Events generated, including dropped ones */
+    uint32_t frequency;         /* Timestamp ticks per second */
+    double event_rate_hz;       /* Mean event rate across all cores */
+    unsigned num_symbols;       /* Symbol table slots (tasks and ISRs) */
+    double drop_rate;           /* Probability of a drop at each event */
+    unsigned max_drop_burst;    /* Events lost per drop: 1 to max_drop_burst */
+    unsigned probe_id;          /* VCD probe the records are written for */
+    uint32_t seed;
+} trace_gen_config_t;
+
+typedef struct trace_gen_stats {
+    uint64_t events_written;
+    uint64_t events_dropped;
+    uint64_t events_dropped_at_end; /* Not followed by an event on the core */
+    uint64_t bytes_written;
+} trace_gen_stats_t;
+
+/* Fill `config` with the defaults used by the benchmark targets. */
+void trace_gen_default_config(trace_gen_config_t *config);
+
+/* Write the trace as an xscope VCD file. */
+bool trace_gen_write_vcd(const trace_gen_config_t *config, FILE *file,
+                         trace_gen_stats_t *stats);
+
+/* Write the trace as a raw PSF file. */
+bool trace_gen_write_psf(const trace_gen_config_t *config, FILE *file,
+                         trace_gen_stats_t *stats);
+
+#endif /* TRACE_GEN_H_ */
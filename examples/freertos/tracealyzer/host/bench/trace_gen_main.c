@@ -0,0 +1,127 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Synthetic trace generator for benchmarking and testing xscope2psf and
+ * psfcut without hardware. Writes an xscope VCD file, or with --psf the raw
+ * PSF stream that the target would have sent, and reports how many events
+ * were dropped so that missing event detection can be checked.
+ *
+ * Usage: xscope2psf_tracegen [OPTIONS] <OUT_FILE>
+ *        -c <CORES>        Cores (default 2)
+ *        -n <EVENTS>       Events, including dropped ones (default 1000000)
+ *        -r <RATE_HZ>      Mean event rate across all cores (default 100000)
+ *        -f <FREQ_HZ>      Timestamp frequency (default 100000000)
+ *        -t <SYMBOLS>      Symbol table slots (default 32)
+ *        -d <RATE>         Drop probability per event (default 0)
+ *        -b <EVENTS>       Maximum events lost per drop (default 8)
+ *        -p <PROBE>        xscope probe of the VCD records (default 0)
+ *        -S <SEED>         Random seed (default 1)
+ *        --psf             Write PSF instead of VCD
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "trace_gen.h"
+
+static bool parse_option(int argc, char *argv[], int *argi,
+                         trace_gen_config_t *config)
+{
+    const char *opt = argv[*argi];
+    unsigned long long value;
+    double rate;
+
+    if (strlen(opt) != 2 || opt[0] != '-' || strchr("cnrftdbpS", opt[1]) == NULL)
+        return false;
+
+    if (++(*argi) >= argc)
+        return false;
+
+    const char *arg = argv[*argi];
+
+    if (opt[1] == 'r' || opt[1] == 'd') {
+        if (sscanf(arg, "%lf", &rate) != 1 || rate < 0)
+            return false;
+        if (opt[1] == 'r')
+            config->event_rate_hz = rate;
+        else
+            config->drop_rate = rate;
+        return true;
+    }
+
+    if (sscanf(arg, "%llu", &value) != 1)
+        return false;
+
+    switch (opt[1]) {
+    case 'c': config->num_cores = (unsigned)value; break;
+    case 'n': config->num_events = value; break;
+    case 'f': config->frequency = (uint32_t)value; break;
+    case 't': config->num_symbols = (unsigned)value; break;
+    case 'b': config->max_drop_burst = (unsigned)value; break;
+    case 'p': config->probe_id = (unsigned)value; break;
+    case 'S': config->seed = (uint32_t)value; break;
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    trace_gen_config_t config;
+    trace_gen_stats_t stats;
+    const char *out_filename = NULL;
+    bool psf = false;
+
+    trace_gen_default_config(&config);
+
+    for (int i = 1; i < argc; i++) {
+        if (0 == strcmp(argv[i], "--psf")) {
+            psf = true;
+        } else if (argv[i][0] != '-' && out_filename == NULL) {
+            out_filename = argv[i];
+        } else if (!parse_option(argc, argv, &i, &config)) {
+            out_filename = NULL;
+            break;
+        }
+    }
+
+    if (out_filename == NULL) {
+        printf("Usage: %s [-c CORES] [-n EVENTS] [-r RATE_HZ] [-f FREQ_HZ] "
+               "[-t SYMBOLS] [-d DROP_RATE] [-b MAX_BURST] [-p PROBE] "
+               "[-S SEED] [--psf] <OUT_FILE>\n", argv[0]);
+        return 1;
+    }
+
+    FILE *file = fopen(out_filename, psf ? "wb" : "w");
+    if (file == NULL) {
+        printf("Failed to open %s\n", out_filename);
+        return 1;
+    }
+
+    // Large writes, the generator is typically used for multi-GB files
+    setvbuf(file, NULL, _IOFBF, 1024 * 1024);
+
+    bool ok = psf ? trace_gen_write_psf(&config, file, &stats) :
+                    trace_gen_write_vcd(&config, file, &stats);
+    ok = (fclose(file) == 0) && ok;
+
+    if (!ok) {
+        printf("Failed to generate %s (invalid configuration?)\n",
+               out_filename);
+        remove(out_filename);
+        return 1;
+    }
+
+    printf("Wrote %s: %llu bytes, %llu events, %llu dropped "
+           "(%llu after the last event on their core)\n", out_filename,
+           (unsigned long long)stats.bytes_written,
+           (unsigned long long)stats.events_written,
+           (unsigned long long)stats.events_dropped,
+           (unsigned long long)stats.events_dropped_at_end);
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined(__linux__)
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#endif
+
+// Abstraction for sleep portability
+#if defined(__GNUC__) || defined(__MINGW32__)
+#include <unistd.h>
+#define SLEEP_MS(x)             usleep((x) * 1000)
+#else
+#include <windows.h>
+#define SLEEP_MS(x)             Sleep(x)
+#endif
+
+#include "file_follow.h"
+
+static int64_t file_size(const char *path)
+{
+    struct stat st;
+
+    return (stat(path, &st) == 0) ? (int64_t)st.st_size : -1;
+}
+
+void file_follow_init(file_follow_t *follow, const char *path,
+                      unsigned max_wait_ms)
+{
+    follow->path = path;
+    follow->max_wait_ms = (max_wait_ms > 0) ? max_wait_ms : 1;
+    follow->backoff_ms = FILE_FOLLOW_MIN_WAIT_MS;
+    follow->last_size = file_size(path);
+    follow->inotify_fd = -1;
+
+#if defined(__linux__)
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (fd >= 0) {
+        const uint32_t mask = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                              IN_DELETE_SELF | IN_MOVE_SELF;
+
+        if (inotify_add_watch(fd, path, mask) >= 0)
+            follow->inotify_fd = fd;
+        else
+            close(fd);
+    }
+#endif
+}
+
+bool file_follow_is_event_driven(const file_follow_t *follow)
+{
+    return follow->inotify_fd >= 0;
+}
+
+#if defined(__linux__)
+static void wait_inotify(file_follow_t *follow)
+{
+    struct pollfd pfd = {.fd = follow->inotify_fd, .events = POLLIN};
+
+    /* The size check closes the window between the caller reaching the end
+     * of the file and the poll below; any append in that window has already
+     * queued an event, so this is only a fast path. */
+    if (file_size(follow->path) != follow->last_size) {
+        follow->last_size = file_size(follow->path);
+        return;
+    }
+
+    if (poll(&pfd, 1, (int)follow->max_wait_ms) > 0) {
+        char events[4096];
+
+        // Drain; the events themselves carry nothing that is needed
+        while (read(follow->inotify_fd, events, sizeof(events)) > 0)
+            ;
+    }
+
+    follow->last_size = file_size(follow->path);
+}
+#endif
+
+static void wait_backoff(file_follow_t *follow)
+{
+    int64_t size = file_size(follow->path);
+
+    // Data has arrived since the last wait; poll quickly again
+    if (size != follow->last_size) {
+        follow->last_size = size;
+        follow->backoff_ms = FILE_FOLLOW_MIN_WAIT_MS;
+    }
+
+    SLEEP_MS(follow->backoff_ms);
+
+    follow->backoff_ms <<= 1;
+    if (follow->backoff_ms > follow->max_wait_ms)
+        follow->backoff_ms = follow->max_wait_ms;
+}
+
+void file_follow_wait(file_follow_t *follow)
+{
+#if defined(__linux__)
+    if (follow->inotify_fd >= 0) {
+        wait_inotify(follow);
+        return;
+    }
+#endif
+
+    wait_backoff(follow);
+}
+
+void file_follow_deinit(file_follow_t *follow)
+{
+#if defined(__linux__)
+    if (follow->inotify_fd >= 0)
+        close(follow->inotify_fd);
+#endif
+
+    follow->inotify_fd = -1;
+}
@@ -0,0 +1,40 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef FILE_FOLLOW_H_
+#define FILE_FOLLOW_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Waits for a file that is being appended to by another process.
+ *
+ * On Linux an inotify watch wakes the caller as soon as the file is modified.
+ * Elsewhere (or if the watch cannot be created) the wait falls back to an
+ * exponential backoff that restarts at FILE_FOLLOW_MIN_WAIT_MS whenever the
+ * file has grown. In both cases a single wait never exceeds `max_wait_ms`.
+ */
+
+#define FILE_FOLLOW_MIN_WAIT_MS 1
+
+typedef struct file_follow {
+    const char *path;
+    unsigned max_wait_ms;
+    unsigned backoff_ms;
+    int64_t last_size;
+    int inotify_fd;             /* -1 when using the backoff fallback */
+} file_follow_t;
+
+void file_follow_init(file_follow_t *follow, const char *path,
+                      unsigned max_wait_ms);
+
+/* Block until the file may have new data, or the maximum wait has elapsed. */
+void file_follow_wait(file_follow_t *follow);
+
+/* Returns true if waits are event driven rather than polled. */
+bool file_follow_is_event_driven(const file_follow_t *follow);
+
+void file_follow_deinit(file_follow_t *follow);
+
+#endif /* FILE_FOLLOW_H_ */
@@ -0,0 +1,117 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+
+bool mapped_file_open(mapped_file_t *file, const char *path)
+{
+    LARGE_INTEGER size;
+
+    memset(file, 0, sizeof(*file));
+
+    HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fh == INVALID_HANDLE_VALUE)
+        return false;
+
+    if (!GetFileSizeEx(fh, &size)) {
+        CloseHandle(fh);
+        return false;
+    }
+
+    file->file_handle = fh;
+    file->size = (size_t)size.QuadPart;
+
+    if (file->size == 0)
+        return true;
+
+    HANDLE mh = CreateFileMappingA(fh, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mh == NULL) {
+        CloseHandle(fh);
+        return false;
+    }
+
+    file->map_handle = mh;
+    file->data = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+
+    if (file->data == NULL) {
+        CloseHandle(mh);
+        CloseHandle(fh);
+        return false;
+    }
+
+    return true;
+}
+
+void mapped_file_close(mapped_file_t *file)
+{
+    if (file->data != NULL)
+        UnmapViewOfFile(file->data);
+    if (file->map_handle != NULL)
+        CloseHandle(file->map_handle);
+    if (file->file_handle != NULL)
+        CloseHandle(file->file_handle);
+
+    memset(file, 0, sizeof(*file));
+}
+
+#else
+
+bool mapped_file_open(mapped_file_t *file, const char *path)
+{
+    struct stat st;
+
+    memset(file, 0, sizeof(*file));
+
+    file->fd = open(path, O_RDONLY);
+    if (file->fd < 0)
+        return false;
+
+    if (fstat(file->fd, &st) != 0) {
+        close(file->fd);
+        return false;
+    }
+
+    file->size = (size_t)st.st_size;
+
+    if (file->size == 0)
+        return true;
+
+    void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, file->fd, 0);
+    if (data == MAP_FAILED) {
+        close(file->fd);
+        return false;
+    }
+
+    // The file is walked once from start to end
+    (void)madvise(data, file->size, MADV_SEQUENTIAL);
+
+    file->data = data;
+    return true;
+}
+
+void mapped_file_close(mapped_file_t *file)
+{
+    if (file->data != NULL)
+        munmap((void *)file->data, file->size);
+    if (file->fd >= 0)
+        close(file->fd);
+
+    memset(file, 0, sizeof(*file));
+    file->fd = -1;
+}
+
+#endif
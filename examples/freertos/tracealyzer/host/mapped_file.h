@@ -0,0 +1,33 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * A read-only, whole-file memory mapping.
+ */
+typedef struct mapped_file {
+    const char *data;
+    size_t size;
+#if defined(_WIN32)
+    void *file_handle;
+    void *map_handle;
+#else
+    int fd;
+#endif
+} mapped_file_t;
+
+/*
+ * Map the file at `path` for sequential reading. Returns false if the file
+ * could not be opened or mapped. An empty file maps successfully with a
+ * NULL `data` pointer.
+ */
+bool mapped_file_open(mapped_file_t *file, const char *path);
+
+void mapped_file_close(mapped_file_t *file);
+
+#endif /* MAPPED_FILE_H_ */
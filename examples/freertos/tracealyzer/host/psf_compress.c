@@ -0,0 +1,631 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#if defined(__linux__)
+#define _GNU_SOURCE     /* fopencookie() */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "psf_compress.h"
+
+#if (PSFZ_FILE_SUPPORTED == 1)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MIN_MATCH               4
+#define MAX_OFFSET              65535
+#define LAST_LITERALS           5   /* Matches end at least this far from the end */
+#define MATCH_FIND_LIMIT        12  /* and start at least this far from it */
+#define SKIP_TRIGGER            6   /* Search faster after 2^6 missed bytes */
+#define MAX_BLOCK_BYTES         (64 * 1024 * 1024)
+
+static uint32_t read_u32(const uint8_t *p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static void write_u32_le(uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = v >> 24;
+}
+
+static uint32_t read_u32_le(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t hash_u32(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - PSFZ_HASH_BITS);
+}
+
+/* Number of equal bytes at `a` and `b`, without reading at or past `limit`. */
+static size_t count_match(const uint8_t *a, const uint8_t *b,
+                          const uint8_t *limit)
+{
+    const uint8_t *start = a;
+
+#if defined(__GNUC__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    while (a + sizeof(uint64_t) <= limit) {
+        uint64_t x, y;
+        memcpy(&x, a, sizeof(x));
+        memcpy(&y, b, sizeof(y));
+
+        if (x != y)
+            return (a - start) + (__builtin_ctzll(x ^ y) >> 3);
+
+        a += sizeof(uint64_t);
+        b += sizeof(uint64_t);
+    }
+#endif
+
+    while (a < limit && *a == *b) {
+        a++;
+        b++;
+    }
+
+    return a - start;
+}
+
+static uint8_t *write_length_ext(uint8_t *op, size_t len)
+{
+    while (len >= 255) {
+        *op++ = 255;
+        len -= 255;
+    }
+    *op++ = (uint8_t)len;
+
+    return op;
+}
+
+static uint8_t *write_literals(uint8_t *op, const uint8_t *literals,
+                               size_t num_literals, size_t match_len,
+                               const uint8_t *src_end)
+{
+    const size_t ml = match_len ? match_len - MIN_MATCH : 0;
+    uint8_t *token = op++;
+
+    *token = (uint8_t)(((num_literals < 15) ? num_literals : 15) << 4);
+    if (num_literals >= 15)
+        op = write_length_ext(op, num_literals - 15);
+
+    // Most runs of literals are short: copy a fixed 16 bytes where possible
+    if (num_literals <= 16 && literals + 16 <= src_end)
+        memcpy(op, literals, 16);
+    else
+        memcpy(op, literals, num_literals);
+    op += num_literals;
+
+    if (match_len)
+        *token |= (uint8_t)((ml < 15) ? ml : 15);
+
+    return op;
+}
+
+size_t psfz_compress_block(const uint8_t *src, size_t len, uint8_t *dst,
+                           uint32_t *hash_table)
+{
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *const end = src + len;
+    uint8_t *op = dst;
+
+    memset(hash_table, 0, sizeof(uint32_t) << PSFZ_HASH_BITS);
+
+    if (len > MATCH_FIND_LIMIT) {
+        const uint8_t *const find_limit = end - MATCH_FIND_LIMIT;
+        const uint8_t *const match_limit = end - LAST_LITERALS;
+
+        while (ip < find_limit) {
+            const uint32_t seq = read_u32(ip);
+            const uint32_t h = hash_u32(seq);
+            const uint8_t *ref = src + hash_table[h];
+
+            hash_table[h] = (uint32_t)(ip - src);
+
+            if (ref == ip || ip - ref > MAX_OFFSET || read_u32(ref) != seq) {
+                ip += 1 + ((ip - anchor) >> SKIP_TRIGGER);
+                continue;
+            }
+
+            // Extend the match backwards over pending literals
+            while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            const size_t match_len = MIN_MATCH +
+                    count_match(ip + MIN_MATCH, ref + MIN_MATCH, match_limit);
+            const size_t offset = ip - ref;
+
+            op = write_literals(op, anchor, ip - anchor, match_len, end);
+            *op++ = offset & 0xFF;
+            *op++ = offset >> 8;
+            if (match_len - MIN_MATCH >= 15)
+                op = write_length_ext(op, match_len - MIN_MATCH - 15);
+
+            ip += match_len;
+            anchor = ip;
+
+            if (ip < find_limit)
+                hash_table[hash_u32(read_u32(ip - 2))] = (uint32_t)(ip - 2 - src);
+        }
+    }
+
+    // The last token carries the remaining literals and no match
+    op = write_literals(op, anchor, end - anchor, 0, end);
+
+    return op - dst;
+}
+
+static bool read_length_ext(const uint8_t **ip, const uint8_t *end,
+                            size_t *len)
+{
+    uint8_t b;
+
+    do {
+        if (*ip >= end)
+            return false;
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+
+    return true;
+}
+
+bool psfz_decompress_block(const uint8_t *src, size_t len, uint8_t *dst,
+                           size_t raw_len)
+{
+    const uint8_t *ip = src;
+    const uint8_t *const end = src + len;
+    uint8_t *op = dst;
+    uint8_t *const out_end = dst + raw_len;
+
+    while (1) {
+        if (ip >= end)
+            return false;
+
+        const uint8_t token = *ip++;
+        size_t num_literals = token >> 4;
+
+        if (num_literals == 15 && !read_length_ext(&ip, end, &num_literals))
+            return false;
+
+        if (num_literals > (size_t)(end - ip) ||
+            num_literals > (size_t)(out_end - op))
+            return false;
+
+        memcpy(op, ip, num_literals);
+        ip += num_literals;
+        op += num_literals;
+
+        if (ip == end)
+            return op == out_end;
+
+        if (end - ip < 2)
+            return false;
+
+        const size_t offset = ip[0] | (ip[1] << 8);
+        size_t match_len = (token & 0x0F) + MIN_MATCH;
+        ip += 2;
+
+        if ((token & 0x0F) == 15 && !read_length_ext(&ip, end, &match_len))
+            return false;
+
+        if (offset == 0 || offset > (size_t)(op - dst) ||
+            match_len > (size_t)(out_end - op))
+            return false;
+
+        const uint8_t *ref = op - offset;
+
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op += match_len;
+        } else {
+            // Overlapping copy, e.g. a run of repeated bytes
+            while (match_len--)
+                *op++ = *ref++;
+        }
+    }
+}
+
+static bool write_block(psfz_writer_t *writer)
+{
+    uint8_t header[8];
+    const uint8_t *data = writer->packed;
+    size_t stored = writer->store_only ? writer->block_len :
+                    psfz_compress_block(writer->block, writer->block_len,
+                                        writer->packed, writer->hash_table);
+    uint32_t flags = 0;
+
+    if (stored >= writer->block_len) {
+        data = writer->block;
+        stored = writer->block_len;
+        flags = PSFZ_STORED_FLAG;
+    }
+
+    write_u32_le(&header[0], (uint32_t)stored | flags);
+    write_u32_le(&header[4], (uint32_t)writer->block_len);
+
+    if (fwrite(header, 1, sizeof(header), writer->file) != sizeof(header) ||
+        fwrite(data, 1, stored, writer->file) != stored)
+        writer->error = true;
+
+    writer->raw_bytes += writer->block_len;
+    writer->stored_bytes += sizeof(header) + stored;
+    writer->block_len = 0;
+
+    return !writer->error;
+}
+
+static void free_writer_buffers(psfz_writer_t *writer)
+{
+    free(writer->block);
+    free(writer->packed);
+    free(writer->hash_table);
+    writer->block = NULL;
+    writer->packed = NULL;
+    writer->hash_table = NULL;
+}
+
+bool psfz_writer_open(psfz_writer_t *writer, FILE *file)
+{
+    uint8_t header[sizeof(psfz_header_t)];
+
+    memset(writer, 0, sizeof(*writer));
+    writer->file = file;
+    writer->block = malloc(PSFZ_BLOCK_BYTES);
+    writer->packed = malloc(PSFZ_COMPRESS_BOUND(PSFZ_BLOCK_BYTES));
+    writer->hash_table = malloc(sizeof(uint32_t) << PSFZ_HASH_BITS);
+
+    if (writer->block == NULL || writer->packed == NULL ||
+        writer->hash_table == NULL) {
+        free_writer_buffers(writer);
+        return false;
+    }
+
+    memcpy(&header[0], PSFZ_MAGIC, 4);
+    write_u32_le(&header[4], PSFZ_VERSION);
+    write_u32_le(&header[8], PSFZ_BLOCK_BYTES);
+    write_u32_le(&header[12], 0);
+
+    writer->stored_bytes = sizeof(header);
+
+    if (fwrite(header, 1, sizeof(header), file) != sizeof(header)) {
+        free_writer_buffers(writer);
+        return false;
+    }
+
+    return true;
+}
+
+bool psfz_writer_write(psfz_writer_t *writer, const void *data, size_t len)
+{
+    const uint8_t *bytes = data;
+
+    while (len > 0) {
+        size_t n = PSFZ_BLOCK_BYTES - writer->block_len;
+        if (n > len)
+            n = len;
+
+        memcpy(&writer->block[writer->block_len], bytes, n);
+        writer->block_len += n;
+        bytes += n;
+        len -= n;
+
+        if (writer->block_len == PSFZ_BLOCK_BYTES && !write_block(writer))
+            return false;
+    }
+
+    return !writer->error;
+}
+
+bool psfz_writer_close(psfz_writer_t *writer)
+{
+    uint8_t marker[4] = {0};
+
+    if (writer->block_len > 0)
+        write_block(writer);
+
+    if (fwrite(marker, 1, sizeof(marker), writer->file) != sizeof(marker))
+        writer->error = true;
+    writer->stored_bytes += sizeof(marker);
+
+    free_writer_buffers(writer);
+
+    return !writer->error;
+}
+
+bool psfz_reader_open(psfz_reader_t *reader, FILE *file)
+{
+    uint8_t header[sizeof(psfz_header_t)];
+
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, PSFZ_MAGIC, 4) != 0)
+        return false;
+
+    memcpy(reader->header.magic, header, 4);
+    reader->header.version = read_u32_le(&header[4]);
+    reader->header.block_bytes = read_u32_le(&header[8]);
+
+    if (reader->header.version != PSFZ_VERSION ||
+        reader->header.block_bytes == 0 ||
+        reader->header.block_bytes > MAX_BLOCK_BYTES)
+        return false;
+
+    reader->block = malloc(reader->header.block_bytes);
+    reader->packed = malloc(PSFZ_COMPRESS_BOUND(reader->header.block_bytes));
+
+    return reader->block != NULL && reader->packed != NULL;
+}
+
+psfz_read_status_t psfz_reader_next(psfz_reader_t *reader)
+{
+    uint8_t header[8];
+    size_t n = fread(header, 1, 4, reader->file);
+
+    reader->block_len = 0;
+
+    if (n < 4)
+        return PSFZ_READ_TRUNCATED;
+
+    const uint32_t stored_field = read_u32_le(&header[0]);
+    const bool is_stored = (stored_field & PSFZ_STORED_FLAG) != 0;
+    const size_t stored = stored_field & ~PSFZ_STORED_FLAG;
+
+    if (stored_field == 0)
+        return PSFZ_READ_END;
+
+    if (fread(&header[4], 1, 4, reader->file) != 4)
+        return PSFZ_READ_TRUNCATED;
+
+    const size_t raw = read_u32_le(&header[4]);
+
+    if (raw > reader->header.block_bytes ||
+        stored > PSFZ_COMPRESS_BOUND(reader->header.block_bytes) ||
+        (is_stored && stored != raw))
+        return PSFZ_READ_CORRUPT;
+
+    uint8_t *dst = is_stored ? reader->block : reader->packed;
+    if (fread(dst, 1, stored, reader->file) != stored)
+        return PSFZ_READ_TRUNCATED;
+
+    if (!is_stored && !psfz_decompress_block(reader->packed, stored,
+                                             reader->block, raw))
+        return PSFZ_READ_CORRUPT;
+
+    reader->block_len = raw;
+
+    return PSFZ_READ_BLOCK;
+}
+
+void psfz_reader_close(psfz_reader_t *reader)
+{
+    free(reader->block);
+    free(reader->packed);
+    reader->block = NULL;
+    reader->packed = NULL;
+}
+
+#if (PSFZ_FILE_SUPPORTED == 1)
+/*
+ * The stream is double buffered: the caller fills one block while a thread
+ * compresses and writes the other, so that compression overlaps the
+ * conversion rather than adding to it. With only one CPU online there is
+ * nothing to overlap with, so blocks are stored, inline, instead.
+ */
+typedef struct psfz_cookie {
+    FILE *file;
+    psfz_writer_t writer;       /* writer.block is owned by the thread while busy */
+    uint8_t *fill;
+    size_t fill_len;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint64_t next_raw_offset;   /* Start of the next block in the stream */
+    uint64_t next_file_offset;  /* and in the file, both under `lock` */
+    bool threaded;
+    bool busy;
+    bool stop;
+} psfz_cookie_t;
+
+static void *psfz_cookie_thread(void *arg)
+{
+    psfz_cookie_t *c = arg;
+
+    pthread_mutex_lock(&c->lock);
+    while (1) {
+        while (!c->busy && !c->stop)
+            pthread_cond_wait(&c->cond, &c->lock);
+        if (!c->busy)
+            break;
+        pthread_mutex_unlock(&c->lock);
+
+        write_block(&c->writer);
+
+        pthread_mutex_lock(&c->lock);
+        c->next_raw_offset = c->writer.raw_bytes;
+        c->next_file_offset = c->writer.stored_bytes;
+        c->busy = false;
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->lock);
+
+    return NULL;
+}
+
+/*
+ * Hand the full fill buffer to the thread once it has finished the last, or
+ * store it here when there is no thread.
+ */
+static bool psfz_cookie_flush(psfz_cookie_t *c)
+{
+    uint8_t *block;
+    bool ok;
+
+    if (c->threaded) {
+        pthread_mutex_lock(&c->lock);
+        while (c->busy)
+            pthread_cond_wait(&c->cond, &c->lock);
+    }
+
+    ok = !c->writer.error;
+    if (ok) {
+        block = c->writer.block;
+        c->writer.block = c->fill;
+        c->writer.block_len = c->fill_len;
+        c->fill = block;
+        c->fill_len = 0;
+        if (c->threaded) {
+            c->busy = true;
+            pthread_cond_broadcast(&c->cond);
+        } else {
+            ok = write_block(&c->writer);
+
+            pthread_mutex_lock(&c->lock);
+            c->next_raw_offset = c->writer.raw_bytes;
+            c->next_file_offset = c->writer.stored_bytes;
+            pthread_mutex_unlock(&c->lock);
+        }
+    }
+
+    if (c->threaded)
+        pthread_mutex_unlock(&c->lock);
+
+    return ok;
+}
+
+static int psfz_cookie_close(void *cookie)
+{
+    psfz_cookie_t *c = cookie;
+    bool ok;
+
+    if (c->threaded) {
+        pthread_mutex_lock(&c->lock);
+        c->stop = true;
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->lock);
+        pthread_join(c->thread, NULL);
+    }
+
+    // The partial block is written by psfz_writer_close()
+    memcpy(c->writer.block, c->fill, c->fill_len);
+    c->writer.block_len = c->fill_len;
+    ok = psfz_writer_close(&c->writer);
+
+    ok = (fclose(c->file) == 0) && ok;
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->cond);
+    free(c->fill);
+    free(c);
+
+    return ok ? 0 : EOF;
+}
+
+static bool psfz_cookie_fill(psfz_cookie_t *c, const char *buf, size_t len)
+{
+    while (len > 0) {
+        size_t n = PSFZ_BLOCK_BYTES - c->fill_len;
+        if (n > len)
+            n = len;
+
+        memcpy(&c->fill[c->fill_len], buf, n);
+        c->fill_len += n;
+        buf += n;
+        len -= n;
+
+        if (c->fill_len == PSFZ_BLOCK_BYTES && !psfz_cookie_flush(c))
+            return false;
+    }
+
+    return true;
+}
+
+#if defined(__linux__)
+static ssize_t psfz_cookie_write(void *cookie, const char *buf, size_t len)
+{
+    return psfz_cookie_fill(cookie, buf, len) ? (ssize_t)len : -1;
+}
+#else
+static int psfz_cookie_write(void *cookie, const char *buf, int len)
+{
+    return psfz_cookie_fill(cookie, buf, len) ? len : -1;
+}
+#endif
+
+bool psfz_spare_cpu(void)
+{
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1;
+}
+
+void psfz_file_position(psfz_file_t *file, uint64_t *raw_offset,
+                        uint64_t *file_offset)
+{
+    pthread_mutex_lock(&file->lock);
+    *raw_offset = file->next_raw_offset;
+    *file_offset = file->next_file_offset;
+    pthread_mutex_unlock(&file->lock);
+}
+
+FILE *psfz_fopen(const char *path, psfz_file_t **file)
+{
+    psfz_cookie_t *c = calloc(1, sizeof(psfz_cookie_t));
+    FILE *stream = NULL;
+
+    if (c == NULL)
+        return NULL;
+
+    c->file = fopen(path, "wb");
+    c->fill = malloc(PSFZ_BLOCK_BYTES);
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->cond, NULL);
+
+    if (c->file != NULL && c->fill != NULL &&
+        psfz_writer_open(&c->writer, c->file) &&
+        ((c->writer.store_only = !psfz_spare_cpu()) ||
+         (c->threaded = (pthread_create(&c->thread, NULL,
+                                        psfz_cookie_thread, c) == 0)))) {
+#if defined(__linux__)
+        cookie_io_functions_t io = {
+            .write = psfz_cookie_write,
+            .close = psfz_cookie_close
+        };
+        stream = fopencookie(c, "wb", io);
+#else
+        stream = funopen(c, NULL, psfz_cookie_write, NULL, psfz_cookie_close);
+#endif
+        if (stream != NULL) {
+            c->next_file_offset = c->writer.stored_bytes;
+            if (file != NULL)
+                *file = c;
+            return stream;
+        }
+
+        psfz_cookie_close(c);
+        return NULL;
+    }
+
+    // psfz_writer_open() frees its own buffers if it fails
+    if (c->writer.block != NULL)
+        psfz_writer_close(&c->writer);
+    if (c->file != NULL)
+        fclose(c->file);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->cond);
+    free(c->fill);
+    free(c);
+
+    return NULL;
+}
+#endif /* (PSFZ_FILE_SUPPORTED == 1) */
@@ -0,0 +1,155 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef PSF_COMPRESS_H_
+#define PSF_COMPRESS_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Block compressed PSF files, as written by `xscope2psf --compress` and read
+ * by psfcat.
+ *
+ * File layout (little-endian):
+ *
+ *     psfz_header_t
+ *     block[0..N), each:
+ *         uint32_t stored_bytes       Bytes of block data that follow; the
+ *                                     top bit is set if they are uncompressed
+ *         uint32_t raw_bytes          Bytes once decompressed
+ *         uint8_t  data[stored_bytes]
+ *     uint32_t 0                      End of file marker
+ *
+ * Every block is compressed on its own, so a block can be decompressed
+ * without any of the preceding data and a file that was not closed (e.g. an
+ * interrupted capture) is readable up to its last complete block.
+ *
+ * The compressed data is a sequence of LZ77 tokens, each:
+ *
+ *     uint8_t  token                  Literal count (high nibble) and match
+ *                                     length - 4 (low nibble); 15 means that
+ *                                     the value continues in the bytes below
+ *     uint8_t  literal_count_ext[]    Added while each byte is 255
+ *     uint8_t  literals[]
+ *     uint16_t match_offset           Distance back to the match (1..65535)
+ *     uint8_t  match_length_ext[]     Added while each byte is 255
+ *
+ * The last token of a block has literals only and no match.
+ */
+
+#define PSFZ_MAGIC              "PSFZ"
+#define PSFZ_VERSION            1
+#define PSFZ_BLOCK_BYTES        (256 * 1024)
+#define PSFZ_STORED_FLAG        0x80000000u
+#define PSFZ_HASH_BITS          14
+
+typedef struct psfz_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t block_bytes;       /* Largest raw_bytes of any block */
+    uint32_t reserved;
+} psfz_header_t;
+
+/* Upper bound on the compressed size of `len` bytes, plus copy slack. */
+#define PSFZ_COMPRESS_BOUND(len) ((len) + (len) / 255 + 32)
+
+/*
+ * Compress `len` bytes into `dst`, which must hold PSFZ_COMPRESS_BOUND(len)
+ * bytes. `hash_table` is scratch space of (1 << PSFZ_HASH_BITS) entries.
+ * Returns the compressed size.
+ */
+size_t psfz_compress_block(const uint8_t *src, size_t len, uint8_t *dst,
+                           uint32_t *hash_table);
+
+/*
+ * Decompress a block into exactly `raw_len` bytes at `dst`. Returns false if
+ * the data is corrupt.
+ */
+bool psfz_decompress_block(const uint8_t *src, size_t len, uint8_t *dst,
+                           size_t raw_len);
+
+typedef struct psfz_writer {
+    FILE *file;
+    uint8_t *block;
+    size_t block_len;
+    uint8_t *packed;
+    uint32_t *hash_table;
+    uint64_t raw_bytes;
+    uint64_t stored_bytes;
+    bool store_only;            /* Write every block uncompressed */
+    bool error;
+} psfz_writer_t;
+
+/* Write the file header to `file` and allocate the block buffers. */
+bool psfz_writer_open(psfz_writer_t *writer, FILE *file);
+
+bool psfz_writer_write(psfz_writer_t *writer, const void *data, size_t len);
+
+/*
+ * Write the last (partial) block and the end of file marker and free the
+ * buffers. `file` is not closed. Returns false if any write failed.
+ */
+bool psfz_writer_close(psfz_writer_t *writer);
+
+typedef enum psfz_read_status {
+    PSFZ_READ_BLOCK,
+    PSFZ_READ_END,
+    PSFZ_READ_TRUNCATED,        /* No end marker: the file was not closed */
+    PSFZ_READ_CORRUPT
+} psfz_read_status_t;
+
+typedef struct psfz_reader {
+    FILE *file;
+    psfz_header_t header;
+    uint8_t *block;             /* The last block read */
+    size_t block_len;
+    uint8_t *packed;
+} psfz_reader_t;
+
+/* Read and check the file header. */
+bool psfz_reader_open(psfz_reader_t *reader, FILE *file);
+
+/* Read and decompress the next block into reader->block. */
+psfz_read_status_t psfz_reader_next(psfz_reader_t *reader);
+
+void psfz_reader_close(psfz_reader_t *reader);
+
+#if defined(__GLIBC__) || defined(__APPLE__) || defined(__FreeBSD__)
+#define PSFZ_FILE_SUPPORTED     1
+
+/*
+ * Returns true if a CPU is free to compress on while the caller converts.
+ * Without one, compression can only add to the conversion time.
+ */
+bool psfz_spare_cpu(void);
+
+typedef struct psfz_cookie psfz_file_t;
+
+/*
+ * Open `path` for writing as a compressed PSF file. Everything written to the
+ * returned stream is compressed on a background thread; fclose() completes
+ * the file. If psfz_spare_cpu() is false, the blocks are stored uncompressed
+ * instead, so that the file is still read by psfcat and psfcut but writing it
+ * costs no more than writing the PSF file itself.
+ *
+ * If `file` is not NULL, it is set to a handle for psfz_file_position(),
+ * which is valid until the stream is closed.
+ */
+FILE *psfz_fopen(const char *path, psfz_file_t **file);
+
+/*
+ * Get the start of the next block to be written to the file, as its offset in
+ * the decompressed stream and in the file. Every byte that has not yet been
+ * written to the file is in that block or a later one. Safe to call from any
+ * thread.
+ */
+void psfz_file_position(psfz_file_t *file, uint64_t *raw_offset,
+                        uint64_t *file_offset);
+#else
+#define PSFZ_FILE_SUPPORTED     0
+#endif
+
+#endif /* PSF_COMPRESS_H_ */
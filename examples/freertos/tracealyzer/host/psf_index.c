@@ -0,0 +1,194 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psf_index.h"
+
+#define ENTRY_FIXED_BYTES       (5 * sizeof(uint64_t))
+#define ENTRY_V1_FIXED_BYTES    (3 * sizeof(uint64_t))
+
+static size_t entry_fixed_bytes(uint32_t version)
+{
+    return (version == 1) ? ENTRY_V1_FIXED_BYTES : ENTRY_FIXED_BYTES;
+}
+
+static size_t entry_bytes(uint32_t version, uint32_t num_cores)
+{
+    return entry_fixed_bytes(version) + num_cores * sizeof(uint16_t);
+}
+
+bool psf_index_writer_open(psf_index_writer_t *writer, const char *path)
+{
+    memset(writer, 0, sizeof(*writer));
+    writer->file = fopen(path, "wb");
+
+    return writer->file != NULL;
+}
+
+void psf_index_writer_set_blocks(psf_index_writer_t *writer,
+                                 psf_index_block_fn_t block_fn, void *ctx)
+{
+    writer->block_fn = block_fn;
+    writer->block_ctx = ctx;
+}
+
+bool psf_index_writer_start(psf_index_writer_t *writer, uint32_t frequency,
+                            uint32_t num_cores, uint64_t bucket_ticks,
+                            uint64_t preamble_bytes)
+{
+    psf_index_header_t *header = &writer->header;
+
+    memcpy(header->magic, PSF_INDEX_MAGIC, sizeof(header->magic));
+    header->version = PSF_INDEX_VERSION;
+    header->frequency = frequency;
+    header->num_cores = num_cores;
+    header->bucket_ticks = (bucket_ticks > 0) ? bucket_ticks : 1;
+    header->preamble_bytes = preamble_bytes;
+
+    writer->started = true;
+
+    return fwrite(header, sizeof(*header), 1, writer->file) == 1;
+}
+
+bool psf_index_writer_event(psf_index_writer_t *writer, uint32_t timestamp,
+                            uint64_t offset, uint64_t event_count,
+                            const uint16_t *core_event_cnts)
+{
+    if (!writer->started)
+        return false;
+
+    /* Events from different cores may be slightly out of order, so only a
+     * large backwards step is treated as a wraparound of the 32-bit timer. */
+    if (writer->num_entries > 0 && timestamp < writer->last_timestamp &&
+        (writer->last_timestamp - timestamp) > 0x80000000u)
+        writer->wraparounds++;
+
+    writer->last_timestamp = timestamp;
+
+    uint64_t extended = (writer->wraparounds << 32) | timestamp;
+    uint64_t bucket = extended / writer->header.bucket_ticks;
+
+    if (writer->num_entries > 0 && bucket <= writer->bucket)
+        return true;
+
+    uint64_t fixed[5] = {extended, offset, event_count, 0, 0};
+    size_t num_cores = writer->header.num_cores;
+    uint16_t unknown = 0xFFFF;
+
+    if (writer->block_fn != NULL)
+        writer->block_fn(writer->block_ctx, &fixed[3], &fixed[4]);
+
+    if (fwrite(fixed, sizeof(fixed), 1, writer->file) != 1)
+        return false;
+
+    for (size_t i = 0; i < num_cores; i++) {
+        const uint16_t *cnt = core_event_cnts ? &core_event_cnts[i] : &unknown;
+        if (fwrite(cnt, sizeof(*cnt), 1, writer->file) != 1)
+            return false;
+    }
+
+    // Keep the index usable while a trace is still being streamed
+    fflush(writer->file);
+
+    writer->bucket = bucket;
+    writer->num_entries++;
+
+    return true;
+}
+
+void psf_index_writer_close(psf_index_writer_t *writer)
+{
+    if (writer->file != NULL)
+        fclose(writer->file);
+
+    writer->file = NULL;
+}
+
+bool psf_index_load(psf_index_t *index, const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    long size;
+
+    memset(index, 0, sizeof(*index));
+
+    if (file == NULL)
+        return false;
+
+    if (fread(&index->header, sizeof(index->header), 1, file) != 1 ||
+        memcmp(index->header.magic, PSF_INDEX_MAGIC, 4) != 0 ||
+        index->header.version < 1 ||
+        index->header.version > PSF_INDEX_VERSION ||
+        fseek(file, 0, SEEK_END) != 0 || (size = ftell(file)) < 0) {
+        fclose(file);
+        return false;
+    }
+
+    index->entry_bytes = entry_bytes(index->header.version,
+                                     index->header.num_cores);
+    index->num_entries =
+            (size - sizeof(index->header)) / index->entry_bytes;
+
+    if (index->num_entries > 0) {
+        index->entries = malloc(index->num_entries * index->entry_bytes);
+
+        if (index->entries == NULL ||
+            fseek(file, sizeof(index->header), SEEK_SET) != 0 ||
+            fread(index->entries, index->entry_bytes, index->num_entries,
+                  file) != index->num_entries) {
+            fclose(file);
+            psf_index_free(index);
+            return false;
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+void psf_index_free(psf_index_t *index)
+{
+    free(index->entries);
+    index->entries = NULL;
+    index->num_entries = 0;
+}
+
+psf_index_entry_t psf_index_entry(const psf_index_t *index, size_t i)
+{
+    const uint8_t *raw = &index->entries[i * index->entry_bytes];
+    psf_index_entry_t entry;
+
+    memcpy(&entry.timestamp, &raw[0], sizeof(uint64_t));
+    memcpy(&entry.offset, &raw[8], sizeof(uint64_t));
+    memcpy(&entry.event_count, &raw[16], sizeof(uint64_t));
+    entry.block_start = 0;
+    entry.block_offset = 0;
+    if (index->header.version > 1) {
+        memcpy(&entry.block_start, &raw[24], sizeof(uint64_t));
+        memcpy(&entry.block_offset, &raw[32], sizeof(uint64_t));
+    }
+    entry.core_event_cnts =
+            (const uint16_t *)&raw[entry_fixed_bytes(index->header.version)];
+
+    return entry;
+}
+
+size_t psf_index_find(const psf_index_t *index, uint64_t timestamp)
+{
+    size_t lo = 0;
+    size_t hi = index->num_entries;
+
+    // Find the first entry with a timestamp > `timestamp`
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (psf_index_entry(index, mid).timestamp <= timestamp)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return (lo > 0) ? lo - 1 : 0;
+}
@@ -0,0 +1,130 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef PSF_INDEX_H_
+#define PSF_INDEX_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A PSF index is a sidecar file that maps coarse timestamp buckets to byte
+ * offsets of events in a PSF file. It allows a time window to be extracted
+ * from a large trace without parsing it from the start.
+ *
+ * File layout (little-endian):
+ *
+ *     psf_index_header_t
+ *     entry[0..N), each:
+ *         uint64_t timestamp          Extended timestamp of the first event
+ *                                     in the bucket (wraparounds resolved)
+ *         uint64_t offset             PSF byte offset of that event
+ *         uint64_t event_count        Events written before that event
+ *         uint64_t block_start        Decompressed offset of a PSFZ block at
+ *                                     or before that event (0 if the PSF file
+ *                                     is not compressed)
+ *         uint64_t block_offset       File offset of that block
+ *         uint16_t core_event_cnt[num_cores]
+ *                                     Last 12-bit event counter seen per
+ *                                     core (0xFFFF if none yet)
+ *
+ * Entries are appended as the PSF file is written, so an index for a trace
+ * that is still being captured is always usable up to its last entry. The
+ * block fields let a window be cut from a compressed PSF file by decompressing
+ * from the block before the window, rather than from the start of the file.
+ * Version 1 entries have no block fields, and are read with both set to 0.
+ */
+
+#define PSF_INDEX_MAGIC         "PSFI"
+#define PSF_INDEX_VERSION       2
+
+typedef struct psf_index_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t frequency;         /* Timestamp ticks per second */
+    uint32_t num_cores;
+    uint64_t bucket_ticks;      /* Bucket width in timestamp ticks */
+    uint64_t preamble_bytes;    /* PSF header, timestamp and symbol table */
+} psf_index_header_t;
+
+typedef struct psf_index_entry {
+    uint64_t timestamp;
+    uint64_t offset;
+    uint64_t event_count;
+    uint64_t block_start;
+    uint64_t block_offset;
+    const uint16_t *core_event_cnts;
+} psf_index_entry_t;
+
+/*
+ * Get the start of the PSFZ block that the next byte written to the PSF file
+ * will be in, as psfz_file_position().
+ */
+typedef void (*psf_index_block_fn_t)(void *ctx, uint64_t *block_start,
+                                     uint64_t *block_offset);
+
+typedef struct psf_index_writer {
+    FILE *file;
+    psf_index_header_t header;
+    bool started;
+    uint32_t last_timestamp;
+    uint64_t wraparounds;
+    uint64_t bucket;
+    uint64_t num_entries;
+    psf_index_block_fn_t block_fn;
+    void *block_ctx;
+} psf_index_writer_t;
+
+typedef struct psf_index {
+    psf_index_header_t header;
+    size_t entry_bytes;
+    size_t num_entries;
+    uint8_t *entries;
+} psf_index_t;
+
+/* Create (truncate) the index file at `path`. */
+bool psf_index_writer_open(psf_index_writer_t *writer, const char *path);
+
+/*
+ * Record the compressed block of each entry, as given by `block_fn`, for a
+ * PSF file that is written compressed.
+ */
+void psf_index_writer_set_blocks(psf_index_writer_t *writer,
+                                 psf_index_block_fn_t block_fn, void *ctx);
+
+/*
+ * Write the index header. Must be called once, before the first event, when
+ * the PSF preamble has been written.
+ */
+bool psf_index_writer_start(psf_index_writer_t *writer, uint32_t frequency,
+                            uint32_t num_cores, uint64_t bucket_ticks,
+                            uint64_t preamble_bytes);
+
+/*
+ * Account for an event with the 32-bit device `timestamp`, located at
+ * `offset` in the PSF file. An entry is appended whenever the event starts a
+ * new bucket.
+ */
+bool psf_index_writer_event(psf_index_writer_t *writer, uint32_t timestamp,
+                            uint64_t offset, uint64_t event_count,
+                            const uint16_t *core_event_cnts);
+
+void psf_index_writer_close(psf_index_writer_t *writer);
+
+/* Load a complete index into memory. A trailing partial entry is ignored. */
+bool psf_index_load(psf_index_t *index, const char *path);
+
+void psf_index_free(psf_index_t *index);
+
+/* Returns the entry at position `i`, which must be < index->num_entries. */
+psf_index_entry_t psf_index_entry(const psf_index_t *index, size_t i);
+
+/*
+ * Returns the position of the last entry with a timestamp <= `timestamp`, or
+ * 0 if there is none.
+ */
+size_t psf_index_find(const psf_index_t *index, uint64_t timestamp);
+
+#endif /* PSF_INDEX_H_ */
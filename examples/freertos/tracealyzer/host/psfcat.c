@@ -0,0 +1,186 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#include <fcntl.h>
+#endif
+
+#include "psf_compress.h"
+
+#define VERSION "1.0.0"
+
+#define NUM_ELEMS(x)            (sizeof(x) / sizeof(x[0]))
+#define MAX_INPUT_FILES         256
+
+typedef enum error_code {
+    ERROR_NONE,
+    ERROR_MISSING_ARG,
+    ERROR_UNKOWN_ARG,
+    ERROR_ARG_VALUE_MISSING,
+    ERROR_INCOMPATIBLE_FILE,
+    ERROR_CORRUPT_FILE,
+    ERROR_FILE_SYSTEM
+} error_code_t;
+
+static const char *help_arg[] = {"-h", "--help"};
+static const char *version_arg[] = {"--version"};
+static const char *test_arg[] = {"-t", "--test"};
+static const char *output_file_arg[] = {"-o", "--out-file"};
+
+static bool show_help = false;
+static bool show_version = false;
+static bool test_mode = false;
+static char *output_filename = NULL;
+static char *input_filenames[MAX_INPUT_FILES];
+static int num_input_files = 0;
+
+static void print_help(char *arg0)
+{
+    printf("Usage:\n");
+    printf("    %s [-h] [--version]\n\n", arg0);
+    printf("    %s [-t] [-o <OUT_FILE>] <IN_FILE>...\n\n", arg0);
+    printf("Decompress Percepio Streaming Format (PSF) files written by\n"
+           "'xscope2psf --compress'. The decompressed data of each IN_FILE is\n"
+           "written, in order, to OUT_FILE or to the standard output. A file\n"
+           "from an interrupted capture is decompressed up to its last complete\n"
+           "block.\n\n");
+    printf("Options:\n");
+    printf("    -h, --help                  This help menu.\n");
+    printf("        --version               Print the version of this tool.\n");
+    printf("    -t, --test                  Only check that the files decompress.\n");
+    printf("    -o, --out-file <OUT_FILE>   The PSF file to generate.\n");
+}
+
+static bool is_matching_arg(char *arg, const char *arg_options[],
+                            int num_options)
+{
+    for (int i = 0; i < num_options; i++) {
+        if (0 == strcmp(arg, arg_options[i]))
+            return true;
+    }
+
+    return false;
+}
+
+static error_code_t process_args(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; i++) {
+        if (is_matching_arg(argv[i], help_arg, NUM_ELEMS(help_arg))) {
+            show_help = true;
+            return ERROR_NONE;
+        } else if (is_matching_arg(argv[i], version_arg,
+                                   NUM_ELEMS(version_arg))) {
+            show_version = true;
+            return ERROR_NONE;
+        } else if (is_matching_arg(argv[i], test_arg, NUM_ELEMS(test_arg))) {
+            test_mode = true;
+        } else if (is_matching_arg(argv[i], output_file_arg,
+                                   NUM_ELEMS(output_file_arg))) {
+            if (++i >= argc) {
+                fprintf(stderr, "ERROR: Missing argument value (%s).\n",
+                        argv[i - 1]);
+                return ERROR_ARG_VALUE_MISSING;
+            }
+            output_filename = argv[i];
+        } else if (argv[i][0] == '-' || num_input_files == MAX_INPUT_FILES) {
+            fprintf(stderr, "ERROR: Unkown argument (%s).\n", argv[i]);
+            return ERROR_UNKOWN_ARG;
+        } else {
+            input_filenames[num_input_files++] = argv[i];
+        }
+    }
+
+    return (num_input_files > 0) ? ERROR_NONE : ERROR_MISSING_ARG;
+}
+
+static error_code_t cat_file(const char *filename, FILE *out,
+                             uint64_t *raw_bytes)
+{
+    FILE *in = fopen(filename, "rb");
+    psfz_reader_t reader;
+    psfz_read_status_t status;
+    error_code_t res = ERROR_NONE;
+
+    if (in == NULL) {
+        fprintf(stderr, "ERROR: Could not open %s.\n", filename);
+        return ERROR_FILE_SYSTEM;
+    }
+
+    if (!psfz_reader_open(&reader, in)) {
+        fprintf(stderr, "ERROR: %s is not a compressed PSF file.\n", filename);
+        psfz_reader_close(&reader);
+        fclose(in);
+        return ERROR_INCOMPATIBLE_FILE;
+    }
+
+    while ((status = psfz_reader_next(&reader)) == PSFZ_READ_BLOCK) {
+        if (out != NULL &&
+            fwrite(reader.block, 1, reader.block_len, out) != reader.block_len) {
+            res = ERROR_FILE_SYSTEM;
+            break;
+        }
+        *raw_bytes += reader.block_len;
+    }
+
+    if (status == PSFZ_READ_TRUNCATED) {
+        fprintf(stderr, "WARNING: %s is incomplete, it was decompressed up to "
+                "its last complete block.\n", filename);
+    } else if (status == PSFZ_READ_CORRUPT) {
+        fprintf(stderr, "ERROR: %s is corrupt after %llu bytes.\n", filename,
+                (unsigned long long)*raw_bytes);
+        res = ERROR_CORRUPT_FILE;
+    }
+
+    psfz_reader_close(&reader);
+    fclose(in);
+
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    int exit_code = process_args(argc, argv);
+    FILE *out = NULL;
+    uint64_t raw_bytes = 0;
+
+    if (show_help || exit_code) {
+        print_help(argv[0]);
+        return exit_code;
+    } else if (show_version) {
+        printf("version %s\n", VERSION);
+        return exit_code;
+    }
+
+    if (test_mode) {
+        out = NULL;
+    } else if (output_filename) {
+        out = fopen(output_filename, "wb");
+        if (out == NULL) {
+            fprintf(stderr, "ERROR: Could not open %s.\n", output_filename);
+            return ERROR_FILE_SYSTEM;
+        }
+    } else {
+#if defined(_WIN32)
+        _setmode(_fileno(stdout), _O_BINARY);
+#endif
+        out = stdout;
+    }
+
+    for (int i = 0; i < num_input_files && exit_code == ERROR_NONE; i++)
+        exit_code = cat_file(input_filenames[i], out, &raw_bytes);
+
+    if (out != NULL && out != stdout && fclose(out) != 0)
+        exit_code = ERROR_FILE_SYSTEM;
+
+    if (test_mode && exit_code == ERROR_NONE)
+        printf("OK, %llu bytes\n", (unsigned long long)raw_bytes);
+
+    return exit_code;
+}
@@ -0,0 +1,343 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "psf_index.h"
+#include "psf_compress.h"
+
+#define VERSION "1.0.0"
+
+// Abstraction for 64-bit file offsets
+#if defined(_WIN32)
+#define FSEEK64(f, o)           _fseeki64((f), (o), SEEK_SET)
+#else
+#define FSEEK64(f, o)           fseeko((f), (off_t)(o), SEEK_SET)
+#endif
+
+#define NUM_ELEMS(x)            (sizeof(x) / sizeof(x[0]))
+#define COPY_BUFFER_BYTES       (1024 * 1024)
+
+typedef enum error_code {
+    ERROR_NONE,
+    ERROR_MISSING_ARG,
+    ERROR_UNKOWN_ARG,
+    ERROR_ARG_VALUE_MISSING,
+    ERROR_ARG_VALUE_PARSING_FAILURE,
+    ERROR_INCOMPATIBLE_INDEX,
+    ERROR_CORRUPT_INPUT,
+    ERROR_FILE_SYSTEM,
+    ERROR_OUT_OF_RESOURCES
+} error_code_t;
+
+static const char *help_arg[] = {"-h", "--help"};
+static const char *version_arg[] = {"--version"};
+static const char *input_file_arg[] = {"-i", "--in-file"};
+static const char *index_file_arg[] = {"-x", "--index"};
+static const char *start_arg[] = {"-s", "--start"};
+static const char *end_arg[] = {"-e", "--end"};
+static const char *output_file_arg[] = {"-o", "--out-file"};
+
+static bool show_help = false;
+static bool show_version = false;
+static char *input_filename = NULL;
+static char *index_filename = NULL;
+static char *output_filename = NULL;
+static double start_s = 0.0;
+static double end_s = -1.0;
+
+static void print_help(char *arg0)
+{
+    printf("Usage:\n");
+    printf("    %s [-h] [--version]\n\n", arg0);
+    printf("    %s -i <IN_FILE> [-x <INDEX_FILE>] [-s <START_S>] [-e <END_S>] -o <OUT_FILE>\n\n",
+           arg0);
+    printf("Extract a time window from a Percepio Streaming Format (PSF) file using the\n"
+           "index generated by 'xscope2psf --index'. Only the selected part of the input\n"
+           "is read. The window is rounded outwards to the index bucket boundaries.\n"
+           "A file written by 'xscope2psf --compress' is decompressed from the block\n"
+           "before the window, and the window is written uncompressed.\n\n");
+    printf("Options:\n");
+    printf("    -h, --help                  This help menu.\n");
+    printf("        --version               Print the version of this tool.\n");
+    printf("    -i, --in-file <IN_FILE>     The PSF file to cut.\n");
+    printf("    -x, --index <INDEX_FILE>    The index of IN_FILE. Default = <IN_FILE>.idx\n");
+    printf("    -s, --start <START_S>       Window start, in seconds from the first event.\n"
+           "                                Default = 0.\n");
+    printf("    -e, --end <END_S>           Window end, in seconds from the first event.\n"
+           "                                Default = end of trace.\n");
+    printf("    -o, --out-file <OUT_FILE>   The PSF file to generate.\n");
+}
+
+static bool is_matching_arg(char *arg, const char *arg_options[],
+                            int num_options)
+{
+    for (int i = 0; i < num_options; i++) {
+        if (0 == strcmp(arg, arg_options[i]))
+            return true;
+    }
+
+    return false;
+}
+
+static error_code_t next_arg_value(int argc, char *argv[], int *argi)
+{
+    if (++(*argi) >= argc) {
+        printf("ERROR: Missing argument value (%s).\n", argv[*argi - 1]);
+        return ERROR_ARG_VALUE_MISSING;
+    }
+
+    return ERROR_NONE;
+}
+
+static error_code_t parse_seconds(const char *arg, double *value)
+{
+    if (sscanf(arg, "%lf", value) != 1 || *value < 0) {
+        printf("ERROR: Argument value (%s) could not be parsed.\n", arg);
+        return ERROR_ARG_VALUE_PARSING_FAILURE;
+    }
+
+    return ERROR_NONE;
+}
+
+static error_code_t process_args(int argc, char *argv[])
+{
+    error_code_t res = ERROR_NONE;
+
+    for (int i = 1; i < argc && res == ERROR_NONE; i++) {
+        if (is_matching_arg(argv[i], help_arg, NUM_ELEMS(help_arg))) {
+            show_help = true;
+            return ERROR_NONE;
+        } else if (is_matching_arg(argv[i], version_arg,
+                                   NUM_ELEMS(version_arg))) {
+            show_version = true;
+            return ERROR_NONE;
+        } else if (is_matching_arg(argv[i], input_file_arg,
+                                   NUM_ELEMS(input_file_arg))) {
+            if ((res = next_arg_value(argc, argv, &i)) == ERROR_NONE)
+                input_filename = argv[i];
+        } else if (is_matching_arg(argv[i], index_file_arg,
+                                   NUM_ELEMS(index_file_arg))) {
+            if ((res = next_arg_value(argc, argv, &i)) == ERROR_NONE)
+                index_filename = argv[i];
+        } else if (is_matching_arg(argv[i], output_file_arg,
+                                   NUM_ELEMS(output_file_arg))) {
+            if ((res = next_arg_value(argc, argv, &i)) == ERROR_NONE)
+                output_filename = argv[i];
+        } else if (is_matching_arg(argv[i], start_arg, NUM_ELEMS(start_arg))) {
+            if ((res = next_arg_value(argc, argv, &i)) == ERROR_NONE)
+                res = parse_seconds(argv[i], &start_s);
+        } else if (is_matching_arg(argv[i], end_arg, NUM_ELEMS(end_arg))) {
+            if ((res = next_arg_value(argc, argv, &i)) == ERROR_NONE)
+                res = parse_seconds(argv[i], &end_s);
+        } else {
+            printf("ERROR: Unkown argument (%s).\n", argv[i]);
+            return ERROR_UNKOWN_ARG;
+        }
+    }
+
+    if (res != ERROR_NONE)
+        return res;
+
+    return (input_filename && output_filename) ? ERROR_NONE : ERROR_MISSING_ARG;
+}
+
+static error_code_t copy_range(FILE *in, FILE *out, uint64_t from, uint64_t to,
+                               unsigned char *buf)
+{
+    if (FSEEK64(in, from) != 0)
+        return ERROR_FILE_SYSTEM;
+
+    // `to` may be UINT64_MAX to copy until the end of the input
+    while (from < to) {
+        size_t chunk = (to - from > COPY_BUFFER_BYTES) ? COPY_BUFFER_BYTES :
+                                                         (size_t)(to - from);
+        size_t n = fread(buf, 1, chunk, in);
+
+        if (n == 0)
+            break;
+
+        if (fwrite(buf, 1, n, out) != n)
+            return ERROR_FILE_SYSTEM;
+
+        from += n;
+    }
+
+    return ferror(in) ? ERROR_FILE_SYSTEM : ERROR_NONE;
+}
+
+static bool is_compressed(FILE *in)
+{
+    char magic[sizeof(PSFZ_MAGIC) - 1];
+    bool compressed = fread(magic, 1, sizeof(magic), in) == sizeof(magic) &&
+                      memcmp(magic, PSFZ_MAGIC, sizeof(magic)) == 0;
+
+    rewind(in);
+    return compressed;
+}
+
+/* Write the part of a block at `pos` in the decompressed stream that falls in
+ * [from, to). */
+static error_code_t write_overlap(FILE *out, const uint8_t *block, size_t len,
+                                  uint64_t pos, uint64_t from, uint64_t to)
+{
+    uint64_t start = (from > pos) ? from : pos;
+    uint64_t end = (to < pos + len) ? to : pos + len;
+
+    if (start >= end)
+        return ERROR_NONE;
+
+    if (fwrite(block + (start - pos), 1, (size_t)(end - start), out) !=
+        (size_t)(end - start))
+        return ERROR_FILE_SYSTEM;
+
+    return ERROR_NONE;
+}
+
+/*
+ * As copy_range() for the preamble and then the window, for a compressed file,
+ * whose index offsets refer to the decompressed stream. Once the preamble is
+ * written, the blocks before `block_start`, the decompressed offset of the
+ * block at file offset `block_offset`, are skipped without being read.
+ */
+static error_code_t cut_compressed(FILE *in, FILE *out, uint64_t preamble_bytes,
+                                   uint64_t from, uint64_t to,
+                                   uint64_t block_start, uint64_t block_offset)
+{
+    psfz_reader_t reader;
+    psfz_read_status_t status = PSFZ_READ_END;
+    error_code_t res = ERROR_NONE;
+    uint64_t pos = 0;
+
+    if (from < preamble_bytes)
+        from = preamble_bytes;
+
+    if (!psfz_reader_open(&reader, in)) {
+        printf("ERROR: Compressed input (%s) has an invalid header.\n",
+               input_filename);
+        return ERROR_CORRUPT_INPUT;
+    }
+
+    while (res == ERROR_NONE && pos < to) {
+        if (pos >= preamble_bytes && pos < block_start) {
+            if (FSEEK64(in, block_offset) != 0) {
+                res = ERROR_FILE_SYSTEM;
+                break;
+            }
+            pos = block_start;
+        }
+
+        if ((status = psfz_reader_next(&reader)) != PSFZ_READ_BLOCK)
+            break;
+
+        res = write_overlap(out, reader.block, reader.block_len, pos, 0,
+                            preamble_bytes);
+        if (res == ERROR_NONE)
+            res = write_overlap(out, reader.block, reader.block_len, pos, from,
+                                to);
+        pos += reader.block_len;
+    }
+
+    if (res == ERROR_NONE && pos < to) {
+        if (status == PSFZ_READ_CORRUPT) {
+            printf("ERROR: Compressed input (%s) is corrupt.\n", input_filename);
+            res = ERROR_CORRUPT_INPUT;
+        } else if (status == PSFZ_READ_TRUNCATED && to != UINT64_MAX) {
+            printf("WARNING: Compressed input (%s) ends before the window.\n",
+                   input_filename);
+        }
+    }
+
+    psfz_reader_close(&reader);
+
+    return res;
+}
+
+int main(int argc, char *argv[])
+{
+    int exit_code = process_args(argc, argv);
+    char default_index[FILENAME_MAX];
+    psf_index_t index;
+
+    if (show_help || exit_code) {
+        print_help(argv[0]);
+        return exit_code;
+    } else if (show_version) {
+        printf("version %s\n", VERSION);
+        return exit_code;
+    }
+
+    if (index_filename == NULL) {
+        snprintf(default_index, sizeof(default_index), "%s.idx",
+                 input_filename);
+        index_filename = default_index;
+    }
+
+    if (!psf_index_load(&index, index_filename)) {
+        printf("ERROR: Could not load index (%s).\n", index_filename);
+        return ERROR_INCOMPATIBLE_INDEX;
+    }
+
+    if (index.num_entries == 0 || index.header.frequency == 0) {
+        printf("ERROR: Index (%s) contains no events.\n", index_filename);
+        psf_index_free(&index);
+        return ERROR_INCOMPATIBLE_INDEX;
+    }
+
+    const double freq = index.header.frequency;
+    const uint64_t t0 = psf_index_entry(&index, 0).timestamp;
+    const uint64_t start_ticks = t0 + (uint64_t)(start_s * freq);
+    const uint64_t end_ticks = (end_s < 0) ? UINT64_MAX :
+                                             t0 + (uint64_t)(end_s * freq);
+
+    size_t first = psf_index_find(&index, start_ticks);
+    size_t last = psf_index_find(&index, end_ticks);
+    const psf_index_entry_t first_entry = psf_index_entry(&index, first);
+    uint64_t from = first_entry.offset;
+    uint64_t to = (last + 1 < index.num_entries) ?
+                  psf_index_entry(&index, last + 1).offset : UINT64_MAX;
+    // Decompress from the start if the index has no usable block
+    uint64_t block_start = (first_entry.block_start <= from) ?
+                           first_entry.block_start : 0;
+
+    FILE *in = fopen(input_filename, "rb");
+    FILE *out = fopen(output_filename, "wb");
+    unsigned char *buf = malloc(COPY_BUFFER_BYTES);
+
+    if (in == NULL || out == NULL || buf == NULL) {
+        exit_code = (buf == NULL) ? ERROR_OUT_OF_RESOURCES : ERROR_FILE_SYSTEM;
+    } else if (is_compressed(in)) {
+        exit_code = cut_compressed(in, out, index.header.preamble_bytes, from,
+                                   to, block_start, first_entry.block_offset);
+    } else {
+        // The PSF preamble is required for Tracealyzer to open the window
+        exit_code = copy_range(in, out, 0, index.header.preamble_bytes, buf);
+
+        if (exit_code == ERROR_NONE && to > from)
+            exit_code = copy_range(in, out, from, to, buf);
+    }
+
+    if (exit_code == ERROR_NONE) {
+        printf("Window: %.3f s to %.3f s (events %llu onwards)\n",
+               (psf_index_entry(&index, first).timestamp - t0) / freq,
+               (last + 1 < index.num_entries) ?
+                   (psf_index_entry(&index, last + 1).timestamp - t0) / freq :
+                   (psf_index_entry(&index, last).timestamp - t0) / freq,
+               (unsigned long long)psf_index_entry(&index, first).event_count);
+    } else if (exit_code != ERROR_CORRUPT_INPUT) {
+        printf("ERROR: Failed to write %s.\n", output_filename);
+    }
+
+    free(buf);
+    if (in != NULL)
+        fclose(in);
+    if (out != NULL)
+        fclose(out);
+    psf_index_free(&index);
+
+    return exit_code;
+}
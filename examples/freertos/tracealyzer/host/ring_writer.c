@@ -0,0 +1,344 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ring_writer.h"
+
+#define RECORD_ALIGN            8
+#define RECORD_ALIGNED(n)       (((n) + RECORD_ALIGN - 1) & ~(size_t)(RECORD_ALIGN - 1))
+#define RECORD_FLAG_ESSENTIAL   0x1
+#define RECORD_FLAG_PAD         0x2     /* Skips to the start of the ring */
+
+/* Records are moved out of the ring in batches of up to this many bytes */
+#define WRITE_BATCH_BYTES       (1024 * 1024)
+#define WRITE_BATCH_SEGMENTS    4096
+
+typedef struct record_header {
+    uint32_t len;               /* Payload bytes; for padding, all bytes */
+    uint16_t file;
+    uint16_t flags;
+} record_header_t;
+
+#define RECORD_HEADER_BYTES     RECORD_ALIGNED(sizeof(record_header_t))
+
+typedef struct segment {
+    unsigned file;
+    size_t offset;
+    size_t len;
+    uint64_t records;
+} segment_t;
+
+struct ring_writer {
+    pthread_mutex_t lock;
+    pthread_cond_t not_full;
+    pthread_cond_t not_empty;
+    pthread_t thread;
+    bool stop;
+
+    unsigned char *ring;
+    size_t capacity;
+    size_t head;                /* Producer position, in bytes written */
+    size_t tail;                /* Consumer position */
+    size_t reserved;            /* Bytes of the pending reservation */
+    ring_writer_policy_t policy;
+    ring_writer_stats_t stats;
+
+    FILE **files;
+    unsigned num_files;
+
+    /* Owned by the writer thread */
+    unsigned char *batch;
+    segment_t *segments;
+    bool *touched;
+};
+
+static record_header_t *header_at(ring_writer_t *w, size_t pos)
+{
+    return (record_header_t *)&w->ring[pos % w->capacity];
+}
+
+static size_t record_bytes(const record_header_t *header)
+{
+    if (header->flags & RECORD_FLAG_PAD)
+        return header->len;
+
+    return RECORD_HEADER_BYTES + RECORD_ALIGNED(header->len);
+}
+
+/* Discards the record at the tail, returning false if it must be kept. */
+static bool discard_oldest(ring_writer_t *w)
+{
+    if (w->tail == w->head)
+        return false;
+
+    record_header_t *header = header_at(w, w->tail);
+
+    if (header->flags & RECORD_FLAG_ESSENTIAL)
+        return false;
+
+    if (!(header->flags & RECORD_FLAG_PAD)) {
+        w->stats.records_dropped++;
+        w->stats.bytes_dropped += header->len;
+    }
+
+    w->tail += record_bytes(header);
+    return true;
+}
+
+/*
+ * Moves records from the tail of the ring into the batch buffer, merging
+ * consecutive records for the same file. Returns the number of segments.
+ */
+static size_t take_batch(ring_writer_t *w)
+{
+    size_t num_segments = 0;
+    size_t len = 0;
+
+    while (w->tail != w->head && num_segments < WRITE_BATCH_SEGMENTS) {
+        record_header_t *header = header_at(w, w->tail);
+
+        if (header->flags & RECORD_FLAG_PAD) {
+            w->tail += header->len;
+            continue;
+        }
+
+        if (len > 0 && len + header->len > WRITE_BATCH_BYTES)
+            break;
+
+        segment_t *seg = (num_segments > 0) ? &w->segments[num_segments - 1] :
+                                              NULL;
+
+        if (seg == NULL || seg->file != header->file) {
+            seg = &w->segments[num_segments++];
+            seg->file = header->file;
+            seg->offset = len;
+            seg->len = 0;
+            seg->records = 0;
+        }
+
+        memcpy(&w->batch[len], (unsigned char *)header + RECORD_HEADER_BYTES,
+               header->len);
+        seg->len += header->len;
+        seg->records++;
+        len += header->len;
+        w->tail += record_bytes(header);
+    }
+
+    return num_segments;
+}
+
+static void *write_thread(void *arg)
+{
+    ring_writer_t *w = arg;
+
+    pthread_mutex_lock(&w->lock);
+
+    while (1) {
+        while (w->tail == w->head && !w->stop)
+            pthread_cond_wait(&w->not_empty, &w->lock);
+
+        if (w->tail == w->head)
+            break;
+
+        // Copying out frees the ring space before the (slow) file write
+        size_t num_segments = take_batch(w);
+        pthread_cond_signal(&w->not_full);
+        pthread_mutex_unlock(&w->lock);
+
+        uint64_t records_written = 0;
+        uint64_t bytes_written = 0;
+        uint64_t write_errors = 0;
+
+        for (size_t i = 0; i < num_segments; i++) {
+            const segment_t *seg = &w->segments[i];
+
+            if (fwrite(&w->batch[seg->offset], 1, seg->len,
+                       w->files[seg->file]) == seg->len) {
+                records_written += seg->records;
+                bytes_written += seg->len;
+            } else {
+                write_errors += seg->records;
+            }
+            w->touched[seg->file] = true;
+        }
+
+        // Keep the output files current for live viewing
+        for (unsigned i = 0; i < w->num_files; i++) {
+            if (w->touched[i])
+                fflush(w->files[i]);
+            w->touched[i] = false;
+        }
+
+        pthread_mutex_lock(&w->lock);
+        w->stats.records_written += records_written;
+        w->stats.bytes_written += bytes_written;
+        w->stats.write_errors += write_errors;
+    }
+
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+ring_writer_t *ring_writer_create(size_t capacity, ring_writer_policy_t policy,
+                                  FILE *const files[], unsigned num_files)
+{
+    ring_writer_t *w = calloc(1, sizeof(ring_writer_t));
+
+    if (w == NULL)
+        return NULL;
+
+    w->capacity = RECORD_ALIGNED(capacity);
+    w->policy = policy;
+    w->num_files = num_files;
+    w->stats.capacity = w->capacity;
+    w->ring = malloc(w->capacity);
+    w->files = calloc(num_files, sizeof(FILE *));
+    w->batch = malloc(WRITE_BATCH_BYTES);
+    w->segments = calloc(WRITE_BATCH_SEGMENTS, sizeof(segment_t));
+    w->touched = calloc(num_files, sizeof(bool));
+
+    if (w->capacity < 2 * RECORD_HEADER_BYTES || w->ring == NULL ||
+        w->files == NULL || w->batch == NULL || w->segments == NULL ||
+        w->touched == NULL) {
+        free(w->ring);
+        free(w->files);
+        free(w->batch);
+        free(w->segments);
+        free(w->touched);
+        free(w);
+        return NULL;
+    }
+
+    // Fault the ring in now rather than on the producer's first pass
+    memset(w->ring, 0, w->capacity);
+    memcpy(w->files, files, num_files * sizeof(FILE *));
+
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->not_full, NULL);
+    pthread_cond_init(&w->not_empty, NULL);
+    pthread_create(&w->thread, NULL, write_thread, w);
+
+    return w;
+}
+
+unsigned char *ring_writer_reserve(ring_writer_t *w, unsigned file,
+                                   size_t len, bool essential)
+{
+    const size_t need = RECORD_HEADER_BYTES + RECORD_ALIGNED(len);
+
+    pthread_mutex_lock(&w->lock);
+
+    const size_t rest = w->capacity - (w->head % w->capacity);
+    const size_t total = (rest < need) ? rest + need : need;
+    bool waited = false;
+
+    w->stats.records_pushed++;
+    w->reserved = 0;
+
+    if (total > w->capacity || len > WRITE_BATCH_BYTES || file >= w->num_files) {
+        w->stats.records_dropped++;
+        w->stats.bytes_dropped += len;
+        pthread_mutex_unlock(&w->lock);
+        return NULL;
+    }
+
+    while (w->capacity - (w->head - w->tail) < total) {
+        if (essential || w->policy == RING_WRITER_BLOCK) {
+            waited = true;
+            pthread_cond_wait(&w->not_full, &w->lock);
+        } else if (w->policy == RING_WRITER_DROP_OLDEST && discard_oldest(w)) {
+            continue;
+        } else {
+            w->stats.records_dropped++;
+            w->stats.bytes_dropped += len;
+            pthread_mutex_unlock(&w->lock);
+            return NULL;
+        }
+    }
+
+    if (waited)
+        w->stats.waits++;
+
+    if (rest < need) {
+        record_header_t *pad = header_at(w, w->head);
+        pad->len = (uint32_t)rest;
+        pad->file = 0;
+        pad->flags = RECORD_FLAG_PAD;
+        w->head += rest;
+    }
+
+    record_header_t *header = header_at(w, w->head);
+    header->len = (uint32_t)len;
+    header->file = (uint16_t)file;
+    header->flags = essential ? RECORD_FLAG_ESSENTIAL : 0;
+    w->reserved = need;
+
+    pthread_mutex_unlock(&w->lock);
+
+    // The writer only reads up to the head, so the record is filled unlocked
+    return (unsigned char *)header + RECORD_HEADER_BYTES;
+}
+
+void ring_writer_commit(ring_writer_t *w)
+{
+    pthread_mutex_lock(&w->lock);
+
+    w->head += w->reserved;
+    w->reserved = 0;
+
+    const size_t queued = w->head - w->tail;
+    if (queued > w->stats.high_watermark)
+        w->stats.high_watermark = queued;
+
+    pthread_cond_signal(&w->not_empty);
+    pthread_mutex_unlock(&w->lock);
+}
+
+void ring_writer_get_stats(ring_writer_t *w, ring_writer_stats_t *stats)
+{
+    pthread_mutex_lock(&w->lock);
+    *stats = w->stats;
+    stats->queued_bytes = w->head - w->tail;
+    pthread_mutex_unlock(&w->lock);
+}
+
+void ring_writer_destroy(ring_writer_t *w, ring_writer_stats_t *stats)
+{
+    pthread_mutex_lock(&w->lock);
+    w->stop = true;
+    pthread_cond_signal(&w->not_empty);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+
+    if (stats != NULL)
+        ring_writer_get_stats(w, stats);
+
+    pthread_cond_destroy(&w->not_empty);
+    pthread_cond_destroy(&w->not_full);
+    pthread_mutex_destroy(&w->lock);
+    free(w->ring);
+    free(w->files);
+    free(w->batch);
+    free(w->segments);
+    free(w->touched);
+    free(w);
+}
+
+bool ring_writer_parse_policy(const char *name, ring_writer_policy_t *policy)
+{
+    if (0 == strcmp(name, "block"))
+        *policy = RING_WRITER_BLOCK;
+    else if (0 == strcmp(name, "drop-oldest"))
+        *policy = RING_WRITER_DROP_OLDEST;
+    else if (0 == strcmp(name, "drop-newest"))
+        *policy = RING_WRITER_DROP_NEWEST;
+    else
+        return false;
+
+    return true;
+}
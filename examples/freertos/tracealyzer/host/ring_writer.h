@@ -0,0 +1,75 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef RING_WRITER_H_
+#define RING_WRITER_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A dedicated writer thread fed by a preallocated ring of variable length
+ * records, so that the producer (e.g. the xscope endpoint callback) is not
+ * held up by the file system.
+ *
+ * Records are reserved in the ring, filled in place and then committed; a
+ * reservation that is not committed is discarded by the next one. There must
+ * be a single producer. When the ring is full the configured policy decides
+ * whether the producer waits, queued records are discarded or the new record
+ * is discarded. Records reserved as essential (e.g. the PSF preamble) are
+ * never discarded: the producer waits for space instead.
+ */
+
+typedef enum ring_writer_policy {
+    RING_WRITER_BLOCK,          /* Wait for the writer to make space */
+    RING_WRITER_DROP_OLDEST,    /* Discard the oldest queued records, or the
+                                   new one if the oldest is essential */
+    RING_WRITER_DROP_NEWEST     /* Discard the record being reserved */
+} ring_writer_policy_t;
+
+typedef struct ring_writer_stats {
+    size_t capacity;            /* Bytes, including record headers */
+    size_t queued_bytes;
+    size_t high_watermark;      /* Most bytes queued at any time */
+    uint64_t records_pushed;    /* Reservations, including dropped ones */
+    uint64_t records_written;
+    uint64_t bytes_written;
+    uint64_t records_dropped;
+    uint64_t bytes_dropped;
+    uint64_t waits;             /* Reservations that waited for space */
+    uint64_t write_errors;      /* Records lost to failed writes */
+} ring_writer_stats_t;
+
+typedef struct ring_writer ring_writer_t;
+
+/*
+ * Start a writer with a ring of `capacity` bytes writing to `files`, which
+ * must stay open until ring_writer_destroy(). Returns NULL on failure.
+ */
+ring_writer_t *ring_writer_create(size_t capacity, ring_writer_policy_t policy,
+                                  FILE *const files[], unsigned num_files);
+
+/*
+ * Reserve `len` bytes for a record to be written to files[file]. Returns NULL
+ * if the record was dropped.
+ */
+unsigned char *ring_writer_reserve(ring_writer_t *writer, unsigned file,
+                                   size_t len, bool essential);
+
+/* Queue the record returned by the last ring_writer_reserve(). */
+void ring_writer_commit(ring_writer_t *writer);
+
+void ring_writer_get_stats(ring_writer_t *writer, ring_writer_stats_t *stats);
+
+/*
+ * Write all queued records, stop the writer thread and free the ring. The
+ * final statistics are returned in `stats` if it is not NULL.
+ */
+void ring_writer_destroy(ring_writer_t *writer, ring_writer_stats_t *stats);
+
+/* Parse "block", "drop-oldest" or "drop-newest". */
+bool ring_writer_parse_policy(const char *name, ring_writer_policy_t *policy);
+
+#endif /* RING_WRITER_H_ */
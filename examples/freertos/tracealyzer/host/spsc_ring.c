@@ -0,0 +1,81 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "spsc_ring.h"
+
+#define SPSC_RING_SPIN_LIMIT    64
+#define SPSC_RING_YIELD_LIMIT   256
+#define SPSC_RING_SLEEP_US      50
+
+bool spsc_ring_init(spsc_ring_t *ring, size_t capacity)
+{
+    size_t size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    ring->slots = calloc(size, sizeof(void *));
+    if (ring->slots == NULL)
+        return false;
+
+    ring->mask = size - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+    return true;
+}
+
+void spsc_ring_deinit(spsc_ring_t *ring)
+{
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+bool spsc_ring_push(spsc_ring_t *ring, void *item)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    if (head - tail > ring->mask)
+        return false;
+
+    ring->slots[head & ring->mask] = item;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+
+    return true;
+}
+
+bool spsc_ring_pop(spsc_ring_t *ring, void **item)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+    if (head == tail)
+        return false;
+
+    *item = ring->slots[tail & ring->mask];
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+
+    return true;
+}
+
+bool spsc_ring_backoff(unsigned *spins)
+{
+    /* Spin briefly as the other side is usually mid-batch, then yield, and
+     * finally sleep so an idle stage does not burn a core. */
+    if (*spins < SPSC_RING_SPIN_LIMIT) {
+        (*spins)++;
+    } else if (*spins < SPSC_RING_YIELD_LIMIT) {
+        (*spins)++;
+        sched_yield();
+    } else {
+        usleep(SPSC_RING_SLEEP_US);
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,45 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef SPSC_RING_H_
+#define SPSC_RING_H_
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define SPSC_RING_CACHE_LINE    64
+
+/*
+ * A bounded, lock-free, single-producer/single-consumer ring of pointers.
+ * Exactly one thread may push and exactly one (other) thread may pop.
+ */
+typedef struct spsc_ring {
+    _Alignas(SPSC_RING_CACHE_LINE) atomic_size_t head;  /* Producer index */
+    _Alignas(SPSC_RING_CACHE_LINE) atomic_size_t tail;  /* Consumer index */
+    _Alignas(SPSC_RING_CACHE_LINE) size_t mask;
+    void **slots;
+} spsc_ring_t;
+
+/*
+ * Initialise a ring able to hold at least `capacity` entries. The capacity is
+ * rounded up to a power of two. Returns false on allocation failure.
+ */
+bool spsc_ring_init(spsc_ring_t *ring, size_t capacity);
+
+void spsc_ring_deinit(spsc_ring_t *ring);
+
+/* Returns false if the ring is full. */
+bool spsc_ring_push(spsc_ring_t *ring, void *item);
+
+/* Returns false if the ring is empty. */
+bool spsc_ring_pop(spsc_ring_t *ring, void **item);
+
+/*
+ * Back-off used while waiting on a full or empty ring. `spins` is a counter
+ * owned by the waiting thread and should be reset to 0 after progress is made.
+ * Returns true once the wait has become long enough to sleep.
+ */
+bool spsc_ring_backoff(unsigned *spins);
+
+#endif /* SPSC_RING_H_ */
@@ -0,0 +1,227 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Test of psfcut on the output of `xscope2psf --index`, with and without
+ * --compress.
+ *
+ * A synthetic VCD file is generated with trace_gen and converted by
+ * xscope2psf, running as a child process, once to a PSF file and once to a
+ * compressed one. Each time window is cut from both by psfcut, and the
+ * windows must be the same, uncompressed, PSF data. A compressed file with a
+ * corrupt block must be refused.
+ *
+ * Usage: xscope2psf_psfcut_test <XSCOPE2PSF> <PSFCUT>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "bench/trace_gen.h"
+#include "psf_compress.h"
+
+#define VCD_FILENAME        "psfcut_test.vcd"
+#define PSF_FILENAME        "psfcut_test.psf"
+#define PSFZ_FILENAME       "psfcut_test.psfz"
+#define CORRUPT_FILENAME    "psfcut_test_corrupt.psfz"
+#define CUT_FILENAME        "psfcut_test_cut.psf"
+#define CUTZ_FILENAME       "psfcut_test_cutz.psf"
+
+typedef struct test_window {
+    const char *start;
+    const char *end;            /* NULL for the end of the trace */
+} test_window_t;
+
+static const test_window_t test_windows[] = {
+    {"0", "0.1"},
+    {"0.5", "0.7"},
+    {"1.3", "1.35"},
+    {"2", NULL},
+    {"100", NULL},
+};
+
+static const char *xscope2psf;
+static const char *psfcut;
+
+/* Run a tool with its output discarded. Returns its exit status. */
+static int run(const char *tool, char *const args[])
+{
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+
+    if (pid == 0) {
+        if (freopen("/dev/null", "w", stdout) == NULL)
+            _exit(1);
+        execv(tool, args);
+        _exit(127);
+    } else if (pid < 0 || waitpid(pid, &status, 0) < 0) {
+        return -1;
+    }
+
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+static int cut(const char *in_file, const char *index_file,
+               const test_window_t *window, const char *out_file)
+{
+    char *args[12];
+    int n = 0;
+
+    args[n++] = (char *)psfcut;
+    args[n++] = "-i";
+    args[n++] = (char *)in_file;
+    args[n++] = "-x";
+    args[n++] = (char *)index_file;
+    args[n++] = "-s";
+    args[n++] = (char *)window->start;
+    if (window->end != NULL) {
+        args[n++] = "-e";
+        args[n++] = (char *)window->end;
+    }
+    args[n++] = "-o";
+    args[n++] = (char *)out_file;
+    args[n] = NULL;
+
+    return run(psfcut, args);
+}
+
+static uint8_t *read_file(const char *filename, size_t *len)
+{
+    FILE *f = fopen(filename, "rb");
+    uint8_t *data = NULL;
+    long size;
+
+    if (f != NULL && fseek(f, 0, SEEK_END) == 0 && (size = ftell(f)) >= 0) {
+        rewind(f);
+        data = malloc(size ? size : 1);
+        if (data != NULL && fread(data, 1, size, f) != (size_t)size) {
+            free(data);
+            data = NULL;
+        }
+        *len = size;
+    }
+    if (f != NULL)
+        fclose(f);
+
+    return data;
+}
+
+static bool files_equal(const char *a, const char *b, size_t *len)
+{
+    size_t a_len = 0, b_len = 0;
+    uint8_t *a_data = read_file(a, &a_len);
+    uint8_t *b_data = read_file(b, &b_len);
+    bool equal = a_data != NULL && b_data != NULL && a_len == b_len &&
+                 memcmp(a_data, b_data, a_len) == 0;
+
+    *len = a_len;
+    free(a_data);
+    free(b_data);
+
+    return equal;
+}
+
+/*
+ * Copy the compressed file with its first block's raw size made larger than
+ * any block, which is caught whether the block was compressed or stored.
+ */
+static bool write_corrupt(void)
+{
+    size_t len = 0;
+    uint8_t *data = read_file(PSFZ_FILENAME, &len);
+    const size_t pos = sizeof(psfz_header_t) + sizeof(uint32_t) + 3;
+    FILE *f;
+    bool ok;
+
+    if (data == NULL || len <= pos) {
+        free(data);
+        return false;
+    }
+
+    data[pos] ^= 0xFF;
+    f = fopen(CORRUPT_FILENAME, "wb");
+    ok = f != NULL && fwrite(data, 1, len, f) == len;
+    if (f != NULL)
+        ok = (fclose(f) == 0) && ok;
+    free(data);
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    trace_gen_config_t config;
+    trace_gen_stats_t stats;
+    bool ok = true;
+
+    if (argc != 3) {
+        printf("Usage: %s <XSCOPE2PSF> <PSFCUT>\n", argv[0]);
+        return 1;
+    }
+    xscope2psf = argv[1];
+    psfcut = argv[2];
+
+    trace_gen_default_config(&config);
+    config.num_events = 300000;
+
+    FILE *vcd = fopen(VCD_FILENAME, "w");
+    if (vcd == NULL || !trace_gen_write_vcd(&config, vcd, &stats) ||
+        fclose(vcd) != 0) {
+        printf("Failed to generate %s\n", VCD_FILENAME);
+        return 1;
+    }
+
+    char *plain_args[] = {(char *)xscope2psf, "-x", "-i", VCD_FILENAME,
+                          "-o", PSF_FILENAME, NULL};
+    char *compressed_args[] = {(char *)xscope2psf, "-x", "-z", "-i",
+                               VCD_FILENAME, "-o", PSFZ_FILENAME, NULL};
+
+    if (run(xscope2psf, plain_args) != 0 ||
+        run(xscope2psf, compressed_args) != 0) {
+        printf("%s failed\n", xscope2psf);
+        return 1;
+    }
+
+    for (size_t i = 0; i < sizeof(test_windows) / sizeof(test_windows[0]); i++) {
+        const test_window_t *window = &test_windows[i];
+        size_t len = 0;
+        bool pass = cut(PSF_FILENAME, PSF_FILENAME ".idx", window,
+                        CUT_FILENAME) == 0 &&
+                    cut(PSFZ_FILENAME, PSFZ_FILENAME ".idx", window,
+                        CUTZ_FILENAME) == 0 &&
+                    files_equal(CUT_FILENAME, CUTZ_FILENAME, &len);
+
+        printf("%s: window %s s to %s, %zu bytes\n", pass ? "PASS" : "FAIL",
+               window->start, window->end ? window->end : "end", len);
+        ok = pass && ok;
+    }
+
+    {
+        const test_window_t window = {"0", NULL};
+        bool pass = write_corrupt() &&
+                    cut(CORRUPT_FILENAME, PSFZ_FILENAME ".idx", &window,
+                        CUTZ_FILENAME) != 0;
+
+        printf("%s: corrupt compressed input refused\n", pass ? "PASS" : "FAIL");
+        ok = pass && ok;
+    }
+
+    remove(VCD_FILENAME);
+    remove(PSF_FILENAME);
+    remove(PSF_FILENAME ".idx");
+    remove(PSFZ_FILENAME);
+    remove(PSFZ_FILENAME ".idx");
+    remove(CORRUPT_FILENAME);
+    remove(CUT_FILENAME);
+    remove(CUTZ_FILENAME);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,289 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+/*
+ * Test of the --in-port ring buffered writer.
+ *
+ * A fake xscope endpoint thread replays records at a fixed line rate through
+ * the same reserve/fill/commit sequence as xscope_record_cb(). The output
+ * files are pipes drained by "disk" threads at a limited rate, so that the
+ * ring overflows when the disk is slower than the link. Each record carries
+ * its sequence number and a checkable pattern, and every byte that reaches a
+ * disk is verified: records must be whole, in order, on the right file, and
+ * the writer's counters must account for every record pushed.
+ *
+ * Usage: xscope2psf_ring_writer_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ring_writer.h"
+
+#define MAX_FILES           2
+#define MIN_RECORD_BYTES    8
+#define MAX_RECORD_BYTES    44
+#define PACING_RECORDS      64
+#define DISK_READ_BYTES     4096
+#define UNLIMITED           0
+
+typedef struct test_case {
+    const char *name;
+    ring_writer_policy_t policy;
+    unsigned num_files;
+    size_t ring_bytes;
+    double line_rate;           /* Bytes per second from the endpoint */
+    double disk_rate;           /* Bytes per second to each file */
+    uint32_t num_records;
+    uint32_t num_essential;     /* Leading records reserved as essential */
+} test_case_t;
+
+typedef struct disk {
+    int fd;
+    unsigned index;
+    unsigned num_files;
+    double rate;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t essential_seen;
+    uint32_t num_essential;
+    int64_t last_seq;
+    bool corrupt;
+} disk_t;
+
+static const test_case_t test_cases[] = {
+    {"block, fast disks", RING_WRITER_BLOCK, 2, 1024 * 1024,
+     20e6, UNLIMITED, 200000, 100},
+    {"block, slow disk", RING_WRITER_BLOCK, 1, 64 * 1024,
+     20e6, 2e6, 20000, 100},
+    {"drop-newest, slow disk", RING_WRITER_DROP_NEWEST, 1, 64 * 1024,
+     20e6, 2e6, 50000, 100},
+    {"drop-oldest, slow disk", RING_WRITER_DROP_OLDEST, 1, 64 * 1024,
+     20e6, 2e6, 50000, 100},
+};
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static size_t record_len(uint32_t seq)
+{
+    return MIN_RECORD_BYTES +
+           4 * ((seq * 2654435761u >> 16) % ((MAX_RECORD_BYTES - MIN_RECORD_BYTES) / 4 + 1));
+}
+
+static uint8_t pattern(uint32_t seq, size_t i)
+{
+    return (uint8_t)(seq * 7 + i);
+}
+
+static void fill_record(uint8_t *dst, uint32_t seq, size_t len)
+{
+    memcpy(dst, &seq, sizeof(seq));
+    dst[4] = (uint8_t)len;
+    for (size_t i = 5; i < len; i++)
+        dst[i] = pattern(seq, i);
+}
+
+static void check_record(disk_t *d, const uint8_t *rec, size_t len)
+{
+    uint32_t seq;
+    memcpy(&seq, rec, sizeof(seq));
+
+    if ((int64_t)seq <= d->last_seq || seq % d->num_files != d->index ||
+        len != record_len(seq))
+        d->corrupt = true;
+
+    for (size_t i = 5; i < len && !d->corrupt; i++) {
+        if (rec[i] != pattern(seq, i))
+            d->corrupt = true;
+    }
+
+    if (seq < d->num_essential)
+        d->essential_seen++;
+
+    d->last_seq = seq;
+    d->records++;
+    d->bytes += len;
+}
+
+/* Drains a pipe at a limited rate, verifying each record. */
+static void *disk_thread(void *arg)
+{
+    disk_t *d = arg;
+    uint8_t buf[DISK_READ_BYTES + MAX_RECORD_BYTES];
+    size_t len = 0;
+    const double start = now_s();
+    uint64_t total = 0;
+    ssize_t n;
+
+    while ((n = read(d->fd, &buf[len], DISK_READ_BYTES)) > 0) {
+        size_t pos = 0;
+
+        len += n;
+        total += n;
+
+        while (len - pos >= MIN_RECORD_BYTES && len - pos >= buf[pos + 4]) {
+            if (buf[pos + 4] < MIN_RECORD_BYTES) {
+                d->corrupt = true;
+                return NULL;
+            }
+            check_record(d, &buf[pos], buf[pos + 4]);
+            pos += buf[pos + 4];
+        }
+
+        memmove(buf, &buf[pos], len - pos);
+        len -= pos;
+
+        if (d->rate != UNLIMITED) {
+            const double due = start + total / d->rate;
+            const double t = now_s();
+            if (due > t)
+                usleep((useconds_t)((due - t) * 1e6));
+        }
+    }
+
+    if (len != 0)
+        d->corrupt = true;
+
+    return NULL;
+}
+
+/* The fake endpoint: pushes records at the line rate, never faster. */
+static void replay_records(const test_case_t *tc, ring_writer_t *writer,
+                           double *max_push_s)
+{
+    const double start = now_s();
+    uint64_t bytes = 0;
+
+    *max_push_s = 0;
+
+    for (uint32_t seq = 0; seq < tc->num_records; seq++) {
+        const size_t len = record_len(seq);
+
+        if (seq % PACING_RECORDS == 0) {
+            const double due = start + bytes / tc->line_rate;
+            while (now_s() < due)
+                ;
+        }
+
+        const double t = now_s();
+        uint8_t *dst = ring_writer_reserve(writer, seq % tc->num_files, len,
+                                           seq < tc->num_essential);
+        if (dst != NULL) {
+            fill_record(dst, seq, len);
+            ring_writer_commit(writer);
+        }
+
+        if (now_s() - t > *max_push_s)
+            *max_push_s = now_s() - t;
+
+        bytes += len;
+    }
+}
+
+static bool run_test(const test_case_t *tc)
+{
+    FILE *files[MAX_FILES];
+    disk_t disks[MAX_FILES];
+    pthread_t threads[MAX_FILES];
+    ring_writer_stats_t stats;
+    double max_push_s;
+    bool ok = true;
+
+    for (unsigned i = 0; i < tc->num_files; i++) {
+        int fds[2];
+
+        if (pipe(fds) != 0)
+            return false;
+
+        memset(&disks[i], 0, sizeof(disks[i]));
+        disks[i].fd = fds[0];
+        disks[i].index = i;
+        disks[i].num_files = tc->num_files;
+        disks[i].rate = tc->disk_rate;
+        disks[i].num_essential = tc->num_essential;
+        disks[i].last_seq = -1;
+        files[i] = fdopen(fds[1], "wb");
+        pthread_create(&threads[i], NULL, disk_thread, &disks[i]);
+    }
+
+    ring_writer_t *writer = ring_writer_create(tc->ring_bytes, tc->policy,
+                                               files, tc->num_files);
+    if (writer == NULL)
+        return false;
+
+    const double start = now_s();
+    replay_records(tc, writer, &max_push_s);
+    const double replayed = now_s() - start;
+    ring_writer_destroy(writer, &stats);
+
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+    uint64_t essential = 0;
+    int64_t last_seq = -1;
+
+    for (unsigned i = 0; i < tc->num_files; i++) {
+        fclose(files[i]);
+        pthread_join(threads[i], NULL);
+        close(disks[i].fd);
+
+        ok = ok && !disks[i].corrupt;
+        records += disks[i].records;
+        bytes += disks[i].bytes;
+        essential += disks[i].essential_seen;
+        if (disks[i].last_seq > last_seq)
+            last_seq = disks[i].last_seq;
+    }
+
+    printf("%s: %llu/%u written, %llu dropped, %llu waits, "
+           "peak %zu of %zu bytes, replay %.3f s, longest push %.3f ms\n",
+           tc->name, (unsigned long long)records, tc->num_records,
+           (unsigned long long)stats.records_dropped,
+           (unsigned long long)stats.waits, stats.high_watermark,
+           stats.capacity, replayed, max_push_s * 1e3);
+
+    ok = ok && stats.records_pushed == tc->num_records;
+    ok = ok && stats.records_written == records && stats.bytes_written == bytes;
+    ok = ok && records + stats.records_dropped == tc->num_records;
+    ok = ok && stats.write_errors == 0 && stats.queued_bytes == 0;
+    ok = ok && stats.high_watermark <= stats.capacity;
+    ok = ok && essential == tc->num_essential;
+
+    if (tc->policy == RING_WRITER_BLOCK) {
+        ok = ok && stats.records_dropped == 0;
+    } else {
+        // The disk is slower than the link: the ring must overflow, but the
+        // endpoint must never wait once past the essential records
+        ok = ok && stats.records_dropped > 0 && stats.waits == 0;
+    }
+
+    if (tc->policy == RING_WRITER_BLOCK && tc->disk_rate != UNLIMITED)
+        ok = ok && stats.waits > 0;
+
+    if (tc->policy == RING_WRITER_DROP_OLDEST)
+        ok = ok && last_seq == (int64_t)tc->num_records - 1;
+
+    printf("%s: %s\n", tc->name, ok ? "PASS" : "FAIL");
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++)
+        ok = run_test(&test_cases[i]) && ok;
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,460 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace_stats.h"
+
+/*
+ * PSF event codes, taken from Tracealyzer's trcKernelPort.h. The upper 4 bits
+ * of the 16-bit event ID hold the parameter count and are masked off.
+ */
+#define PSF_EVENT_CODE_MASK         0x0FFF
+#define PSF_EVENT_OBJ_NAME          0x03
+#define PSF_EVENT_DEFINE_ISR        0x07
+#define PSF_EVENT_ISR_BEGIN         0x33
+#define PSF_EVENT_ISR_RESUME        0x34
+#define PSF_EVENT_TS_BEGIN          0x35
+#define PSF_EVENT_TS_RESUME         0x36
+#define PSF_EVENT_TASK_ACTIVATE     0x37
+
+#define PSF_EVENT_HEADER_BYTES      8
+#define IDLE_TASK_PREFIX            "IDLE"
+
+bool trace_stats_init(trace_stats_t *stats, uint32_t num_cores,
+                      uint32_t frequency)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->frequency = (frequency > 0) ? frequency : 1;
+    stats->num_cores = num_cores;
+    stats->cores = calloc(num_cores ? num_cores : 1, sizeof(*stats->cores));
+
+    for (uint32_t i = 0; i < num_cores && stats->cores; i++)
+        stats->cores[i].task = -1;
+
+    return stats->cores != NULL;
+}
+
+void trace_stats_free(trace_stats_t *stats)
+{
+    free(stats->cores);
+    free(stats->objects);
+    free(stats->slots);
+    memset(stats, 0, sizeof(*stats));
+}
+
+static size_t slot_of(const trace_stats_t *stats, uint32_t handle)
+{
+    // Fibonacci hashing; handles are often aligned addresses
+    const size_t mask = stats->num_slots - 1;
+    size_t slot = (size_t)((handle * 2654435769u) >> 8) & mask;
+
+    while (stats->slots[slot] != 0 &&
+           stats->objects[stats->slots[slot] - 1].handle != handle)
+        slot = (slot + 1) & mask;
+
+    return slot;
+}
+
+static bool grow(trace_stats_t *stats)
+{
+    size_t max_objects = stats->max_objects ? 2 * stats->max_objects : 64;
+    void *objects = realloc(stats->objects,
+                            max_objects * sizeof(*stats->objects));
+    int *slots = calloc(2 * max_objects, sizeof(*slots));
+
+    if (objects == NULL || slots == NULL) {
+        if (objects != NULL)
+            stats->objects = objects;
+        free(slots);
+        return false;
+    }
+
+    free(stats->slots);
+    stats->objects = objects;
+    stats->max_objects = max_objects;
+    stats->slots = slots;
+    stats->num_slots = 2 * max_objects;
+
+    for (size_t i = 0; i < stats->num_objects; i++)
+        stats->slots[slot_of(stats, stats->objects[i].handle)] = (int)i + 1;
+
+    return true;
+}
+
+static int find_object(trace_stats_t *stats, uint32_t handle)
+{
+    if (stats->num_slots > 0) {
+        size_t slot = slot_of(stats, handle);
+
+        if (stats->slots[slot] != 0)
+            return stats->slots[slot] - 1;
+    }
+
+    if (stats->num_objects == stats->max_objects && !grow(stats))
+        return -1;
+
+    trace_stats_object_t *obj = &stats->objects[stats->num_objects];
+    memset(obj, 0, sizeof(*obj));
+    obj->handle = handle;
+    obj->min_ticks = UINT64_MAX;
+    stats->slots[slot_of(stats, handle)] = (int)stats->num_objects + 1;
+
+    return (int)stats->num_objects++;
+}
+
+void trace_stats_symbol(trace_stats_t *stats, uint32_t handle,
+                        const char *name, size_t max_len)
+{
+    int i = find_object(stats, handle);
+    size_t n = 0;
+
+    if (i < 0)
+        return;
+
+    // Keep names safe to emit unquoted in CSV and unescaped in JSON
+    for (; n < max_len && n < TRACE_STATS_NAME_BYTES - 1 && name[n]; n++) {
+        char c = name[n];
+        stats->objects[i].name[n] =
+                (c < 0x20 || c > 0x7E || c == '"' || c == '\\' || c == ',') ?
+                '_' : c;
+    }
+    stats->objects[i].name[n] = '\0';
+}
+
+static bool is_idle(const trace_stats_object_t *obj)
+{
+    return strncmp(obj->name, IDLE_TASK_PREFIX,
+                   sizeof(IDLE_TASK_PREFIX) - 1) == 0;
+}
+
+static uint64_t ticks_to_us(const trace_stats_t *stats, uint64_t ticks)
+{
+    return (ticks * 1000000) / stats->frequency;
+}
+
+/* Charge the time since the core's previous event to what was running. */
+static void attribute(trace_stats_t *stats, trace_stats_core_t *core)
+{
+    uint64_t delta = core->now - core->mark;
+
+    core->mark = core->now;
+
+    if (core->isr_depth > 0) {
+        core->busy_ticks += delta;
+    } else if (core->task >= 0) {
+        trace_stats_object_t *task = &stats->objects[core->task];
+
+        task->ticks += delta;
+        if (!is_idle(task))
+            core->busy_ticks += delta;
+    }
+}
+
+static void isr_exit(trace_stats_t *stats, trace_stats_core_t *core)
+{
+    core->isr_depth--;
+
+    int i = core->isr[core->isr_depth];
+    if (i < 0)
+        return;
+
+    trace_stats_object_t *isr = &stats->objects[i];
+    uint64_t ticks = core->now - core->isr_begin[core->isr_depth];
+    uint64_t us = ticks_to_us(stats, ticks);
+    int bucket = 0;
+
+    while (us > 0 && bucket < TRACE_STATS_HIST_BUCKETS - 1) {
+        us >>= 1;
+        bucket++;
+    }
+
+    isr->count++;
+    isr->ticks += ticks;
+    isr->hist[bucket]++;
+    if (ticks < isr->min_ticks)
+        isr->min_ticks = ticks;
+    if (ticks > isr->max_ticks)
+        isr->max_ticks = ticks;
+}
+
+static void task_switch(trace_stats_t *stats, trace_stats_core_t *core,
+                        uint32_t handle)
+{
+    // Resuming a task ends all ISRs that were active on the core
+    while (core->isr_depth > 0)
+        isr_exit(stats, core);
+
+    int i = find_object(stats, handle);
+
+    if (i >= 0 && i != core->task) {
+        stats->objects[i].count++;
+        core->switches++;
+    }
+
+    core->task = i;
+}
+
+static void isr_begin(trace_stats_t *stats, trace_stats_core_t *core,
+                      uint32_t handle)
+{
+    if (core->isr_depth == TRACE_STATS_MAX_ISR_DEPTH)
+        return;
+
+    int i = find_object(stats, handle);
+    if (i >= 0)
+        stats->objects[i].is_isr = true;
+
+    core->isr[core->isr_depth] = i;
+    core->isr_begin[core->isr_depth] = core->now;
+    core->isr_depth++;
+}
+
+static void isr_resume(trace_stats_t *stats, trace_stats_core_t *core,
+                       uint32_t handle)
+{
+    // Unwind to the resumed ISR, which stays active
+    while (core->isr_depth > 1) {
+        isr_exit(stats, core);
+
+        int i = core->isr[core->isr_depth - 1];
+        if (i >= 0 && stats->objects[i].handle == handle)
+            break;
+    }
+}
+
+void trace_stats_event(trace_stats_t *stats, const uint8_t *event, size_t len)
+{
+    uint16_t id;
+    uint32_t timestamp;
+    uint32_t param = 0;
+
+    if (len < PSF_EVENT_HEADER_BYTES)
+        return;
+
+    memcpy(&id, &event[0], sizeof(id));
+    memcpy(&timestamp, &event[4], sizeof(timestamp));
+    if (len >= PSF_EVENT_HEADER_BYTES + sizeof(param))
+        memcpy(&param, &event[PSF_EVENT_HEADER_BYTES], sizeof(param));
+
+    uint32_t core_id = event[3] >> 4;
+    stats->events++;
+
+    if (core_id >= stats->num_cores)
+        return;
+
+    trace_stats_core_t *core = &stats->cores[core_id];
+
+    if (!core->started) {
+        core->started = true;
+        core->first = core->now = core->mark = timestamp;
+    } else if ((uint32_t)(timestamp - core->last_timestamp) < 0x80000000u) {
+        // Small backwards steps (reordering) are ignored, not wraparounds
+        core->now += (uint32_t)(timestamp - core->last_timestamp);
+    } else {
+        timestamp = core->last_timestamp;
+    }
+    core->last_timestamp = timestamp;
+
+    attribute(stats, core);
+
+    if (len < PSF_EVENT_HEADER_BYTES + sizeof(param))
+        return;
+
+    switch (id & PSF_EVENT_CODE_MASK) {
+    case PSF_EVENT_TS_BEGIN:
+    case PSF_EVENT_TS_RESUME:
+    case PSF_EVENT_TASK_ACTIVATE:
+        task_switch(stats, core, param);
+        break;
+    case PSF_EVENT_ISR_BEGIN:
+        isr_begin(stats, core, param);
+        break;
+    case PSF_EVENT_ISR_RESUME:
+        isr_resume(stats, core, param);
+        break;
+    case PSF_EVENT_OBJ_NAME:
+        trace_stats_symbol(stats, param,
+                           (const char *)&event[PSF_EVENT_HEADER_BYTES + 4],
+                           len - PSF_EVENT_HEADER_BYTES - 4);
+        break;
+    case PSF_EVENT_DEFINE_ISR:
+        // Parameters: handle, priority, name
+        if (len > PSF_EVENT_HEADER_BYTES + 8) {
+            trace_stats_symbol(stats, param,
+                               (const char *)&event[PSF_EVENT_HEADER_BYTES + 8],
+                               len - PSF_EVENT_HEADER_BYTES - 8);
+            int i = find_object(stats, param);
+            if (i >= 0)
+                stats->objects[i].is_isr = true;
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/* The longest span observed on any core, in ticks. */
+static uint64_t duration_ticks(const trace_stats_t *stats)
+{
+    uint64_t duration = 0;
+
+    for (uint32_t i = 0; i < stats->num_cores; i++) {
+        const trace_stats_core_t *core = &stats->cores[i];
+        if (core->started && core->now - core->first > duration)
+            duration = core->now - core->first;
+    }
+
+    return duration;
+}
+
+static double percent(uint64_t part, uint64_t whole)
+{
+    return whole ? (100.0 * part) / whole : 0.0;
+}
+
+static double rate_hz(const trace_stats_t *stats, uint64_t count,
+                      uint64_t ticks)
+{
+    return ticks ? ((double)count * stats->frequency) / ticks : 0.0;
+}
+
+static double to_s(const trace_stats_t *stats, uint64_t ticks)
+{
+    return (double)ticks / stats->frequency;
+}
+
+static double to_us(const trace_stats_t *stats, uint64_t ticks)
+{
+    return (1e6 * ticks) / stats->frequency;
+}
+
+static bool is_reported_task(const trace_stats_object_t *obj)
+{
+    return !obj->is_isr && (obj->count > 0 || obj->ticks > 0);
+}
+
+static bool is_reported_isr(const trace_stats_object_t *obj)
+{
+    return obj->is_isr && obj->count > 0;
+}
+
+bool trace_stats_write_json(const trace_stats_t *stats, FILE *file)
+{
+    const uint64_t duration = duration_ticks(stats);
+    const char *sep = "";
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"frequency\": %u,\n", stats->frequency);
+    fprintf(file, "  \"duration_s\": %.6f,\n", to_s(stats, duration));
+    fprintf(file, "  \"events\": %llu,\n",
+            (unsigned long long)stats->events);
+    fprintf(file, "  \"missing_events\": %llu,\n",
+            (unsigned long long)stats->missing_events);
+
+    fprintf(file, "  \"cores\": [");
+    for (uint32_t i = 0; i < stats->num_cores; i++) {
+        const trace_stats_core_t *core = &stats->cores[i];
+        const uint64_t span = core->now - core->first;
+
+        fprintf(file, "%s\n    {\"core\": %u, \"utilisation_percent\": %.2f, "
+                "\"busy_s\": %.6f, \"context_switches\": %llu, "
+                "\"switch_rate_hz\": %.1f}", sep, i,
+                percent(core->busy_ticks, span), to_s(stats, core->busy_ticks),
+                (unsigned long long)core->switches,
+                rate_hz(stats, core->switches, span));
+        sep = ",";
+    }
+    fprintf(file, "\n  ],\n");
+
+    sep = "";
+    fprintf(file, "  \"tasks\": [");
+    for (size_t i = 0; i < stats->num_objects; i++) {
+        const trace_stats_object_t *task = &stats->objects[i];
+
+        if (!is_reported_task(task))
+            continue;
+
+        fprintf(file, "%s\n    {\"handle\": \"0x%08X\", \"name\": \"%s\", "
+                "\"cpu_s\": %.6f, \"cpu_percent\": %.2f, "
+                "\"activations\": %llu}", sep, task->handle, task->name,
+                to_s(stats, task->ticks), percent(task->ticks, duration),
+                (unsigned long long)task->count);
+        sep = ",";
+    }
+    fprintf(file, "\n  ],\n");
+
+    sep = "";
+    fprintf(file, "  \"isrs\": [");
+    for (size_t i = 0; i < stats->num_objects; i++) {
+        const trace_stats_object_t *isr = &stats->objects[i];
+        const char *hist_sep = "";
+
+        if (!is_reported_isr(isr))
+            continue;
+
+        fprintf(file, "%s\n    {\"handle\": \"0x%08X\", \"name\": \"%s\", "
+                "\"count\": %llu, \"min_us\": %.3f, \"mean_us\": %.3f, "
+                "\"max_us\": %.3f, \"histogram\": [", sep, isr->handle,
+                isr->name, (unsigned long long)isr->count,
+                to_us(stats, isr->min_ticks),
+                to_us(stats, isr->ticks) / isr->count,
+                to_us(stats, isr->max_ticks));
+
+        for (int b = 0; b < TRACE_STATS_HIST_BUCKETS; b++) {
+            if (isr->hist[b] == 0)
+                continue;
+
+            fprintf(file, "%s{\"from_us\": %llu, \"count\": %llu}", hist_sep,
+                    b ? (1ULL << (b - 1)) : 0ULL,
+                    (unsigned long long)isr->hist[b]);
+            hist_sep = ", ";
+        }
+        fprintf(file, "]}");
+        sep = ",";
+    }
+    fprintf(file, "\n  ]\n}\n");
+
+    return !ferror(file);
+}
+
+bool trace_stats_write_csv(const trace_stats_t *stats, FILE *file)
+{
+    const uint64_t duration = duration_ticks(stats);
+
+    fprintf(file, "kind,id,name,count,rate_hz,total_us,percent,"
+                  "min_us,mean_us,max_us\n");
+
+    for (uint32_t i = 0; i < stats->num_cores; i++) {
+        const trace_stats_core_t *core = &stats->cores[i];
+        const uint64_t span = core->now - core->first;
+
+        fprintf(file, "core,%u,,%llu,%.1f,%.3f,%.2f,,,\n", i,
+                (unsigned long long)core->switches,
+                rate_hz(stats, core->switches, span),
+                to_us(stats, core->busy_ticks),
+                percent(core->busy_ticks, span));
+    }
+
+    for (size_t i = 0; i < stats->num_objects; i++) {
+        const trace_stats_object_t *obj = &stats->objects[i];
+
+        if (is_reported_task(obj)) {
+            fprintf(file, "task,0x%08X,%s,%llu,%.1f,%.3f,%.2f,,,\n",
+                    obj->handle, obj->name, (unsigned long long)obj->count,
+                    rate_hz(stats, obj->count, duration),
+                    to_us(stats, obj->ticks), percent(obj->ticks, duration));
+        } else if (is_reported_isr(obj)) {
+            fprintf(file, "isr,0x%08X,%s,%llu,%.1f,%.3f,%.2f,%.3f,%.3f,%.3f\n",
+                    obj->handle, obj->name, (unsigned long long)obj->count,
+                    rate_hz(stats, obj->count, duration),
+                    to_us(stats, obj->ticks), percent(obj->ticks, duration),
+                    to_us(stats, obj->min_ticks),
+                    to_us(stats, obj->ticks) / obj->count,
+                    to_us(stats, obj->max_ticks));
+        }
+    }
+
+    return !ferror(file);
+}
@@ -0,0 +1,86 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef TRACE_STATS_H_
+#define TRACE_STATS_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Runtime analytics computed from the PSF event stream while it is converted:
+ * per-task CPU time, per-core utilisation and context switch rate, and ISR
+ * entry-to-exit latency histograms.
+ *
+ * Time on each core is attributed to the context that was running since the
+ * previous event on that core: the innermost active ISR, otherwise the current
+ * task. Tasks named "IDLE*" do not count towards core utilisation. Time before
+ * the first task switch on a core is not attributed.
+ */
+
+/* Histogram buckets: [0, 1) us, then [2^(i-1), 2^i) us, the last is open. */
+#define TRACE_STATS_HIST_BUCKETS    24
+#define TRACE_STATS_MAX_ISR_DEPTH   8
+#define TRACE_STATS_NAME_BYTES      32
+
+typedef struct trace_stats_object {
+    uint32_t handle;
+    char name[TRACE_STATS_NAME_BYTES];
+    bool is_isr;
+    uint64_t ticks;             /* CPU time (tasks) or total latency (ISRs) */
+    uint64_t count;             /* Activations (tasks) or invocations (ISRs) */
+    uint64_t min_ticks;
+    uint64_t max_ticks;
+    uint64_t hist[TRACE_STATS_HIST_BUCKETS];
+} trace_stats_object_t;
+
+typedef struct trace_stats_core {
+    bool started;
+    uint32_t last_timestamp;
+    uint64_t first;             /* Extended timestamps */
+    uint64_t now;
+    uint64_t mark;              /* Start of the current attribution period */
+    int task;                   /* Object index of the running task, or -1 */
+    int isr_depth;
+    int isr[TRACE_STATS_MAX_ISR_DEPTH];
+    uint64_t isr_begin[TRACE_STATS_MAX_ISR_DEPTH];
+    uint64_t busy_ticks;
+    uint64_t switches;
+} trace_stats_core_t;
+
+typedef struct trace_stats {
+    uint32_t frequency;
+    uint32_t num_cores;
+    trace_stats_core_t *cores;
+    trace_stats_object_t *objects;
+    size_t num_objects;
+    size_t max_objects;
+    int *slots;                 /* Open addressing: object index + 1, 0 free */
+    size_t num_slots;
+    uint64_t events;
+    uint64_t missing_events;
+} trace_stats_t;
+
+bool trace_stats_init(trace_stats_t *stats, uint32_t num_cores,
+                      uint32_t frequency);
+
+void trace_stats_free(trace_stats_t *stats);
+
+/* Name the task or ISR with `handle`, e.g. from the PSF symbol table. */
+void trace_stats_symbol(trace_stats_t *stats, uint32_t handle,
+                        const char *name, size_t max_len);
+
+/* Account for a single PSF event of `len` bytes. */
+void trace_stats_event(trace_stats_t *stats, const uint8_t *event, size_t len);
+
+bool trace_stats_write_json(const trace_stats_t *stats, FILE *file);
+
+/*
+ * One row per core, task and ISR with the columns:
+ * kind,id,name,count,rate_hz,total_us,percent,min_us,mean_us,max_us
+ */
+bool trace_stats_write_csv(const trace_stats_t *stats, FILE *file);
+
+#endif /* TRACE_STATS_H_ */
@@ -0,0 +1,248 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VCD_DECODE_SSE2         1
+#endif
+
+#include "vcd_decode.h"
+
+#define HEX_INVALID             0xFF
+
+/*
+ * Maps an ASCII character to its hex nibble value, or HEX_INVALID. Any
+ * invalid lookup sets bits in the upper nibble, which allows the scalar
+ * decoder to validate a whole record with a single test at the end.
+ */
+static const uint8_t hex_lut[256] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+};
+
+static inline bool is_delim(char c)
+{
+    return (c == ' ') || (c == '\n') || (c == '\r');
+}
+
+static inline bool is_digit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+bool vcd_is_end_of_header(const char *line, const char *end)
+{
+    const char end_of_header[] = "$enddefinitions";
+    const size_t len = sizeof(end_of_header) - 1;
+
+    while (line < end && is_delim(*line))
+        line++;
+
+    if ((size_t)(end - line) < len || memcmp(line, end_of_header, len) != 0)
+        return false;
+
+    line += len;
+    return (line == end) || is_delim(*line);
+}
+
+bool vcd_parse_record(const char *line, const char *end, vcd_record_t *record)
+{
+    const char *p = line;
+    size_t num_bytes = 0;
+    unsigned int probe_id = 0;
+
+    if (p >= end || *p++ != 'l')
+        return false;
+
+    // Length field
+    if (p >= end || !is_digit(*p))
+        return false;
+
+    while (p < end && is_digit(*p))
+        num_bytes = (num_bytes * 10) + (*p++ - '0');
+
+    if (p >= end || *p != ' ')
+        return false;
+
+    while (p < end && *p == ' ')
+        p++;
+
+    // Hex-string field; this must be exactly twice the announced length
+    const char *hex = p;
+
+    while (p < end && !is_delim(*p))
+        p++;
+
+    if ((size_t)(p - hex) != (num_bytes << 1))
+        return false;
+
+    while (p < end && *p == ' ')
+        p++;
+
+    // Probe ID field
+    if (p >= end || !is_digit(*p))
+        return false;
+
+    while (p < end && is_digit(*p))
+        probe_id = (probe_id * 10) + (*p++ - '0');
+
+    if (p < end && !is_delim(*p))
+        return false;
+
+    record->hex = hex;
+    record->num_bytes = num_bytes;
+    record->probe_id = probe_id;
+
+    return true;
+}
+
+static inline bool hex_decode_lut(uint8_t *dst, const char *src,
+                                  size_t num_bytes)
+{
+    const unsigned char *s = (const unsigned char *)src;
+    uint8_t invalid = 0;
+
+    for (size_t i = 0; i < num_bytes; i++) {
+        uint8_t hi = hex_lut[s[i << 1]];
+        uint8_t lo = hex_lut[s[(i << 1) + 1]];
+
+        invalid |= hi | lo;
+        dst[i] = (uint8_t)((hi << 4) | (lo & 0x0F));
+    }
+
+    return (invalid & 0xF0) == 0;
+}
+
+#if defined(__AVX2__)
+
+/*
+ * Converts 32 characters into 16 bytes. Each character is classified as a
+ * decimal digit or a (case-folded) 'a'-'f' letter via unsigned saturating
+ * compares; anything else fails the mask test.
+ */
+static inline bool hex_decode_32(uint8_t *dst, const char *src)
+{
+    const __m256i ascii_0 = _mm256_set1_epi8('0');
+    const __m256i ascii_a = _mm256_set1_epi8('a');
+    const __m256i case_bit = _mm256_set1_epi8(0x20);
+    const __m256i nine = _mm256_set1_epi8(9);
+    const __m256i five = _mm256_set1_epi8(5);
+    const __m256i ten = _mm256_set1_epi8(10);
+    const __m256i lo_mask = _mm256_set1_epi16(0x00F0);
+
+    __m256i v = _mm256_loadu_si256((const __m256i *)src);
+
+    __m256i d = _mm256_sub_epi8(v, ascii_0);
+    __m256i is_d = _mm256_cmpeq_epi8(_mm256_min_epu8(d, nine), d);
+    __m256i a = _mm256_sub_epi8(_mm256_or_si256(v, case_bit), ascii_a);
+    __m256i is_a = _mm256_cmpeq_epi8(_mm256_min_epu8(a, five), a);
+
+    if ((uint32_t)_mm256_movemask_epi8(_mm256_or_si256(is_d, is_a)) !=
+        0xFFFFFFFF)
+        return false;
+
+    __m256i nib = _mm256_or_si256(_mm256_and_si256(is_d, d),
+                                  _mm256_and_si256(is_a,
+                                                   _mm256_add_epi8(a, ten)));
+
+    // Even characters are the high nibble, odd characters the low nibble
+    __m256i bytes = _mm256_or_si256(
+            _mm256_and_si256(_mm256_slli_epi16(nib, 4), lo_mask),
+            _mm256_srli_epi16(nib, 8));
+
+    __m256i packed = _mm256_packus_epi16(bytes, bytes);
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    _mm_storeu_si128((__m128i *)dst, _mm256_castsi256_si128(packed));
+
+    return true;
+}
+
+#elif defined(VCD_DECODE_SSE2)
+
+/*
+ * Converts 16 characters into 8 bytes. See the AVX2 variant for details.
+ */
+static inline bool hex_decode_16(uint8_t *dst, const char *src)
+{
+    const __m128i ascii_0 = _mm_set1_epi8('0');
+    const __m128i ascii_a = _mm_set1_epi8('a');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i nine = _mm_set1_epi8(9);
+    const __m128i five = _mm_set1_epi8(5);
+    const __m128i ten = _mm_set1_epi8(10);
+    const __m128i lo_mask = _mm_set1_epi16(0x00F0);
+
+    __m128i v = _mm_loadu_si128((const __m128i *)src);
+
+    __m128i d = _mm_sub_epi8(v, ascii_0);
+    __m128i is_d = _mm_cmpeq_epi8(_mm_min_epu8(d, nine), d);
+    __m128i a = _mm_sub_epi8(_mm_or_si128(v, case_bit), ascii_a);
+    __m128i is_a = _mm_cmpeq_epi8(_mm_min_epu8(a, five), a);
+
+    if (_mm_movemask_epi8(_mm_or_si128(is_d, is_a)) != 0xFFFF)
+        return false;
+
+    __m128i nib = _mm_or_si128(_mm_and_si128(is_d, d),
+                               _mm_and_si128(is_a, _mm_add_epi8(a, ten)));
+
+    __m128i bytes = _mm_or_si128(
+            _mm_and_si128(_mm_slli_epi16(nib, 4), lo_mask),
+            _mm_srli_epi16(nib, 8));
+
+    _mm_storel_epi64((__m128i *)dst, _mm_packus_epi16(bytes, bytes));
+
+    return true;
+}
+
+#endif
+
+bool vcd_hex_decode(uint8_t *dst, const char *src, size_t num_bytes)
+{
+    size_t i = 0;
+
+#if defined(__AVX2__)
+    for (; i + 16 <= num_bytes; i += 16) {
+        if (!hex_decode_32(&dst[i], &src[i << 1]))
+            return false;
+    }
+#elif defined(VCD_DECODE_SSE2)
+    for (; i + 8 <= num_bytes; i += 8) {
+        if (!hex_decode_16(&dst[i], &src[i << 1]))
+            return false;
+    }
+#endif
+
+    return hex_decode_lut(&dst[i], &src[i << 1], num_bytes - i);
+}
+
+const char *vcd_hex_decode_kernel(void)
+{
+#if defined(__AVX2__)
+    return "avx2";
+#elif defined(VCD_DECODE_SSE2)
+    return "sse2";
+#else
+    return "lut";
+#endif
+}
@@ -0,0 +1,55 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef VCD_DECODE_H_
+#define VCD_DECODE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A byte record as written to an xscope VCD file, e.g.:
+ *
+ *     l4 00465350 0
+ *
+ * The fields reference the source line directly; nothing is copied.
+ */
+typedef struct vcd_record {
+    const char *hex;        /* Start of the hex-string (not NUL terminated). */
+    size_t num_bytes;       /* Decoded length announced by the 'l' field. */
+    unsigned int probe_id;  /* The xscope probe that emitted the record. */
+} vcd_record_t;
+
+/*
+ * Returns true if the line spanning [line, end) is the "$enddefinitions"
+ * command which terminates the VCD header.
+ */
+bool vcd_is_end_of_header(const char *line, const char *end);
+
+/*
+ * Parse a record line in place. The line spans [line, end) and may or may not
+ * include the trailing newline. Returns false when the line is not a
+ * well-formed record, including when the hex-string length does not match the
+ * announced length.
+ */
+bool vcd_parse_record(const char *line, const char *end, vcd_record_t *record);
+
+/*
+ * Convert `num_bytes * 2` hex characters at `src` into `num_bytes` bytes at
+ * `dst`. Both upper and lower case digits are accepted. Returns false if a
+ * non-hex character is encountered, in which case the contents of `dst` are
+ * undefined.
+ *
+ * Uses AVX2 or SSE2 when the compiler targets them, and a lookup table
+ * otherwise (and for the tail of each record).
+ */
+bool vcd_hex_decode(uint8_t *dst, const char *src, size_t num_bytes);
+
+/*
+ * Returns the name of the decode kernel selected at compile time
+ * ("avx2", "sse2" or "lut").
+ */
+const char *vcd_hex_decode_kernel(void);
+
+#endif /* VCD_DECODE_H_ */
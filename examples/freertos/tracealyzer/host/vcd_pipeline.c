@@ -0,0 +1,680 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "vcd_decode.h"
+#include "vcd_pipeline.h"
+#include "spsc_ring.h"
+
+#define HEADER_LINE_BUFFER_BYTES    4096
+
+/*
+ * The number of batches in circulation per decode worker. This bounds memory
+ * use and allows the split stage to run ahead of the slowest worker.
+ */
+#define BATCHES_PER_WORKER          2
+#define BATCHES_EXTRA               4
+
+typedef struct batch_record {
+    size_t offset;              /* Offset of the decoded bytes in batch->out */
+    size_t len;
+    size_t line;                /* Line index within the batch */
+    unsigned probe;             /* Position in config->probe_ids */
+    vcd_pipeline_record_status_t status;
+} batch_record_t;
+
+typedef struct batch {
+    const char *text;           /* Whole lines of VCD text */
+    size_t text_len;
+    char *text_buf;             /* Backing store when reading from a FILE */
+    size_t text_cap;
+
+    unsigned char *out;         /* Decoded PSF bytes, contiguous */
+    size_t out_len;
+    size_t out_cap;
+
+    batch_record_t *recs;
+    size_t num_recs;
+    size_t recs_cap;
+    size_t num_lines;
+} batch_t;
+
+typedef struct pipeline {
+    const vcd_pipeline_config_t *config;
+    const char *in_data;
+    size_t in_size;
+    FILE *in_file;
+    FILE *const *out_files;
+    int16_t probe_index[VCD_PIPELINE_MAX_PROBE_ID + 1];  /* -1 if skipped */
+
+    batch_t *batches;
+    size_t num_batches;
+
+    spsc_ring_t free_ring;      /* write --> split */
+    spsc_ring_t *work_rings;    /* split --> decode[i] */
+    spsc_ring_t *done_rings;    /* decode[i] --> validate */
+    spsc_ring_t write_ring;     /* validate --> write */
+
+    atomic_bool abort;
+    atomic_int error;
+    long long header_lines;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t bytes_lost;
+} pipeline_t;
+
+typedef struct worker {
+    pipeline_t *p;
+    unsigned index;
+} worker_t;
+
+static bool ring_push_wait(pipeline_t *p, spsc_ring_t *ring, void *item)
+{
+    unsigned spins = 0;
+
+    while (!spsc_ring_push(ring, item)) {
+        if (atomic_load_explicit(&p->abort, memory_order_relaxed))
+            return false;
+        spsc_ring_backoff(&spins);
+    }
+
+    return true;
+}
+
+static bool ring_pop_wait(pipeline_t *p, spsc_ring_t *ring, void **item,
+                          bool abortable)
+{
+    unsigned spins = 0;
+
+    while (!spsc_ring_pop(ring, item)) {
+        if (abortable &&
+            atomic_load_explicit(&p->abort, memory_order_relaxed))
+            return false;
+        spsc_ring_backoff(&spins);
+    }
+
+    return true;
+}
+
+/*
+ * As ring_pop_wait(), calling the idle callback every VCD_PIPELINE_IDLE_MS
+ * once the wait has become long enough to sleep.
+ */
+static bool ring_pop_wait_idle(pipeline_t *p, spsc_ring_t *ring, void **item)
+{
+    const vcd_pipeline_config_t *cfg = p->config;
+    struct timespec last = {0};
+    unsigned spins = 0;
+
+    while (!spsc_ring_pop(ring, item)) {
+        if (atomic_load_explicit(&p->abort, memory_order_relaxed))
+            return false;
+
+        if (spsc_ring_backoff(&spins) && cfg->idle_cb != NULL) {
+            struct timespec now;
+
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if ((now.tv_sec - last.tv_sec) * 1000 +
+                (now.tv_nsec - last.tv_nsec) / 1000000 >= VCD_PIPELINE_IDLE_MS) {
+                cfg->idle_cb(cfg->ctx);
+                last = now;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void pipeline_abort(pipeline_t *p)
+{
+    atomic_store(&p->abort, true);
+}
+
+/*
+ * Returns the end of the last complete line in [buf, buf + len), or NULL.
+ */
+static const char *find_last_line_end(const char *buf, size_t len)
+{
+    while (len > 0) {
+        if (buf[--len] == '\n')
+            return &buf[len + 1];
+    }
+
+    return NULL;
+}
+
+/*
+ * Split stage, file source. The VCD header is consumed line by line, after
+ * which the file is read in blocks; any partial line at the end of a block is
+ * carried over to the next batch. The carry is always shorter than a block,
+ * as a block without any newline is passed on whole.
+ */
+static void split_file(pipeline_t *p, uint64_t *seq)
+{
+    const vcd_pipeline_config_t *cfg = p->config;
+    const size_t block = cfg->batch_bytes;
+    char line[HEADER_LINE_BUFFER_BYTES];
+    char *carry = malloc(block);
+    size_t carry_len = 0;
+    bool stop = false;
+
+    if (carry == NULL) {
+        atomic_store(&p->error, -1);
+        pipeline_abort(p);
+        return;
+    }
+
+    while (!stop) {
+        if (fgets(line, sizeof(line), p->in_file) == NULL) {
+            if (!cfg->follow || !cfg->wait_cb(cfg->ctx)) {
+                stop = true;
+                break;
+            }
+            clearerr(p->in_file);
+            continue;
+        }
+
+        p->header_lines++;
+        if (vcd_is_end_of_header(line, line + strlen(line)))
+            break;
+    }
+
+    while (!stop) {
+        batch_t *batch;
+        size_t len = carry_len;
+        size_t complete = 0;
+
+        if (!ring_pop_wait(p, &p->free_ring, (void **)&batch, true))
+            break;
+
+        if (batch->text_buf == NULL) {
+            batch->text_cap = block;
+            batch->text_buf = malloc(batch->text_cap);
+
+            if (batch->text_buf == NULL) {
+                atomic_store(&p->error, -1);
+                pipeline_abort(p);
+                break;
+            }
+        }
+
+        memcpy(batch->text_buf, carry, carry_len);
+        carry_len = 0;
+
+        while (1) {
+            size_t n = fread(&batch->text_buf[len], 1, block - len,
+                             p->in_file);
+            const char *line_end;
+
+            len += n;
+            line_end = find_last_line_end(batch->text_buf, len);
+
+            if (line_end != NULL) {
+                complete = line_end - batch->text_buf;
+                break;
+            }
+
+            // A line longer than a block is passed on as is
+            if (len >= block) {
+                complete = len;
+                break;
+            }
+
+            if (ferror(p->in_file)) {
+                atomic_store(&p->error, -1);
+                pipeline_abort(p);
+                stop = true;
+                break;
+            }
+
+            if (!cfg->follow) {
+                complete = len;
+                stop = true;
+                break;
+            }
+
+            clearerr(p->in_file);
+            if (n == 0 && !cfg->wait_cb(cfg->ctx)) {
+                complete = len;
+                stop = true;
+                break;
+            }
+        }
+
+        if (complete == 0)
+            break;
+
+        carry_len = len - complete;
+        memcpy(carry, &batch->text_buf[complete], carry_len);
+
+        batch->text = batch->text_buf;
+        batch->text_len = complete;
+        p->bytes_in += complete;
+
+        if (!ring_push_wait(p, &p->work_rings[*seq % cfg->num_workers], batch))
+            break;
+        (*seq)++;
+    }
+
+    free(carry);
+}
+
+/*
+ * Split stage, in-memory source. Batches reference the mapping directly.
+ */
+static void split_mapped(pipeline_t *p, uint64_t *seq)
+{
+    const vcd_pipeline_config_t *cfg = p->config;
+    const char *pos = p->in_data;
+    const char *end = p->in_data + p->in_size;
+
+    while (pos < end) {
+        const char *eol = memchr(pos, '\n', end - pos);
+        const char *line_end = (eol != NULL) ? eol : end;
+        bool end_of_header = vcd_is_end_of_header(pos, line_end);
+
+        p->header_lines++;
+        pos = (eol != NULL) ? eol + 1 : end;
+
+        if (end_of_header)
+            break;
+    }
+
+    while (pos < end) {
+        batch_t *batch;
+        size_t len = end - pos;
+
+        if (len > cfg->batch_bytes) {
+            const char *from = pos + cfg->batch_bytes - 1;
+            const char *eol = memchr(from, '\n', end - from);
+            len = (eol != NULL) ? (size_t)(eol - pos + 1) : (size_t)(end - pos);
+        }
+
+        if (!ring_pop_wait(p, &p->free_ring, (void **)&batch, true))
+            break;
+
+        batch->text = pos;
+        batch->text_len = len;
+        p->bytes_in += len;
+        pos += len;
+
+        if (!ring_push_wait(p, &p->work_rings[*seq % cfg->num_workers], batch))
+            break;
+        (*seq)++;
+    }
+}
+
+static void *split_thread(void *arg)
+{
+    pipeline_t *p = arg;
+    uint64_t seq = 0;
+
+    if (p->in_data != NULL || p->in_file == NULL)
+        split_mapped(p, &seq);
+    else
+        split_file(p, &seq);
+
+    // Terminate every worker, in the order the validate stage will look
+    for (unsigned i = 0; i < p->config->num_workers; i++) {
+        unsigned w = (seq + i) % p->config->num_workers;
+        if (!ring_push_wait(p, &p->work_rings[w], NULL))
+            break;
+    }
+
+    return NULL;
+}
+
+static bool batch_add_record(batch_t *batch, size_t offset, size_t len,
+                             size_t line, unsigned probe,
+                             vcd_pipeline_record_status_t status)
+{
+    if (batch->num_recs == batch->recs_cap) {
+        size_t cap = batch->recs_cap ? batch->recs_cap * 2 : 1024;
+        batch_record_t *recs = realloc(batch->recs, cap * sizeof(*recs));
+
+        if (recs == NULL)
+            return false;
+
+        batch->recs = recs;
+        batch->recs_cap = cap;
+    }
+
+    batch_record_t *rec = &batch->recs[batch->num_recs++];
+    rec->offset = offset;
+    rec->len = len;
+    rec->line = line;
+    rec->probe = probe;
+    rec->status = status;
+
+    return true;
+}
+
+static bool decode_batch(pipeline_t *p, batch_t *batch)
+{
+    const char *pos = batch->text;
+    const char *end = batch->text + batch->text_len;
+
+    batch->out_len = 0;
+    batch->num_recs = 0;
+    batch->num_lines = 0;
+
+    // Two characters per byte; the decoded data can never exceed this
+    if (batch->out_cap < batch->text_len / 2) {
+        unsigned char *out = realloc(batch->out, batch->text_len / 2);
+
+        if (out == NULL)
+            return false;
+
+        batch->out = out;
+        batch->out_cap = batch->text_len / 2;
+    }
+
+    while (pos < end) {
+        const char *eol = memchr(pos, '\n', end - pos);
+        const char *line_end = (eol != NULL) ? eol : end;
+        size_t line = batch->num_lines++;
+        vcd_record_t record;
+        bool ok = true;
+
+        if (pos[0] != 'l') {
+            pos = line_end + 1;
+            continue;
+        }
+
+        if (!vcd_parse_record(pos, line_end, &record)) {
+            ok = batch_add_record(batch, 0, 0, line, 0,
+                                  VCD_PIPELINE_RECORD_MALFORMED);
+        } else if (record.probe_id > VCD_PIPELINE_MAX_PROBE_ID ||
+                   p->probe_index[record.probe_id] < 0) {
+            ok = true;
+        } else if ((p->config->max_record_bytes > 0 &&
+                    record.num_bytes > p->config->max_record_bytes) ||
+                   !vcd_hex_decode(&batch->out[batch->out_len], record.hex,
+                                   record.num_bytes)) {
+            ok = batch_add_record(batch, 0, 0, line,
+                                  p->probe_index[record.probe_id],
+                                  VCD_PIPELINE_RECORD_MALFORMED);
+        } else {
+            ok = batch_add_record(batch, batch->out_len, record.num_bytes,
+                                  line, p->probe_index[record.probe_id],
+                                  VCD_PIPELINE_RECORD_VALID);
+            batch->out_len += record.num_bytes;
+        }
+
+        if (!ok)
+            return false;
+
+        pos = line_end + 1;
+    }
+
+    return true;
+}
+
+static void *decode_thread(void *arg)
+{
+    worker_t *w = arg;
+    pipeline_t *p = w->p;
+
+    while (1) {
+        batch_t *batch;
+
+        if (!ring_pop_wait(p, &p->work_rings[w->index], (void **)&batch, true))
+            break;
+
+        if (batch != NULL && !decode_batch(p, batch)) {
+            atomic_store(&p->error, -1);
+            pipeline_abort(p);
+            break;
+        }
+
+        if (!ring_push_wait(p, &p->done_rings[w->index], batch) ||
+            batch == NULL)
+            break;
+    }
+
+    return NULL;
+}
+
+static void write_bytes(pipeline_t *p, unsigned probe,
+                        const unsigned char *bytes, size_t len)
+{
+    size_t n = fwrite(bytes, 1, len, p->out_files[probe]);
+
+    p->bytes_out += n;
+    p->bytes_lost += len - n;
+}
+
+/* Write each run of consecutive records for the same probe at once. */
+static void write_demultiplexed(pipeline_t *p, const batch_t *batch)
+{
+    size_t start = 0;
+    size_t end = 0;
+    unsigned probe = 0;
+
+    for (size_t i = 0; i < batch->num_recs; i++) {
+        const batch_record_t *rec = &batch->recs[i];
+
+        if (rec->len == 0)
+            continue;
+
+        if (rec->offset + rec->len > batch->out_len)
+            break;
+
+        // Valid records are decoded back to back, so each run is contiguous
+        if (rec->probe != probe && end > start) {
+            write_bytes(p, probe, &batch->out[start], end - start);
+            start = end;
+        }
+
+        probe = rec->probe;
+        end = rec->offset + rec->len;
+    }
+
+    if (end > start)
+        write_bytes(p, probe, &batch->out[start], end - start);
+}
+
+static void *write_thread(void *arg)
+{
+    pipeline_t *p = arg;
+
+    /* The validate stage always terminates this stage with NULL, so batches
+     * already validated are written even when the pipeline is aborted. */
+    while (1) {
+        batch_t *batch;
+
+        ring_pop_wait(p, &p->write_ring, (void **)&batch, false);
+        if (batch == NULL)
+            break;
+
+        if (p->config->num_probes > 1)
+            write_demultiplexed(p, batch);
+        else if (batch->out_len > 0)
+            write_bytes(p, 0, batch->out, batch->out_len);
+
+        ring_push_wait(p, &p->free_ring, batch);
+    }
+
+    return NULL;
+}
+
+/*
+ * Validate stage; runs on the calling thread so that the record callback
+ * observes records in file order.
+ */
+static int validate(pipeline_t *p, long long *lines)
+{
+    const vcd_pipeline_config_t *cfg = p->config;
+    uint64_t seq = 0;
+    long long base = -1;
+    int res = 0;
+
+    while (res == 0) {
+        batch_t *batch;
+        unsigned w = seq % cfg->num_workers;
+
+        if (!ring_pop_wait_idle(p, &p->done_rings[w], (void **)&batch) ||
+            batch == NULL)
+            break;
+
+        // The header line count is published before the first batch
+        if (base < 0)
+            base = p->header_lines;
+
+        for (size_t i = 0; i < batch->num_recs; i++) {
+            batch_record_t *rec = &batch->recs[i];
+
+            res = cfg->record_cb(cfg->ctx, rec->status, rec->probe,
+                                 &batch->out[rec->offset], rec->len,
+                                 base + rec->line + 1);
+            if (res != 0) {
+                // Drop this record and everything after it
+                batch->out_len = rec->offset;
+                pipeline_abort(p);
+                break;
+            }
+        }
+
+        base += batch->num_lines;
+        ring_push_wait(p, &p->write_ring, batch);
+        seq++;
+    }
+
+    *lines = base;
+    ring_push_wait(p, &p->write_ring, NULL);
+
+    return res;
+}
+
+static bool pipeline_init(pipeline_t *p)
+{
+    const unsigned workers = p->config->num_workers;
+
+    p->num_batches = (workers * BATCHES_PER_WORKER) + BATCHES_EXTRA;
+    p->batches = calloc(p->num_batches, sizeof(batch_t));
+    p->work_rings = calloc(workers, sizeof(spsc_ring_t));
+    p->done_rings = calloc(workers, sizeof(spsc_ring_t));
+
+    if (p->batches == NULL || p->work_rings == NULL || p->done_rings == NULL)
+        return false;
+
+    // Every ring can hold all batches plus a terminating NULL
+    if (!spsc_ring_init(&p->free_ring, p->num_batches + 1) ||
+        !spsc_ring_init(&p->write_ring, p->num_batches + 1))
+        return false;
+
+    for (unsigned i = 0; i < workers; i++) {
+        if (!spsc_ring_init(&p->work_rings[i], p->num_batches + 1) ||
+            !spsc_ring_init(&p->done_rings[i], p->num_batches + 1))
+            return false;
+    }
+
+    for (size_t i = 0; i < p->num_batches; i++)
+        spsc_ring_push(&p->free_ring, &p->batches[i]);
+
+    return true;
+}
+
+static void pipeline_deinit(pipeline_t *p)
+{
+    if (p->batches != NULL) {
+        for (size_t i = 0; i < p->num_batches; i++) {
+            free(p->batches[i].text_buf);
+            free(p->batches[i].out);
+            free(p->batches[i].recs);
+        }
+        free(p->batches);
+    }
+
+    for (unsigned i = 0; i < p->config->num_workers; i++) {
+        if (p->work_rings != NULL)
+            spsc_ring_deinit(&p->work_rings[i]);
+        if (p->done_rings != NULL)
+            spsc_ring_deinit(&p->done_rings[i]);
+    }
+
+    free(p->work_rings);
+    free(p->done_rings);
+    spsc_ring_deinit(&p->free_ring);
+    spsc_ring_deinit(&p->write_ring);
+}
+
+int vcd_pipeline_run(const vcd_pipeline_config_t *config,
+                     const char *in_data, size_t in_size, FILE *in_file,
+                     FILE *const out_files[], vcd_pipeline_stats_t *stats)
+{
+    pipeline_t p;
+    pthread_t split_tid, write_tid;
+    pthread_t *decode_tids;
+    worker_t *workers;
+    long long lines = 0;
+    int res;
+
+    memset(&p, 0, sizeof(p));
+    p.config = config;
+    p.in_data = in_data;
+    p.in_size = in_size;
+    p.in_file = in_file;
+    p.out_files = out_files;
+    memset(p.probe_index, 0xFF, sizeof(p.probe_index));
+    atomic_init(&p.abort, false);
+    atomic_init(&p.error, 0);
+
+    decode_tids = calloc(config->num_workers, sizeof(pthread_t));
+    workers = calloc(config->num_workers, sizeof(worker_t));
+
+    if (decode_tids == NULL || workers == NULL || !pipeline_init(&p)) {
+        pipeline_deinit(&p);
+        free(decode_tids);
+        free(workers);
+        return -1;
+    }
+
+    for (unsigned i = config->num_probes; i-- > 0;) {
+        // Records for a probe listed twice go to its first output
+        if (config->probe_ids[i] <= VCD_PIPELINE_MAX_PROBE_ID)
+            p.probe_index[config->probe_ids[i]] = (int16_t)i;
+
+        // Batches are already large; stdio buffering would only add a copy.
+        setvbuf(out_files[i], NULL, _IONBF, 0);
+    }
+
+    pthread_create(&write_tid, NULL, write_thread, &p);
+
+    for (unsigned i = 0; i < config->num_workers; i++) {
+        workers[i].p = &p;
+        workers[i].index = i;
+        pthread_create(&decode_tids[i], NULL, decode_thread, &workers[i]);
+    }
+
+    pthread_create(&split_tid, NULL, split_thread, &p);
+
+    res = validate(&p, &lines);
+
+    pthread_join(split_tid, NULL);
+    for (unsigned i = 0; i < config->num_workers; i++)
+        pthread_join(decode_tids[i], NULL);
+    pthread_join(write_tid, NULL);
+
+    if (res == 0)
+        res = atomic_load(&p.error);
+
+    if (stats != NULL) {
+        stats->lines = (lines < 0) ? p.header_lines : lines;
+        stats->bytes_in = p.bytes_in;
+        stats->bytes_out = p.bytes_out;
+        stats->bytes_lost = p.bytes_lost;
+    }
+
+    pipeline_deinit(&p);
+    free(decode_tids);
+    free(workers);
+
+    return res;
+}
@@ -0,0 +1,95 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+
+#ifndef VCD_PIPELINE_H_
+#define VCD_PIPELINE_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * A multi-threaded VCD to PSF conversion pipeline:
+ *
+ *   split --> decode (x num_workers) --> validate --> write
+ *
+ * The split stage cuts the input into batches of whole lines and hands them
+ * to the decode workers round-robin. The validate stage collects batches back
+ * in their original order, so the record callback observes every record in
+ * file order, exactly as a single-threaded conversion would. Stages are
+ * connected by bounded lock-free SPSC rings and batch buffers are recycled
+ * from the write stage back to the split stage.
+ *
+ * Records for several probes may be selected; each is written to its own
+ * output file in the same single pass over the input.
+ */
+
+#define VCD_PIPELINE_MAX_PROBE_ID   255
+
+typedef enum vcd_pipeline_record_status {
+    VCD_PIPELINE_RECORD_VALID,
+    VCD_PIPELINE_RECORD_MALFORMED   /* Unparsable line, invalid hex data or
+                                       longer than max_record_bytes */
+} vcd_pipeline_record_status_t;
+
+/*
+ * Called on the validate stage, in file order, for every record targeting
+ * a configured probe and for every malformed record line. `probe` is the
+ * position of the record's probe in the configured probe_ids (0 for malformed
+ * lines). Valid record bytes may be modified in place before they are written.
+ * Returning a non-zero value stops the pipeline and is returned by
+ * vcd_pipeline_run().
+ */
+typedef int (*vcd_pipeline_record_cb_t)(void *ctx,
+                                        vcd_pipeline_record_status_t status,
+                                        unsigned probe, unsigned char *bytes,
+                                        size_t len, long long line);
+
+/*
+ * Called on the split stage when a followed input has no more data. Should
+ * block until more data may be available and return false to end the
+ * conversion.
+ */
+typedef bool (*vcd_pipeline_wait_cb_t)(void *ctx);
+
+/*
+ * Called on the validate stage, between records, every VCD_PIPELINE_IDLE_MS
+ * or so while it waits for the next batch, e.g. to report progress on state
+ * that only the record callback may touch.
+ */
+typedef void (*vcd_pipeline_idle_cb_t)(void *ctx);
+
+#define VCD_PIPELINE_IDLE_MS        50
+
+typedef struct vcd_pipeline_config {
+    unsigned num_workers;           /* Number of decode threads (>= 1) */
+    const unsigned int *probe_ids;  /* Records for other probes are skipped */
+    unsigned num_probes;
+    size_t batch_bytes;             /* Approximate VCD text per batch */
+    size_t max_record_bytes;        /* Longer records are malformed, 0 for no limit */
+    bool follow;                    /* Wait for more data at end of input */
+    vcd_pipeline_record_cb_t record_cb;
+    vcd_pipeline_wait_cb_t wait_cb; /* Required when follow is set */
+    vcd_pipeline_idle_cb_t idle_cb; /* Optional */
+    void *ctx;
+} vcd_pipeline_config_t;
+
+typedef struct vcd_pipeline_stats {
+    long long lines;
+    uint64_t bytes_in;
+    uint64_t bytes_out;
+    uint64_t bytes_lost;            /* Bytes that failed to write */
+} vcd_pipeline_stats_t;
+
+/*
+ * Exactly one of `in_data` (a complete, e.g. memory-mapped, VCD image of
+ * `in_size` bytes) or `in_file` must be provided. Records for probe_ids[i]
+ * are written to out_files[i]. Returns 0 on success, -1 on a resource or file
+ * system failure, or the first non-zero value returned by the record callback.
+ */
+int vcd_pipeline_run(const vcd_pipeline_config_t *config,
+                     const char *in_data, size_t in_size, FILE *in_file,
+                     FILE *const out_files[], vcd_pipeline_stats_t *stats);
+
+#endif /* VCD_PIPELINE_H_ */
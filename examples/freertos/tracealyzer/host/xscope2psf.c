@@ -7,9 +7,26 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdarg.h>
+#include <time.h>
 #include "xscope_endpoint.h"
+#include "vcd_decode.h"
+#include "mapped_file.h"
+#include "psf_index.h"
+#include "file_follow.h"
+#include "trace_stats.h"
+#include "psf_compress.h"
+
+#if defined(_MSC_VER)
+#define VCD_PIPELINE_ENABLED    0
+#define RING_WRITER_ENABLED     0
+#else
+#define VCD_PIPELINE_ENABLED    1
+#define RING_WRITER_ENABLED     1
+#include "vcd_pipeline.h"
+#include "ring_writer.h"
+#endif
 
-#define VERSION "1.0.2"
+#define VERSION "1.1.0"
 
 // Abstraction for sleep portability
 #if defined(__GNUC__) || defined(__MINGW32__)
@@ -25,13 +42,61 @@
 #define NUM_ELEMS(x)            (sizeof(x) / sizeof(x[0]))
 
 /*
- * The xscope probe to process on.
+ * The default xscope probe to process on.
  * Tracealyzer's trcStreamPort.c is currently expected to call xscope_bytes()
- * for probe ID 0.
+ * for probe ID 0. Other probes, e.g. those of another tile, are selected with
+ * --probes.
  */
 #define XSCOPE_PROBE_ID         0
 
+/*
+ * The maximum number of probes converted in a single pass over the input, and
+ * the largest probe ID that can be selected.
+ */
+#define MAX_PROBES              16
+#define MAX_PROBE_ID            255
+
 #define MAX_LINE_BUFFER_BYTES   4096
+#define MAX_RECORD_BYTES        (MAX_LINE_BUFFER_BYTES >> 1)
+
+/*
+ * The amount of PSF data accumulated before each write in --mmap mode.
+ */
+#define OUTPUT_BATCH_BYTES      (8 * 1024 * 1024)
+
+/*
+ * The amount of VCD text handed to a decode worker at a time when --jobs is
+ * specified.
+ */
+#define PIPELINE_BATCH_BYTES    (1024 * 1024)
+
+/*
+ * The default size of the ring buffer between the xscope endpoint and the
+ * file writer thread in --in-port mode, in MB (--buffer).
+ */
+#define DEFAULT_RING_BUFFER_MB  64
+
+/*
+ * The width of each timestamp bucket in the PSF index (--index).
+ */
+#define INDEX_BUCKET_MS         100
+
+/*
+ * The minimum interval between stream status reports, in seconds.
+ */
+#define STATUS_PERIOD_S         1
+
+/*
+ * The interval at which the analytics files (--analytics) are rewritten in
+ * stream mode, in seconds.
+ */
+#define ANALYTICS_PERIOD_S      5
+
+/*
+ * The number of events between checks of the clock for an analytics rewrite.
+ * While the input is quiet the rewrite is instead driven by the follow wait.
+ */
+#define ANALYTICS_CHECK_EVENTS  4096
 
 /*
  * Enables additional informational logging while processing the PSF data.
@@ -114,6 +179,35 @@ typedef struct TraceEntryTableHeader
     uint32_t uiEntryStateCount;
 } TraceEntryTableHeader_t;
 
+/*
+ * The conversion state of a single probe. Each selected probe carries its own
+ * PSF stream and is written to its own PSF file.
+ */
+typedef struct psf_stream {
+    unsigned int probe_id;
+    char log_prefix[16];        /* Empty when converting a single probe */
+    char out_filename[FILENAME_MAX];
+    FILE *out_file;
+#if (PSFZ_FILE_SUPPORTED == 1)
+    psfz_file_t *psfz_file;     /* NULL unless written with --compress */
+#endif
+    process_psf_state_t psf_state;
+    TraceEntryTableHeader_t psf_evt_table;
+    uint32_t psf_evt_entry;
+    uint16_t *event_cnts;
+    uint16_t num_cores;
+    uint32_t timestamp_frequency;
+    uint64_t psf_offset;
+    int event_count;
+    bool index_mode;
+    psf_index_writer_t psf_index;
+    bool analytics_started;
+    trace_stats_t trace_stats;
+    time_t last_analytics_write;
+    unsigned char *batch;       /* Output batch in --mmap mode */
+    size_t batch_len;
+} psf_stream_t;
+
 /*
  * The available command line argument flags/options.
  */
@@ -121,6 +215,14 @@ static const char *help_arg[] = {"-h", "--help"};
 static const char *version_arg[] = {"--version"};
 static const char *verbose_arg[] = {"-v", "--verbose"};
 static const char *stream_arg[] = {"-s", "--stream"};
+static const char *mmap_arg[] = {"-m", "--mmap"};
+static const char *jobs_arg[] = {"-j", "--jobs"};
+static const char *index_arg[] = {"-x", "--index"};
+static const char *analytics_arg[] = {"-a", "--analytics"};
+static const char *compress_arg[] = {"-z", "--compress"};
+static const char *probes_arg[] = {"-P", "--probes"};
+static const char *buffer_arg[] = {"-b", "--buffer"};
+static const char *overflow_arg[] = {"-O", "--overflow"};
 static const char *print_endpoint_arg[] = {"-p", "--print-endpoint"};
 static const char *delay_arg[] = {"-d", "--delay"};
 static const char *input_file_arg[] = {"-i", "--in-file"};
@@ -128,13 +230,15 @@ static const char *input_port_arg[] = {"-I", "--in-port"};
 static const char *output_file_arg[] = {"-o", "--out-file"};
 
 static bool running = true;
-static int event_count = 0;
 static long long line_count = 0;
-static process_psf_state_t psf_state = PROCESS_PSF_HEADER;
-static TraceEntryTableHeader_t psf_evt_table;
-static uint32_t psf_evt_entry = 0;
-static uint16_t *event_cnts = NULL;
-static uint16_t num_cores;
+static psf_stream_t streams[MAX_PROBES];
+static unsigned num_streams = 0;
+static psf_stream_t *stream_by_probe[MAX_PROBE_ID + 1];
+static file_follow_t input_follow = {.inotify_fd = -1};
+#if (RING_WRITER_ENABLED == 1)
+static ring_writer_t *record_writer = NULL;
+static ring_writer_policy_t overflow_policy = RING_WRITER_BLOCK;
+#endif
 
 /*
  * Variables set by command line arguments.
@@ -143,21 +247,29 @@ static log_level_t log_level = LOG_WRN;
 static bool show_help = false;
 static bool show_version = false;
 static bool stream_mode = false;
+static bool mmap_mode = false;
+static int num_jobs = 0;
+static bool index_mode = false;
+static bool compress_mode = false;
+static char *analytics_prefix = NULL;
+static unsigned int probe_ids[MAX_PROBES] = {XSCOPE_PROBE_ID};
+static unsigned num_probe_ids = 1;
 static bool print_endpoint = false;
+static int ring_buffer_mb = DEFAULT_RING_BUFFER_MB;
 static int sleep_ms = 1000;
 static char *input_host = NULL;
 static char *input_port = NULL;
 static char *input_filename = NULL;
 static char *output_filename = NULL;
-static FILE *out_file = NULL;
 
 static void print_help(char *arg0)
 {
     printf("Usage:\n");
     printf("    %s [-h] [--version]\n\n", arg0);
-    printf("    %s [-v] [-s] [-d <DELAY_MS>] -i <IN_FILE> -o <OUT_FILE>\n\n",
+    printf("    %s [-v] [-s] [-d <DELAY_MS>] [-j <JOBS>] [-x] [-z] [-a <PREFIX>] [-P <PROBES>] -i <IN_FILE> -o <OUT_FILE>\n\n",
            arg0);
-    printf("    %s [-v] [-p] -I <HOST>:<PORT> -o <OUT_FILE>\n\n", arg0);
+    printf("    %s [-v] -m [-j <JOBS>] [-x] [-z] [-a <PREFIX>] [-P <PROBES>] -i <IN_FILE> -o <OUT_FILE>\n\n", arg0);
+    printf("    %s [-v] [-p] [-b <MB>] [-O <POLICY>] [-x] [-z] [-a <PREFIX>] [-P <PROBES>] -I <HOST>:<PORT> -o <OUT_FILE>\n\n", arg0);
     printf("Generate a Percepio Streaming Format (PSF) file based on Tracealyzer data received\n"
            "via an xscope Value Change Dump (VCD) file or an xscope endpoint socket connection.\n\n");
     printf("Options:\n");
@@ -167,11 +279,43 @@ static void print_help(char *arg0)
     printf("    -s, --stream                Once the end of a file has been reached,\n"
            "                                continue to wait for more data. Terminate\n"
            "                                execution via Ctrl+C or other means.\n");
+    printf("    -m, --mmap                  Memory-map the input file and write output in\n"
+           "                                large batches. Intended for offline conversion\n"
+           "                                of large files; cannot be used with --stream.\n");
+    printf("    -j, --jobs <JOBS>           Convert the input file on a multi-threaded pipeline\n"
+           "                                using JOBS decode threads. PSF data is still\n"
+           "                                validated and written in order. Default = 0\n"
+           "                                (single-threaded).\n");
+    printf("    -x, --index                 Also generate <OUT_FILE>.idx, which maps timestamps\n"
+           "                                to offsets in OUT_FILE. See psfcut.\n");
+    printf("    -z, --compress              Write OUT_FILE in compressed blocks, which is\n"
+           "                                read back with psfcat. Offsets in the --index\n"
+           "                                file refer to the decompressed data. With\n"
+           "                                no spare CPU, the blocks are stored uncompressed.\n");
+    printf("    -a, --analytics <PREFIX>    Write per-task CPU load, per-core utilisation,\n"
+           "                                context switch and ISR latency statistics to\n"
+           "                                PREFIX.json and PREFIX.csv at exit. In stream\n"
+           "                                mode, the files are also updated every %d s.\n",
+           ANALYTICS_PERIOD_S);
+    printf("    -P, --probes <PROBES>       Comma separated xscope probe IDs to convert, e.g.\n"
+           "                                one per tile. When more than one is given, each\n"
+           "                                probe N is written to <OUT_FILE>_probeN.psf (and\n"
+           "                                <PREFIX>_probeN for --analytics). Default = %d.\n",
+           XSCOPE_PROBE_ID);
     printf("    -p, --print-endpoint        When using -in-port, this option will enable\n"
            "                                reception of printf data on this xscope endpoint.\n");
-    printf("    -d, --delay <DELAY_MS>      The time in milliseconds to sleep when waiting for more\n"
-           "                                data on the input file stream. This option only applies\n"
-           "                                for --stream. Default = 1000.\n");
+    printf("    -b, --buffer <MB>           When using --in-port, the size of the buffer between\n"
+           "                                the xscope endpoint and the thread writing the PSF\n"
+           "                                files. Default = %d.\n", DEFAULT_RING_BUFFER_MB);
+    printf("    -O, --overflow <POLICY>     When using --in-port, what to do when the buffer is\n"
+           "                                full: 'block' the xscope endpoint, 'drop-oldest'\n"
+           "                                or 'drop-newest' events. Dropped events are\n"
+           "                                reported at exit. 'drop-oldest' cannot be used\n"
+           "                                with --index. Default = block.\n");
+    printf("    -d, --delay <DELAY_MS>      The maximum time in milliseconds to wait for more\n"
+           "                                data on the input file stream. On Linux, appended data\n"
+           "                                is picked up as soon as it is written. This option only\n"
+           "                                applies for --stream. Default = 1000.\n");
     printf("    -i, --in-file <IN_FILE>     The VCD file to process. In stream mode, the\n"
            "                                application will wait for such a file to exist.\n");
     printf("    -I, --in-port <HOST>:<PORT> The host and port (separated by ':') on which\n"
@@ -201,14 +345,49 @@ static void write_log(log_level_t level, const char *format, ...)
     va_end(args);
 }
 
+static int total_event_count(void)
+{
+    int count = 0;
+
+    for (unsigned i = 0; i < num_streams; i++)
+        count += streams[i].event_count;
+
+    return count;
+}
+
 static void print_stream_status(void)
 {
+    static int last_event_count = 0;
+    static time_t last_print = 0;
+    const int event_count = total_event_count();
+    time_t now = time(NULL);
+
+    if (last_event_count == event_count || now - last_print < STATUS_PERIOD_S)
+        return;
+
+    last_event_count = event_count;
+    last_print = now;
+
     write_log(LOG_INF, "[STREAM STATUS]\n");
 
     if (input_filename)
         write_log(LOG_INF, "- Read %lld lines\n", line_count);
 
-    write_log(LOG_INF, "- Processed %d events\n", event_count + 1);
+    for (unsigned i = 0; i < num_streams; i++)
+        write_log(LOG_INF, "- %sProcessed %d events\n", streams[i].log_prefix,
+                  streams[i].event_count + 1);
+
+#if (RING_WRITER_ENABLED == 1)
+    if (record_writer != NULL) {
+        ring_writer_stats_t stats;
+        ring_writer_get_stats(record_writer, &stats);
+
+        write_log(LOG_INF, "- Buffered %zu KB (peak %zu KB of %zu KB), "
+                  "dropped %llu records\n", stats.queued_bytes / 1024,
+                  stats.high_watermark / 1024, stats.capacity / 1024,
+                  (unsigned long long)stats.records_dropped);
+    }
+#endif
 }
 
 static void print_psf_header(TraceHeader_t *header)
@@ -254,30 +433,35 @@ static void print_psf_event(unsigned char trace_bytes[], int num_trace_bytes)
     printf("\n");
 }
 
-static void print_psf_event_table_header(unsigned char trace_bytes[],
+static void print_psf_event_table_header(const psf_stream_t *stream,
+                                         unsigned char trace_bytes[],
                                          int trace_length)
 {
+    const TraceEntryTableHeader_t *psf_evt_table = &stream->psf_evt_table;
+
     write_log(LOG_INF, "[PSF Event Table]\n");
-    write_log(LOG_INF, "- Slots: %d\n", psf_evt_table.uiSlots);
+    write_log(LOG_INF, "- Slots: %d\n", psf_evt_table->uiSlots);
     write_log(LOG_INF, "- Entry Symbol Length: %d\n",
-              psf_evt_table.uiEntrySymbolLength);
+              psf_evt_table->uiEntrySymbolLength);
     write_log(LOG_INF, "- Entry State Count: %d\n",
-              psf_evt_table.uiEntryStateCount);
+              psf_evt_table->uiEntryStateCount);
 }
 
-static void print_psf_event_table_entry(unsigned char trace_bytes[],
+static void print_psf_event_table_entry(const psf_stream_t *stream,
+                                        unsigned char trace_bytes[],
                                         int trace_length)
 {
+    const TraceEntryTableHeader_t *psf_evt_table = &stream->psf_evt_table;
     uint32_t states_offset = sizeof(uint32_t);
     uint32_t options_offset =
-            (psf_evt_table.uiEntryStateCount + 1) * sizeof(uint32_t);
+            (psf_evt_table->uiEntryStateCount + 1) * sizeof(uint32_t);
     uint32_t symbol_offset = options_offset + sizeof(uint32_t);
 
     write_log(LOG_INF, "[PSF Event Entry]\n");
     write_log(LOG_INF, "- Address: 0x%02X%02X%02X%02X\n", trace_bytes[3],
               trace_bytes[2], trace_bytes[1], trace_bytes[0]);
     write_log(LOG_INF, "- States:");
-    for (uint32_t i = 0; i < psf_evt_table.uiEntryStateCount; i++) {
+    for (uint32_t i = 0; i < psf_evt_table->uiEntryStateCount; i++) {
         write_log(LOG_INF, " 0x%02X%02X%02X%02X",
                   trace_bytes[(i * sizeof(uint32_t)) + states_offset + 3],
                   trace_bytes[(i * sizeof(uint32_t)) + states_offset + 2],
@@ -288,7 +472,7 @@ static void print_psf_event_table_entry(unsigned char trace_bytes[],
     write_log(LOG_INF, "- Options: 0x%02X%02X%02X%02X\n",
               trace_bytes[options_offset + 3], trace_bytes[options_offset + 2],
               trace_bytes[options_offset + 1], trace_bytes[options_offset]);
-    write_log(LOG_INF, "- Symbol: %.*s\n", psf_evt_table.uiEntrySymbolLength,
+    write_log(LOG_INF, "- Symbol: %.*s\n", psf_evt_table->uiEntrySymbolLength,
               &trace_bytes[symbol_offset]);
 }
 #endif /* (PRINT_PSF_EVENTS == 1) */
@@ -313,7 +497,8 @@ static void print_record(unsigned int id, unsigned long long timestamp,
 }
 #endif /* (PRINT_OTHER_RECORDS == 1) */
 
-static error_code_t process_psf_header(unsigned char trace_bytes[],
+static error_code_t process_psf_header(psf_stream_t *stream,
+                                       unsigned char trace_bytes[],
                                        int trace_length)
 {
     const uint32_t expected_bom = 0x50534600;
@@ -322,7 +507,8 @@ static error_code_t process_psf_header(unsigned char trace_bytes[],
     /* The xscope probe's first record should be the PSF header in
      * its entirety. */
     if (trace_length != sizeof(TraceHeader_t)) {
-        write_log(LOG_ERR, "Incompatible PSF header length detected.\n");
+        write_log(LOG_ERR, "%sIncompatible PSF header length detected.\n",
+                  stream->log_prefix);
         return ERROR_INCOMPATIBLE_VCD;
     }
 
@@ -330,7 +516,8 @@ static error_code_t process_psf_header(unsigned char trace_bytes[],
 
     // The magic cookie/BOM should always be "\0FSP" on xcore
     if (header.uiPSF != expected_bom) {
-        write_log(LOG_ERR, "Incompatible PSF BOM detected.\n");
+        write_log(LOG_ERR, "%sIncompatible PSF BOM detected.\n",
+                  stream->log_prefix);
         return ERROR_INCOMPATIBLE_VCD;
     }
 
@@ -338,86 +525,107 @@ static error_code_t process_psf_header(unsigned char trace_bytes[],
 
     if (header.uiNumCores > 0) {
         uint16_t data_size = header.uiNumCores * sizeof(uint16_t);
-        event_cnts = malloc(data_size);
+        stream->event_cnts = malloc(data_size);
 
-        if (event_cnts == NULL)
+        if (stream->event_cnts == NULL)
             return ERROR_OUT_OF_RESOURCES;
 
-        num_cores = header.uiNumCores;
+        stream->num_cores = header.uiNumCores;
 
         /* Set each event count to 0xFFFF which is an invalid value
          * for the 12-bit counter. */
-        memset(event_cnts, 0xFF, data_size);
+        memset(stream->event_cnts, 0xFF, data_size);
     }
 
     return ERROR_NONE;
 }
 
-static error_code_t process_psf_timestamp(unsigned char trace_bytes[],
+static error_code_t process_psf_timestamp(psf_stream_t *stream,
+                                          unsigned char trace_bytes[],
                                           int trace_length)
 {
     TraceTimestamp_t timestamp;
 
     if (trace_length != sizeof(TraceTimestamp_t)) {
-        write_log(LOG_ERR, "Incompatible PSF timestamp length detected.\n");
+        write_log(LOG_ERR, "%sIncompatible PSF timestamp length detected.\n",
+                  stream->log_prefix);
         return ERROR_INCOMPATIBLE_VCD;
     }
 
     memcpy(&timestamp, trace_bytes, sizeof(TraceTimestamp_t));
     print_psf_timestamp(&timestamp);
+    stream->timestamp_frequency = timestamp.frequency;
     return ERROR_NONE;
 }
 
-static error_code_t process_psf_event_table_header(unsigned char trace_bytes[],
+static error_code_t process_psf_event_table_header(psf_stream_t *stream,
+                                                   unsigned char trace_bytes[],
                                                    int trace_length)
 {
     if (trace_length != sizeof(TraceEntryTableHeader_t)) {
         write_log(LOG_ERR,
-                  "Incompatible PSF event table header length detected.\n");
+                  "%sIncompatible PSF event table header length detected.\n",
+                  stream->log_prefix);
         return ERROR_INCOMPATIBLE_VCD;
     }
 
-    memcpy(&psf_evt_table, trace_bytes, sizeof(TraceEntryTableHeader_t));
+    memcpy(&stream->psf_evt_table, trace_bytes,
+           sizeof(TraceEntryTableHeader_t));
 
 #if (PRINT_PSF_EVENTS == 1)
-    print_psf_event_table_header(trace_bytes, trace_length);
+    print_psf_event_table_header(stream, trace_bytes, trace_length);
 #endif
 
     return ERROR_NONE;
 }
 
-static error_code_t process_psf_event_table_entry(unsigned char trace_bytes[],
+static error_code_t process_psf_event_table_entry(psf_stream_t *stream,
+                                                  unsigned char trace_bytes[],
                                                   int trace_length)
 {
+    const TraceEntryTableHeader_t *psf_evt_table = &stream->psf_evt_table;
     uint32_t expected_len =
-            (psf_evt_table.uiEntryStateCount + 2) * sizeof(uint32_t) +
-            psf_evt_table.uiEntrySymbolLength;
+            (psf_evt_table->uiEntryStateCount + 2) * sizeof(uint32_t) +
+            psf_evt_table->uiEntrySymbolLength;
     if (trace_length != expected_len) {
         write_log(LOG_ERR,
-                  "Incompatible PSF event table header length detected.\n");
+                  "%sIncompatible PSF event table header length detected.\n",
+                  stream->log_prefix);
         return ERROR_INCOMPATIBLE_VCD;
     }
 
 #if (PRINT_PSF_EVENTS == 1)
-    print_psf_event_table_entry(trace_bytes, trace_length);
+    print_psf_event_table_entry(stream, trace_bytes, trace_length);
 #endif
 
+    if (stream->analytics_started) {
+        uint32_t address;
+        memcpy(&address, trace_bytes, sizeof(address));
+        trace_stats_symbol(&stream->trace_stats, address,
+                (const char *)&trace_bytes[expected_len -
+                                           psf_evt_table->uiEntrySymbolLength],
+                psf_evt_table->uiEntrySymbolLength);
+    }
+
     return ERROR_NONE;
 }
 
-static void detect_missing_events(unsigned char trace_bytes[],
-                                  int num_trace_bytes)
+static int detect_missing_events(psf_stream_t *stream,
+                                 unsigned char trace_bytes[],
+                                 int num_trace_bytes)
 {
     const int core_id_offset = 3;
     const int evt_cnt_offset_lo = 2;
     const int evt_cnt_offset_hi = 3;
     const int hi_evt_cnt_mask = 0x0F;
     const uint16_t invalid_evt_cnt = 0xFFFF;
+    uint16_t *event_cnts = stream->event_cnts;
 
     uint16_t core_id = trace_bytes[core_id_offset] >> 4;
+    int missing = 0;
 
-    if (event_cnts == NULL || core_id >= num_cores)
-        return;
+    if (event_cnts == NULL || core_id >= stream->num_cores)
+        return 0;
 
     uint16_t event_cnt =
         ((trace_bytes[evt_cnt_offset_hi] & hi_evt_cnt_mask) << 8) |
@@ -430,16 +638,21 @@ static void detect_missing_events(unsigned char trace_bytes[],
             (event_cnt - event_cnts[core_id]) :
             ((0x1000 - event_cnts[core_id]) + event_cnt);
 
-        if (event_cnt_delta > 1)
+        if (event_cnt_delta > 1) {
+            missing = event_cnt_delta - 1;
             write_log(LOG_WRN,
-                "Detected %d missing events (Core %d @ Current %d).\n",
-                event_cnt_delta - 1, core_id, event_cnt);
+                "%sDetected %d missing events (Core %d @ Current %d).\n",
+                stream->log_prefix, missing, core_id, event_cnt);
+        }
     }
 
     event_cnts[core_id] = event_cnt;
+
+    return missing;
 }
 
-static void modify_trace_event_count(unsigned char trace_bytes[],
+static void modify_trace_event_count(psf_stream_t *stream,
+                                     unsigned char trace_bytes[],
                                      int num_trace_bytes)
 {
     const int core_id_offset = 3;
@@ -447,7 +660,7 @@ static void modify_trace_event_count(unsigned char trace_bytes[],
     const int evt_cnt_offset_hi = 3;
     const int core_id_mask = 0xF0;
     const int hi_evt_cnt_mask = 0x0F;
-    char *evt_cnt = (char *)&event_count;
+    char *evt_cnt = (char *)&stream->event_count;
 
     /*
      * Modify the event counter while retaining core id. The trace's event
@@ -462,10 +675,72 @@ static void modify_trace_event_count(unsigned char trace_bytes[],
     trace_bytes[evt_cnt_offset_hi] =
             (trace_bytes[core_id_offset] & core_id_mask) |
             (evt_cnt[1] & hi_evt_cnt_mask);
-    event_count++;
+    stream->event_count++;
 }
 
-static error_code_t process_trace_event(unsigned char trace_bytes[],
+/*
+ * Write the stream's analytics to <analytics_prefix>[_probeN]<extension> via
+ * a temporary file, so that a reader polling the file during a stream never
+ * observes a partial update.
+ */
+static bool write_analytics_file(const psf_stream_t *stream,
+                                 const char *extension,
+                                 bool (*write_fn)(const trace_stats_t *, FILE *))
+{
+    char filename[FILENAME_MAX];
+    char tmp_filename[FILENAME_MAX + sizeof(".tmp")];
+
+    if (num_streams > 1)
+        snprintf(filename, sizeof(filename), "%s_probe%u%s", analytics_prefix,
+                 stream->probe_id, extension);
+    else
+        snprintf(filename, sizeof(filename), "%s%s", analytics_prefix,
+                 extension);
+    snprintf(tmp_filename, sizeof(tmp_filename), "%s.tmp", filename);
+
+    FILE *file = fopen(tmp_filename, "w");
+    if (file == NULL)
+        return false;
+
+    bool ok = write_fn(&stream->trace_stats, file);
+    ok = (fclose(file) == 0) && ok;
+
+    // rename() does not replace an existing file on Windows
+    remove(filename);
+    return ok && (rename(tmp_filename, filename) == 0);
+}
+
+static void write_analytics(const psf_stream_t *stream)
+{
+    if (!stream->analytics_started)
+        return;
+
+    if (!write_analytics_file(stream, ".json", trace_stats_write_json) ||
+        !write_analytics_file(stream, ".csv", trace_stats_write_csv))
+        write_log(LOG_ERR, "%sFailed to write analytics (%s).\n",
+                  stream->log_prefix, analytics_prefix);
+}
+
+static void refresh_analytics(psf_stream_t *stream, time_t now)
+{
+    if (stream->analytics_started &&
+        now - stream->last_analytics_write >= ANALYTICS_PERIOD_S) {
+        write_analytics(stream);
+        stream->last_analytics_write = now;
+    }
+}
+
+/* Called from the follow wait, so the files are kept current when idle. */
+static void refresh_all_analytics(void)
+{
+    const time_t now = time(NULL);
+
+    for (unsigned i = 0; i < num_streams; i++)
+        refresh_analytics(&streams[i], now);
+}
+
+static error_code_t process_trace_event(psf_stream_t *stream,
+                                        unsigned char trace_bytes[],
                                         int num_trace_bytes)
 {
     /*
@@ -479,10 +754,11 @@ static error_code_t process_trace_event(unsigned char trace_bytes[],
         // Provide the line number in the file when processing a VCD file.
         if (input_filename) {
             write_log(LOG_WRN,
-                    "Trace event data length too small (line %lld).\n",
-                    line_count);
+                    "%sTrace event data length too small (line %lld).\n",
+                    stream->log_prefix, line_count);
         } else {
-            write_log(LOG_WRN, "Trace event data length too small.\n");
+            write_log(LOG_WRN, "%sTrace event data length too small.\n",
+                      stream->log_prefix);
         }
 
         return ERROR_DATA_TOO_SHORT;
@@ -492,13 +768,38 @@ static error_code_t process_trace_event(unsigned char trace_bytes[],
     print_psf_event(trace_bytes, num_trace_bytes);
 #endif
 
-    detect_missing_events(trace_bytes, num_trace_bytes);
-    modify_trace_event_count(trace_bytes, num_trace_bytes);
+    if (stream->index_mode && num_trace_bytes >= 8) {
+        uint32_t timestamp;
+        memcpy(&timestamp, &trace_bytes[4], sizeof(timestamp));
+
+        // Indexed on the state prior to this event
+        if (!psf_index_writer_event(&stream->psf_index, timestamp,
+                                    stream->psf_offset, stream->event_count,
+                                    stream->event_cnts)) {
+            write_log(LOG_ERR, "%sFailed to write the PSF index.\n",
+                      stream->log_prefix);
+            stream->index_mode = false;
+        }
+    }
+
+    int missing = detect_missing_events(stream, trace_bytes, num_trace_bytes);
+
+    if (stream->analytics_started) {
+        stream->trace_stats.missing_events += missing;
+        trace_stats_event(&stream->trace_stats, trace_bytes, num_trace_bytes);
+
+        if (stream_mode &&
+            (stream->event_count % ANALYTICS_CHECK_EVENTS) == 0)
+            refresh_analytics(stream, time(NULL));
+    }
+
+    modify_trace_event_count(stream, trace_bytes, num_trace_bytes);
 
     return ERROR_NONE;
 }
 
-static error_code_t process_psf_data(unsigned char trace_bytes[],
+static error_code_t process_psf_data(psf_stream_t *stream,
+                                     unsigned char trace_bytes[],
                                      int trace_length)
 {
     error_code_t res = ERROR_NONE;
@@ -509,132 +810,363 @@ static error_code_t process_psf_data(unsigned char trace_bytes[],
      * The state machine below handles this logic.
      */
 
-    switch (psf_state) {
+    switch (stream->psf_state) {
     case PROCESS_PSF_HEADER:
-        res = process_psf_header(trace_bytes, trace_length);
-        psf_state = PROCESS_PSF_TIMESTAMP;
+        res = process_psf_header(stream, trace_bytes, trace_length);
+        stream->psf_state = PROCESS_PSF_TIMESTAMP;
         break;
     case PROCESS_PSF_TIMESTAMP:
-        res = process_psf_timestamp(trace_bytes, trace_length);
-        psf_state = PROCESS_PSF_EVENT_TABLE_HEADER;
+        res = process_psf_timestamp(stream, trace_bytes, trace_length);
+        stream->psf_state = PROCESS_PSF_EVENT_TABLE_HEADER;
+
+        if (analytics_prefix && res == ERROR_NONE) {
+            stream->analytics_started =
+                    trace_stats_init(&stream->trace_stats, stream->num_cores,
+                                     stream->timestamp_frequency);
+            if (!stream->analytics_started)
+                write_log(LOG_ERR, "%sFailed to start analytics.\n",
+                          stream->log_prefix);
+        }
         break;
     case PROCESS_PSF_EVENT_TABLE_HEADER:
-        res = process_psf_event_table_header(trace_bytes, trace_length);
-        psf_state = PROCESS_PSF_EVENT_TABLE_ENTRY;
+        res = process_psf_event_table_header(stream, trace_bytes, trace_length);
+        stream->psf_state = PROCESS_PSF_EVENT_TABLE_ENTRY;
         break;
     case PROCESS_PSF_EVENT_TABLE_ENTRY:
-        psf_evt_entry++;
-        res = process_psf_event_table_entry(trace_bytes, trace_length);
-
-        if (psf_evt_entry >= psf_evt_table.uiSlots) {
-            psf_state = PROCESS_PSF_EVENT;
+        stream->psf_evt_entry++;
+        res = process_psf_event_table_entry(stream, trace_bytes, trace_length);
+
+        if (stream->psf_evt_entry >= stream->psf_evt_table.uiSlots) {
+            const uint32_t frequency = stream->timestamp_frequency;
+
+            stream->psf_state = PROCESS_PSF_EVENT;
+
+            // Events start immediately after the symbol table
+            if (stream->index_mode &&
+                !psf_index_writer_start(&stream->psf_index, frequency,
+                        stream->num_cores,
+                        ((uint64_t)frequency * INDEX_BUCKET_MS) / 1000,
+                        stream->psf_offset + trace_length)) {
+                write_log(LOG_ERR, "%sFailed to write the PSF index.\n",
+                          stream->log_prefix);
+                stream->index_mode = false;
+            }
         }
         break;
     case PROCESS_PSF_EVENT:
-        res = process_trace_event(trace_bytes, trace_length);
+        res = process_trace_event(stream, trace_bytes, trace_length);
         break;
     default:
         res = ERROR_INTERNAL;
         break;
     }
 
+    stream->psf_offset += trace_length;
+
     return res;
 }
 
-static error_code_t process_vcd_file(FILE *input_file, FILE *output_file)
+/*
+ * Locate the record carried by a single VCD line spanning [line, end).
+ * Returns the stream of the record's probe, or NULL if the line does not carry
+ * PSF data for any of the selected probes.
+ */
+static psf_stream_t *parse_vcd_line(const char *line, const char *end,
+                                    parsing_vcd_state_t *parsing_state,
+                                    vcd_record_t *record)
+{
+    /* Filter lines related to VCD header; afterwards, only process lines
+     * that begin with 'l' which are expected to be run-length encoded
+     * hex-strings representing the Tracealyzer PSF data. */
+    if (*parsing_state == PARSING_VCD_HEADER) {
+        if (vcd_is_end_of_header(line, end))
+            *parsing_state = PARSING_VCD_RECORDS;
+
+        return NULL;
+    } else {
+        bool is_trace_data = (line < end && line[0] == 'l');
+        if (!is_trace_data)
+            return NULL;
+    }
+
+    // Fields are located in place; the hex-string is decoded separately.
+    if (!vcd_parse_record(line, end, record)) {
+        write_log(LOG_WRN, "Unexpected encoding (line %lld).\n", line_count);
+        return NULL;
+    }
+
+    // Skip lines not targeting a selected probe ID
+    if (record->probe_id > MAX_PROBE_ID)
+        return NULL;
+
+    return stream_by_probe[record->probe_id];
+}
+
+/*
+ * Decode a record located by parse_vcd_line() into trace_bytes, which must
+ * hold at least max_bytes, and process it on its stream. *decoded_len is set
+ * to the number of bytes to be written to the stream's PSF file (0 if none).
+ */
+static error_code_t process_vcd_record(psf_stream_t *stream,
+                                       const vcd_record_t *record,
+                                       unsigned char trace_bytes[],
+                                       size_t max_bytes, int *decoded_len)
+{
+    *decoded_len = 0;
+
+    if ((record->num_bytes > max_bytes) ||
+        !vcd_hex_decode(trace_bytes, record->hex, record->num_bytes)) {
+        write_log(LOG_WRN, "Unexpected encoding (line %lld).\n", line_count);
+        return ERROR_NONE;
+    }
+
+    error_code_t res = process_psf_data(stream, trace_bytes,
+                                        (int)record->num_bytes);
+    if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT)
+        return res;
+
+    *decoded_len = (int)record->num_bytes;
+    return ERROR_NONE;
+}
+
+static void print_end_of_file_status(void)
+{
+    write_log(LOG_INF, "End of file reached.\n");
+    write_log(LOG_INF, "Read %lld lines.\n", line_count);
+
+    for (unsigned i = 0; i < num_streams; i++)
+        write_log(LOG_INF, "%sProcessed %d events.\n", streams[i].log_prefix,
+                  streams[i].event_count + 1);
+}
+
+static error_code_t process_vcd_file(FILE *input_file)
 {
-    int last_event_count = 0;
     parsing_vcd_state_t parsing_state = PARSING_VCD_HEADER;
     char line[MAX_LINE_BUFFER_BYTES];
+    unsigned char trace_bytes[MAX_RECORD_BYTES];
+    size_t line_len = 0;
 
     while (1) {
-        const char delim[] = " \n\r";
-        char *line_ptr = fgets(line, sizeof(line), input_file);
+        char *line_ptr = fgets(&line[line_len], sizeof(line) - line_len,
+                               input_file);
+
+        if (line_ptr != NULL)
+            line_len += strlen(line_ptr);
+
+        /* A line that is still being written is held back until it is
+         * complete, as waits now end as soon as the writer appends data. */
+        if (stream_mode && line_len > 0 && line[line_len - 1] != '\n' &&
+            line_len < sizeof(line) - 1)
+            line_ptr = NULL;
 
         if (line_ptr == NULL) {
             if (!stream_mode)
                 break;
 
-            if (last_event_count != event_count) {
-                print_stream_status();
-                last_event_count = event_count;
-            }
+            // Make everything converted so far visible before waiting
+            for (unsigned i = 0; i < num_streams; i++)
+                fflush(streams[i].out_file);
+            print_stream_status();
+            refresh_all_analytics();
 
-            SLEEP_MS(sleep_ms);
+            file_follow_wait(&input_follow);
+            clearerr(input_file);
             continue;
         }
 
         line_count++;
 
-        /* Filter lines related to VCD header; afterwards, only process lines
-         * that begin with 'l' which are expected to be run-length encoded
-         * hex-strings representing the Tracealyzer PSF data. */
-        if (parsing_state == PARSING_VCD_HEADER) {
-            char *token = strtok(line, delim);
-            const char *end_of_header = "$enddefinitions";
+        vcd_record_t record;
+        psf_stream_t *stream = parse_vcd_line(line, line + line_len,
+                                              &parsing_state, &record);
+        line_len = 0;
+        if (stream == NULL)
+            continue;
 
-            if (strcmp(token, end_of_header) == 0)
-                parsing_state = PARSING_VCD_RECORDS;
+        int decoded_trace_len;
+        error_code_t res = process_vcd_record(stream, &record, trace_bytes,
+                                              sizeof(trace_bytes),
+                                              &decoded_trace_len);
+        if (res != ERROR_NONE)
+            return res;
 
-            continue;
-        } else {
-            bool is_trace_data = (line[0] == 'l');
-            if (!is_trace_data)
-                continue;
-        }
+        if (fwrite(trace_bytes, sizeof(trace_bytes[0]), decoded_trace_len,
+                   stream->out_file) != decoded_trace_len)
+            write_log(LOG_ERR, "Data lost while writing to file system.\n");
+    }
 
-        // The first token indicates the length of the data that follows
-        char *len_field = strtok(line, delim);
+    if (feof(input_file) && !stream_mode)
+        print_end_of_file_status();
 
-        // The second token has the trace data that needs to be converted
-        char *trace_data = strtok(NULL, delim);
+    return ERROR_NONE;
+}
 
-        /* The third token indicates the probe ID. Skip lines not targeting the
-         * expected probe ID. */
-        char *scope_probe = strtok(NULL, delim);
+static error_code_t flush_output_batch(psf_stream_t *stream)
+{
+    if (stream->batch_len > 0 &&
+        fwrite(stream->batch, 1, stream->batch_len, stream->out_file) !=
+        stream->batch_len) {
+        write_log(LOG_ERR, "Data lost while writing to file system.\n");
+        return ERROR_FILE_SYSTEM;
+    }
 
-        if (len_field == NULL || trace_data == NULL || scope_probe == NULL) {
-            write_log(LOG_WRN, "Unexpected encoding (line %lld).\n",
-                      line_count);
-            continue;
-        }
+    stream->batch_len = 0;
+    return ERROR_NONE;
+}
 
-        if (strcmp(scope_probe, XSTR(XSCOPE_PROBE_ID)) != 0)
-            continue;
+/*
+ * Offline conversion of a memory-mapped VCD file. Records are decoded straight
+ * into a large output batch per stream which is written once full, so the
+ * per-line cost is limited to the newline search and the decode itself.
+ */
+static error_code_t process_vcd_mapped(const mapped_file_t *input_file)
+{
+    parsing_vcd_state_t parsing_state = PARSING_VCD_HEADER;
+    const char *pos = input_file->data;
+    const char *end = input_file->data + input_file->size;
+    error_code_t res = ERROR_NONE;
 
-        int trace_data_chars = strlen(trace_data);
+    for (unsigned i = 0; i < num_streams; i++) {
+        streams[i].batch = malloc(OUTPUT_BATCH_BYTES);
+        streams[i].batch_len = 0;
+
+        if (streams[i].batch == NULL)
+            res = ERROR_OUT_OF_RESOURCES;
+
+        // The batch is handed to the OS directly; skip stdio's own buffering.
+        setvbuf(streams[i].out_file, NULL, _IONBF, 0);
+    }
+
+    while (pos < end && res == ERROR_NONE) {
+        const char *eol = memchr(pos, '\n', end - pos);
+        const char *line_end = (eol != NULL) ? eol : end;
+        vcd_record_t record;
         int decoded_trace_len;
 
-        if ((sscanf(len_field, "l%d", &decoded_trace_len) != 1) ||
-            (trace_data_chars != (decoded_trace_len << 1))) {
-            write_log(LOG_WRN, "Unexpected encoding (line %lld).\n",
-                      line_count);
+        line_count++;
+
+        psf_stream_t *stream = parse_vcd_line(pos, line_end, &parsing_state,
+                                              &record);
+        pos = line_end + 1;
+        if (stream == NULL)
             continue;
+
+        if (OUTPUT_BATCH_BYTES - stream->batch_len < MAX_RECORD_BYTES) {
+            res = flush_output_batch(stream);
+            if (res != ERROR_NONE)
+                break;
         }
 
-        unsigned char trace_bytes[MAX_LINE_BUFFER_BYTES >> 1];
+        res = process_vcd_record(stream, &record,
+                                 &stream->batch[stream->batch_len],
+                                 MAX_RECORD_BYTES, &decoded_trace_len);
+        if (res != ERROR_NONE)
+            break;
+
+        stream->batch_len += decoded_trace_len;
+    }
 
-        // Convert the trace_data from a hex-string to an array of bytes
-        for (int i = 0; i < decoded_trace_len; i++)
-            sscanf(&trace_data[i << 1], "%02hhx", &trace_bytes[i]);
+    for (unsigned i = 0; i < num_streams; i++) {
+        if (res == ERROR_NONE)
+            res = flush_output_batch(&streams[i]);
 
-        error_code_t res = process_psf_data(trace_bytes, decoded_trace_len);
-        if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT)
-            return res;
+        free(streams[i].batch);
+        streams[i].batch = NULL;
+    }
 
-        if (fwrite(trace_bytes, sizeof(trace_bytes[0]), decoded_trace_len,
-                   output_file) != decoded_trace_len)
-            write_log(LOG_ERR, "Data lost while writing to file system.\n");
+    if (res == ERROR_NONE)
+        print_end_of_file_status();
+
+    return res;
+}
+
+#if (VCD_PIPELINE_ENABLED == 1)
+/*
+ * Runs on the pipeline's validate stage, which presents records in file order.
+ */
+static int pipeline_record_cb(void *ctx, vcd_pipeline_record_status_t status,
+                              unsigned probe, unsigned char *bytes, size_t len,
+                              long long line)
+{
+    line_count = line;
+
+    if (status == VCD_PIPELINE_RECORD_MALFORMED) {
+        write_log(LOG_WRN, "Unexpected encoding (line %lld).\n", line_count);
+        return ERROR_NONE;
     }
 
-    if (feof(input_file) && !stream_mode) {
-        write_log(LOG_INF, "End of file reached.\n");
-        write_log(LOG_INF, "Read %lld lines.\n", line_count);
-        write_log(LOG_INF, "Processed %d events.\n", event_count + 1);
+    error_code_t res = process_psf_data(&streams[probe], bytes, (int)len);
+    if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT)
+        return res;
+
+    return ERROR_NONE;
+}
+
+/* Runs on the pipeline's split stage. */
+static bool pipeline_wait_cb(void *ctx)
+{
+    file_follow_wait(&input_follow);
+    return true;
+}
+
+/*
+ * Runs on the pipeline's validate stage, which owns the counters reported and
+ * the analytics, so both are updated there rather than from the split stage's
+ * wait.
+ */
+static void pipeline_idle_cb(void *ctx)
+{
+    print_stream_status();
+    refresh_all_analytics();
+}
+
+static error_code_t process_vcd_pipelined(const mapped_file_t *input_map,
+                                          FILE *input_file)
+{
+    // Left zeroed if the pipeline fails before it runs
+    vcd_pipeline_stats_t stats = {0};
+    FILE *out_files[MAX_PROBES];
+    const vcd_pipeline_config_t config = {
+        .num_workers = num_jobs,
+        .probe_ids = probe_ids,
+        .num_probes = num_streams,
+        .batch_bytes = PIPELINE_BATCH_BYTES,
+        .max_record_bytes = MAX_RECORD_BYTES,
+        .follow = stream_mode,
+        .record_cb = pipeline_record_cb,
+        .wait_cb = pipeline_wait_cb,
+        .idle_cb = stream_mode ? pipeline_idle_cb : NULL,
+        .ctx = NULL,
+    };
+
+    // Streams are opened in the order of probe_ids
+    for (unsigned i = 0; i < num_streams; i++)
+        out_files[i] = streams[i].out_file;
+
+    int res = vcd_pipeline_run(&config,
+                               input_map ? input_map->data : NULL,
+                               input_map ? input_map->size : 0,
+                               input_map ? NULL : input_file,
+                               out_files, &stats);
+
+    line_count = stats.lines;
+
+    if (stats.bytes_lost > 0)
+        write_log(LOG_ERR, "Data lost while writing to file system.\n");
+
+    if (res < 0) {
+        write_log(LOG_ERR, "Conversion pipeline failed.\n");
+        return ERROR_OUT_OF_RESOURCES;
+    } else if (res > 0) {
+        return (error_code_t)res;
     }
 
+    if (!stream_mode)
+        print_end_of_file_status();
+
     return ERROR_NONE;
 }
+#endif /* (VCD_PIPELINE_ENABLED == 1) */
 
 static void xscope_exit_cb(void)
 {
@@ -671,18 +1203,44 @@ static void xscope_record_cb(unsigned int id, unsigned long long timestamp,
     if (!running)
         return;
 
-    if (id == XSCOPE_PROBE_ID) {
-        error_code_t res = process_psf_data(data_bytes, length);
+    psf_stream_t *stream = (id <= MAX_PROBE_ID) ? stream_by_probe[id] : NULL;
+
+#if (RING_WRITER_ENABLED == 1)
+    if (stream != NULL) {
+        // The PSF preamble is required for the file to be opened at all
+        const bool essential = (stream->psf_state != PROCESS_PSF_EVENT);
+        unsigned char *bytes = ring_writer_reserve(record_writer,
+                                                   stream - streams, length,
+                                                   essential);
+
+        // Dropped records show up as missing events
+        if (bytes == NULL)
+            return;
+
+        // Processed in place, the record is written by the writer thread
+        memcpy(bytes, data_bytes, length);
+        error_code_t res = process_psf_data(stream, bytes, length);
         if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT) {
             running = false;
             return;
         }
 
-        if (fwrite(data_bytes, sizeof(data_bytes[0]), length, out_file) !=
-            length) {
+        ring_writer_commit(record_writer);
+    }
+#else
+    if (stream != NULL) {
+        error_code_t res = process_psf_data(stream, data_bytes, length);
+        if (res != ERROR_NONE && res != ERROR_DATA_TOO_SHORT) {
+            running = false;
+            return;
+        }
+
+        if (fwrite(data_bytes, sizeof(data_bytes[0]), length,
+                   stream->out_file) != length) {
             write_log(LOG_ERR, "Data lost while writing to file system.\n");
         }
     }
+#endif
 #if (PRINT_OTHER_RECORDS == 1)
     else {
         print_record(id, timestamp, length, data_val, data_bytes);
@@ -712,6 +1270,35 @@ static error_code_t next_arg_value(int argc, char *argv[], int *argi)
     return ERROR_NONE;
 }
 
+static error_code_t parse_probe_ids(const char *arg)
+{
+    const char *pos = arg;
+
+    num_probe_ids = 0;
+
+    while (1) {
+        char *end;
+        unsigned long id = strtoul(pos, &end, 10);
+
+        if (end == pos || id > MAX_PROBE_ID || num_probe_ids == MAX_PROBES)
+            return ERROR_ARG_VALUE_PARSING_FAILURE;
+
+        for (unsigned i = 0; i < num_probe_ids; i++) {
+            if (probe_ids[i] == id)
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+        }
+
+        probe_ids[num_probe_ids++] = (unsigned int)id;
+
+        if (*end == '\0')
+            return ERROR_NONE;
+        else if (*end != ',')
+            return ERROR_ARG_VALUE_PARSING_FAILURE;
+
+        pos = end + 1;
+    }
+}
+
 static error_code_t process_args(int argc, char *argv[])
 {
     bool in_port_present = false;
@@ -766,6 +1353,72 @@ static error_code_t process_args(int argc, char *argv[])
         } else if (is_matching_arg(argv[i], stream_arg,
                                    NUM_ELEMS(stream_arg))) {
             stream_mode = true;
+        } else if (is_matching_arg(argv[i], mmap_arg, NUM_ELEMS(mmap_arg))) {
+            mmap_mode = true;
+        } else if (is_matching_arg(argv[i], index_arg, NUM_ELEMS(index_arg))) {
+            index_mode = true;
+        } else if (is_matching_arg(argv[i], compress_arg,
+                                   NUM_ELEMS(compress_arg))) {
+#if (PSFZ_FILE_SUPPORTED == 1)
+            compress_mode = true;
+            if (!psfz_spare_cpu())
+                write_log(LOG_WRN, "No spare CPU to compress on; --compress "
+                          "will store the PSF blocks uncompressed.\n");
+#else
+            write_log(LOG_ERR, "--compress is not supported on this platform.\n");
+            return ERROR_UNKOWN_ARG;
+#endif
+        } else if (is_matching_arg(argv[i], analytics_arg,
+                                   NUM_ELEMS(analytics_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            analytics_prefix = argv[i];
+        } else if (is_matching_arg(argv[i], probes_arg,
+                                   NUM_ELEMS(probes_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (parse_probe_ids(argv[i]) != ERROR_NONE) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
+        } else if (is_matching_arg(argv[i], buffer_arg,
+                                   NUM_ELEMS(buffer_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (sscanf(argv[i], "%d", &ring_buffer_mb) != 1 ||
+                ring_buffer_mb <= 0) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
+        } else if (is_matching_arg(argv[i], overflow_arg,
+                                   NUM_ELEMS(overflow_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+#if (RING_WRITER_ENABLED == 1)
+            if (!ring_writer_parse_policy(argv[i], &overflow_policy)) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
+#else
+            write_log(LOG_ERR, "--overflow is not supported on this platform.\n");
+            return ERROR_UNKOWN_ARG;
+#endif
+        } else if (is_matching_arg(argv[i], jobs_arg, NUM_ELEMS(jobs_arg))) {
+            if (next_arg_value(argc, argv, &i) != ERROR_NONE)
+                return ERROR_ARG_VALUE_MISSING;
+
+            if (sscanf(argv[i], "%d", &num_jobs) != 1 || num_jobs < 0) {
+                write_log(LOG_ERR, "Argument value (%s) could not be parsed.\n",
+                          argv[i]);
+                return ERROR_ARG_VALUE_PARSING_FAILURE;
+            }
         } else if (is_matching_arg(argv[i], verbose_arg,
                                    NUM_ELEMS(verbose_arg))) {
             log_level = LOG_INF;
@@ -778,15 +1431,155 @@ static error_code_t process_args(int argc, char *argv[])
     if (in_port_present && in_file_present)
         return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
 
+    if (mmap_mode && (stream_mode || in_port_present))
+        return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
+
+    if (num_jobs > 0 && in_port_present)
+        return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
+
+#if (RING_WRITER_ENABLED == 1)
+    // Discarding processed records would invalidate the indexed offsets
+    if (index_mode && overflow_policy == RING_WRITER_DROP_OLDEST)
+        return ERROR_MUTUALLY_EXCLUSIVE_ARGS;
+#endif
+
+#if (VCD_PIPELINE_ENABLED == 0)
+    if (num_jobs > 0) {
+        write_log(LOG_ERR, "--jobs is not supported on this platform.\n");
+        return ERROR_UNKOWN_ARG;
+    }
+#endif
+
     return ((in_port_present || in_file_present) && out_file_present) ?
                    ERROR_NONE :
                    ERROR_MISSING_ARG;
 }
 
+/*
+ * The PSF file of a probe; with several probes, _probe<N> is inserted ahead of
+ * the extension of OUT_FILE.
+ */
+static void stream_filename(char *dst, size_t size, unsigned int probe_id)
+{
+    const char *base = output_filename;
+
+    if (num_probe_ids == 1) {
+        snprintf(dst, size, "%s", output_filename);
+        return;
+    }
+
+    for (const char *c = output_filename; *c; c++) {
+        if (*c == '/' || *c == '\\')
+            base = c + 1;
+    }
+
+    const char *ext = strrchr(base, '.');
+    if (ext == NULL || ext == base)
+        ext = base + strlen(base);
+
+    snprintf(dst, size, "%.*s_probe%u%s", (int)(ext - output_filename),
+             output_filename, probe_id, ext);
+}
+
+#if (PSFZ_FILE_SUPPORTED == 1)
+static void psfz_block_position(void *ctx, uint64_t *block_start,
+                                uint64_t *block_offset)
+{
+    psfz_file_position(ctx, block_start, block_offset);
+}
+#endif
+
+static bool open_streams(void)
+{
+    for (unsigned i = 0; i < num_probe_ids; i++) {
+        psf_stream_t *stream = &streams[num_streams];
+
+        memset(stream, 0, sizeof(*stream));
+        stream->probe_id = probe_ids[i];
+        stream->psf_state = PROCESS_PSF_HEADER;
+
+        if (num_probe_ids > 1)
+            snprintf(stream->log_prefix, sizeof(stream->log_prefix),
+                     "[Probe %u] ", stream->probe_id);
+
+        stream_filename(stream->out_filename, sizeof(stream->out_filename),
+                        stream->probe_id);
+
+        write_log(LOG_INF, "%sOpening output file ...\n", stream->log_prefix);
+#if (PSFZ_FILE_SUPPORTED == 1)
+        if (compress_mode)
+            stream->out_file = psfz_fopen(stream->out_filename,
+                                          &stream->psfz_file);
+        else
+#endif
+        stream->out_file = fopen(stream->out_filename, "wb");
+
+        if (stream->out_file == NULL)
+            return false;
+
+        num_streams++;
+        stream_by_probe[stream->probe_id] = stream;
+
+        if (index_mode) {
+            char index_filename[FILENAME_MAX + sizeof(".idx")];
+            snprintf(index_filename, sizeof(index_filename), "%s.idx",
+                     stream->out_filename);
+
+            write_log(LOG_INF, "%sOpening index file ...\n",
+                      stream->log_prefix);
+            stream->index_mode = psf_index_writer_open(&stream->psf_index,
+                                                       index_filename);
+            if (!stream->index_mode)
+                write_log(LOG_ERR, "Failed to open index file (%s).\n",
+                          index_filename);
+#if (PSFZ_FILE_SUPPORTED == 1)
+            else if (stream->psfz_file != NULL)
+                psf_index_writer_set_blocks(&stream->psf_index,
+                                            psfz_block_position,
+                                            stream->psfz_file);
+#endif
+        }
+    }
+
+    return true;
+}
+
+static void close_streams(void)
+{
+    for (unsigned i = 0; i < num_streams; i++) {
+        psf_stream_t *stream = &streams[i];
+
+        if (stream->analytics_started) {
+            write_log(LOG_INF, "%sWriting analytics ...\n",
+                      stream->log_prefix);
+            write_analytics(stream);
+            trace_stats_free(&stream->trace_stats);
+        }
+
+        fclose(stream->out_file);
+        psf_index_writer_close(&stream->psf_index);
+        free(stream->event_cnts);
+        stream_by_probe[stream->probe_id] = NULL;
+    }
+
+    num_streams = 0;
+}
+
+static void format_probe_ids(char *dst, size_t size)
+{
+    size_t len = 0;
+
+    dst[0] = '\0';
+    for (unsigned i = 0; i < num_probe_ids && len < size; i++)
+        len += snprintf(&dst[len], size - len, i ? ", %u" : "%u", probe_ids[i]);
+}
+
 int main(int argc, char *argv[])
 {
     int exit_code = process_args(argc, argv);
     FILE *in_file = NULL;
+    mapped_file_t in_map = {0};
+    char probes[MAX_PROBES * 5];
 
     if (show_help || exit_code) {
         print_help(argv[0]);
@@ -797,7 +1590,14 @@ int main(int argc, char *argv[])
     }
 
     // Setup the input data source based on the specified user arguments
-    if (input_filename) {
+    if (input_filename && mmap_mode) {
+        write_log(LOG_INF, "Mapping input file ...\n");
+
+        if (!mapped_file_open(&in_map, input_filename)) {
+            write_log(LOG_INF, "File not found.\n");
+            return ERROR_FILE_SYSTEM;
+        }
+    } else if (input_filename) {
         write_log(LOG_INF, "Opening input file ...\n");
 
         while (1) {
@@ -824,25 +1624,58 @@ int main(int argc, char *argv[])
         xscope_ep_set_exit_cb(xscope_exit_cb);
     }
 
-    write_log(LOG_INF, "Opening output file ...\n");
-    out_file = fopen(output_filename, "wb");
-
-    if (out_file == NULL) {
+    if (!open_streams()) {
+        close_streams();
         if (in_file != NULL)
             fclose(in_file);
+        if (mmap_mode)
+            mapped_file_close(&in_map);
 
         return ERROR_FILE_SYSTEM;
     }
 
+    format_probe_ids(probes, sizeof(probes));
+
     // Process the input data source based on the specified user arguments
     if (input_filename) {
-        write_log(LOG_INF, "Processing file (Probe: %d) ...\n",
-                  XSCOPE_PROBE_ID);
-        exit_code = process_vcd_file(in_file, out_file);
+        if (stream_mode) {
+            file_follow_init(&input_follow, input_filename, sleep_ms);
+            write_log(LOG_INF, "Following file (%s) ...\n",
+                      file_follow_is_event_driven(&input_follow) ?
+                      "inotify" : "polling");
+        }
+
+        write_log(LOG_INF, "Processing file (Probe: %s) ...\n", probes);
+#if (VCD_PIPELINE_ENABLED == 1)
+        if (num_jobs > 0)
+            exit_code = process_vcd_pipelined(mmap_mode ? &in_map : NULL,
+                                              in_file);
+        else
+#endif
+        if (mmap_mode)
+            exit_code = process_vcd_mapped(&in_map);
+        else
+            exit_code = process_vcd_file(in_file);
     } else {
+#if (RING_WRITER_ENABLED == 1)
+        FILE *out_files[MAX_PROBES];
+        for (unsigned i = 0; i < num_streams; i++)
+            out_files[i] = streams[i].out_file;
+
+        record_writer = ring_writer_create((size_t)ring_buffer_mb * 1024 * 1024,
+                                           overflow_policy, out_files,
+                                           num_streams);
+        if (record_writer == NULL) {
+            write_log(LOG_ERR, "Failed to allocate the %d MB buffer.\n",
+                      ring_buffer_mb);
+            close_streams();
+            return ERROR_OUT_OF_RESOURCES;
+        }
+#endif
+
         write_log(LOG_INF,
-                  "Connecting to xscope (Probe: %d, Host: %s, Port: %s) ...\n",
-                  XSCOPE_PROBE_ID, input_host, input_port);
+                  "Connecting to xscope (Probe: %s, Host: %s, Port: %s) ...\n",
+                  probes, input_host, input_port);
         int error = xscope_ep_connect(input_host, input_port);
         if (error) {
             running = false;
@@ -850,27 +1683,45 @@ int main(int argc, char *argv[])
         }
 
         // While 'running' print out basic status info for user feedback.
-        int last_event_count = 0;
         while (running) {
-            if (last_event_count != event_count) {
-                print_stream_status();
-                last_event_count = event_count;
-            }
-
+            print_stream_status();
             SLEEP_MS(1000);
         }
 
         write_log(LOG_INF, "Disconnecting from xscope ...\n");
         xscope_ep_disconnect();
+
+#if (RING_WRITER_ENABLED == 1)
+        ring_writer_stats_t stats;
+
+        write_log(LOG_INF, "Flushing buffer ...\n");
+        ring_writer_destroy(record_writer, &stats);
+        record_writer = NULL;
+
+        write_log(LOG_INF, "Buffer peak %zu KB of %zu KB, waited for space "
+                  "%llu times\n", stats.high_watermark / 1024,
+                  stats.capacity / 1024, (unsigned long long)stats.waits);
+
+        if (stats.records_dropped > 0)
+            write_log(LOG_WRN, "Dropped %llu records (%llu bytes) while the "
+                      "buffer was full.\n",
+                      (unsigned long long)stats.records_dropped,
+                      (unsigned long long)stats.bytes_dropped);
+
+        if (stats.write_errors > 0)
+            write_log(LOG_ERR, "Data lost while writing to file system "
+                      "(%llu records).\n",
+                      (unsigned long long)stats.write_errors);
+#endif
     }
 
     write_log(LOG_INF, "Closing files ...\n");
-    fclose(out_file);
+    close_streams();
+    file_follow_deinit(&input_follow);
     if (in_file != NULL)
         fclose(in_file);
-
-    if (event_cnts != NULL)
-        free(event_cnts);
+    if (mmap_mode)
+        mapped_file_close(&in_map);
 
     write_log(LOG_INF, "Done.\n");
 
@@ -0,0 +1,213 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Benchmark of sending pipeline frames from tile[0] to a frame pool on
+ * tile[1], over the host's intertile link, each message of which takes
+ * TRANSACTION_US to start, as the handshake does on the device.
+ *
+ * Frames are sent one per message, received into a buffer and copied into
+ * a frame from the pool, and then by the frame link, which receives each
+ * straight into a pool frame. Each frame carries a sequence number, which
+ * the receiver checks, and the time the sender had it ready, from which the
+ * receiver times it. The link's counters give the messages and the bytes
+ * copied per frame.
+ *
+ * Usage: xscope_fileio_frame_link_bench [TRANSACTION_US] [FRAMES]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "xcore/hwtimer.h"
+#include "platform.h"
+#include "platform/driver_instances.h"
+
+#include "app_conf.h"
+#include "frame_pool.h"
+#include "frame_link.h"
+#include "stage_timing.h"
+
+#define POOL_FRAMES     8
+#define CREDIT_BATCH    2
+#define FIRST_PORT      16
+#define MAX_RUNS        2
+
+typedef struct {
+    uint32_t seq;
+    uint32_t time_ready;
+    int32_t data[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+} bench_frame_t;
+
+typedef enum {
+    MODE_COPY,
+    MODE_LINK,
+} bench_mode_t;
+
+enum {
+    OWNER_RECEIVER = 1,
+};
+
+static bench_mode_t mode;
+static unsigned num_frames;
+static unsigned run_count;
+static uint8_t data_port;
+static uint8_t credit_port;
+static FRAME_POOL_STORAGE(pool_storage, sizeof(bench_frame_t), POOL_FRAMES);
+static frame_pool_t pool;
+static frame_link_tx_t tx_links[MAX_RUNS];
+static frame_link_rx_t rx_links[MAX_RUNS];
+static frame_link_tx_t *tx_link;
+static frame_link_rx_t *rx_link;
+static QueueHandle_t done_queue;
+static stage_timing_t latency;
+static unsigned out_of_order;
+static size_t rx_bytes_copied;
+
+static void sender(void *arg)
+{
+    static bench_frame_t frame;
+    rtos_intertile_t *ctx = arg;
+
+    for (unsigned seq = 0; seq < num_frames; seq++) {
+        frame.seq = seq;
+        frame.data[0][0] = seq;
+        frame.time_ready = get_reference_time();
+
+        if (mode == MODE_COPY) {
+            rtos_intertile_tx(ctx, data_port, &frame, sizeof(frame));
+        } else {
+            frame_link_tx(tx_link, &frame);
+        }
+    }
+
+    for (;;) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+static bench_frame_t *receive(rtos_intertile_t *ctx)
+{
+    static bench_frame_t buf;
+    bench_frame_t *frame;
+
+    if (mode == MODE_LINK) {
+        return frame_link_rx(rx_link);
+    }
+
+    /* A message at a time, into a buffer, then into a frame */
+    (void) rtos_intertile_rx_len(ctx, data_port, portMAX_DELAY);
+    rtos_intertile_rx_data(ctx, &buf, sizeof(buf));
+    while ((frame = frame_pool_get(&pool, OWNER_RECEIVER)) == NULL) {
+        vTaskDelay(1);
+    }
+    memcpy(frame, &buf, sizeof(buf));
+    rx_bytes_copied += sizeof(buf);
+
+    return frame;
+}
+
+static void receiver(void *arg)
+{
+    rtos_intertile_t *ctx = arg;
+    int done = 1;
+
+    for (unsigned seq = 0; seq < num_frames; seq++) {
+        bench_frame_t *frame = receive(ctx);
+
+        stage_timing_record(&latency, get_reference_time() - frame->time_ready);
+        out_of_order += (frame->seq != seq) || (frame->data[0][0] != (int32_t)seq);
+
+        if (mode == MODE_LINK) {
+            frame_link_rx_release(rx_link, frame, OWNER_RECEIVER);
+        } else {
+            frame_pool_release(frame, OWNER_RECEIVER);
+        }
+    }
+
+    xQueueSend(done_queue, &done, portMAX_DELAY);
+    for (;;) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+static void run(bench_mode_t bench_mode, const char *name)
+{
+    host_intertile_stats_t before;
+    host_intertile_stats_t after;
+    rtos_intertile_t *ctx[2];
+    uint32_t time_start;
+    uint32_t ticks;
+    int done;
+
+    mode = bench_mode;
+    out_of_order = 0;
+    rx_bytes_copied = 0;
+    stage_timing_init(&latency, name, 1);
+    frame_pool_init(&pool, pool_storage, sizeof(bench_frame_t), POOL_FRAMES);
+
+    /* Fresh links and ports for each run, as the tasks of earlier runs
+     * keep theirs */
+    xassert(run_count < MAX_RUNS);
+    tx_link = &tx_links[run_count];
+    rx_link = &rx_links[run_count];
+    data_port = FIRST_PORT + 2 * run_count;
+    credit_port = data_port + 1;
+    run_count++;
+
+    host_rtos_tile_set(1);
+    ctx[1] = host_intertile_ctx();
+    frame_link_rx_init(rx_link, ctx[1], data_port, credit_port, sizeof(bench_frame_t),
+                       &pool, OWNER_RECEIVER, CREDIT_BATCH);
+    xTaskCreate(receiver, "receiver", 0, ctx[1], appconfDATA_PIPELINE_TASK_PRIORITY, NULL);
+
+    host_rtos_tile_set(0);
+    ctx[0] = host_intertile_ctx();
+    if (mode == MODE_LINK) {
+        frame_link_tx_init(tx_link, ctx[0], data_port, credit_port, sizeof(bench_frame_t),
+                           POOL_FRAMES, appconfDATA_PIPELINE_TASK_PRIORITY);
+    }
+
+    host_intertile_stats(0, &before);
+    time_start = get_reference_time();
+    xTaskCreate(sender, "sender", 0, ctx[0], appconfDATA_PIPELINE_TASK_PRIORITY, NULL);
+    xQueueReceive(done_queue, &done, portMAX_DELAY);
+    ticks = get_reference_time() - time_start;
+    host_intertile_stats(0, &after);
+
+    printf("%-22s %9.2f %11.0f %9.2f %9.2f %12.0f %9u\n",
+           name,
+           (after.transactions - before.transactions) / (double)num_frames,
+           (after.bytes_copied - before.bytes_copied + rx_bytes_copied) / (double)num_frames,
+           stage_timing_mean(&latency) * 1e6 / PLATFORM_REFERENCE_HZ,
+           stage_timing_percentile(&latency, 990) * 1e6 / PLATFORM_REFERENCE_HZ,
+           num_frames * (double)PLATFORM_REFERENCE_HZ / ticks,
+           out_of_order);
+}
+
+int main(int argc, char *argv[])
+{
+    host_intertile_transaction_us = (argc > 1) ? atoi(argv[1]) : 20;
+    num_frames = (argc > 2) ? atoi(argv[2]) : 5000;
+    if (num_frames == 0) {
+        fprintf(stderr, "Usage: %s [TRANSACTION_US] [FRAMES]\n", argv[0]);
+        return 1;
+    }
+
+    host_rtos_tile_set(0);
+    done_queue = xQueueCreate(1, sizeof(int));
+
+    printf("%u frames of %u bytes from tile 0 to tile 1, %u us to start each message\n",
+           num_frames, (unsigned)sizeof(bench_frame_t), host_intertile_transaction_us);
+    printf("%-22s %9s %11s %9s %9s %12s %9s\n",
+           "sent by", "msgs/frm", "bytes/frm", "mean us", "p99 us", "frames/s", "misorder");
+    run(MODE_COPY, "message, then copied");
+    run(MODE_LINK, "frame link");
+
+    return 0;
+}
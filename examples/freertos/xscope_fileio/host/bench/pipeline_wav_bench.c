@@ -0,0 +1,236 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Benchmark of the example's pipeline stages on the host, against a WAV
+ * file.
+ *
+ * The stages of both tiles are built from the example's own source (see
+ * data_pipeline_stages.h) and run, in order, by the POSIX generic_pipeline,
+ * one thread per stage, with no intertile link or xscope_fileio. IN.wav is
+ * read into memory and cut into frames, as the fileio task does, and its
+ * frames are passed through the stages PASSES times, followed by an end of
+ * stream frame. The frames of the last pass are written to OUT.wav, which
+ * is then the same as the example's output for IN.wav.
+ *
+ * The frames per second and the times faster than real time that the
+ * stages ran at are printed, as are each stage's timings. The stage
+ * threads are named, so that "perf record" and "perf report --sort comm"
+ * give each stage's profile.
+ *
+ * Usage: xscope_fileio_pipeline_wav_bench IN.wav OUT.wav [PASSES]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "xcore/hwtimer.h"
+#include "platform.h"
+
+#include "app_conf.h"
+#include "generic_pipeline.h"
+#include "data_pipeline.h"
+#include "data_pipeline_stages.h"
+#include "stage_timing.h"
+#include "wav_utils.h"
+#include "wav_convert.h"
+
+typedef struct {
+    const int32_t *samples;     /* [block][channel][frame], the whole file */
+    unsigned block_count;
+    unsigned frames_total;      /* Of every pass, not counting end of stream */
+    unsigned frames_in;
+} bench_input_t;
+
+typedef struct {
+    uint8_t *file_data;         /* The last pass, as written to OUT.wav */
+    size_t block_bytes;
+    unsigned block_count;
+    unsigned num_channels;
+    wav_sample_format_t format;
+    unsigned frames_out;
+    QueueHandle_t done_queue;
+} bench_output_t;
+
+static void *bench_input(bench_input_t *in)
+{
+    frame_data_t *frame;
+
+    if (in->frames_in > in->frames_total) {
+        /* The end of stream frame has been sent */
+        for (;;) {
+            vTaskDelay(portMAX_DELAY);
+        }
+    }
+
+    frame = pvPortMalloc(sizeof(frame_data_t));
+    xassert(frame != NULL);
+
+    if (in->frames_in == in->frames_total) {
+        frame->end_of_stream = 1;
+    } else {
+        const unsigned block = in->frames_in % in->block_count;
+
+        memcpy(frame->data,
+               &in->samples[(size_t)block * appconfMAX_CHANNELS * appconfFRAME_ADVANCE],
+               sizeof(frame->data));
+        frame->end_of_stream = 0;
+    }
+    in->frames_in++;
+
+    return frame;
+}
+
+static int bench_output(frame_data_t *frame, bench_output_t *out)
+{
+    if (frame->end_of_stream) {
+        int done = 1;
+
+        xQueueSend(out->done_queue, &done, portMAX_DELAY);
+    } else {
+        const unsigned block = out->frames_out % out->block_count;
+
+        wav_interleave_from_s32(&out->file_data[block * out->block_bytes], out->format,
+                                &frame->data[0][0], appconfFRAME_ADVANCE,
+                                out->num_channels, appconfFRAME_ADVANCE);
+        out->frames_out++;
+    }
+
+    return DATA_PIPELINE_FREE_FRAME;
+}
+
+static void print_timing(const stage_timing_t *t)
+{
+    printf("%-28s %6u %9u %9.2f %9.2f %9.2f\n",
+           t->name, t->tile, t->count,
+           stage_timing_mean(t) * 1e6 / PLATFORM_REFERENCE_HZ,
+           stage_timing_percentile(t, 990) * 1e6 / PLATFORM_REFERENCE_HZ,
+           t->max_ticks * 1e6 / PLATFORM_REFERENCE_HZ);
+}
+
+int main(int argc, char *argv[])
+{
+    static bench_input_t in;
+    static bench_output_t out;
+    xscope_file_t infile;
+    xscope_file_t outfile;
+    wav_header header;
+    wav_header output_header;
+    unsigned header_size;
+    uint64_t data_bytes;
+    unsigned passes;
+    uint8_t *file_data;
+    int32_t *samples;
+    uint32_t time_start;
+    uint32_t ticks;
+    int done;
+
+    passes = (argc > 3) ? atoi(argv[3]) : 1;
+    if (argc < 3 || argc > 4 || passes == 0) {
+        fprintf(stderr, "Usage: %s IN.wav OUT.wav [PASSES]\n", argv[0]);
+        return 1;
+    }
+
+    infile = xscope_open_file(argv[1], "rb");
+    if (infile.fp == NULL || get_wav_header_details(&infile, &header, &header_size, &data_bytes) != 0) {
+        fprintf(stderr, "Error: cannot read the WAV header of %s\n", argv[1]);
+        return 1;
+    }
+
+    out.format = wav_get_sample_format(header.audio_format, header.bit_depth);
+    out.num_channels = header.num_channels;
+    if (out.format == WAV_SAMPLE_UNSUPPORTED ||
+        out.num_channels < 1 || out.num_channels > appconfMAX_CHANNELS) {
+        fprintf(stderr, "Error: %s is not 16, 24 or 32 bit PCM, or 32 bit float, of 1 to %u channels\n",
+                argv[1], appconfMAX_CHANNELS);
+        return 1;
+    }
+
+    /* As the example, whole frames only */
+    out.block_bytes = (size_t)appconfFRAME_ADVANCE * wav_get_num_bytes_per_frame(&header);
+    out.block_count = data_bytes / out.block_bytes;
+    if (out.block_count == 0 || (uint64_t)out.block_count * out.block_bytes > UINT32_MAX - (WAV_HEADER_BYTES - 8)) {
+        fprintf(stderr, "Error: %s has no whole frames, or too many to hold\n", argv[1]);
+        return 1;
+    }
+
+    file_data = malloc((size_t)out.block_count * out.block_bytes);
+    samples = calloc((size_t)out.block_count * appconfMAX_CHANNELS * appconfFRAME_ADVANCE, sizeof(int32_t));
+    out.file_data = malloc((size_t)out.block_count * out.block_bytes);
+    xassert(file_data != NULL && samples != NULL && out.file_data != NULL);
+
+    xscope_fseek(&infile, wav_get_frame_start(&header, 0, header_size), SEEK_SET);
+    if (xscope_fread(&infile, file_data, (size_t)out.block_count * out.block_bytes) != (size_t)out.block_count * out.block_bytes) {
+        fprintf(stderr, "Error: cannot read the samples of %s\n", argv[1]);
+        return 1;
+    }
+    for (unsigned b = 0; b < out.block_count; b++) {
+        wav_deinterleave_to_s32(&samples[(size_t)b * appconfMAX_CHANNELS * appconfFRAME_ADVANCE], appconfFRAME_ADVANCE,
+                                &file_data[(size_t)b * out.block_bytes], out.format,
+                                out.num_channels, appconfFRAME_ADVANCE);
+    }
+    free(file_data);
+
+    in.samples = samples;
+    in.block_count = out.block_count;
+    in.frames_total = out.block_count * passes;
+    out.done_queue = xQueueCreate(1, sizeof(int));
+
+    stage_timing_init(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_PREEMPTION_DISABLED], "stage_preemption_disabled", 1);
+    stage_timing_init(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_PREEMPTION_ENABLED], "stage_preemption_enabled", 1);
+    stage_timing_init(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_3], "stage_3", 0);
+
+    {
+        const pipeline_stage_t stages[DATA_PIPELINE_STAGE_COUNT] = {
+            (pipeline_stage_t)stage_preemption_disabled,
+            (pipeline_stage_t)stage_preemption_enabled,
+            (pipeline_stage_t)stage_3,
+        };
+        const size_t stage_stack_sizes[DATA_PIPELINE_STAGE_COUNT] = { 0 };
+
+        host_rtos_tile_set(0);
+        time_start = get_reference_time();
+        generic_pipeline_init((pipeline_input_t)bench_input,
+                              (pipeline_output_t)bench_output,
+                              &in,
+                              &out,
+                              stages,
+                              stage_stack_sizes,
+                              appconfDATA_PIPELINE_TASK_PRIORITY,
+                              DATA_PIPELINE_STAGE_COUNT);
+        xQueueReceive(out.done_queue, &done, portMAX_DELAY);
+        ticks = get_reference_time() - time_start;
+    }
+
+    printf("%u frames of %u samples of %u channels at %d Hz, %u passes: %.0f frames/s, %.1f times real time\n",
+           in.frames_total, appconfFRAME_ADVANCE, out.num_channels, header.sample_rate, passes,
+           in.frames_total * (double)PLATFORM_REFERENCE_HZ / ticks,
+           ((double)in.frames_total * appconfFRAME_ADVANCE / header.sample_rate) /
+                   ((double)ticks / PLATFORM_REFERENCE_HZ));
+    printf("%-28s %6s %9s %9s %9s %9s\n", "stage", "tile", "frames", "mean us", "p99 us", "max us");
+    for (int i = 0; i < DATA_PIPELINE_STAGE_COUNT; i++) {
+        print_timing(&data_pipeline_stage_timings[i]);
+    }
+
+    wav_form_header(&output_header,
+                    header.audio_format,
+                    header.num_channels,
+                    header.sample_rate,
+                    header.bit_depth,
+                    out.block_count * appconfFRAME_ADVANCE);
+    outfile = xscope_open_file(argv[2], "wb");
+    if (outfile.fp == NULL) {
+        fprintf(stderr, "Error: cannot open %s\n", argv[2]);
+        return 1;
+    }
+    xscope_fwrite(&outfile, (uint8_t *)&output_header, WAV_HEADER_BYTES);
+    xscope_fwrite(&outfile, out.file_data, (size_t)out.block_count * out.block_bytes);
+    xscope_close_all_files();
+
+    return 0;
+}
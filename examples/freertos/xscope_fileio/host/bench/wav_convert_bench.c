@@ -0,0 +1,109 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Throughput of the WAV sample conversion kernels against the naive
+ * sample-by-sample loops, one pipeline frame (appconfFRAME_ADVANCE frames)
+ * per call.
+ *
+ * Usage: xscope_fileio_wav_convert_bench [MB]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "wav_convert.h"
+#include "wav_convert_ref.h"
+
+#define FRAME_ADVANCE   240
+#define MAX_CHANNELS    8
+#define DEFAULT_MB      256
+
+typedef void (*deinterleave_fn)(int32_t *, size_t, const uint8_t *,
+                                wav_sample_format_t, unsigned, unsigned);
+typedef void (*interleave_fn)(uint8_t *, wav_sample_format_t, const int32_t *,
+                              size_t, unsigned, unsigned);
+
+static const wav_sample_format_t formats[] = {
+    WAV_SAMPLE_S16, WAV_SAMPLE_S24, WAV_SAMPLE_S32, WAV_SAMPLE_F32
+};
+static const char *format_names[] = {"s16", "s24", "s32", "f32"};
+static const unsigned channel_counts[] = {1, 2, 6, 8};
+
+static uint8_t raw[MAX_CHANNELS * FRAME_ADVANCE * 4];
+static int32_t planar[MAX_CHANNELS * FRAME_ADVANCE];
+static volatile uint32_t sink;
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Returns the MB/s of raw WAV data converted */
+static double time_deinterleave(deinterleave_fn fn, wav_sample_format_t format,
+                                unsigned num_channels, size_t total_bytes)
+{
+    const size_t frame_bytes = (size_t)FRAME_ADVANCE * num_channels * wav_get_sample_bytes(format);
+    const size_t reps = total_bytes / frame_bytes + 1;
+    const double start = now_s();
+
+    for (size_t r = 0; r < reps; r++) {
+        raw[r % frame_bytes] ^= 1;
+        fn(planar, FRAME_ADVANCE, raw, format, num_channels, FRAME_ADVANCE);
+        sink += planar[r % FRAME_ADVANCE];
+    }
+
+    return reps * frame_bytes / (now_s() - start) / 1e6;
+}
+
+static double time_interleave(interleave_fn fn, wav_sample_format_t format,
+                              unsigned num_channels, size_t total_bytes)
+{
+    const size_t frame_bytes = (size_t)FRAME_ADVANCE * num_channels * wav_get_sample_bytes(format);
+    const size_t reps = total_bytes / frame_bytes + 1;
+    const double start = now_s();
+
+    for (size_t r = 0; r < reps; r++) {
+        planar[r % FRAME_ADVANCE] ^= 1;
+        fn(raw, format, planar, FRAME_ADVANCE, num_channels, FRAME_ADVANCE);
+        sink += raw[r % frame_bytes];
+    }
+
+    return reps * frame_bytes / (now_s() - start) / 1e6;
+}
+
+int main(int argc, char *argv[])
+{
+    const size_t total_bytes = (size_t)((argc > 1) ? atoi(argv[1]) : DEFAULT_MB) * 1000000;
+
+    for (size_t i = 0; i < sizeof(raw); i++) {
+        raw[i] = (uint8_t)(i * 37);
+    }
+    // Keep the float samples in range
+    for (size_t i = 3; i < sizeof(raw); i += 4) {
+        raw[i] &= 0x3F;
+    }
+
+    printf("%-6s %-9s %12s %12s %8s %12s %12s %8s\n", "format", "channels",
+           "in ref MB/s", "in MB/s", "speedup", "out ref MB/s", "out MB/s", "speedup");
+
+    for (unsigned f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        for (unsigned c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+            const unsigned ch = channel_counts[c];
+            const double in_ref = time_deinterleave(wav_deinterleave_to_s32_ref, formats[f], ch, total_bytes);
+            const double in = time_deinterleave(wav_deinterleave_to_s32, formats[f], ch, total_bytes);
+            const double out_ref = time_interleave(wav_interleave_from_s32_ref, formats[f], ch, total_bytes);
+            const double out = time_interleave(wav_interleave_from_s32, formats[f], ch, total_bytes);
+
+            printf("%-6s %-9u %12.0f %12.0f %7.1fx %12.0f %12.0f %7.1fx\n",
+                   format_names[f], ch, in_ref, in, in / in_ref, out_ref, out, out / out_ref);
+        }
+    }
+
+    return 0;
+}
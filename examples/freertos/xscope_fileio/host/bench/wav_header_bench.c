@@ -0,0 +1,173 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Transport calls and time per parse of the WAV header parser against the
+ * previous parser, which made a request per field, for a range of header
+ * layouts. On the device each call is a round trip to the host over xscope,
+ * so the calls, not the host time, are what matter there.
+ *
+ * Usage: xscope_fileio_wav_header_bench [TMP_DIR] [ITERATIONS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "xscope_io_device.h"
+#include "wav_utils.h"
+#include "wav_convert.h"
+#include "wav_header_ref.h"
+
+#define MAX_PATH            512
+#define DEFAULT_ITERATIONS  20000
+
+typedef struct {
+    const char *name;
+    uint8_t bytes[4096];
+    size_t len;
+} layout_t;
+
+static char path[MAX_PATH];
+static layout_t layouts[4];
+
+/* rtos_printf() in the parsers, which report each rejected header */
+int quiet_printf(const char *format, ...)
+{
+    (void) format;
+    return 0;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void put32(uint8_t *p, uint32_t x)
+{
+    for (int i = 0; i < 4; i++) {
+        p[i] = (uint8_t)(x >> (8 * i));
+    }
+}
+
+static size_t put_chunk(uint8_t *p, const char *id, uint32_t size)
+{
+    memcpy(p, id, 4);
+    put32(p + 4, size);
+    memset(p + 8, 0, size);
+    return 8 + size;
+}
+
+/* A RIFF header with the given chunks between the RIFF section and data */
+static size_t make_riff(uint8_t *p, const uint8_t *fmt, size_t fmt_len,
+                        const char *extra_id, uint32_t extra_size, int extra_first)
+{
+    size_t len = 12;
+
+    memcpy(p, "RIFF\0\0\0\0WAVE", 12);
+    if (extra_id && extra_first) {
+        len += put_chunk(p + len, extra_id, extra_size);
+    }
+    memcpy(p + len, fmt, fmt_len);
+    len += fmt_len;
+    if (extra_id && !extra_first) {
+        len += put_chunk(p + len, extra_id, extra_size);
+    }
+    memcpy(p + len, "data", 4);
+    put32(p + len + 4, 48000 * 4);
+    len += 8;
+
+    return len;
+}
+
+static void make_layouts(void)
+{
+    static const uint8_t fmt_extensible[48] = {
+        'f', 'm', 't', ' ', 40, 0, 0, 0,
+        0xFE, 0xFF, 2, 0, 0x80, 0xBB, 0, 0, 0, 0xDC, 0x05, 0, 8, 0, 32, 0,
+        22, 0, 32, 0, 3, 0, 0, 0,
+        WAV_FORMAT_PCM, 0, 0, 0, 0, 0, 0x10, 0, 0x80, 0, 0, 0xAA, 0, 0x38, 0x9B, 0x71,
+    };
+    wav_header canonical;
+
+    wav_form_header(&canonical, WAV_FORMAT_PCM, 1, 16000, 32, 48000);
+    layouts[0].name = "canonical RIFF";
+    memcpy(layouts[0].bytes, &canonical, WAV_HEADER_BYTES);
+    layouts[0].len = WAV_HEADER_BYTES;
+
+    layouts[1].name = "extensible fmt, fact";
+    layouts[1].len = make_riff(layouts[1].bytes, fmt_extensible, sizeof(fmt_extensible), "fact", 4, 0);
+
+    layouts[2].name = "2 KB LIST before fmt";
+    layouts[2].len = make_riff(layouts[2].bytes, (const uint8_t *)&canonical + 12, 24, "LIST", 2048, 1);
+
+    layouts[3].name = "RF64, 6 GB of data";
+    wav_form_rf64_header(layouts[3].bytes, WAV_FORMAT_IEEE_FLOAT, 2, 48000, 32, 750000000ull);
+    layouts[3].len = WAV_RF64_HEADER_BYTES;
+}
+
+/* Returns the seconds per parse, and the calls made by the last one, or a
+ * negative time if the parser rejects the header */
+static double time_parse(const layout_t *layout, int ref, unsigned iterations, unsigned *calls)
+{
+    FILE *fp = fopen(path, "wb");
+    xscope_file_t file;
+    wav_header s;
+    unsigned header_size;
+    uint64_t data_bytes;
+    double start;
+    int ret = 0;
+
+    // Some sample data after the header, for the window to read into
+    fwrite(layout->bytes, 1, layout->len, fp);
+    for (int i = 0; i < 4096; i++) {
+        fputc(0, fp);
+    }
+    fclose(fp);
+
+    file = xscope_open_file(path, "rb");
+    start = now_s();
+    for (unsigned i = 0; i < iterations && ret == 0; i++) {
+        xscope_io_reset_stats();
+        ret = ref ? get_wav_header_details_ref(&file, &s, &header_size)
+                  : get_wav_header_details(&file, &s, &header_size, &data_bytes);
+    }
+    const double t = (now_s() - start) / iterations;
+    xscope_close_all_files();
+
+    *calls = xscope_io_stats.reads + xscope_io_stats.seeks + xscope_io_stats.tells;
+
+    return (ret == 0) ? t : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *tmp_dir = (argc > 1) ? argv[1] : ".";
+    const unsigned iterations = (argc > 2) ? (unsigned)atoi(argv[2]) : DEFAULT_ITERATIONS;
+
+    snprintf(path, sizeof(path), "%s/wav_header_bench.wav", tmp_dir);
+    make_layouts();
+
+    printf("%-22s %10s %10s %12s %12s\n", "header", "ref calls", "calls", "ref us", "us");
+
+    for (size_t i = 0; i < sizeof(layouts) / sizeof(layouts[0]); i++) {
+        unsigned ref_calls, calls;
+        const double t_ref = time_parse(&layouts[i], 1, iterations, &ref_calls);
+        const double t = time_parse(&layouts[i], 0, iterations, &calls);
+
+        if (t_ref < 0) {
+            printf("%-22s %10s %10u %12s %12.2f\n", layouts[i].name, "rejected", calls, "-", t * 1e6);
+        } else {
+            printf("%-22s %10u %10u %12.2f %12.2f\n", layouts[i].name, ref_calls, calls,
+                   t_ref * 1e6, t * 1e6);
+        }
+    }
+
+    remove(path);
+
+    return 0;
+}
@@ -0,0 +1,174 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Benchmark of the stall that xscope_fileio calls cause other tasks on the
+ * same tile, made in a critical section and by the xscope I/O service.
+ *
+ * A loader task reads a file one frame per call, each call waiting
+ * ROUND_TRIP_US as if for the host. Meanwhile a victim task on the same
+ * tile runs the loop of the example's stage_preemption_enabled(), which
+ * yields every 100 samples, and times each frame. On SMP FreeRTOS a yield
+ * needs the kernel lock, which a critical section holds, so with critical
+ * sections the victim stalls for the rest of every round trip. The host
+ * RTOS shim models this, see posix/FreeRTOS.h.
+ *
+ * Usage: xscope_fileio_io_service_bench [ROUND_TRIP_US] [FRAMES] [TMP_DIR]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "rtos_osal.h"
+#include "xcore/hwtimer.h"
+#include "platform.h"
+
+#include "app_conf.h"
+#include "fileio/xscope_fileio_buffer.h"
+#include "fileio/xscope_io_service.h"
+#include "stage_timing.h"
+
+#define FRAME_BYTES     appconfDATA_FRAME_SIZE_BYTES
+
+typedef enum {
+    MODE_CRITICAL_SECTION,
+    MODE_IO_SERVICE,
+} bench_mode_t;
+
+static bench_mode_t mode;
+static unsigned num_frames;
+static xscope_file_t file;
+static xscope_fileio_reader_t reader;
+static uint8_t reader_buf[FRAME_BYTES];
+static volatile int loading;
+static QueueHandle_t done_queue;
+static stage_timing_t victim_timing;
+static uint32_t load_ticks;
+
+static int read_frame(void *arg)
+{
+    return (int)xscope_fileio_reader_read(&reader, arg, FRAME_BYTES);
+}
+
+static void loader(void *arg)
+{
+    uint8_t frame[FRAME_BYTES];
+    int done = 1;
+    const uint32_t time_start = get_reference_time();
+
+    (void) arg;
+
+    xscope_fileio_reader_init(&reader, &file, reader_buf, sizeof(reader_buf), 0);
+
+    for (unsigned i = 0; i < num_frames; i++) {
+        if (mode == MODE_CRITICAL_SECTION) {
+            int state = rtos_osal_critical_enter();
+            {
+                (void) read_frame(frame);
+            }
+            rtos_osal_critical_exit(state);
+        } else {
+            (void) xscope_io_service_call(read_frame, frame);
+        }
+    }
+
+    load_ticks = get_reference_time() - time_start;
+    loading = 0;
+    xQueueSend(done_queue, &done, portMAX_DELAY);
+    for (;;) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+/* The loop of stage_preemption_enabled() in data_pipeline_tile1.c */
+static void victim(void *arg)
+{
+    static int32_t data[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+    int done = 1;
+
+    (void) arg;
+
+    while (loading) {
+        const uint32_t time_start = get_reference_time();
+        for (int ch=0; ch<appconfMAX_CHANNELS; ch++) {
+            for (int i=0; i<appconfFRAME_ADVANCE; i++) {
+                data[ch][i] *= 2;
+                if (i % 100 == 0) {
+                    taskYIELD();
+                }
+            }
+        }
+        stage_timing_record(&victim_timing, get_reference_time() - time_start);
+    }
+
+    xQueueSend(done_queue, &done, portMAX_DELAY);
+    for (;;) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+static void run(bench_mode_t bench_mode, const char *name)
+{
+    int done;
+
+    mode = bench_mode;
+    loading = 1;
+    stage_timing_init(&victim_timing, name, 0);
+
+    xTaskCreate(victim, "victim", 0, NULL, appconfDATA_PIPELINE_TASK_PRIORITY, NULL);
+    xTaskCreate(loader, "loader", 0, NULL, appconfXSCOPE_IO_TASK_PRIORITY, NULL);
+    xQueueReceive(done_queue, &done, portMAX_DELAY);
+    xQueueReceive(done_queue, &done, portMAX_DELAY);
+
+    printf("%-18s %8u %9.2f %9.2f %9.2f %9.2f %12.0f\n",
+           name, victim_timing.count,
+           stage_timing_mean(&victim_timing) * 1e6 / PLATFORM_REFERENCE_HZ,
+           stage_timing_percentile(&victim_timing, 990) * 1e6 / PLATFORM_REFERENCE_HZ,
+           stage_timing_percentile(&victim_timing, 999) * 1e6 / PLATFORM_REFERENCE_HZ,
+           victim_timing.max_ticks * 1e6 / PLATFORM_REFERENCE_HZ,
+           num_frames * (double)PLATFORM_REFERENCE_HZ / load_ticks);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *tmp_dir = (argc > 3) ? argv[3] : ".";
+    char path[512];
+    FILE *fp;
+
+    xscope_io_round_trip_us = (argc > 1) ? atoi(argv[1]) : 100;
+    num_frames = (argc > 2) ? atoi(argv[2]) : 2000;
+
+    snprintf(path, sizeof(path), "%s/io_service_bench.bin", tmp_dir);
+    fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Usage: %s [ROUND_TRIP_US] [FRAMES] [TMP_DIR]\n", argv[0]);
+        return 1;
+    }
+    for (unsigned i = 0; i < num_frames; i++) {
+        static const uint8_t frame[FRAME_BYTES];
+        fwrite(frame, 1, sizeof(frame), fp);
+    }
+    fclose(fp);
+    file = xscope_open_file(path, "rb");
+
+    host_rtos_tile_set(0);
+    done_queue = xQueueCreate(2, sizeof(int));
+    xscope_io_service_start(appconfXSCOPE_IO_TASK_PRIORITY, 0x10, 0);
+
+    printf("%u frames read, one per call, with a %u us round trip, by a task on the victim's tile\n",
+           num_frames, xscope_io_round_trip_us);
+    printf("%-18s %8s %9s %9s %9s %9s %12s\n",
+           "xscope calls in", "frames", "mean us", "p99 us", "p99.9 us", "max us", "reads/s");
+    run(MODE_CRITICAL_SECTION, "critical section");
+    run(MODE_IO_SERVICE, "I/O service");
+
+    xscope_close_all_files();
+    remove(path);
+
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef GENERIC_PIPELINE_H_
+#define GENERIC_PIPELINE_H_
+
+#include <stddef.h>
+
+typedef void *(*pipeline_input_t)(void *input_app_data);
+typedef int (*pipeline_output_t)(void *data, void *output_app_data);
+typedef void (*pipeline_stage_t)(void *data);
+
+/* As the RTOS framework's generic_pipeline: one thread per stage, with
+ * two frame deep queues between them, so that a stage built for the device
+ * can be run, and profiled, on the host. The frame is freed after output
+ * returns non-zero.
+ *
+ * The stage threads are POSIX threads, rather than tasks of the host RTOS
+ * shim, but run on the calling thread's tile. Each stack is the stage's
+ * stack size, in words, or GENERIC_PIPELINE_MIN_STACK_BYTES if that is
+ * larger. The priority is ignored. On Linux the threads are named
+ * "stage<tile>.<stage>". */
+void generic_pipeline_init(const pipeline_input_t input,
+                           const pipeline_output_t output,
+                           void * const input_data,
+                           void * const output_data,
+                           const pipeline_stage_t * const stage_functions,
+                           const size_t * const stage_stack_sizes,
+                           const int pipeline_priority,
+                           const int stage_count);
+
+#endif /* GENERIC_PIPELINE_H_ */
@@ -0,0 +1,176 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifdef __linux__
+#define _GNU_SOURCE     /* For pthread_setname_np() */
+#endif
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
+
+#include "FreeRTOS.h"
+#include "generic_pipeline.h"
+
+#define PIPELINE_QUEUE_LENGTH   2
+
+/* Bytes of each stage thread's stack at least. The device's stack sizes,
+ * which are in words, are computed by the XMOS tools for code built for
+ * the device, and code built for the host may need more. */
+#ifndef GENERIC_PIPELINE_MIN_STACK_BYTES
+#define GENERIC_PIPELINE_MIN_STACK_BYTES    (256 * 1024)
+#endif
+
+/* A bounded queue of frames. A full queue blocks the stage before it, as
+ * on the device. */
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    void *frames[PIPELINE_QUEUE_LENGTH];
+    unsigned head;
+    unsigned count;
+} pipeline_queue_t;
+
+typedef struct {
+    pipeline_input_t input;
+    pipeline_output_t output;
+    void *input_data;
+    void *output_data;
+    pipeline_stage_t stage_function;
+    int tile;
+    pipeline_queue_t *input_queue;      /* NULL for the first stage */
+    pipeline_queue_t *output_queue;     /* NULL for the last stage */
+} pipeline_stage_ctx_t;
+
+static void pipeline_queue_init(pipeline_queue_t *queue)
+{
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+    queue->head = 0;
+    queue->count = 0;
+}
+
+static void pipeline_queue_send(pipeline_queue_t *queue, void *frame)
+{
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == PIPELINE_QUEUE_LENGTH) {
+        pthread_cond_wait(&queue->not_full, &queue->lock);
+    }
+    queue->frames[(queue->head + queue->count) % PIPELINE_QUEUE_LENGTH] = frame;
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+static void *pipeline_queue_receive(pipeline_queue_t *queue)
+{
+    void *frame;
+
+    pthread_mutex_lock(&queue->lock);
+    while (queue->count == 0) {
+        pthread_cond_wait(&queue->not_empty, &queue->lock);
+    }
+    frame = queue->frames[queue->head];
+    queue->head = (queue->head + 1) % PIPELINE_QUEUE_LENGTH;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    return frame;
+}
+
+static void *pipeline_stage_thread(void *arg)
+{
+    pipeline_stage_ctx_t *ctx = arg;
+    void *data;
+
+    /* Stages may use the host RTOS shim, as on their tile */
+    host_rtos_tile_set(ctx->tile);
+
+    for (;;) {
+        if (ctx->input_queue == NULL) {
+            data = ctx->input(ctx->input_data);
+        } else {
+            data = pipeline_queue_receive(ctx->input_queue);
+        }
+
+        ctx->stage_function(data);
+
+        if (ctx->output_queue == NULL) {
+            if (ctx->output(data, ctx->output_data)) {
+                vPortFree(data);
+            }
+        } else {
+            pipeline_queue_send(ctx->output_queue, data);
+        }
+    }
+
+    return NULL;
+}
+
+void generic_pipeline_init(const pipeline_input_t input,
+                           const pipeline_output_t output,
+                           void * const input_data,
+                           void * const output_data,
+                           const pipeline_stage_t * const stage_functions,
+                           const size_t * const stage_stack_sizes,
+                           const int pipeline_priority,
+                           const int stage_count)
+{
+    pipeline_stage_ctx_t *ctx = calloc(stage_count, sizeof(pipeline_stage_ctx_t));
+    pipeline_queue_t *queues = calloc(stage_count, sizeof(pipeline_queue_t));
+    xassert(ctx != NULL && queues != NULL);
+
+    (void) pipeline_priority;
+
+    for (int i = 0; i < stage_count; i++) {
+        ctx[i].input = input;
+        ctx[i].output = output;
+        ctx[i].input_data = input_data;
+        ctx[i].output_data = output_data;
+        ctx[i].stage_function = stage_functions[i];
+        ctx[i].tile = host_rtos_tile_get();
+
+        if (i > 0) {
+            pipeline_queue_init(&queues[i]);
+            ctx[i].input_queue = &queues[i];
+            ctx[i - 1].output_queue = ctx[i].input_queue;
+        }
+    }
+
+    for (int i = 0; i < stage_count; i++) {
+        size_t stack_bytes = stage_stack_sizes[i] * sizeof(uint32_t);
+        pthread_attr_t attr;
+        pthread_t thread;
+        int ret;
+
+        if (stack_bytes < GENERIC_PIPELINE_MIN_STACK_BYTES) {
+            stack_bytes = GENERIC_PIPELINE_MIN_STACK_BYTES;
+        }
+        if (stack_bytes < PTHREAD_STACK_MIN) {
+            stack_bytes = PTHREAD_STACK_MIN;
+        }
+
+        pthread_attr_init(&attr);
+        pthread_attr_setstacksize(&attr, stack_bytes);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        ret = pthread_create(&thread, &attr, pipeline_stage_thread, &ctx[i]);
+        xassert(ret == 0);
+        pthread_attr_destroy(&attr);
+#ifdef __linux__
+        {
+            /* Named for perf and gdb, within the 16 bytes Linux allows */
+            char name[16];
+
+            snprintf(name, sizeof(name), "stage%d.%d", ctx[i].tile % 10, i % 100);
+            pthread_setname_np(thread, name);
+        }
+#endif
+        (void) ret;
+    }
+}
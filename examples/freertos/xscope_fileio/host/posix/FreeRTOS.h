@@ -0,0 +1,56 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef FREERTOS_H_
+#define FREERTOS_H_
+
+/* POSIX stand-in for the subset of FreeRTOS, and of the RTOS framework, used
+ * by the xscope_fileio example. Tasks are threads, with no priorities or
+ * core affinity. Critical sections hold a lock per tile, which a yield on
+ * that tile waits for, as on SMP FreeRTOS. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <assert.h>
+
+typedef long BaseType_t;
+typedef unsigned long UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define configSTACK_DEPTH_TYPE          size_t      /* The pipelines pass stack sizes as size_t */
+#define configMINIMAL_STACK_SIZE        256
+#define configMAX_PRIORITIES            32
+#define configTICK_RATE_HZ              1000
+
+#define portMAX_DELAY                   ((TickType_t)0xFFFFFFFF)
+#define pdMS_TO_TICKS(ms)               ((TickType_t)(((uint64_t)(ms) * configTICK_RATE_HZ) / 1000))
+#define pdFALSE                         ((BaseType_t)0)
+#define pdTRUE                          ((BaseType_t)1)
+#define pdPASS                          pdTRUE
+#define pdFAIL                          pdFALSE
+
+/* Thread stacks are sized by the host */
+#define RTOS_THREAD_STACK_SIZE(x)       0
+
+/* May be defined on the command line, to a function of the same type */
+#ifndef rtos_printf
+#define rtos_printf                     printf
+#else
+int rtos_printf(const char *format, ...);
+#endif
+#define xassert(e)                      assert(e)
+
+#define pvPortMalloc(size)              malloc(size)
+#define vPortFree(p)                    free(p)
+
+uint32_t rtos_interrupt_mask_all(void);
+void rtos_interrupt_mask_set(uint32_t mask);
+
+/* The tile that the calling thread runs on, inherited by the tasks it
+ * creates. Both tiles run in the one process. */
+void host_rtos_tile_set(int tile);
+int host_rtos_tile_get(void);
+
+#endif /* FREERTOS_H_ */
@@ -0,0 +1,526 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "semphr.h"
+#include "rtos_osal.h"
+#include "platform/driver_instances.h"
+#include "xcore/hwtimer.h"
+#include "platform.h"
+
+#define NUM_TILES               2
+#define NUM_INTERTILE_PORTS     32
+
+struct host_task {
+    pthread_t thread;
+    TaskFunction_t task_code;
+    void *parameters;
+    int tile;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    uint32_t notify_count;
+};
+
+struct host_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+    uint8_t *items;
+    size_t item_size;
+    size_t length;
+    size_t head;
+    size_t count;
+};
+
+/* One direction of the intertile link. As on the device, a tile sends one
+ * message at a time, holding tx_lock from rtos_intertile_tx_len() until
+ * the receiver has taken its data, and each byte is copied once, from the
+ * sender's buffer straight to the receiver's. As the device's driver does,
+ * each length is followed by exactly one rtos_intertile_tx_data() of the
+ * whole message, which releases the lock, and is received by exactly one
+ * rtos_intertile_rx_data(). */
+typedef struct {
+    pthread_mutex_t tx_lock;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t len;                 /* Bytes in the message */
+    size_t tx_remaining;        /* Bytes not yet given by the sender */
+    const uint8_t *chunk;       /* Given by the sender, not yet taken */
+    size_t chunk_len;
+    host_intertile_stats_t stats;
+} intertile_link_t;
+
+struct host_intertile {
+    QueueHandle_t ports[NUM_INTERTILE_PORTS];   /* Messages to this tile */
+    intertile_link_t tx;                        /* Messages from this tile */
+};
+
+static __thread int current_tile;
+static __thread struct host_task *current_task;
+static __thread intertile_link_t *pending_rx_link;
+static __thread size_t pending_rx_remaining;
+
+/* Each tile's kernel lock, held by critical sections and taken by yields,
+ * as SMP FreeRTOS does */
+static pthread_mutex_t critical_lock[NUM_TILES] = {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_MUTEX_INITIALIZER,
+};
+static pthread_once_t intertile_once = PTHREAD_ONCE_INIT;
+static struct host_intertile intertile[NUM_TILES];
+
+void host_rtos_tile_set(int tile)
+{
+    current_tile = tile;
+}
+
+int host_rtos_tile_get(void)
+{
+    return current_tile;
+}
+
+int rtos_osal_critical_enter(void)
+{
+    pthread_mutex_lock(&critical_lock[current_tile]);
+    return current_tile;
+}
+
+void rtos_osal_critical_exit(int state)
+{
+    pthread_mutex_unlock(&critical_lock[state]);
+}
+
+uint32_t rtos_interrupt_mask_all(void)
+{
+    return 0;
+}
+
+void rtos_interrupt_mask_set(uint32_t mask)
+{
+    (void) mask;
+}
+
+uint32_t get_reference_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint32_t)(ts.tv_sec * (uint64_t)PLATFORM_REFERENCE_HZ +
+                      ts.tv_nsec / (1000000000 / PLATFORM_REFERENCE_HZ));
+}
+
+/* Absolute deadline for a wait of ticks, for pthread_cond_timedwait() */
+static struct timespec deadline_after(TickType_t ticks)
+{
+    struct timespec ts;
+    const uint64_t ns = (uint64_t)ticks * (1000000000 / configTICK_RATE_HZ);
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ns / 1000000000;
+    ts.tv_nsec += ns % 1000000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+
+    return ts;
+}
+
+/* Wait on cond until ready() or the ticks run out. Returns ready(). */
+static int wait_until(pthread_cond_t *cond, pthread_mutex_t *lock,
+                      int (*ready)(void *), void *arg, TickType_t ticks)
+{
+    struct timespec deadline;
+
+    if (ticks != portMAX_DELAY && ticks != 0) {
+        deadline = deadline_after(ticks);
+    }
+
+    while (!ready(arg)) {
+        if (ticks == 0) {
+            return 0;
+        } else if (ticks == portMAX_DELAY) {
+            pthread_cond_wait(cond, lock);
+        } else if (pthread_cond_timedwait(cond, lock, &deadline) == ETIMEDOUT) {
+            return ready(arg);
+        }
+    }
+
+    return 1;
+}
+
+static void *task_entry(void *arg)
+{
+    struct host_task *task = arg;
+
+    current_tile = task->tile;
+    current_task = task;
+    task->task_code(task->parameters);
+
+    return NULL;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t task_code,
+                       const char *name,
+                       configSTACK_DEPTH_TYPE stack_depth,
+                       void *parameters,
+                       UBaseType_t priority,
+                       TaskHandle_t *created_task)
+{
+    struct host_task *task = calloc(1, sizeof(*task));
+
+    (void) name;
+    (void) stack_depth;
+    (void) priority;
+
+    if (task == NULL) {
+        return pdFAIL;
+    }
+
+    task->task_code = task_code;
+    task->parameters = parameters;
+    task->tile = current_tile;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->cond, NULL);
+
+    // The handle is set before the task can use it
+    if (created_task != NULL) {
+        *created_task = task;
+    }
+
+    if (pthread_create(&task->thread, NULL, task_entry, task) != 0) {
+        free(task);
+        return pdFAIL;
+    }
+    pthread_detach(task->thread);
+
+    return pdPASS;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current_task;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    const uint64_t ns = (uint64_t)ticks * (1000000000 / configTICK_RATE_HZ);
+    struct timespec ts = {ns / 1000000000, ns % 1000000000};
+
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(get_reference_time() / (PLATFORM_REFERENCE_HZ / configTICK_RATE_HZ));
+}
+
+void host_rtos_yield(void)
+{
+    pthread_mutex_lock(&critical_lock[current_tile]);
+    pthread_mutex_unlock(&critical_lock[current_tile]);
+    sched_yield();
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify_count++;
+    pthread_cond_broadcast(&task->cond);
+    pthread_mutex_unlock(&task->lock);
+
+    return pdPASS;
+}
+
+static int task_notified(void *arg)
+{
+    return ((struct host_task *)arg)->notify_count > 0;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait)
+{
+    struct host_task *task = current_task;
+    uint32_t count;
+
+    xassert(task != NULL);
+
+    pthread_mutex_lock(&task->lock);
+    wait_until(&task->cond, &task->lock, task_notified, task, ticks_to_wait);
+    count = task->notify_count;
+    if (count > 0) {
+        task->notify_count = clear_count_on_exit ? 0 : count - 1;
+    }
+    pthread_mutex_unlock(&task->lock);
+
+    return count;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+    struct host_queue *queue = calloc(1, sizeof(*queue));
+
+    if (queue == NULL) {
+        return NULL;
+    }
+
+    queue->items = malloc(length * item_size + 1);
+    if (queue->items == NULL) {
+        free(queue);
+        return NULL;
+    }
+
+    queue->item_size = item_size;
+    queue->length = length;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->not_empty, NULL);
+    pthread_cond_init(&queue->not_full, NULL);
+
+    return queue;
+}
+
+static int queue_has_space(void *arg)
+{
+    struct host_queue *queue = arg;
+    return queue->count < queue->length;
+}
+
+static int queue_has_item(void *arg)
+{
+    return ((struct host_queue *)arg)->count > 0;
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    if (!wait_until(&queue->not_full, &queue->lock, queue_has_space, queue, ticks_to_wait)) {
+        pthread_mutex_unlock(&queue->lock);
+        return pdFAIL;
+    }
+
+    const size_t tail = (queue->head + queue->count) % queue->length;
+    if (queue->item_size > 0) {
+        memcpy(&queue->items[tail * queue->item_size], item, queue->item_size);
+    }
+    queue->count++;
+    pthread_cond_signal(&queue->not_empty);
+    pthread_mutex_unlock(&queue->lock);
+
+    return pdPASS;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    if (!wait_until(&queue->not_empty, &queue->lock, queue_has_item, queue, ticks_to_wait)) {
+        pthread_mutex_unlock(&queue->lock);
+        return pdFAIL;
+    }
+
+    if (queue->item_size > 0) {
+        memcpy(buffer, &queue->items[queue->head * queue->item_size], queue->item_size);
+    }
+    queue->head = (queue->head + 1) % queue->length;
+    queue->count--;
+    pthread_cond_signal(&queue->not_full);
+    pthread_mutex_unlock(&queue->lock);
+
+    return pdPASS;
+}
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue)
+{
+    UBaseType_t count;
+
+    pthread_mutex_lock(&queue->lock);
+    count = queue->count;
+    pthread_mutex_unlock(&queue->lock);
+
+    return count;
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->not_empty);
+    pthread_cond_destroy(&queue->not_full);
+    free(queue->items);
+    free(queue);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+    SemaphoreHandle_t sem = xQueueCreate(1, 0);
+
+    if (sem != NULL) {
+        xSemaphoreGive(sem);
+    }
+
+    return sem;
+}
+
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count)
+{
+    SemaphoreHandle_t sem = xQueueCreate(max_count, 0);
+
+    for (UBaseType_t i = 0; sem != NULL && i < initial_count; i++) {
+        xSemaphoreGive(sem);
+    }
+
+    return sem;
+}
+
+unsigned host_intertile_transaction_us;
+
+static void intertile_init(void)
+{
+    for (int t = 0; t < NUM_TILES; t++) {
+        intertile_link_t *link = &intertile[t].tx;
+
+        for (int p = 0; p < NUM_INTERTILE_PORTS; p++) {
+            intertile[t].ports[p] = xQueueCreate(1, sizeof(intertile_link_t *));
+            xassert(intertile[t].ports[p] != NULL);
+        }
+        pthread_mutex_init(&link->tx_lock, NULL);
+        pthread_mutex_init(&link->lock, NULL);
+        pthread_cond_init(&link->cond, NULL);
+    }
+}
+
+rtos_intertile_t *host_intertile_ctx(void)
+{
+    pthread_once(&intertile_once, intertile_init);
+
+    return &intertile[current_tile];
+}
+
+void host_intertile_stats(int tile, host_intertile_stats_t *stats)
+{
+    intertile_link_t *link = &intertile[tile].tx;
+
+    pthread_once(&intertile_once, intertile_init);
+    pthread_mutex_lock(&link->lock);
+    *stats = link->stats;
+    pthread_mutex_unlock(&link->lock);
+}
+
+void rtos_intertile_tx_len(rtos_intertile_t *ctx, uint8_t port, size_t len)
+{
+    // Deliver to the other tile's end of the link
+    struct host_intertile *peer = &intertile[(ctx == &intertile[0]) ? 1 : 0];
+    intertile_link_t *link = &ctx->tx;
+
+    xassert(port < NUM_INTERTILE_PORTS && len > 0);
+
+    pthread_mutex_lock(&link->tx_lock);
+    if (host_intertile_transaction_us > 0) {
+        struct timespec ts = { host_intertile_transaction_us / 1000000, (host_intertile_transaction_us % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+
+    pthread_mutex_lock(&link->lock);
+    link->len = len;
+    link->tx_remaining = len;
+    link->stats.transactions++;
+    pthread_mutex_unlock(&link->lock);
+
+    xQueueSend(peer->ports[port], &link, portMAX_DELAY);
+}
+
+static int chunk_taken(void *arg)
+{
+    return ((intertile_link_t *)arg)->chunk_len == 0;
+}
+
+static int chunk_given(void *arg)
+{
+    return ((intertile_link_t *)arg)->chunk_len > 0;
+}
+
+size_t rtos_intertile_tx_data(rtos_intertile_t *ctx, const void *data, size_t len)
+{
+    intertile_link_t *link = &ctx->tx;
+    int done;
+
+    pthread_mutex_lock(&link->lock);
+    xassert(len == link->len && link->tx_remaining == link->len);
+    link->chunk = data;
+    link->chunk_len = len;
+    pthread_cond_broadcast(&link->cond);
+    wait_until(&link->cond, &link->lock, chunk_taken, link, portMAX_DELAY);
+    link->tx_remaining -= len;
+    done = (link->tx_remaining == 0);
+    pthread_mutex_unlock(&link->lock);
+
+    if (done) {
+        pthread_mutex_unlock(&link->tx_lock);
+    }
+
+    return len;
+}
+
+void rtos_intertile_tx(rtos_intertile_t *ctx, uint8_t port, const void *msg, size_t len)
+{
+    rtos_intertile_tx_len(ctx, port, len);
+    rtos_intertile_tx_data(ctx, msg, len);
+}
+
+size_t rtos_intertile_rx_len(rtos_intertile_t *ctx, uint8_t port, unsigned timeout)
+{
+    xassert(port < NUM_INTERTILE_PORTS && pending_rx_link == NULL);
+
+    if (xQueueReceive(ctx->ports[port], &pending_rx_link, timeout) != pdPASS) {
+        return 0;
+    }
+    pending_rx_remaining = pending_rx_link->len;
+
+    return pending_rx_remaining;
+}
+
+size_t rtos_intertile_rx_data(rtos_intertile_t *ctx, void *data, size_t len)
+{
+    intertile_link_t *link = pending_rx_link;
+    uint8_t *dst = data;
+
+    (void) ctx;
+    xassert(link != NULL && len == pending_rx_remaining);
+
+    // Take the bytes as the sender gives them
+    pthread_mutex_lock(&link->lock);
+    for (size_t taken = 0; taken < len; ) {
+        size_t n;
+
+        wait_until(&link->cond, &link->lock, chunk_given, link, portMAX_DELAY);
+        n = (link->chunk_len < len - taken) ? link->chunk_len : len - taken;
+        memcpy(dst + taken, link->chunk, n);
+        link->chunk += n;
+        link->chunk_len -= n;
+        link->stats.bytes_copied += n;
+        taken += n;
+        if (link->chunk_len == 0) {
+            pthread_cond_broadcast(&link->cond);
+        }
+    }
+    pthread_mutex_unlock(&link->lock);
+
+    pending_rx_remaining -= len;
+    if (pending_rx_remaining == 0) {
+        pending_rx_link = NULL;
+    }
+
+    return len;
+}
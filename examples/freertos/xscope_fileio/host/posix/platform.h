@@ -0,0 +1,9 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef PLATFORM_H_
+#define PLATFORM_H_
+
+#define PLATFORM_REFERENCE_HZ   100000000
+
+#endif /* PLATFORM_H_ */
@@ -0,0 +1,20 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef DRIVER_INSTANCES_H_
+#define DRIVER_INSTANCES_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "rtos_intertile.h"
+
+/* Each source file is built for the tile given by THIS_XCORE_TILE, as on the
+ * device. */
+#define ON_TILE(t)  (THIS_XCORE_TILE == (t))
+
+/* The calling thread's end of the link */
+rtos_intertile_t *host_intertile_ctx(void);
+#define intertile_ctx   host_intertile_ctx()
+
+#endif /* DRIVER_INSTANCES_H_ */
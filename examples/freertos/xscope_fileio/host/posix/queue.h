@@ -0,0 +1,21 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include "FreeRTOS.h"
+
+typedef struct host_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks_to_wait);
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *buffer, TickType_t ticks_to_wait);
+
+UBaseType_t uxQueueMessagesWaiting(QueueHandle_t queue);
+
+void vQueueDelete(QueueHandle_t queue);
+
+#endif /* QUEUE_H_ */
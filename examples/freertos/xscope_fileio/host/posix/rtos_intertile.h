@@ -0,0 +1,39 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef RTOS_INTERTILE_H_
+#define RTOS_INTERTILE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* The intertile link between the two tiles of the one process. As on the
+ * device, a message is sent as its length, then all of its data in one
+ * piece, which the sender waits for the receiver to take in one piece. A
+ * length followed by its data in several pieces fails an assertion. A tile
+ * sends one message at a time, on any port, and each port holds one
+ * message until its receiver asks for it. */
+typedef struct host_intertile rtos_intertile_t;
+
+void rtos_intertile_tx_len(rtos_intertile_t *ctx, uint8_t port, size_t len);
+
+size_t rtos_intertile_tx_data(rtos_intertile_t *ctx, const void *data, size_t len);
+
+void rtos_intertile_tx(rtos_intertile_t *ctx, uint8_t port, const void *msg, size_t len);
+
+size_t rtos_intertile_rx_len(rtos_intertile_t *ctx, uint8_t port, unsigned timeout);
+
+size_t rtos_intertile_rx_data(rtos_intertile_t *ctx, void *data, size_t len);
+
+/* Messages sent, and bytes copied, by the link from a tile to the other */
+typedef struct {
+    unsigned transactions;
+    size_t bytes_copied;
+} host_intertile_stats_t;
+
+void host_intertile_stats(int tile, host_intertile_stats_t *stats);
+
+/* Time taken to start each message, emulating the link's handshake */
+extern unsigned host_intertile_transaction_us;
+
+#endif /* RTOS_INTERTILE_H_ */
@@ -0,0 +1,14 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef RTOS_OSAL_H_
+#define RTOS_OSAL_H_
+
+#include "FreeRTOS.h"
+
+/* Held across both cores of a tile, and by ISRs, as SMP FreeRTOS's
+ * critical sections are */
+int rtos_osal_critical_enter(void);
+void rtos_osal_critical_exit(int state);
+
+#endif /* RTOS_OSAL_H_ */
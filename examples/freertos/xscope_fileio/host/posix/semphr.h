@@ -0,0 +1,20 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef SEMPHR_H_
+#define SEMPHR_H_
+
+#include "queue.h"
+
+/* A mutex is a queue of one empty item that starts full */
+typedef QueueHandle_t SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+
+/* A counting semaphore is a queue of max_count empty items */
+SemaphoreHandle_t xSemaphoreCreateCounting(UBaseType_t max_count, UBaseType_t initial_count);
+
+#define xSemaphoreTake(sem, ticks)  xQueueReceive((sem), NULL, (ticks))
+#define xSemaphoreGive(sem)         xQueueSend((sem), NULL, 0)
+
+#endif /* SEMPHR_H_ */
@@ -0,0 +1,12 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef SOC_XSCOPE_HOST_H_
+#define SOC_XSCOPE_HOST_H_
+
+#include "xcore/chanend.h"
+
+/* Files are local, so xscope_fileio is always ready */
+int xscope_fileio_is_initialized(void);
+
+#endif /* SOC_XSCOPE_HOST_H_ */
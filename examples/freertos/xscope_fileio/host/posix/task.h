@@ -0,0 +1,35 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef TASK_H_
+#define TASK_H_
+
+#include "FreeRTOS.h"
+
+typedef struct host_task *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+BaseType_t xTaskCreate(TaskFunction_t task_code,
+                       const char *name,
+                       configSTACK_DEPTH_TYPE stack_depth,
+                       void *parameters,
+                       UBaseType_t priority,
+                       TaskHandle_t *created_task);
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+
+void vTaskDelay(TickType_t ticks);
+
+TickType_t xTaskGetTickCount(void);
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_count_on_exit, TickType_t ticks_to_wait);
+
+#define vTaskCoreAffinitySet(task, mask)    ((void)(task), (void)(mask))
+#define taskYIELD()                         host_rtos_yield()
+#define portGET_CORE_ID()                   0
+
+void host_rtos_yield(void);
+
+#endif /* TASK_H_ */
@@ -0,0 +1,9 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XCORE_CHANEND_H_
+#define XCORE_CHANEND_H_
+
+typedef unsigned chanend_t;
+
+#endif /* XCORE_CHANEND_H_ */
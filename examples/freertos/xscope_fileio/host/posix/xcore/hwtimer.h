@@ -0,0 +1,12 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XCORE_HWTIMER_H_
+#define XCORE_HWTIMER_H_
+
+#include <stdint.h>
+
+/* The 100 MHz reference timer, from the host's monotonic clock */
+uint32_t get_reference_time(void);
+
+#endif /* XCORE_HWTIMER_H_ */
@@ -0,0 +1,54 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_IO_DEVICE_H_
+#define XSCOPE_IO_DEVICE_H_
+
+/* POSIX stand-in for the device side of lib_xscope_fileio, so that the
+ * example's file handling can be built and tested on the host. Each call is
+ * served from a local file and counted, as each would be a round trip to the
+ * host over xscope on the device. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "xcore/chanend.h"
+
+typedef struct {
+    FILE *fp;
+} xscope_file_t;
+
+typedef struct {
+    unsigned reads;
+    unsigned writes;
+    unsigned seeks;
+    unsigned tells;
+    size_t bytes_read;
+    size_t bytes_written;
+} xscope_io_stats_t;
+
+/* Transport calls made since the last xscope_io_reset_stats() */
+extern xscope_io_stats_t xscope_io_stats;
+
+/* Microseconds each call waits, as if for the host. 0 by default. */
+extern unsigned xscope_io_round_trip_us;
+
+void xscope_io_reset_stats(void);
+
+/* No connection is needed: files are opened on the local file system */
+void xscope_io_init(chanend_t xscope_end);
+
+xscope_file_t xscope_open_file(const char *filename, char *attributes);
+
+size_t xscope_fread(xscope_file_t *xscope_io_handle, uint8_t *buffer, size_t n_bytes_to_read);
+
+void xscope_fwrite(xscope_file_t *xscope_io_handle, uint8_t *buffer, size_t n_bytes_to_write);
+
+int xscope_fseek(xscope_file_t *xscope_io_handle, int offset, int whence);
+
+int xscope_ftell(xscope_file_t *xscope_io_handle);
+
+void xscope_close_all_files(void);
+
+#endif /* XSCOPE_IO_DEVICE_H_ */
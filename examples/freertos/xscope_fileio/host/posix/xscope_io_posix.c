@@ -0,0 +1,102 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "xscope_io_device.h"
+#include "soc_xscope_host.h"
+
+#define MAX_OPEN_FILES 8
+
+xscope_io_stats_t xscope_io_stats;
+unsigned xscope_io_round_trip_us;
+
+static FILE *open_files[MAX_OPEN_FILES];
+
+static void round_trip(void)
+{
+    if (xscope_io_round_trip_us > 0) {
+        struct timespec ts = { xscope_io_round_trip_us / 1000000, (xscope_io_round_trip_us % 1000000) * 1000 };
+        nanosleep(&ts, NULL);
+    }
+}
+
+void xscope_io_reset_stats(void)
+{
+    memset(&xscope_io_stats, 0, sizeof(xscope_io_stats));
+}
+
+void xscope_io_init(chanend_t xscope_end)
+{
+    (void) xscope_end;
+}
+
+int xscope_fileio_is_initialized(void)
+{
+    return 1;
+}
+
+xscope_file_t xscope_open_file(const char *filename, char *attributes)
+{
+    xscope_file_t file = { fopen(filename, attributes) };
+
+    for (int i = 0; file.fp != NULL && i < MAX_OPEN_FILES; i++) {
+        if (open_files[i] == NULL) {
+            open_files[i] = file.fp;
+            break;
+        }
+    }
+
+    return file;
+}
+
+size_t xscope_fread(xscope_file_t *xscope_io_handle, uint8_t *buffer, size_t n_bytes_to_read)
+{
+    size_t n = fread(buffer, 1, n_bytes_to_read, xscope_io_handle->fp);
+
+    round_trip();
+
+    xscope_io_stats.reads++;
+    xscope_io_stats.bytes_read += n;
+
+    return n;
+}
+
+void xscope_fwrite(xscope_file_t *xscope_io_handle, uint8_t *buffer, size_t n_bytes_to_write)
+{
+    size_t n = fwrite(buffer, 1, n_bytes_to_write, xscope_io_handle->fp);
+
+    round_trip();
+
+    xscope_io_stats.writes++;
+    xscope_io_stats.bytes_written += n;
+}
+
+int xscope_fseek(xscope_file_t *xscope_io_handle, int offset, int whence)
+{
+    xscope_io_stats.seeks++;
+    round_trip();
+
+    return fseek(xscope_io_handle->fp, offset, whence);
+}
+
+int xscope_ftell(xscope_file_t *xscope_io_handle)
+{
+    xscope_io_stats.tells++;
+    round_trip();
+
+    return (int)ftell(xscope_io_handle->fp);
+}
+
+void xscope_close_all_files(void)
+{
+    for (int i = 0; i < MAX_OPEN_FILES; i++) {
+        if (open_files[i] != NULL) {
+            fclose(open_files[i]);
+            open_files[i] = NULL;
+        }
+    }
+}
@@ -0,0 +1,115 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Report of the stage timings written by the xscope_fileio example at end
+ * of stream: min, mean, p99 and max of each stage, and its p99 as a share
+ * of the frame budget, the time between frames at the stream's sample
+ * rate. With -H, the histogram of each stage is printed too.
+ *
+ * Usage: xscope_fileio_stage_timing_report [-H] [FILE]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "stage_timing.h"
+
+#define DEFAULT_FILE    "stage_timing.bin"
+#define HIST_WIDTH      50
+
+static double ticks_to_us(uint32_t ticks, uint32_t reference_hz)
+{
+    return ticks * 1e6 / reference_hz;
+}
+
+static void print_histogram(const stage_timing_t *t, uint32_t reference_hz)
+{
+    uint32_t peak = 0;
+
+    for (unsigned bin = 0; bin < STAGE_TIMING_BINS; bin++) {
+        peak = (t->hist[bin] > peak) ? t->hist[bin] : peak;
+    }
+
+    for (unsigned bin = 0; bin < STAGE_TIMING_BINS; bin++) {
+        if (t->hist[bin] == 0) {
+            continue;
+        }
+        const int width = (int)(((uint64_t)t->hist[bin] * HIST_WIDTH + peak - 1) / peak);
+        printf("    %10.2f - %10.2f us %8u %.*s\n",
+               ticks_to_us(stage_timing_bin_lower(bin), reference_hz),
+               ticks_to_us(stage_timing_bin_upper(bin), reference_hz),
+               t->hist[bin], width,
+               "##################################################");
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    const char *path = DEFAULT_FILE;
+    int histogram = 0;
+    stage_timing_file_header_t header;
+    stage_timing_t t;
+    double budget_us;
+    FILE *fp;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-H") == 0) {
+            histogram = 1;
+        } else {
+            path = argv[i];
+        }
+    }
+
+    fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Usage: %s [-H] [FILE]\nCould not open %s\n", argv[0], path);
+        return 1;
+    }
+
+    if (fread(&header, sizeof(header), 1, fp) != 1 ||
+        header.magic != STAGE_TIMING_FILE_MAGIC ||
+        header.version != STAGE_TIMING_FILE_VERSION ||
+        header.num_bins != STAGE_TIMING_BINS ||
+        header.record_bytes != sizeof(stage_timing_t) ||
+        header.reference_hz == 0) {
+        fprintf(stderr, "%s is not a version %d stage timing file\n", path, STAGE_TIMING_FILE_VERSION);
+        fclose(fp);
+        return 1;
+    }
+
+    budget_us = header.sample_rate ? header.frame_advance * 1e6 / header.sample_rate : 0;
+    printf("%u samples per frame at %u Hz: frame budget %.1f us\n",
+           header.frame_advance, header.sample_rate, budget_us);
+    printf("%-28s %4s %8s %10s %10s %10s %10s %9s\n",
+           "stage", "tile", "frames", "min us", "mean us", "p99 us", "max us", "p99/budget");
+
+    for (uint32_t i = 0; i < header.num_stages; i++) {
+        if (fread(&t, sizeof(t), 1, fp) != 1) {
+            fprintf(stderr, "%s: only %u of %u stages\n", path, i, header.num_stages);
+            fclose(fp);
+            return 1;
+        }
+        t.name[STAGE_TIMING_NAME_BYTES - 1] = '\0';
+
+        const double p99_us = ticks_to_us(stage_timing_percentile(&t, 990), header.reference_hz);
+
+        printf("%-28s %4u %8u %10.2f %10.2f %10.2f %10.2f %8.2f%%\n",
+               t.name, t.tile, t.count,
+               t.count ? ticks_to_us(t.min_ticks, header.reference_hz) : 0.0,
+               ticks_to_us(stage_timing_mean(&t), header.reference_hz),
+               p99_us,
+               ticks_to_us(t.max_ticks, header.reference_hz),
+               budget_us > 0 ? 100.0 * p99_us / budget_us : 0.0);
+
+        if (histogram) {
+            print_histogram(&t, header.reference_hz);
+        }
+    }
+
+    fclose(fp);
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the batch manifest parser.
+ *
+ * A manifest with comments, blank lines, tabs, CRLF line ends, malformed
+ * lines and no newline at its end is parsed, and each pair of file names,
+ * and each line number reported for a malformed line, is checked.
+ *
+ * Usage: xscope_fileio_batch_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "fileio/xscope_fileio_batch.h"
+
+typedef struct {
+    int ret;
+    unsigned line;
+    const char *input;
+    const char *output;
+} expected_t;
+
+static const char manifest_text[] =
+    "# input output\n"
+    "in/001.wav out/001.wav\n"
+    "\n"
+    "   \t\n"
+    "  in/002.wav\t\tout/002.wav  \r\n"
+    "only_one.wav\n"
+    "a.wav b.wav c.wav\n"
+    "  # indented comment\n"
+    "in/003.wav out/003.wav";
+
+static const expected_t expected[] = {
+    { 1, 2, "in/001.wav", "out/001.wav" },
+    { 1, 5, "in/002.wav", "out/002.wav" },
+    { -1, 6, NULL, NULL },
+    { -1, 7, NULL, NULL },
+    { 1, 9, "in/003.wav", "out/003.wav" },
+    { 0, 9, NULL, NULL },
+};
+
+int main(void)
+{
+    char manifest[sizeof(manifest_text)];
+    xscope_fileio_batch_t batch;
+    bool ok = true;
+
+    memcpy(manifest, manifest_text, sizeof(manifest_text));
+    xscope_fileio_batch_init(&batch, manifest);
+
+    for (unsigned i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        char *input = NULL;
+        char *output = NULL;
+        const expected_t *e = &expected[i];
+        const int ret = xscope_fileio_batch_next(&batch, &input, &output);
+        bool entry_ok = (ret == e->ret) && (batch.line == e->line);
+
+        if (entry_ok && ret == 1) {
+            entry_ok = (strcmp(input, e->input) == 0) && (strcmp(output, e->output) == 0);
+        }
+        printf("line %u: %d %s %s: %s\n", batch.line, ret,
+               (ret == 1) ? input : "-", (ret == 1) ? output : "-",
+               entry_ok ? "PASS" : "FAIL");
+        ok = ok && entry_ok;
+    }
+
+    /* The end of the manifest is reported again, if asked */
+    {
+        char *input, *output;
+        ok = ok && (xscope_fileio_batch_next(&batch, &input, &output) == 0);
+    }
+
+    printf("batch manifest: %s\n", ok ? "PASS" : "FAIL");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,195 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the buffered xscope_fileio reader and writer.
+ *
+ * Runs the example's frame loop over the POSIX stand-in for xscope_fileio:
+ * a file of frames is read frame by frame and written back out, once with
+ * the per-frame xscope_fseek() and xscope_fread() the task used to make and
+ * once through the buffered reader and writer. The output must match the
+ * input byte for byte, and the transport calls per frame are reported and
+ * checked against the buffer size.
+ *
+ * Usage: xscope_fileio_buffer_test [TMP_DIR]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "xscope_io_device.h"
+#include "fileio/xscope_fileio_buffer.h"
+
+#define FRAME_BYTES     (240 * sizeof(int32_t))
+#define HEADER_BYTES    44
+#define MAX_PATH        512
+
+typedef struct test_case {
+    const char *name;
+    unsigned num_frames;
+    size_t tail_bytes;          /* Partial frame at the end of the input */
+    size_t buffer_bytes;        /* 0 for the unbuffered baseline */
+    size_t read_bytes;          /* Bytes per read, normally one frame */
+} test_case_t;
+
+static const test_case_t test_cases[] = {
+    {"unbuffered", 1000, 0, 0, FRAME_BYTES},
+    {"16 frame buffer", 1000, 0, 16 * FRAME_BYTES, FRAME_BYTES},
+    {"1 frame buffer", 1000, 0, FRAME_BYTES, FRAME_BYTES},
+    {"odd buffer, partial last frame", 1000, 100, 4096 + 12, FRAME_BYTES},
+    {"reads larger than the buffer", 200, 7, 1000, 3 * FRAME_BYTES},
+};
+
+static char in_path[MAX_PATH];
+static char out_path[MAX_PATH];
+
+static uint8_t pattern(size_t i)
+{
+    return (uint8_t)((i * 2654435761u) >> 13);
+}
+
+static bool write_input(size_t len)
+{
+    FILE *fp = fopen(in_path, "wb");
+
+    if (fp == NULL) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        fputc(pattern(i), fp);
+    }
+
+    return fclose(fp) == 0;
+}
+
+static bool check_output(size_t len)
+{
+    FILE *fp = fopen(out_path, "rb");
+    size_t i = 0;
+    int c;
+    bool ok = true;
+
+    if (fp == NULL) {
+        return false;
+    }
+
+    while ((c = fgetc(fp)) != EOF && ok) {
+        ok = (i < len) && (c == pattern(i));
+        i++;
+    }
+    fclose(fp);
+
+    return ok && (i == len);
+}
+
+static bool run_test(const test_case_t *tc)
+{
+    const size_t data_bytes = tc->num_frames * FRAME_BYTES + tc->tail_bytes;
+    const unsigned num_reads = (data_bytes + tc->read_bytes - 1) / tc->read_bytes;
+    uint8_t *frame = malloc(tc->read_bytes);
+    uint8_t *reader_buf = malloc(tc->buffer_bytes + 1);
+    uint8_t *writer_buf = malloc(tc->buffer_bytes + 1);
+    uint8_t header[HEADER_BYTES];
+    xscope_fileio_reader_t reader;
+    xscope_fileio_writer_t writer;
+    xscope_file_t infile, outfile;
+    size_t total = 0;
+    bool ok = true;
+
+    if (!write_input(HEADER_BYTES + data_bytes)) {
+        return false;
+    }
+
+    infile = xscope_open_file(in_path, "rb");
+    outfile = xscope_open_file(out_path, "wb");
+    if (infile.fp == NULL || outfile.fp == NULL) {
+        return false;
+    }
+
+    // The header is copied as the example does, before the frame loop
+    xscope_fread(&infile, header, HEADER_BYTES);
+    xscope_fwrite(&outfile, header, HEADER_BYTES);
+
+    xscope_io_reset_stats();
+
+    if (tc->buffer_bytes) {
+        xscope_fileio_reader_init(&reader, &infile, reader_buf, tc->buffer_bytes, HEADER_BYTES);
+        xscope_fileio_writer_init(&writer, &outfile, writer_buf, tc->buffer_bytes);
+    }
+
+    for (unsigned b = 0; b < num_reads; b++) {
+        size_t n;
+
+        if (tc->buffer_bytes) {
+            n = xscope_fileio_reader_read(&reader, frame, tc->read_bytes);
+            xscope_fileio_writer_write(&writer, frame, n);
+        } else {
+            xscope_fseek(&infile, HEADER_BYTES + b * tc->read_bytes, SEEK_SET);
+            n = xscope_fread(&infile, frame, tc->read_bytes);
+            xscope_fwrite(&outfile, frame, n);
+        }
+        total += n;
+    }
+
+    // Reading past the end returns nothing
+    if (tc->buffer_bytes) {
+        ok = ok && (xscope_fileio_reader_read(&reader, frame, tc->read_bytes) == 0);
+        xscope_fileio_writer_flush(&writer);
+    }
+
+    const xscope_io_stats_t stats = xscope_io_stats;
+    xscope_close_all_files();
+
+    const unsigned calls = stats.reads + stats.writes + stats.seeks + stats.tells;
+
+    printf("%s: %u reads of %zu bytes, %u seeks, %u freads, %u fwrites, "
+           "%.3f transport calls per read\n",
+           tc->name, num_reads, tc->read_bytes, stats.seeks, stats.reads,
+           stats.writes, (double)calls / num_reads);
+
+    ok = ok && (total == data_bytes);
+    ok = ok && (stats.bytes_read == data_bytes);
+    ok = ok && (stats.bytes_written == data_bytes);
+    ok = ok && check_output(HEADER_BYTES + data_bytes);
+
+    if (tc->buffer_bytes) {
+        // One seek in all, and one request per buffer in each direction
+        // (plus the request that finds the end of the file)
+        const unsigned max_requests = data_bytes / tc->buffer_bytes + 2;
+
+        ok = ok && (stats.seeks == 1);
+        ok = ok && (stats.reads <= max_requests);
+        ok = ok && (stats.writes <= max_requests);
+    } else {
+        ok = ok && (stats.seeks == num_reads);
+    }
+
+    printf("%s: %s\n", tc->name, ok ? "PASS" : "FAIL");
+
+    free(frame);
+    free(reader_buf);
+    free(writer_buf);
+    remove(in_path);
+    remove(out_path);
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *tmp_dir = (argc > 1) ? argv[1] : ".";
+    bool ok = true;
+
+    snprintf(in_path, sizeof(in_path), "%s/fileio_buffer_test_in.wav", tmp_dir);
+    snprintf(out_path, sizeof(out_path), "%s/fileio_buffer_test_out.wav", tmp_dir);
+
+    for (size_t i = 0; i < sizeof(test_cases) / sizeof(test_cases[0]); i++) {
+        ok = run_test(&test_cases[i]) && ok;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the stage timing collector.
+ *
+ * The histogram bins must cover every 32 bit time, in order and without
+ * gaps, each no wider than 1/8 of its lower bound. Random times, spread
+ * over many octaves, are then recorded, and the count, min, max and mean
+ * must be exact. Each percentile must be no less than the exact percentile
+ * of the times recorded, and within the width of its bin of it.
+ *
+ * Usage: xscope_fileio_stage_timing_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stage_timing.h"
+
+#define NUM_SAMPLES     100000
+
+static uint32_t samples[NUM_SAMPLES];
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *)a;
+    const uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static bool check_bins(void)
+{
+    bool ok = (stage_timing_bin_lower(0) == 0) &&
+              (stage_timing_bin_upper(STAGE_TIMING_BINS - 1) == UINT32_MAX);
+
+    for (unsigned bin = 0; bin < STAGE_TIMING_BINS && ok; bin++) {
+        const uint32_t lower = stage_timing_bin_lower(bin);
+        const uint32_t upper = stage_timing_bin_upper(bin);
+
+        ok = (stage_timing_bin(lower) == bin) && (stage_timing_bin(upper) == bin);
+        ok = ok && ((uint64_t)(upper - lower) * STAGE_TIMING_SUB_BINS <= lower || upper == lower);
+        if (bin + 1 < STAGE_TIMING_BINS) {
+            ok = ok && (stage_timing_bin_lower(bin + 1) == upper + 1);
+        }
+        if (!ok) {
+            printf("bin %u: %u to %u\n", bin, lower, upper);
+        }
+    }
+
+    printf("histogram bins: %s\n", ok ? "PASS" : "FAIL");
+
+    return ok;
+}
+
+static bool check_statistics(void)
+{
+    static const unsigned permilles[] = {0, 10, 500, 900, 990, 999, 1000};
+    stage_timing_t t;
+    uint64_t total = 0;
+    bool ok;
+
+    stage_timing_init(&t, "test", 1);
+
+    for (unsigned i = 0; i < NUM_SAMPLES; i++) {
+        // Log uniform, from 0 to 2^24 ticks
+        samples[i] = rng() >> (8 + rng() % 24);
+        total += samples[i];
+        stage_timing_record(&t, samples[i]);
+    }
+    qsort(samples, NUM_SAMPLES, sizeof(samples[0]), compare_u32);
+
+    ok = (t.count == NUM_SAMPLES) && (t.total_ticks == total) &&
+         (t.min_ticks == samples[0]) && (t.max_ticks == samples[NUM_SAMPLES - 1]) &&
+         (stage_timing_mean(&t) == (uint32_t)(total / NUM_SAMPLES)) &&
+         (strcmp(t.name, "test") == 0) && (t.tile == 1);
+
+    for (unsigned i = 0; i < sizeof(permilles) / sizeof(permilles[0]); i++) {
+        const uint64_t rank = ((uint64_t)NUM_SAMPLES * permilles[i] + 999) / 1000;
+        const uint32_t exact = samples[rank ? rank - 1 : 0];
+        const uint32_t p = stage_timing_percentile(&t, permilles[i]);
+        const bool p_ok = (p >= exact) && (p <= stage_timing_bin_upper(stage_timing_bin(exact)));
+
+        printf("%u per mille: exact %u, from histogram %u: %s\n", permilles[i], exact, p, p_ok ? "PASS" : "FAIL");
+        ok = ok && p_ok;
+    }
+
+    printf("statistics of %u samples: %s\n", NUM_SAMPLES, ok ? "PASS" : "FAIL");
+
+    return ok;
+}
+
+int main(void)
+{
+    bool ok = check_bins();
+
+    ok = check_statistics() && ok;
+
+    return ok ? 0 : 1;
+}
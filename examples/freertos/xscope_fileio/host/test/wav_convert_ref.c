@@ -0,0 +1,107 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "wav_convert_ref.h"
+
+#define Q31_SCALE 2147483648.0
+
+static int32_t read_sample(const uint8_t *p, wav_sample_format_t format)
+{
+    switch (format) {
+    case WAV_SAMPLE_S16:
+        return (int32_t)(int16_t)(p[0] | (p[1] << 8)) * 65536;
+    case WAV_SAMPLE_S24: {
+        int32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+        if (v & 0x800000) {
+            v -= 0x1000000;
+        }
+        return v * 256;
+    }
+    case WAV_SAMPLE_S32:
+        return (int32_t)((uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+                         ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24));
+    case WAV_SAMPLE_F32: {
+        float f;
+        memcpy(&f, p, sizeof(f));
+        const double v = (double)f * Q31_SCALE;
+        if (isnan(v)) {
+            return 0;
+        } else if (v >= Q31_SCALE) {
+            return INT32_MAX;
+        } else if (v < -Q31_SCALE) {
+            return INT32_MIN;
+        }
+        return (int32_t)v;
+    }
+    default:
+        return 0;
+    }
+}
+
+static void write_sample(uint8_t *p, wav_sample_format_t format, int32_t v)
+{
+    const uint32_t u = (uint32_t)v;
+
+    switch (format) {
+    case WAV_SAMPLE_S16:
+        p[0] = (u >> 16) & 0xFF;
+        p[1] = (u >> 24) & 0xFF;
+        break;
+    case WAV_SAMPLE_S24:
+        p[0] = (u >> 8) & 0xFF;
+        p[1] = (u >> 16) & 0xFF;
+        p[2] = (u >> 24) & 0xFF;
+        break;
+    case WAV_SAMPLE_S32:
+        p[0] = u & 0xFF;
+        p[1] = (u >> 8) & 0xFF;
+        p[2] = (u >> 16) & 0xFF;
+        p[3] = (u >> 24) & 0xFF;
+        break;
+    case WAV_SAMPLE_F32: {
+        const float f = (float)((double)v / Q31_SCALE);
+        memcpy(p, &f, sizeof(f));
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void wav_deinterleave_to_s32_ref(int32_t *dst,
+                                 size_t dst_stride,
+                                 const uint8_t *src,
+                                 wav_sample_format_t format,
+                                 unsigned num_channels,
+                                 unsigned num_frames)
+{
+    const unsigned sample_bytes = wav_get_sample_bytes(format);
+
+    for (unsigned i = 0; i < num_frames; i++) {
+        for (unsigned c = 0; c < num_channels; c++) {
+            dst[c * dst_stride + i] =
+                read_sample(&src[(i * num_channels + c) * sample_bytes], format);
+        }
+    }
+}
+
+void wav_interleave_from_s32_ref(uint8_t *dst,
+                                 wav_sample_format_t format,
+                                 const int32_t *src,
+                                 size_t src_stride,
+                                 unsigned num_channels,
+                                 unsigned num_frames)
+{
+    const unsigned sample_bytes = wav_get_sample_bytes(format);
+
+    for (unsigned i = 0; i < num_frames; i++) {
+        for (unsigned c = 0; c < num_channels; c++) {
+            write_sample(&dst[(i * num_channels + c) * sample_bytes], format,
+                         src[c * src_stride + i]);
+        }
+    }
+}
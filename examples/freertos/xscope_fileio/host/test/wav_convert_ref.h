@@ -0,0 +1,29 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef WAV_CONVERT_REF_H_
+#define WAV_CONVERT_REF_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "wav_convert.h"
+
+/* Naive sample-by-sample versions of the wav_convert.h kernels, for testing
+ * and benchmarking them against */
+
+void wav_deinterleave_to_s32_ref(int32_t *dst,
+                                 size_t dst_stride,
+                                 const uint8_t *src,
+                                 wav_sample_format_t format,
+                                 unsigned num_channels,
+                                 unsigned num_frames);
+
+void wav_interleave_from_s32_ref(uint8_t *dst,
+                                 wav_sample_format_t format,
+                                 const int32_t *src,
+                                 size_t src_stride,
+                                 unsigned num_channels,
+                                 unsigned num_frames);
+
+#endif /* WAV_CONVERT_REF_H_ */
@@ -0,0 +1,150 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the WAV sample conversion kernels.
+ *
+ * For every sample format and a range of channel and frame counts, random
+ * interleaved data (with full scale, out of range and NaN values for float)
+ * is converted to the planar int32_t layout and back. Both directions must
+ * match the naive reference conversion exactly, must not write outside the
+ * frames and channels converted, and integer samples must come back
+ * unchanged.
+ *
+ * Usage: xscope_fileio_wav_convert_test
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "wav_convert.h"
+#include "wav_convert_ref.h"
+
+#define MAX_CHANNELS    8
+#define MAX_FRAMES      1001
+#define STRIDE          (MAX_FRAMES + 3)
+#define GUARD_S32       0x5A5A5A5A
+#define GUARD_BYTE      0xA5
+
+static const wav_sample_format_t formats[] = {
+    WAV_SAMPLE_S16, WAV_SAMPLE_S24, WAV_SAMPLE_S32, WAV_SAMPLE_F32
+};
+static const char *format_names[] = {"s16", "s24", "s32", "f32"};
+static const unsigned channel_counts[] = {1, 2, 3, 4, 6, 8};
+static const unsigned frame_counts[] = {0, 1, 7, 240, MAX_FRAMES};
+
+static const float special_floats[] = {
+    0.0f, -0.0f, 1.0f, -1.0f, 0.99999994f, -0.99999994f, 2.0f, -2.0f,
+    1e-12f, -1e-12f, INFINITY, -INFINITY, NAN
+};
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void fill_input(uint8_t *src, wav_sample_format_t format, size_t num_samples)
+{
+    if (format == WAV_SAMPLE_F32) {
+        for (size_t i = 0; i < num_samples; i++) {
+            float v;
+            if (rng() % 8 == 0) {
+                v = special_floats[rng() % (sizeof(special_floats) / sizeof(special_floats[0]))];
+            } else {
+                v = (float)((int32_t)rng()) / 2147483648.0f;
+            }
+            memcpy(&src[i * 4], &v, sizeof(v));
+        }
+    } else {
+        for (size_t i = 0; i < num_samples * wav_get_sample_bytes(format); i++) {
+            src[i] = (uint8_t)rng();
+        }
+    }
+}
+
+static bool run_test(unsigned f, unsigned num_channels, unsigned num_frames)
+{
+    static uint8_t src[MAX_CHANNELS * MAX_FRAMES * 4 + 16];
+    static uint8_t out[MAX_CHANNELS * MAX_FRAMES * 4 + 16];
+    static uint8_t out_ref[MAX_CHANNELS * MAX_FRAMES * 4 + 16];
+    static int32_t planar[MAX_CHANNELS * STRIDE];
+    static int32_t planar_ref[MAX_CHANNELS * STRIDE];
+    const wav_sample_format_t format = formats[f];
+    const size_t bytes = (size_t)num_channels * num_frames * wav_get_sample_bytes(format);
+    bool ok = true;
+
+    fill_input(src, format, (size_t)num_channels * num_frames);
+
+    for (size_t i = 0; i < MAX_CHANNELS * STRIDE; i++) {
+        planar[i] = GUARD_S32;
+        planar_ref[i] = GUARD_S32;
+    }
+    memset(out, GUARD_BYTE, sizeof(out));
+    memset(out_ref, GUARD_BYTE, sizeof(out_ref));
+
+    wav_deinterleave_to_s32(planar, STRIDE, src, format, num_channels, num_frames);
+    wav_deinterleave_to_s32_ref(planar_ref, STRIDE, src, format, num_channels, num_frames);
+    ok = ok && (memcmp(planar, planar_ref, sizeof(planar)) == 0);
+
+    wav_interleave_from_s32(out, format, planar, STRIDE, num_channels, num_frames);
+    wav_interleave_from_s32_ref(out_ref, format, planar, STRIDE, num_channels, num_frames);
+    ok = ok && (memcmp(out, out_ref, sizeof(out)) == 0);
+
+    // Nothing is written past the converted data
+    for (size_t i = bytes; i < sizeof(out); i++) {
+        ok = ok && (out[i] == GUARD_BYTE);
+    }
+    for (unsigned c = 0; c < MAX_CHANNELS; c++) {
+        for (unsigned i = 0; i < STRIDE; i++) {
+            if (c >= num_channels || i >= num_frames) {
+                ok = ok && (planar[c * STRIDE + i] == GUARD_S32);
+            }
+        }
+    }
+
+    // Integer samples pass through unchanged
+    if (format != WAV_SAMPLE_F32) {
+        ok = ok && (memcmp(out, src, bytes) == 0);
+    }
+
+    if (!ok) {
+        printf("%s, %u channels, %u frames: FAIL\n", format_names[f], num_channels, num_frames);
+    }
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned num_tests = 0;
+    bool ok = true;
+
+    ok = ok && (wav_get_sample_format(WAV_FORMAT_PCM, 16) == WAV_SAMPLE_S16);
+    ok = ok && (wav_get_sample_format(WAV_FORMAT_PCM, 24) == WAV_SAMPLE_S24);
+    ok = ok && (wav_get_sample_format(WAV_FORMAT_PCM, 32) == WAV_SAMPLE_S32);
+    ok = ok && (wav_get_sample_format(WAV_FORMAT_IEEE_FLOAT, 32) == WAV_SAMPLE_F32);
+    ok = ok && (wav_get_sample_format(WAV_FORMAT_PCM, 8) == WAV_SAMPLE_UNSUPPORTED);
+    ok = ok && (wav_get_sample_format(WAV_FORMAT_IEEE_FLOAT, 64) == WAV_SAMPLE_UNSUPPORTED);
+
+    for (unsigned f = 0; f < sizeof(formats) / sizeof(formats[0]); f++) {
+        for (unsigned c = 0; c < sizeof(channel_counts) / sizeof(channel_counts[0]); c++) {
+            for (unsigned n = 0; n < sizeof(frame_counts) / sizeof(frame_counts[0]); n++) {
+                ok = run_test(f, channel_counts[c], frame_counts[n]) && ok;
+                num_tests++;
+            }
+        }
+    }
+
+    printf("%u conversions: %s\n", num_tests, ok ? "PASS" : "FAIL");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+
+#include "wav_header_ref.h"
+#include "wav_convert.h"
+
+#define RIFF_SECTION_SIZE (12)
+#define FMT_SUBCHUNK_MIN_SIZE (24)
+#define EXTENDED_FMT_GUID_SIZE (16)
+
+int get_wav_header_details_ref(xscope_file_t *input_file, wav_header *s, unsigned *header_size){
+  //Assume file is already open here. First rewind.
+  xscope_fseek(input_file, 0, SEEK_SET);
+  //read riff header section (12 bytes)
+  xscope_fread(input_file, (uint8_t*)(&s->riff_header[0]), RIFF_SECTION_SIZE);
+  if(memcmp(s->riff_header, "RIFF", sizeof(s->riff_header)) != 0)
+  {
+    rtos_printf("Error: couldn't find RIFF: 0x%x, 0x%x, 0x%x, 0x%x\n", s->riff_header[0], s->riff_header[1], s->riff_header[2], s->riff_header[3]);
+    return 1;
+  }
+
+  if(memcmp(s->wave_header, "WAVE", sizeof(s->wave_header)) != 0)
+  {
+    rtos_printf("Error: couldn't find WAVE:, 0x%x, 0x%x, 0x%x, 0x%x\n", s->wave_header[0], s->wave_header[1], s->wave_header[2], s->wave_header[3]);
+    return 1;
+  }
+  
+  xscope_fread(input_file, (uint8_t*)&s->fmt_header[0], FMT_SUBCHUNK_MIN_SIZE);
+  if(memcmp(s->fmt_header, "fmt ", sizeof(s->fmt_header)) != 0)
+  {
+    rtos_printf("Error: couldn't find fmt: 0x%x, 0x%x, 0x%x, 0x%x\n", s->fmt_header[0], s->fmt_header[1], s->fmt_header[2], s->fmt_header[3]);
+    return 1;
+  }
+  
+  unsigned fmt_subchunk_actual_size = s->fmt_chunk_size + sizeof(s->fmt_header) + sizeof(s->fmt_chunk_size); //fmt_chunk_size doesn't include the fmt_header(4) and size(4) bytes
+  unsigned fmt_subchunk_remaining_size = fmt_subchunk_actual_size - FMT_SUBCHUNK_MIN_SIZE;
+  
+  if(s->audio_format == (short)0xfffe)
+  {
+    //seek to the end of fmt subchunk and rewind 16bytes to the beginning of GUID
+    xscope_fseek(input_file, fmt_subchunk_remaining_size - EXTENDED_FMT_GUID_SIZE, SEEK_CUR);
+    //The first 2 bytes of GUID is the audio_format.
+    xscope_fread(input_file, (uint8_t *)&s->audio_format, sizeof(s->audio_format));
+    //skip the rest of GUID
+    xscope_fseek(input_file, EXTENDED_FMT_GUID_SIZE - sizeof(s->audio_format), SEEK_CUR);
+  }
+  else
+  {
+    //go to the end of fmt subchunk
+    xscope_fseek(input_file, fmt_subchunk_remaining_size, SEEK_CUR);
+  }
+  if(s->audio_format != WAV_FORMAT_PCM && s->audio_format != WAV_FORMAT_IEEE_FLOAT)
+  {
+    rtos_printf("Error: audio format(%d) is not PCM or IEEE float\n", s->audio_format);
+    return 1;
+  }
+  
+  //read header (4 bytes) for the next subchunk
+  xscope_fread(input_file, (uint8_t*)&s->data_header[0], sizeof(s->data_header));
+  //if next subchunk is fact, read subchunk size and skip it
+  if(memcmp(s->data_header, "fact", sizeof(s->data_header)) == 0)
+  {
+    uint32_t chunksize;
+    xscope_fread(input_file, (uint8_t *)&chunksize, sizeof(s->data_bytes));
+    xscope_fseek(input_file, chunksize, SEEK_CUR);
+    xscope_fread(input_file, (uint8_t*)(&s->data_header[0]), sizeof(s->data_header));
+  }
+  //only thing expected at this point is the 'data' subchunk. Throw error if not found.
+  if(memcmp(s->data_header, "data", sizeof(s->data_header)) != 0)
+  {
+    rtos_printf("Error: couldn't find data: 0x%x, 0x%x, 0x%x, 0x%x\n", s->data_header[0], s->data_header[1], s->data_header[2], s->data_header[3]);
+    return 1;
+  }
+  //read data subchunk size. 
+  xscope_fread(input_file, (uint8_t *)&s->data_bytes, sizeof(s->data_bytes));
+  *header_size = xscope_ftell(input_file); //total file size should be header_size + data_bytes
+  //No need to close file - handled by caller
+
+  return 0;
+}
@@ -0,0 +1,14 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef WAV_HEADER_REF_H_
+#define WAV_HEADER_REF_H_
+
+#include "wav_utils.h"
+
+/* The previous WAV header parser, which reads each field of a RIFF file
+ * with its own xscope_fread() or xscope_fseek(), for testing and
+ * benchmarking get_wav_header_details() against */
+int get_wav_header_details_ref(xscope_file_t *input_file, wav_header *s, unsigned *header_size);
+
+#endif /* WAV_HEADER_REF_H_ */
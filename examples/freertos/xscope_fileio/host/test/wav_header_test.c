@@ -0,0 +1,399 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the WAV header parser.
+ *
+ * Random RIFF and RF64 headers, with extensible fmt chunks, odd sized and
+ * unknown chunks before and after fmt, and data sizes past 4 GB for RF64,
+ * are written out and parsed over the POSIX stand-in for xscope_fileio.
+ * The fields, data offset and data size must match what was written, and a
+ * header that fits in the parser's window must take a single read. Headers
+ * that the previous parser could handle must parse the same with both.
+ *
+ * The valid headers are then fuzzed, with random bytes overwritten and the
+ * file cut short. The parser must not read or loop past the file, and any
+ * header it accepts must have its data chunk within the file. Build with
+ * -fsanitize=address,undefined to check the walk over the window.
+ *
+ * Usage: xscope_fileio_wav_header_test [TMP_DIR] [ITERATIONS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "xscope_io_device.h"
+#include "wav_utils.h"
+#include "wav_convert.h"
+#include "wav_header_ref.h"
+
+#define MAX_PATH            512
+#define MAX_HEADER_BYTES    (16 * 1024)
+#define MAX_EXTRA_CHUNKS    4
+#define DEFAULT_ITERATIONS  20000
+
+typedef struct {
+    wav_header fmt;             /* Fields expected from the parser */
+    unsigned header_size;
+    uint64_t data_bytes;
+    bool rf64;
+    bool ref_compatible;        /* RIFF, fmt, optional fact, then data */
+} expected_t;
+
+static char path[MAX_PATH];
+static uint8_t file_bytes[MAX_HEADER_BYTES];
+static uint32_t rng_state = 0x12345678;
+
+/* rtos_printf() in the parser, which reports each rejected header */
+int quiet_printf(const char *format, ...)
+{
+    (void) format;
+    return 0;
+}
+
+static uint32_t rng(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static void put16(uint8_t *p, uint16_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x >> 8);
+}
+
+static void put32(uint8_t *p, uint32_t x)
+{
+    put16(p, (uint16_t)x);
+    put16(p + 2, (uint16_t)(x >> 16));
+}
+
+static void put64(uint8_t *p, uint64_t x)
+{
+    put32(p, (uint32_t)x);
+    put32(p + 4, (uint32_t)(x >> 32));
+}
+
+static size_t put_chunk(uint8_t *p, const char *id, uint32_t size)
+{
+    memcpy(p, id, 4);
+    put32(p + 4, size);
+    for (uint32_t i = 0; i < size; i++) {
+        p[8 + i] = (uint8_t)rng();
+    }
+    if (size & 1) {
+        p[8 + size] = 0;
+    }
+
+    return 8 + size + (size & 1);
+}
+
+/* Chunks that are skipped, some large enough to push data out of the window */
+static size_t put_extra_chunks(uint8_t *p, unsigned count)
+{
+    static const char *ids[] = {"fact", "LIST", "JUNK", "bext", "cue "};
+    size_t len = 0;
+
+    for (unsigned i = 0; i < count; i++) {
+        const uint32_t size = (rng() % 4 == 0) ? rng() % 2000 : rng() % 64;
+        len += put_chunk(p + len, ids[rng() % 5], size);
+    }
+
+    return len;
+}
+
+/* Write a random valid header, followed by a little sample data, to
+ * file_bytes. Returns the file length. */
+static size_t make_header(expected_t *e)
+{
+    static const short bit_depths[] = {16, 24, 32};
+    static const int sample_rates[] = {8000, 16000, 44100, 48000, 96000};
+    uint8_t *p = file_bytes;
+    const bool extensible = (rng() % 3 == 0);
+    const unsigned extra_before = (rng() % 4 == 0) ? rng() % (MAX_EXTRA_CHUNKS + 1) : 0;
+    const unsigned extra_after = (rng() % 2 == 0) ? rng() % (MAX_EXTRA_CHUNKS + 1) : 0;
+    wav_header *f = &e->fmt;
+    uint32_t fmt_size;
+    size_t len;
+
+    memset(e, 0, sizeof(*e));
+    e->rf64 = (rng() % 4 == 0);
+
+    f->audio_format = (rng() % 2) ? WAV_FORMAT_PCM : WAV_FORMAT_IEEE_FLOAT;
+    f->num_channels = 1 + rng() % 8;
+    f->sample_rate = sample_rates[rng() % 5];
+    f->bit_depth = (f->audio_format == WAV_FORMAT_IEEE_FLOAT) ? 32 : bit_depths[rng() % 3];
+    f->sample_alignment = f->num_channels * f->bit_depth / 8;
+    f->byte_rate = f->sample_rate * f->sample_alignment;
+
+    if (e->rf64) {
+        e->data_bytes = ((uint64_t)(rng() % 0x4000) << 24 | rng() % 0x1000000) * f->sample_alignment;
+    } else {
+        e->data_bytes = (rng() % 0x10000) * (uint64_t)f->sample_alignment;
+    }
+
+    memcpy(p, e->rf64 ? "RF64" : "RIFF", 4);
+    put32(p + 4, e->rf64 ? 0xFFFFFFFF : (uint32_t)rng());
+    memcpy(p + 8, "WAVE", 4);
+    len = 12;
+
+    if (e->rf64) {
+        // The table of other chunk sizes is unused
+        const uint32_t table_len = rng() % 3;
+        uint8_t *ds64 = p + len;
+
+        len += put_chunk(ds64, "ds64", 28 + table_len * 12);
+        put64(ds64 + 8, e->data_bytes + 100);
+        put64(ds64 + 16, e->data_bytes);
+        put64(ds64 + 24, e->data_bytes / f->sample_alignment);
+        put32(ds64 + 32, table_len);
+    }
+
+    len += put_extra_chunks(p + len, extra_before);
+
+    fmt_size = extensible ? 40 : (rng() % 3 == 0) ? 18 : 16;
+    len += put_chunk(p + len, "fmt ", fmt_size);
+    put16(p + len - fmt_size + 0, extensible ? 0xFFFE : f->audio_format);
+    put16(p + len - fmt_size + 2, f->num_channels);
+    put32(p + len - fmt_size + 4, f->sample_rate);
+    put32(p + len - fmt_size + 8, f->byte_rate);
+    put16(p + len - fmt_size + 12, f->sample_alignment);
+    put16(p + len - fmt_size + 14, f->bit_depth);
+    if (fmt_size > 16) {
+        put16(p + len - fmt_size + 16, fmt_size - 18);
+    }
+    if (extensible) {
+        // The first two bytes of the subformat GUID are the format
+        put16(p + len - fmt_size + 24, f->audio_format);
+    }
+    f->fmt_chunk_size = fmt_size;
+
+    e->ref_compatible = !e->rf64 && extra_before == 0 && extra_after <= 1;
+    if (extra_after == 1) {
+        const uint32_t size = rng() % 64;
+        len += put_chunk(p + len, "fact", size);
+        // The previous parser did not skip padding
+        e->ref_compatible = e->ref_compatible && !(size & 1);
+    } else {
+        len += put_extra_chunks(p + len, extra_after);
+    }
+
+    memcpy(p + len, "data", 4);
+    put32(p + len + 4, e->rf64 ? 0xFFFFFFFF : (uint32_t)e->data_bytes);
+    len += 8;
+    e->header_size = len;
+
+    // Some of the sample data, which the parser's window may reach into
+    for (uint32_t n = rng() % 600; n > 0; n--) {
+        p[len++] = (uint8_t)rng();
+    }
+
+    return len;
+}
+
+static bool write_file(const uint8_t *bytes, size_t len)
+{
+    FILE *fp = fopen(path, "wb");
+
+    if (fp == NULL) {
+        return false;
+    }
+    if (fwrite(bytes, 1, len, fp) != len) {
+        fclose(fp);
+        return false;
+    }
+
+    return fclose(fp) == 0;
+}
+
+static int parse_file(wav_header *s, unsigned *header_size, uint64_t *data_bytes, bool ref)
+{
+    xscope_file_t file = xscope_open_file(path, "rb");
+    int ret;
+
+    if (file.fp == NULL) {
+        return -1;
+    }
+
+    xscope_io_reset_stats();
+    if (ref) {
+        ret = get_wav_header_details_ref(&file, s, header_size);
+        *data_bytes = (uint32_t)s->data_bytes;
+    } else {
+        ret = get_wav_header_details(&file, s, header_size, data_bytes);
+    }
+    xscope_close_all_files();
+
+    return ret;
+}
+
+static bool same_fmt(const wav_header *a, const wav_header *b)
+{
+    return a->audio_format == b->audio_format &&
+           a->num_channels == b->num_channels &&
+           a->sample_rate == b->sample_rate &&
+           a->byte_rate == b->byte_rate &&
+           a->sample_alignment == b->sample_alignment &&
+           a->bit_depth == b->bit_depth;
+}
+
+static bool check_valid(const expected_t *e, size_t len, unsigned *single_reads, unsigned *ref_checked)
+{
+    wav_header s, s_ref;
+    unsigned header_size, header_size_ref;
+    uint64_t data_bytes, data_bytes_ref;
+
+    if (!write_file(file_bytes, len)) {
+        return false;
+    }
+
+    if (parse_file(&s, &header_size, &data_bytes, false) != 0 ||
+        !same_fmt(&s, &e->fmt) ||
+        header_size != e->header_size ||
+        data_bytes != e->data_bytes) {
+        printf("valid %s header of %u bytes: parsed incorrectly\n",
+               e->rf64 ? "RF64" : "RIFF", e->header_size);
+        return false;
+    }
+
+    // One seek to rewind, then one read when the header fits the window
+    if (e->header_size <= WAV_HEADER_WINDOW_BYTES) {
+        if (xscope_io_stats.reads != 1 || xscope_io_stats.seeks != 1) {
+            printf("header of %u bytes: %u reads, %u seeks\n", e->header_size,
+                   xscope_io_stats.reads, xscope_io_stats.seeks);
+            return false;
+        }
+        (*single_reads)++;
+    }
+
+    if (e->ref_compatible) {
+        if (parse_file(&s_ref, &header_size_ref, &data_bytes_ref, true) != 0 ||
+            !same_fmt(&s, &s_ref) ||
+            header_size != header_size_ref ||
+            data_bytes != data_bytes_ref) {
+            printf("header of %u bytes: differs from the previous parser\n", e->header_size);
+            return false;
+        }
+        (*ref_checked)++;
+    }
+
+    return true;
+}
+
+/* Overwrite a few bytes of the header, or cut the file short, and parse */
+static bool check_fuzzed(size_t len, const expected_t *e)
+{
+    wav_header s;
+    unsigned header_size;
+    uint64_t data_bytes;
+    int ret;
+
+    switch (rng() % 3) {
+    case 0:
+        len = rng() % (len + 1);
+        break;
+    default:
+        for (unsigned n = 1 + rng() % 8; n > 0; n--) {
+            const size_t i = rng() % (e->header_size + 8 < len ? e->header_size + 8 : len);
+            file_bytes[i] = (rng() % 4 == 0) ? 0xFF : (uint8_t)rng();
+        }
+        break;
+    }
+
+    if (!write_file(file_bytes, len)) {
+        return false;
+    }
+
+    ret = parse_file(&s, &header_size, &data_bytes, false);
+
+    // Each read after the first starts at a chunk header within the file
+    if (xscope_io_stats.reads > 1 + len / 8) {
+        printf("fuzzed header: %u reads of a %zu byte file\n", xscope_io_stats.reads, len);
+        return false;
+    }
+    if (ret == 0 && header_size > len) {
+        printf("fuzzed header: data at %u, past the end of a %zu byte file\n", header_size, len);
+        return false;
+    }
+
+    return true;
+}
+
+/* Fixed cases: errors, and the headers written by wav_utils */
+static bool check_fixed(void)
+{
+    static const char *bad[] = {
+        "RIFX\x24\0\0\0WAVEfmt \x10\0\0\0\1\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0data\0\0\0\0",
+        "RIFF\x24\0\0\0WAVXfmt \x10\0\0\0\1\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0data\0\0\0\0",
+        "RIFF\x24\0\0\0WAVEdata\0\0\0\0fmt \x10\0\0\0\1\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0",
+        "RIFF\x24\0\0\0WAVEfmt \x0e\0\0\0\1\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0data\0\0\0\0",
+        "RIFF\x24\0\0\0WAVEfmt \x12\0\0\0\xfe\xff\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0\0\0data\0\0\0\0",
+        "RIFF\x24\0\0\0WAVEfmt \x10\0\0\0\2\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0data\0\0\0\0",
+        "RIFF\x24\0\0\0WAVEfmt \x10\0\0\0\1\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0",
+        "RF64\xff\xff\xff\xffWAVEfmt \x10\0\0\0\1\0\1\0\x80\x3e\0\0\0\x7d\0\0\2\0\x10\0data\xff\xff\xff\xff",
+    };
+    static const size_t bad_len[] = {44, 44, 44, 42, 46, 44, 36, 44};
+    uint8_t header[WAV_RF64_HEADER_BYTES];
+    wav_header riff_header;
+    wav_header s;
+    unsigned header_size;
+    uint64_t data_bytes;
+    bool ok = true;
+
+    for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+        ok = ok && write_file((const uint8_t *)bad[i], bad_len[i]);
+        ok = ok && (parse_file(&s, &header_size, &data_bytes, false) != 0);
+    }
+
+    wav_form_header(&riff_header, WAV_FORMAT_PCM, 2, 48000, 24, 1000);
+    ok = ok && write_file((const uint8_t *)&riff_header, WAV_HEADER_BYTES);
+    ok = ok && (parse_file(&s, &header_size, &data_bytes, false) == 0);
+    ok = ok && (header_size == WAV_HEADER_BYTES) && (data_bytes == 6000);
+    ok = ok && (s.num_channels == 2) && (s.sample_rate == 48000) && (s.bit_depth == 24);
+
+    // 6 GB of float samples
+    wav_form_rf64_header(header, WAV_FORMAT_IEEE_FLOAT, 2, 48000, 32, 750000000ull);
+    ok = ok && write_file(header, WAV_RF64_HEADER_BYTES);
+    ok = ok && (parse_file(&s, &header_size, &data_bytes, false) == 0);
+    ok = ok && (header_size == WAV_RF64_HEADER_BYTES) && (data_bytes == 6000000000ull);
+    ok = ok && (s.audio_format == WAV_FORMAT_IEEE_FLOAT) && (s.num_channels == 2);
+    ok = ok && (s.byte_rate == 48000 * 8) && (s.sample_alignment == 8);
+
+    printf("fixed headers: %s\n", ok ? "PASS" : "FAIL");
+
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    const char *tmp_dir = (argc > 1) ? argv[1] : ".";
+    const unsigned iterations = (argc > 2) ? (unsigned)atoi(argv[2]) : DEFAULT_ITERATIONS;
+    unsigned single_reads = 0;
+    unsigned ref_checked = 0;
+    bool ok;
+
+    snprintf(path, sizeof(path), "%s/wav_header_test.wav", tmp_dir);
+
+    ok = check_fixed();
+
+    for (unsigned i = 0; i < iterations && ok; i++) {
+        expected_t e;
+        const size_t len = make_header(&e);
+
+        ok = check_valid(&e, len, &single_reads, &ref_checked);
+        ok = ok && check_fuzzed(len, &e);
+    }
+
+    printf("%u random headers, %u parsed from a single read, %u checked against the previous parser, "
+           "%u fuzzed: %s\n", iterations, single_reads, ref_checked, iterations, ok ? "PASS" : "FAIL");
+
+    remove(path);
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Linux build of the xscope_fileio example.
+ *
+ * The fileio task and the data pipelines of both tiles are built from the
+ * example's own sources, over POSIX stand-ins for FreeRTOS, the intertile
+ * link and xscope_fileio (see posix/). in.wav is read from, and out.wav
+ * written to, the working directory or DIR, as the xscope host endpoint
+ * would. The process exits when the fileio task closes the files.
+ *
+ * Usage: xscope_fileio_host [DIR]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "app_conf.h"
+#include "fileio/xscope_fileio_task.h"
+#include "data_pipeline.h"
+
+/* Each tile's data_pipeline_init(), renamed when built for the host */
+void data_pipeline_init_tile0(void *input_app_data, void *output_app_data);
+void data_pipeline_init_tile1(void *input_app_data, void *output_app_data);
+
+/* As in main.c, for DATA_TRANSPORT_METHOD == XSCOPE_FILEIO */
+int data_pipeline_output(
+        void *output_app_data,
+        int8_t **output_data_frame,
+        size_t frame_count)
+{
+    (void) output_app_data;
+
+    (void) xscope_fileio_tx_to_host((uint8_t*)output_data_frame, frame_count);
+
+    return DATA_PIPELINE_DONT_FREE_FRAME;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 2 || (argc == 2 && chdir(argv[1]) != 0)) {
+        fprintf(stderr, "Usage: %s [DIR]\n", argv[0]);
+        return 1;
+    }
+
+    // The tasks exit the process, so flush each line as it is printed
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    host_rtos_tile_set(1);
+    data_pipeline_init_tile1(NULL, NULL);
+
+    host_rtos_tile_set(0);
+    xscope_fileio_tasks_create(appconfXSCOPE_IO_TASK_PRIORITY, NULL);
+    data_pipeline_init_tile0(NULL, NULL);
+
+    for (;;) {
+        pause();
+    }
+
+    return 0;
+}
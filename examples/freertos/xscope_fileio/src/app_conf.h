@@ -6,6 +6,8 @@
 
 /* Intertile port settings */
 #define appconfEXAMPLE_DATA_PORT          16
+#define appconfSTAGE_TIMING_PORT          17
+#define appconfEXAMPLE_CREDIT_PORT        18
 
 /* Application tile specifiers */
 #include "platform/driver_instances.h"
@@ -13,12 +15,52 @@
 /* App configuration */
 #define appconfINPUT_FILENAME  "in.wav\0"
 #define appconfOUTPUT_FILENAME "out.wav\0"
-#define appconfMAX_CHANNELS 1
+/* Stage timings, written at end of stream. See stage_timing.h */
+#define appconfSTAGE_TIMING_FILENAME "stage_timing.bin\0"
+
+/* Set to 1 to process every pair of files listed in the manifest in one
+ * session, in place of appconfINPUT_FILENAME and appconfOUTPUT_FILENAME.
+ * See fileio/xscope_fileio_batch.h. The stage timings of each file are
+ * written next to its output file, with appconfBATCH_STAGE_TIMING_SUFFIX
+ * appended to its name. */
+#ifndef appconfBATCH_MODE
+#define appconfBATCH_MODE 0
+#endif
+#define appconfBATCH_MANIFEST_FILENAME "batch.txt\0"
+#ifndef appconfBATCH_MANIFEST_MAX_BYTES
+#define appconfBATCH_MANIFEST_MAX_BYTES 16384
+#endif
+#define appconfBATCH_STAGE_TIMING_SUFFIX ".timing.bin"
+#define appconfBATCH_MAX_FILENAME_BYTES 256
+/* Largest number of channels in the input file. Each pipeline frame holds
+ * this many channels, unused channels are zero. */
+#ifndef appconfMAX_CHANNELS
+#define appconfMAX_CHANNELS 2
+#endif
 #define appconfFRAME_ADVANCE 240
 #define appconfFRAME_ELEMENT_SIZE sizeof(int32_t)
-#define appconfDATA_FRAME_SIZE_BYTES   (appconfFRAME_ADVANCE * appconfFRAME_ELEMENT_SIZE)
+#define appconfDATA_FRAME_SIZE_BYTES   (appconfMAX_CHANNELS * appconfFRAME_ADVANCE * appconfFRAME_ELEMENT_SIZE)
+
+/* Number of frames kept in flight between the file reads and the file writes,
+ * counting the end of stream frame. 1 handles one frame at a time. */
+#ifndef appconfFILEIO_PIPELINE_DEPTH
+#define appconfFILEIO_PIPELINE_DEPTH   4
+#endif
+
+/* Frames in each tile's pool of pipeline frames, one for each credit the
+ * tile sending to it holds: those in flight, and those whose credits are
+ * held back to be returned appconfFRAME_LINK_CREDIT_BATCH at a time */
+#define appconfFRAME_LINK_CREDIT_BATCH 2
+#define appconfFRAME_POOL_FRAMES       (appconfFILEIO_PIPELINE_DEPTH + appconfFRAME_LINK_CREDIT_BATCH - 1)
+
+/* Frames read from, or written to, the host per xscope_fileio request */
+#ifndef appconfFILEIO_BUFFER_FRAMES
+#define appconfFILEIO_BUFFER_FRAMES    16
+#endif
 
-#define appconfAPP_NOTIFY_FILEIO_DONE  0
+/* Requests that can wait for the xscope I/O service task. The fileio task
+ * makes one at a time. */
+#define appconfXSCOPE_IO_SERVICE_QUEUE_LENGTH  2
 
 /* Task Priorities */
 #define appconfSTARTUP_TASK_PRIORITY              (configMAX_PRIORITIES - 2)
@@ -5,23 +5,47 @@
 #define DATA_PIPELINE_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "app_conf.h"
+#include "stage_timing.h"
 
 #define DATA_PIPELINE_DONT_FREE_FRAME 0
 #define DATA_PIPELINE_FREE_FRAME      1
 
+/* Samples of each channel, left justified whatever the WAV sample format.
+ * The fileio task follows the last frame of a stream with one that has
+ * end_of_stream set, and no samples. The stages pass it on untouched, so
+ * when it reaches the fileio task every frame before it has been handled.
+ * The stages in data_pipeline_stages.c keep no state from frame to frame,
+ * other than their timings, which cover the whole run, so none of them
+ * has anything to reset on this frame. A stage that did keep state would
+ * have to reset it here, as the next frame, if any, starts another file. */
 typedef struct {
-    int32_t data[appconfFRAME_ADVANCE];
+    int32_t data[appconfMAX_CHANNELS][appconfFRAME_ADVANCE];
+    uint32_t end_of_stream;
 } frame_data_t;
 
+/* Holders of a frame from a tile's frame_pool_t */
+typedef enum {
+    FRAME_OWNER_PIPELINE = 1,   /* Receiving or in the pipeline stages */
+    FRAME_OWNER_FILEIO,         /* Queued for, or held by, the file writer */
+} frame_owner_t;
+
 void data_pipeline_init(
         void *input_app_data,
         void *output_app_data);
 
-void data_pipeline_input(
-        void *input_app_data,
-        int8_t **input_data_frame,
-        size_t frame_count);
+/* This tile's stage timings, which the fileio task writes at end of
+ * stream. Returns the number of stages. */
+size_t data_pipeline_stage_timing(stage_timing_t **timing);
+
+/* Return a frame that tile[0]'s pipeline output handed on, held by owner,
+ * to its pool, and its credit to tile[1] */
+void data_pipeline_frame_release(frame_data_t *frame_data, frame_owner_t owner);
+
+/* Requests to tile[1], on appconfSTAGE_TIMING_PORT, for its stage timings */
+#define DATA_PIPELINE_STAGE_TIMING_READ         0
+#define DATA_PIPELINE_STAGE_TIMING_READ_RESET   1   /* Then clear them */
 
 int data_pipeline_output(
         void *output_app_data,
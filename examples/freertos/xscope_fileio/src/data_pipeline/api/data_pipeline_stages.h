@@ -0,0 +1,30 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef DATA_PIPELINE_STAGES_H_
+#define DATA_PIPELINE_STAGES_H_
+
+#include "data_pipeline.h"
+#include "stage_timing.h"
+
+/* The example's pipeline stages, apart from the tasks and frame links that
+ * bring frames to them, so that they may also be built and run on the
+ * host (see host/bench/pipeline_wav_bench.c). Tile[1] runs the first two
+ * stages, and tile[0] the last. */
+
+enum {
+    DATA_PIPELINE_STAGE_PREEMPTION_DISABLED,
+    DATA_PIPELINE_STAGE_PREEMPTION_ENABLED,
+    DATA_PIPELINE_STAGE_3,
+    DATA_PIPELINE_STAGE_COUNT
+};
+
+/* Each stage's timing, recorded as it handles a frame. The tile that runs
+ * a stage initializes its timing. */
+extern stage_timing_t data_pipeline_stage_timings[DATA_PIPELINE_STAGE_COUNT];
+
+void stage_preemption_disabled(frame_data_t *frame_data);
+void stage_preemption_enabled(frame_data_t *frame_data);
+void stage_3(frame_data_t *frame_data);
+
+#endif /* DATA_PIPELINE_STAGES_H_ */
@@ -0,0 +1,85 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <stdint.h>
+#include <xcore/hwtimer.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* App headers */
+#include "app_conf.h"
+#include "data_pipeline.h"
+#include "data_pipeline_stages.h"
+
+stage_timing_t data_pipeline_stage_timings[DATA_PIPELINE_STAGE_COUNT];
+
+void stage_preemption_disabled(frame_data_t *frame_data)
+{
+    uint32_t time_start, time_end;
+
+    if (frame_data->end_of_stream) {
+        return;
+    }
+
+    // Disable preemption around the performance critical code section that follows
+    uint32_t mask = rtos_interrupt_mask_all();
+    {
+        time_start = get_reference_time();
+        /* Apply a fixed gain to all samples */
+        for (int ch=0; ch<appconfMAX_CHANNELS; ch++) {
+            for (int i=0; i<appconfFRAME_ADVANCE; i++) {
+                frame_data->data[ch][i] *= 2;
+            }
+        }
+        time_end = get_reference_time();
+    }
+    rtos_interrupt_mask_set(mask); // Enable preemption
+
+    stage_timing_record(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_PREEMPTION_DISABLED], time_end - time_start);
+}
+
+void stage_preemption_enabled(frame_data_t *frame_data)
+{
+    uint32_t time_start, time_end;
+
+    if (frame_data->end_of_stream) {
+        return;
+    }
+
+    // Preemption is not disabled around the code section that follows
+    //   Instead, the code periodically yields to the RTOS kernel to 
+    //   emulate a task context switch.
+
+    time_start = get_reference_time();
+    /* Apply a fixed gain to all samples */
+    for (int ch=0; ch<appconfMAX_CHANNELS; ch++) {
+        for (int i=0; i<appconfFRAME_ADVANCE; i++) {
+            frame_data->data[ch][i] *= 2;
+            if (i % 100 == 0) {
+                // Yield to the RTOS kernel here
+                taskYIELD();
+            }
+        }
+    }
+    time_end = get_reference_time();
+
+    stage_timing_record(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_PREEMPTION_ENABLED], time_end - time_start);
+}
+
+void stage_3(frame_data_t *frame_data)
+{
+    uint32_t time_start, time_end;
+
+    if (frame_data->end_of_stream) {
+        return;
+    }
+
+    time_start = get_reference_time();
+    /* Do nothing */
+    time_end = get_reference_time();
+
+    stage_timing_record(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_3], time_end - time_start);
+}
@@ -17,43 +17,45 @@
 /* App headers */
 #include "app_conf.h"
 #include "data_pipeline.h"
+#include "data_pipeline_stages.h"
+#include "frame_pool.h"
+#include "frame_link.h"
 
 #if ON_TILE(0)
 
-static void *data_pipeline_input_i(void *input_app_data)
-{
-    frame_data_t *frame_data;
+/* This tile's stages */
+#define FIRST_STAGE     DATA_PIPELINE_STAGE_3
+#define STAGE_COUNT     1
 
-    frame_data = pvPortMalloc(sizeof(frame_data_t));
-    memset(frame_data, 0x00, sizeof(frame_data_t));
+static FRAME_POOL_STORAGE(frame_pool_storage, sizeof(frame_data_t), appconfFRAME_POOL_FRAMES);
+static frame_pool_t frame_pool;
+static frame_link_rx_t input_link;     /* From the pipeline on tile[1] */
 
-    size_t bytes_received = 0;
-    bytes_received = rtos_intertile_rx_len(
-            intertile_ctx,
-            appconfEXAMPLE_DATA_PORT,
-            portMAX_DELAY);
-
-    xassert(bytes_received == sizeof(frame_data_t));
+size_t data_pipeline_stage_timing(stage_timing_t **timing)
+{
+    *timing = &data_pipeline_stage_timings[FIRST_STAGE];
+    return STAGE_COUNT;
+}
 
-    rtos_intertile_rx_data(
-            intertile_ctx,
-            frame_data,
-            bytes_received);
+static void *data_pipeline_input_i(void *input_app_data)
+{
+    (void) input_app_data;
 
-    return frame_data;
+    /* Every byte of the frame is received into a frame from the pool */
+    return frame_link_rx(&input_link);
 }
 
 static int data_pipeline_output_i(frame_data_t *frame_data,
                                    void *output_app_data)
 {
     return data_pipeline_output(output_app_data,
-                               (int8_t **)frame_data->data,
-                               appconfDATA_FRAME_SIZE_BYTES);
+                               (int8_t **)frame_data,
+                               sizeof(frame_data_t));
 }
 
-static void stage_3(frame_data_t *frame_data)
+void data_pipeline_frame_release(frame_data_t *frame_data, frame_owner_t owner)
 {
-    /* Do nothing */
+    frame_link_rx_release(&input_link, frame_data, owner);
 }
 
 void data_pipeline_init(
@@ -62,6 +64,17 @@ void data_pipeline_init(
 {
     const int stage_count = 1;
 
+    frame_pool_init(&frame_pool, frame_pool_storage, sizeof(frame_data_t), appconfFRAME_POOL_FRAMES);
+    frame_link_rx_init(&input_link,
+                       intertile_ctx,
+                       appconfEXAMPLE_DATA_PORT,
+                       appconfEXAMPLE_CREDIT_PORT,
+                       sizeof(frame_data_t),
+                       &frame_pool,
+                       FRAME_OWNER_PIPELINE,
+                       appconfFRAME_LINK_CREDIT_BATCH);
+    stage_timing_init(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_3], "stage_3", THIS_XCORE_TILE);
+
     const pipeline_stage_t stages[] = {
         (pipeline_stage_t) stage_3,
     };
@@ -17,72 +17,78 @@
 /* App headers */
 #include "app_conf.h"
 #include "data_pipeline.h"
+#include "data_pipeline_stages.h"
+#include "frame_pool.h"
+#include "frame_link.h"
 
 #if ON_TILE(1)
 
-static void *data_pipeline_input_i(void *input_app_data)
-{
-    frame_data_t *frame_data;
-
-    frame_data = pvPortMalloc(sizeof(frame_data_t));
-    memset(frame_data, 0x00, sizeof(frame_data_t));
+/* This tile's stages */
+#define FIRST_STAGE     DATA_PIPELINE_STAGE_PREEMPTION_DISABLED
+#define STAGE_COUNT     2
 
-    data_pipeline_input(input_app_data,
-                       (int8_t **)frame_data->data,
-                       appconfDATA_FRAME_SIZE_BYTES);
+static FRAME_POOL_STORAGE(frame_pool_storage, sizeof(frame_data_t), appconfFRAME_POOL_FRAMES);
+static frame_pool_t frame_pool;
+static frame_link_rx_t input_link;     /* From the fileio task on tile[0] */
+static frame_link_tx_t output_link;    /* To the pipeline on tile[0] */
 
-    return frame_data;
-}
-
-static int data_pipeline_output_i(frame_data_t *frame_data,
-                                   void *output_app_data)
+size_t data_pipeline_stage_timing(stage_timing_t **timing)
 {
-    rtos_intertile_tx(intertile_ctx,
-                      appconfEXAMPLE_DATA_PORT,
-                      frame_data,
-                      sizeof(frame_data_t));
-    return DATA_PIPELINE_FREE_FRAME;
+    *timing = &data_pipeline_stage_timings[FIRST_STAGE];
+    return STAGE_COUNT;
 }
 
-static void stage_preemption_disabled(frame_data_t *frame_data)
+/* Sends this tile's stage timings to the fileio task on tile[0] each time
+ * it asks, which it does at end of stream, and clears them if asked to */
+static void stage_timing_server(void *arg)
 {
-    uint32_t time_start, time_end;
-
-    // Disable preemption around the performance critical code section that follows
-    uint32_t mask = rtos_interrupt_mask_all();
-    {
-        time_start = get_reference_time();
-        /* Apply a fixed gain to all samples */
-        for (int i=0; i<appconfFRAME_ADVANCE; i++) {
-            frame_data->data[i] *= 2;
+    (void) arg;
+
+    for (;;) {
+        uint8_t request;
+        size_t bytes_received;
+
+        bytes_received = rtos_intertile_rx_len(
+                intertile_ctx,
+                appconfSTAGE_TIMING_PORT,
+                portMAX_DELAY);
+
+        xassert(bytes_received == sizeof(request));
+
+        rtos_intertile_rx_data(
+                intertile_ctx,
+                &request,
+                bytes_received);
+
+        rtos_intertile_tx(intertile_ctx,
+                          appconfSTAGE_TIMING_PORT,
+                          &data_pipeline_stage_timings[FIRST_STAGE],
+                          STAGE_COUNT * sizeof(stage_timing_t));
+
+        if (request == DATA_PIPELINE_STAGE_TIMING_READ_RESET) {
+            for (int i = 0; i < STAGE_COUNT; i++) {
+                stage_timing_reset(&data_pipeline_stage_timings[FIRST_STAGE + i]);
+            }
         }
-        time_end = get_reference_time();
     }
-    rtos_interrupt_mask_set(mask); // Enable preemption
-    
-    rtos_printf("stage_preemption_disabled: %d (microseconds) \n", (time_end - time_start) / 100);
 }
 
-static void stage_preemption_enabled(frame_data_t *frame_data)
+static void *data_pipeline_input_i(void *input_app_data)
 {
-    uint32_t time_start, time_end;
-    
-    // Preemption is not disabled around the code section that follows
-    //   Instead, the code periodically yields to the RTOS kernel to 
-    //   emulate a task context switch.
-
-    time_start = get_reference_time();
-    /* Apply a fixed gain to all samples */
-    for (int i=0; i<appconfFRAME_ADVANCE; i++) {
-        frame_data->data[i] *= 2;
-        if (i % 100 == 0) {
-            // Yield to the RTOS kernel here
-            taskYIELD();
-        }
-    }
-    time_end = get_reference_time();
+    (void) input_app_data;
 
-    rtos_printf("stage_preemption_enabled: %d (microseconds) \n", (time_end - time_start) / 100);
+    /* Every byte of the frame is received into a frame from the pool */
+    return frame_link_rx(&input_link);
+}
+
+static int data_pipeline_output_i(frame_data_t *frame_data,
+                                   void *output_app_data)
+{
+    (void) output_app_data;
+
+    frame_link_tx(&output_link, frame_data);
+    frame_link_rx_release(&input_link, frame_data, FRAME_OWNER_PIPELINE);
+    return DATA_PIPELINE_DONT_FREE_FRAME;
 }
 
 void data_pipeline_init(
@@ -91,6 +97,33 @@ void data_pipeline_init(
 {
     const int stage_count = 2;
 
+    frame_pool_init(&frame_pool, frame_pool_storage, sizeof(frame_data_t), appconfFRAME_POOL_FRAMES);
+    frame_link_rx_init(&input_link,
+                       intertile_ctx,
+                       appconfEXAMPLE_DATA_PORT,
+                       appconfEXAMPLE_CREDIT_PORT,
+                       sizeof(frame_data_t),
+                       &frame_pool,
+                       FRAME_OWNER_PIPELINE,
+                       appconfFRAME_LINK_CREDIT_BATCH);
+    /* Tile[0] has a frame for each credit */
+    frame_link_tx_init(&output_link,
+                       intertile_ctx,
+                       appconfEXAMPLE_DATA_PORT,
+                       appconfEXAMPLE_CREDIT_PORT,
+                       sizeof(frame_data_t),
+                       appconfFRAME_POOL_FRAMES,
+                       appconfDATA_PIPELINE_TASK_PRIORITY);
+    stage_timing_init(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_PREEMPTION_DISABLED], "stage_preemption_disabled", THIS_XCORE_TILE);
+    stage_timing_init(&data_pipeline_stage_timings[DATA_PIPELINE_STAGE_PREEMPTION_ENABLED], "stage_preemption_enabled", THIS_XCORE_TILE);
+
+    xTaskCreate((TaskFunction_t) stage_timing_server,
+                "stage_timing_server",
+                RTOS_THREAD_STACK_SIZE(stage_timing_server),
+                NULL,
+                appconfDATA_PIPELINE_TASK_PRIORITY,
+                NULL);
+
     const pipeline_stage_t stages[] = {
         (pipeline_stage_t)stage_preemption_disabled,
         (pipeline_stage_t)stage_preemption_enabled,
@@ -0,0 +1,66 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stddef.h>
+#include <string.h>
+
+#include "fileio/xscope_fileio_batch.h"
+
+static int is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+/* Terminate the field at *p, and return the start of the one after it */
+static char *next_field(char *p)
+{
+    while (*p != '\0' && !is_blank(*p)) {
+        p++;
+    }
+    while (is_blank(*p)) {
+        *p++ = '\0';
+    }
+    return p;
+}
+
+void xscope_fileio_batch_init(xscope_fileio_batch_t *batch, char *manifest)
+{
+    batch->next = manifest;
+    batch->line = 0;
+}
+
+int xscope_fileio_batch_next(xscope_fileio_batch_t *batch,
+                             char **input_filename,
+                             char **output_filename)
+{
+    while (*batch->next != '\0') {
+        char *line = batch->next;
+        char *end = strchr(line, '\n');
+
+        if (end != NULL) {
+            *end = '\0';
+            batch->next = end + 1;
+        } else {
+            batch->next = line + strlen(line);
+        }
+        batch->line++;
+
+        while (is_blank(*line)) {
+            line++;
+        }
+        if (*line == '\0' || *line == '#') {
+            continue;
+        }
+
+        *input_filename = line;
+        *output_filename = next_field(line);
+
+        if (**output_filename == '\0' || *next_field(*output_filename) != '\0') {
+            return -1;
+        }
+
+        return 1;
+    }
+
+    return 0;
+}
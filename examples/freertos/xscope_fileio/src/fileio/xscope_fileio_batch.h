@@ -0,0 +1,35 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_FILEIO_BATCH_H_
+#define XSCOPE_FILEIO_BATCH_H_
+
+/* Parser of the batch manifest, the list of files to process in one session.
+ *
+ * Each line of the manifest names an input WAV file and the output file to
+ * write, separated by spaces or tabs:
+ *
+ *     # input           output
+ *     vectors/001.wav   results/001.wav
+ *
+ * Blank lines, and lines starting with '#', are skipped. File names can not
+ * contain spaces. The manifest is parsed in place, in memory, so no file
+ * is held open while the files it names are processed.
+ */
+
+typedef struct {
+    char *next;             /* Start of the next line */
+    unsigned line;          /* Number of the line last returned */
+} xscope_fileio_batch_t;
+
+/* Parse the NUL terminated manifest, which is modified as it is parsed */
+void xscope_fileio_batch_init(xscope_fileio_batch_t *batch, char *manifest);
+
+/* Returns 1 and the next pair of file names, 0 at the end of the manifest,
+ * or -1 if the next line is not a pair of file names. Parsing can carry on
+ * after a line that is not. */
+int xscope_fileio_batch_next(xscope_fileio_batch_t *batch,
+                             char **input_filename,
+                             char **output_filename);
+
+#endif /* XSCOPE_FILEIO_BATCH_H_ */
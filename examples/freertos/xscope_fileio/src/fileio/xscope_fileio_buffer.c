@@ -0,0 +1,129 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "fileio/xscope_fileio_buffer.h"
+
+void xscope_fileio_reader_init(xscope_fileio_reader_t *reader,
+                               xscope_file_t *file,
+                               uint8_t *buf,
+                               size_t buf_size,
+                               long offset)
+{
+    reader->file = file;
+    reader->buf = buf;
+    reader->buf_size = buf_size;
+    reader->pos = 0;
+    reader->len = 0;
+    reader->offset = offset;
+    reader->seek_pending = 1;
+    reader->eof = 0;
+}
+
+/* Fetch up to len bytes from the host, straight after the previous request */
+static size_t reader_fetch(xscope_fileio_reader_t *reader, uint8_t *dst, size_t len)
+{
+    size_t bytes_read;
+
+    if (reader->seek_pending) {
+        xscope_fseek(reader->file, (int)reader->offset, SEEK_SET);
+        reader->seek_pending = 0;
+    }
+
+    bytes_read = xscope_fread(reader->file, dst, len);
+    reader->offset += bytes_read;
+    if (bytes_read < len) {
+        reader->eof = 1;
+    }
+
+    return bytes_read;
+}
+
+size_t xscope_fileio_reader_read(xscope_fileio_reader_t *reader,
+                                 uint8_t *dst,
+                                 size_t len)
+{
+    size_t total = 0;
+
+    while (total < len) {
+        size_t n = reader->len - reader->pos;
+
+        if (n == 0) {
+            if (reader->eof) {
+                break;
+            }
+
+            /* Reads of a whole buffer or more bypass it */
+            if (len - total >= reader->buf_size) {
+                size_t direct = reader_fetch(reader, dst + total, len - total);
+                total += direct;
+                continue;
+            }
+
+            reader->pos = 0;
+            reader->len = reader_fetch(reader, reader->buf, reader->buf_size);
+            n = reader->len;
+            if (n == 0) {
+                break;
+            }
+        }
+
+        if (n > len - total) {
+            n = len - total;
+        }
+        memcpy(dst + total, reader->buf + reader->pos, n);
+        reader->pos += n;
+        total += n;
+    }
+
+    return total;
+}
+
+void xscope_fileio_writer_init(xscope_fileio_writer_t *writer,
+                               xscope_file_t *file,
+                               uint8_t *buf,
+                               size_t buf_size)
+{
+    writer->file = file;
+    writer->buf = buf;
+    writer->buf_size = buf_size;
+    writer->len = 0;
+}
+
+void xscope_fileio_writer_write(xscope_fileio_writer_t *writer,
+                                const uint8_t *src,
+                                size_t len)
+{
+    while (len > 0) {
+        size_t n = writer->buf_size - writer->len;
+
+        /* Writes of a whole buffer or more bypass it */
+        if (writer->len == 0 && len >= writer->buf_size) {
+            xscope_fwrite(writer->file, (uint8_t *)src, len);
+            return;
+        }
+
+        if (n > len) {
+            n = len;
+        }
+        memcpy(writer->buf + writer->len, src, n);
+        writer->len += n;
+        src += n;
+        len -= n;
+
+        if (writer->len == writer->buf_size) {
+            xscope_fileio_writer_flush(writer);
+        }
+    }
+}
+
+void xscope_fileio_writer_flush(xscope_fileio_writer_t *writer)
+{
+    if (writer->len > 0) {
+        xscope_fwrite(writer->file, writer->buf, writer->len);
+        writer->len = 0;
+    }
+}
@@ -0,0 +1,65 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_FILEIO_BUFFER_H_
+#define XSCOPE_FILEIO_BUFFER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "xscope_io_device.h"
+
+/* Buffered sequential access to a file over xscope_fileio.
+ *
+ * Every xscope_fread(), xscope_fwrite() and xscope_fseek() is a round trip to
+ * the host. The reader fetches buf_size bytes per request and serves smaller
+ * reads from the buffer, seeking only once, at its start offset. The writer
+ * collects small writes and sends them buf_size bytes at a time.
+ *
+ * The buffers are provided by the caller. Neither type is thread safe.
+ */
+
+typedef struct {
+    xscope_file_t *file;
+    uint8_t *buf;
+    size_t buf_size;
+    size_t pos;             /* Next byte of buf to return */
+    size_t len;             /* Valid bytes in buf */
+    uint64_t offset;        /* File offset of the next read from the host */
+    int seek_pending;
+    int eof;
+} xscope_fileio_reader_t;
+
+typedef struct {
+    xscope_file_t *file;
+    uint8_t *buf;
+    size_t buf_size;
+    size_t len;             /* Bytes waiting in buf */
+} xscope_fileio_writer_t;
+
+/* Read file sequentially from offset. The seek is made on the first read. */
+void xscope_fileio_reader_init(xscope_fileio_reader_t *reader,
+                               xscope_file_t *file,
+                               uint8_t *buf,
+                               size_t buf_size,
+                               long offset);
+
+/* Returns the number of bytes read, less than len only at the end of file */
+size_t xscope_fileio_reader_read(xscope_fileio_reader_t *reader,
+                                 uint8_t *dst,
+                                 size_t len);
+
+/* Write to file at its current position */
+void xscope_fileio_writer_init(xscope_fileio_writer_t *writer,
+                               xscope_file_t *file,
+                               uint8_t *buf,
+                               size_t buf_size);
+
+void xscope_fileio_writer_write(xscope_fileio_writer_t *writer,
+                                const uint8_t *src,
+                                size_t len);
+
+/* Send any buffered bytes. Must be called before the file is closed. */
+void xscope_fileio_writer_flush(xscope_fileio_writer_t *writer);
+
+#endif /* XSCOPE_FILEIO_BUFFER_H_ */
@@ -4,7 +4,9 @@
 #include <platform.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <limits.h>
 #include <string.h>
+#include <xcore/hwtimer.h>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -15,14 +17,32 @@
 #include "app_conf.h"
 #include "platform/driver_instances.h"
 #include "fileio/xscope_fileio_task.h"
+#include "fileio/xscope_fileio_buffer.h"
+#include "fileio/xscope_fileio_batch.h"
+#include "fileio/xscope_io_service.h"
+#include "data_pipeline.h"
+#include "frame_pool.h"
+#include "frame_link.h"
 #include "xscope_io_device.h"
 #include "wav_utils.h"
+#include "wav_convert.h"
 
 static TaskHandle_t fileio_task_handle;
 static QueueHandle_t fileio_queue;
+static frame_link_tx_t input_link;      /* To the first stage on tile[1] */
+static frame_data_t tx_frame;           /* Reused once each frame is sent */
 
 static xscope_file_t infile;
 static xscope_file_t outfile;
+static xscope_fileio_reader_t reader;
+static xscope_fileio_writer_t writer;
+static uint8_t *reader_buf;
+static uint8_t *writer_buf;
+
+/* Format of both files */
+static wav_sample_format_t sample_format;
+static unsigned num_channels;
+static size_t file_frame_bytes;     /* Bytes of appconfFRAME_ADVANCE frames */
 
 #if ON_TILE(XSCOPE_HOST_IO_TILE)
 static SemaphoreHandle_t mutex_xscope_fileio;
@@ -45,157 +65,529 @@ void init_xscope_host_data_user_cb(chanend_t c_host) {
 }
 #endif
 
+/* Requests run by the xscope I/O service task, which makes every
+ * xscope_fileio call. See xscope_io_service.h */
+
+typedef struct {
+    uint8_t *buf;
+    size_t len;
+} fileio_io_buf_t;
+
+typedef struct {
+    char *input_filename;
+    char *output_filename;
+    wav_header *header;
+    unsigned *header_size;
+    uint64_t *data_bytes;
+} fileio_io_open_t;
+
+typedef struct {
+    char *filename;
+    stage_timing_file_header_t *header;
+    stage_timing_t *remote_timing;
+    size_t remote_bytes;
+    stage_timing_t *local_timing;
+    size_t local_bytes;
+} fileio_io_timing_t;
+
+/* Open both files and parse the input file header */
+static int fileio_io_open(void *arg)
+{
+    fileio_io_open_t *io = arg;
+
+    infile = xscope_open_file(io->input_filename, "rb");
+    outfile = xscope_open_file(io->output_filename, "wb");
+
+    return get_wav_header_details(&infile, io->header, io->header_size, io->data_bytes);
+}
+
+/* Write the output file header. The host answers a tell only once it has
+ * handled every earlier request, so the header is written before any reads */
+static int fileio_io_write_header(void *arg)
+{
+    fileio_io_buf_t *io = arg;
+
+    xscope_fwrite(&outfile, io->buf, io->len);
+    (void) xscope_ftell(&outfile);
+
+    return 0;
+}
+
+/* Returns the number of bytes read */
+static int fileio_io_read_frame(void *arg)
+{
+    fileio_io_buf_t *io = arg;
+
+    return (int)xscope_fileio_reader_read(&reader, io->buf, io->len);
+}
+
+static int fileio_io_write_frame(void *arg)
+{
+    fileio_io_buf_t *io = arg;
+
+    xscope_fileio_writer_write(&writer, io->buf, io->len);
+
+    return 0;
+}
+
+static int fileio_io_flush(void *arg)
+{
+    (void) arg;
+
+    xscope_fileio_writer_flush(&writer);
+
+    return 0;
+}
+
+static int fileio_io_write_timing(void *arg)
+{
+    fileio_io_timing_t *io = arg;
+    xscope_file_t timing_file;
+
+    timing_file = xscope_open_file(io->filename, "wb");
+    xscope_fwrite(&timing_file, (uint8_t*)io->header, sizeof(stage_timing_file_header_t));
+    xscope_fwrite(&timing_file, (uint8_t*)io->remote_timing, io->remote_bytes);
+    xscope_fwrite(&timing_file, (uint8_t*)io->local_timing, io->local_bytes);
+
+    return 0;
+}
+
+static int fileio_io_close_all(void *arg)
+{
+    (void) arg;
+
+    xscope_close_all_files();
+
+    return 0;
+}
+
+#if (appconfBATCH_MODE == 1)
+/* Read the whole manifest into io->buf, then close it. Returns the number
+ * of bytes read. */
+static int fileio_io_read_manifest(void *arg)
+{
+    fileio_io_buf_t *io = arg;
+    xscope_file_t manifest_file;
+    size_t bytes_read;
+
+    manifest_file = xscope_open_file(appconfBATCH_MANIFEST_FILENAME, "rb");
+    bytes_read = xscope_fread(&manifest_file, io->buf, io->len);
+    xscope_close_all_files();
+
+    return (int)bytes_read;
+}
+#endif
+
 size_t xscope_fileio_tx_to_host(uint8_t *buf, size_t len_bytes) {
-    size_t ret = 0;
-    xQueueSend(fileio_queue, buf, portMAX_DELAY);
+    frame_data_t *frame_data = (frame_data_t *)buf;
 
-    return ret;
+    frame_pool_transfer(frame_data, FRAME_OWNER_PIPELINE, FRAME_OWNER_FILEIO);
+    xQueueSend(fileio_queue, &frame_data, portMAX_DELAY);
+
+    return len_bytes;
 }
 
-size_t xscope_fileio_rx_from_host(void *input_app_data, int8_t **input_data_frame, size_t frame_count) {
+/* Read the next frame block from the input file and convert it to the
+ * pipeline layout. Channels past num_channels in in_frame are left as they
+ * are, i.e. zero. */
+static void fileio_read_frame(frame_data_t *in_frame,
+                              uint8_t *file_buf)
+{
+    fileio_io_buf_t io = { file_buf, file_frame_bytes };
+    size_t bytes_read = 0;
+
+    bytes_read = xscope_io_service_call(fileio_io_read_frame, &io);
+
+    memset(file_buf + bytes_read, 0x00, file_frame_bytes - bytes_read);
+
+    wav_deinterleave_to_s32(&in_frame->data[0][0], appconfFRAME_ADVANCE, file_buf,
+                            sample_format, num_channels, appconfFRAME_ADVANCE);
+    in_frame->end_of_stream = 0;
+}
 
-    size_t bytes_received = 0;
-    bytes_received = rtos_intertile_rx_len(
+/* Write the stage timings of both tiles to timing_filename, in the layout
+ * given in stage_timing.h, print a summary of each, then clear them for the
+ * next file. Called once the end of stream frame has been received back,
+ * so no stage is still timing. */
+static void fileio_write_stage_timing(uint32_t sample_rate, char *timing_filename)
+{
+    fileio_io_timing_t io;
+    uint8_t request = DATA_PIPELINE_STAGE_TIMING_READ_RESET;
+    stage_timing_t *local_timing;
+    stage_timing_t *remote_timing;
+    stage_timing_file_header_t header;
+    size_t local_count;
+    size_t remote_bytes;
+    const uint64_t budget_ticks = sample_rate ? ((uint64_t)appconfFRAME_ADVANCE * PLATFORM_REFERENCE_HZ) / sample_rate : 0;
+
+    local_count = data_pipeline_stage_timing(&local_timing);
+
+    /* Ask tile[1] for its stage timings */
+    rtos_intertile_tx(intertile_ctx,
+                      appconfSTAGE_TIMING_PORT,
+                      &request,
+                      sizeof(request));
+    remote_bytes = rtos_intertile_rx_len(
             intertile_ctx,
-            appconfEXAMPLE_DATA_PORT,
+            appconfSTAGE_TIMING_PORT,
             portMAX_DELAY);
-    
-    xassert(bytes_received == frame_count);
-
+    xassert(remote_bytes % sizeof(stage_timing_t) == 0);
+    remote_timing = pvPortMalloc(remote_bytes);
+    xassert(remote_timing);
     rtos_intertile_rx_data(
             intertile_ctx,
-            input_data_frame,
-            bytes_received);
+            remote_timing,
+            remote_bytes);
+
+    header.magic = STAGE_TIMING_FILE_MAGIC;
+    header.version = STAGE_TIMING_FILE_VERSION;
+    header.reference_hz = PLATFORM_REFERENCE_HZ;
+    header.frame_advance = appconfFRAME_ADVANCE;
+    header.sample_rate = sample_rate;
+    header.num_bins = STAGE_TIMING_BINS;
+    header.num_stages = remote_bytes / sizeof(stage_timing_t) + local_count;
+    header.record_bytes = sizeof(stage_timing_t);
+
+    io.filename = timing_filename;
+    io.header = &header;
+    io.remote_timing = remote_timing;
+    io.remote_bytes = remote_bytes;
+    io.local_timing = local_timing;
+    io.local_bytes = local_count * sizeof(stage_timing_t);
+    (void) xscope_io_service_call(fileio_io_write_timing, &io);
+
+    for (size_t i = 0; i < header.num_stages; i++) {
+        const stage_timing_t *t = (i < remote_bytes / sizeof(stage_timing_t))
+                ? &remote_timing[i]
+                : &local_timing[i - remote_bytes / sizeof(stage_timing_t)];
+        const uint32_t p99 = stage_timing_percentile(t, 990);
+        const unsigned p99_permille = budget_ticks ? (unsigned)((uint64_t)p99 * 1000 / budget_ticks) : 0;
+
+        rtos_printf("%s (tile %u): %u frames, min %u, mean %u, p99 %u, max %u (microseconds), p99 is %u.%u%% of the frame budget\n",
+                    t->name, t->tile, t->count,
+                    t->count ? t->min_ticks / (PLATFORM_REFERENCE_HZ / 1000000) : 0,
+                    stage_timing_mean(t) / (PLATFORM_REFERENCE_HZ / 1000000),
+                    p99 / (PLATFORM_REFERENCE_HZ / 1000000),
+                    t->max_ticks / (PLATFORM_REFERENCE_HZ / 1000000),
+                    p99_permille / 10, p99_permille % 10);
+    }
 
-    return bytes_received;
-}
+    for (size_t i = 0; i < local_count; i++) {
+        stage_timing_reset(&local_timing[i]);
+    }
 
-void xscope_fileio_user_done(void) {
-    xTaskNotifyGive(fileio_task_handle);
+    vPortFree(remote_timing);
 }
 
-/* This task reads the input file in chunks and sends it through the data pipeline
- * After reading the entire file, it will wait until the user has confirmed
- * all writing is complete before closing files.
+/* Read input_filename in chunks and send it through the data pipeline,
+ * writing the results to output_filename and the stage timings to
+ * timing_filename. After reading the entire file, it sends an end of stream
+ * frame after the last, and returns as soon as that frame has come back
+ * through the pipeline. Returns 0, or -1 if the input file can not be
+ * processed, in which case no frame has been sent.
+ * Up to appconfFILEIO_PIPELINE_DEPTH frames are in the pipeline at once, so
+ * the next frames are read while earlier ones are processed. The pipeline
+ * keeps frames in order, so the results are written in order.
  */
- /* NOTE:
-  * xscope fileio uses events.  Only xscope_fread() currently, but wrapping
-  * all calls just in case */
-void xscope_fileio(void *arg) {
-    (void) arg;
-    int state = 0;
+static int fileio_stream_file(char *input_filename,
+                              char *output_filename,
+                              char *timing_filename)
+{
+    fileio_io_open_t io_open;
+    fileio_io_buf_t io_header;
+    fileio_io_buf_t io_frame;
     wav_header input_header_struct, output_header_struct;
+    uint8_t output_rf64_header[WAV_RF64_HEADER_BYTES];
     unsigned input_header_size;
-    unsigned frame_count;
+    uint64_t input_data_bytes;
+    uint64_t output_data_bytes;
+    uint64_t frame_count;
     unsigned block_count;        
-    uint8_t in_buf[appconfDATA_FRAME_SIZE_BYTES];
-    uint8_t out_buf[appconfDATA_FRAME_SIZE_BYTES];
-    size_t bytes_read = 0;
-
-    /* Wait until xscope_fileio is initialized */
-    while(xscope_fileio_is_initialized() == 0) {
-        vTaskDelay(pdMS_TO_TICKS(1));
-    }
-
-    fileio_queue = xQueueCreate(1, appconfDATA_FRAME_SIZE_BYTES);
+    unsigned frames_sent;       /* Including the end of stream frame */
+    unsigned blocks_written;
+    frame_data_t *out_frame;
+    uint8_t file_buf[appconfDATA_FRAME_SIZE_BYTES];
+    uint32_t time_last, time_now;
+    uint64_t elapsed_ticks = 0;
 
     rtos_printf("Open test files\n");
-    state = rtos_osal_critical_enter();
-    {
-        infile = xscope_open_file(appconfINPUT_FILENAME, "rb");
-        outfile = xscope_open_file(appconfOUTPUT_FILENAME, "wb");
-        // Validate input wav file
-        if(get_wav_header_details(&infile, &input_header_struct, &input_header_size) != 0){
-            rtos_printf("Error: error in get_wav_header_details()\n");
-            _Exit(1);
-        }
-        xscope_fseek(&infile, input_header_size, SEEK_SET);
+    io_open.input_filename = input_filename;
+    io_open.output_filename = output_filename;
+    io_open.header = &input_header_struct;
+    io_open.header_size = &input_header_size;
+    io_open.data_bytes = &input_data_bytes;
+    // Validate input wav file
+    if(xscope_io_service_call(fileio_io_open, &io_open) != 0){
+        rtos_printf("Error: error in get_wav_header_details() for %s file\n", input_filename);
+        return -1;
     }
-    rtos_osal_critical_exit(state);
 
-    // Ensure 32bit wav file
-    if(input_header_struct.bit_depth != 32)
+    // Ensure 16, 24 or 32 bit PCM, or 32 bit float wav file
+    sample_format = wav_get_sample_format(input_header_struct.audio_format, input_header_struct.bit_depth);
+    if(sample_format == WAV_SAMPLE_UNSUPPORTED)
     {
-        rtos_printf("Error: unsupported wav bit depth (%d) for %s file. Only 32 supported\n", input_header_struct.bit_depth, appconfINPUT_FILENAME);
-        _Exit(1);
+        rtos_printf("Error: unsupported wav format (%d) and bit depth (%d) for %s file. Only 16, 24 and 32 bit PCM, and 32 bit float supported\n", input_header_struct.audio_format, input_header_struct.bit_depth, input_filename);
+        return -1;
     }
-    // Ensure input wav file contains correct number of channels 
-    if(input_header_struct.num_channels != appconfMAX_CHANNELS){
-        rtos_printf("Error: wav num channels(%d) does not match (%u)\n", input_header_struct.num_channels, appconfMAX_CHANNELS);
-        _Exit(1);
+    // Ensure input wav file fits in the pipeline frames
+    if(input_header_struct.num_channels < 1 || input_header_struct.num_channels > appconfMAX_CHANNELS){
+        rtos_printf("Error: wav num channels(%d) is not between 1 and %u\n", input_header_struct.num_channels, appconfMAX_CHANNELS);
+        return -1;
     }
+    num_channels = input_header_struct.num_channels;
+    file_frame_bytes = appconfFRAME_ADVANCE * wav_get_num_bytes_per_frame(&input_header_struct);
     
-    // Calculate number of frames in the wav file
-    frame_count = wav_get_num_frames(&input_header_struct);
-    block_count = frame_count / appconfFRAME_ADVANCE; 
-
-    // Create output wav file
-    wav_form_header(&output_header_struct,
-        input_header_struct.audio_format,
-        appconfMAX_CHANNELS,
-        input_header_struct.sample_rate,
-        input_header_struct.bit_depth,
-        block_count*appconfFRAME_ADVANCE);
-
-    xscope_fwrite(&outfile, (uint8_t*)(&output_header_struct), WAV_HEADER_BYTES);
-
-    // ensure the write above has time to complete before performing any reads
-    vTaskDelay(pdMS_TO_TICKS(1000));
-
-    // Iterate over frame blocks and send the data to the first pipeline stage on tile[1]
-    for(unsigned b=0; b<block_count; b++) {
-        memset(in_buf, 0x00, appconfDATA_FRAME_SIZE_BYTES);
-        long input_location =  wav_get_frame_start(&input_header_struct, b * appconfFRAME_ADVANCE, input_header_size);
-
-        state = rtos_osal_critical_enter();
-        {
-            xscope_fseek(&infile, input_location, SEEK_SET);
-            bytes_read = xscope_fread(&infile, in_buf, appconfDATA_FRAME_SIZE_BYTES);
+    // Calculate number of frames in the wav file, which may be RF64
+    frame_count = input_data_bytes / wav_get_num_bytes_per_frame(&input_header_struct);
+    if(frame_count / appconfFRAME_ADVANCE > UINT_MAX){
+        rtos_printf("Error: wav file of %llu frames is too long\n", (unsigned long long)frame_count);
+        return -1;
+    }
+    block_count = frame_count / appconfFRAME_ADVANCE;
+
+    // Create output wav file, as RF64 if its data does not fit a RIFF header
+    output_data_bytes = (uint64_t)block_count * file_frame_bytes;
+    if(output_data_bytes > UINT32_MAX - (WAV_HEADER_BYTES - 8)){
+        wav_form_rf64_header(output_rf64_header,
+            input_header_struct.audio_format,
+            input_header_struct.num_channels,
+            input_header_struct.sample_rate,
+            input_header_struct.bit_depth,
+            (uint64_t)block_count*appconfFRAME_ADVANCE);
+
+        io_header.buf = output_rf64_header;
+        io_header.len = WAV_RF64_HEADER_BYTES;
+    } else {
+        wav_form_header(&output_header_struct,
+            input_header_struct.audio_format,
+            input_header_struct.num_channels,
+            input_header_struct.sample_rate,
+            input_header_struct.bit_depth,
+            block_count*appconfFRAME_ADVANCE);
+
+        io_header.buf = (uint8_t*)(&output_header_struct);
+        io_header.len = WAV_HEADER_BYTES;
+    }
+    (void) xscope_io_service_call(fileio_io_write_header, &io_header);
+
+    // The frame blocks are contiguous in both files, so they are read and
+    // written sequentially, appconfFILEIO_BUFFER_FRAMES at a time
+    xscope_fileio_reader_init(&reader, &infile, reader_buf,
+                              appconfFILEIO_BUFFER_FRAMES * appconfDATA_FRAME_SIZE_BYTES,
+                              wav_get_frame_start(&input_header_struct, 0, input_header_size));
+    xscope_fileio_writer_init(&writer, &outfile, writer_buf,
+                              appconfFILEIO_BUFFER_FRAMES * appconfDATA_FRAME_SIZE_BYTES);
+
+    // Iterate over frame blocks and send the data to the first pipeline stage
+    // on tile[1], then the end of stream frame, until that comes back. The
+    // frame that marks the end of the stream follows the last through the
+    // pipeline, so once it is received back, no stage on either tile holds
+    // a frame.
+    memset(&tx_frame, 0x00, sizeof(tx_frame));
+    frames_sent = 0;
+    blocks_written = 0;
+    time_last = get_reference_time();
+    for(;;) {
+        // Keep the pipeline full, reading ahead of the frame to be written,
+        // and sending each frame as soon as it is read
+        while((frames_sent <= block_count) && (frames_sent - blocks_written < appconfFILEIO_PIPELINE_DEPTH)) {
+            if (frames_sent < block_count) {
+                fileio_read_frame(&tx_frame, file_buf);
+            } else {
+                tx_frame.end_of_stream = 1;
+            }
+            frame_link_tx(&input_link, &tx_frame);
+            frames_sent++;
         }
-        rtos_osal_critical_exit(state);
 
-        memset(in_buf + bytes_read, 0x00, appconfDATA_FRAME_SIZE_BYTES - bytes_read);
+        // read from queue here and write to file, then return the frame to its pool
+        xQueueReceive(fileio_queue, &out_frame, portMAX_DELAY);
+        if (out_frame->end_of_stream) {
+            data_pipeline_frame_release(out_frame, FRAME_OWNER_FILEIO);
+            break;
+        }
+        wav_interleave_from_s32(file_buf, sample_format, &out_frame->data[0][0], appconfFRAME_ADVANCE,
+                                num_channels, appconfFRAME_ADVANCE);
+        data_pipeline_frame_release(out_frame, FRAME_OWNER_FILEIO);
+        io_frame.buf = file_buf;
+        io_frame.len = file_frame_bytes;
+        (void) xscope_io_service_call(fileio_io_write_frame, &io_frame);
+        blocks_written++;
+
+        // Accumulate per frame so that the 32 bit reference timer can wrap
+        time_now = get_reference_time();
+        elapsed_ticks += (uint32_t)(time_now - time_last);
+        time_last = time_now;
+    }
+
+    xassert(blocks_written == block_count);
+    (void) xscope_io_service_call(fileio_io_flush, NULL);
 
-        rtos_intertile_tx(intertile_ctx,
-                        appconfEXAMPLE_DATA_PORT,
-                        in_buf,
-                        appconfDATA_FRAME_SIZE_BYTES);
+    fileio_write_stage_timing(input_header_struct.sample_rate, timing_filename);
 
-        // read from queue here and write to file 
-        xQueueReceive(fileio_queue,  out_buf, portMAX_DELAY);
-        xscope_fwrite(&outfile, out_buf, appconfDATA_FRAME_SIZE_BYTES);
+    if (elapsed_ticks > 0) {
+        rtos_printf("Processed %u frames of %s in %u ms, %u frames/s (pipeline depth %u)\n",
+                    block_count,
+                    input_filename,
+                    (unsigned)(elapsed_ticks / (PLATFORM_REFERENCE_HZ / 1000)),
+                    (unsigned)(((uint64_t)block_count * PLATFORM_REFERENCE_HZ) / elapsed_ticks),
+                    appconfFILEIO_PIPELINE_DEPTH);
     }
 
-#if (appconfAPP_NOTIFY_FILEIO_DONE == 1)
-    /* Wait for user to tell us they are done writing */
-    (void) ulTaskNotifyTake(pdFALSE, portMAX_DELAY);
-#else
-    /* Otherwise, assume data pipeline is done after 1 second */
-    vTaskDelay(pdMS_TO_TICKS(1000));
-#endif
+    return 0;
+}
+
+/* Process one file, then close it and its output files. lib_xscope_fileio
+ * closes files only all at once, so no file is held open from one file to
+ * the next. */
+static int fileio_process_file(char *input_filename,
+                               char *output_filename,
+                               char *timing_filename)
+{
+    int ret;
+
+    ret = fileio_stream_file(input_filename, output_filename, timing_filename);
 
     rtos_printf("Close all files\n");
-    state = rtos_osal_critical_enter();
-    {
-        xscope_close_all_files();
+    (void) xscope_io_service_call(fileio_io_close_all, NULL);
+
+    return ret;
+}
+
+#if (appconfBATCH_MODE == 1)
+/* Process every pair of files in appconfBATCH_MANIFEST_FILENAME, timing
+ * each. Returns the number that could not be processed. */
+static unsigned fileio_process_batch(void)
+{
+    fileio_io_buf_t io_manifest;
+    xscope_fileio_batch_t batch;
+    char *manifest;
+    char *input_filename;
+    char *output_filename;
+    char timing_filename[appconfBATCH_MAX_FILENAME_BYTES];
+    size_t manifest_bytes;
+    unsigned files = 0;
+    unsigned failures = 0;
+    uint32_t time_start, time_end;
+    int ret;
+
+    /* The whole manifest is read, and the file closed, before the first
+     * pair is opened */
+    manifest = pvPortMalloc(appconfBATCH_MANIFEST_MAX_BYTES + 1);
+    xassert(manifest);
+
+    io_manifest.buf = (uint8_t*)manifest;
+    io_manifest.len = appconfBATCH_MANIFEST_MAX_BYTES + 1;
+    manifest_bytes = xscope_io_service_call(fileio_io_read_manifest, &io_manifest);
+
+    if (manifest_bytes > appconfBATCH_MANIFEST_MAX_BYTES) {
+        rtos_printf("Error: %s is larger than %u bytes\n", appconfBATCH_MANIFEST_FILENAME, appconfBATCH_MANIFEST_MAX_BYTES);
+        vPortFree(manifest);
+        return 1;
     }
-    rtos_osal_critical_exit(state);
+    manifest[manifest_bytes] = '\0';
+
+    xscope_fileio_batch_init(&batch, manifest);
+    while ((ret = xscope_fileio_batch_next(&batch, &input_filename, &output_filename)) != 0) {
+        if (ret < 0) {
+            rtos_printf("Error: line %u of %s is not an input and an output file name\n", batch.line, appconfBATCH_MANIFEST_FILENAME);
+            failures++;
+            continue;
+        }
+        files++;
+
+        if (strlen(output_filename) + sizeof(appconfBATCH_STAGE_TIMING_SUFFIX) > sizeof(timing_filename)) {
+            rtos_printf("Error: output file name %s is too long\n", output_filename);
+            failures++;
+            continue;
+        }
+        strcpy(timing_filename, output_filename);
+        strcat(timing_filename, appconfBATCH_STAGE_TIMING_SUFFIX);
+
+        time_start = get_reference_time();
+        ret = fileio_process_file(input_filename, output_filename, timing_filename);
+        time_end = get_reference_time();
+
+        rtos_printf("Batch file %u, %s to %s: %s in %u ms\n",
+                    files, input_filename, output_filename,
+                    (ret == 0) ? "done" : "FAILED",
+                    (unsigned)((uint32_t)(time_end - time_start) / (PLATFORM_REFERENCE_HZ / 1000)));
+        if (ret != 0) {
+            failures++;
+        }
+    }
+
+    rtos_printf("Batch of %u files processed, %u failures\n", files, failures);
+
+    vPortFree(manifest);
+
+    return failures;
+}
+#endif
+
+void xscope_fileio(void *arg) {
+    (void) arg;
+    unsigned failures;
+
+    /* Wait until xscope_fileio is initialized */
+    while(xscope_fileio_is_initialized() == 0) {
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+    /* The queue holds a pointer to every frame in flight, so the pipeline
+     * output never blocks while this task is sending the next frame */
+    fileio_queue = xQueueCreate(appconfFILEIO_PIPELINE_DEPTH, sizeof(frame_data_t *));
+
+    reader_buf = pvPortMalloc(appconfFILEIO_BUFFER_FRAMES * appconfDATA_FRAME_SIZE_BYTES);
+    writer_buf = pvPortMalloc(appconfFILEIO_BUFFER_FRAMES * appconfDATA_FRAME_SIZE_BYTES);
+    xassert(reader_buf && writer_buf);
+
+#if (appconfBATCH_MODE == 1)
+    failures = fileio_process_batch();
+#else
+    failures = (fileio_process_file(appconfINPUT_FILENAME,
+                                    appconfOUTPUT_FILENAME,
+                                    appconfSTAGE_TIMING_FILENAME) != 0);
+#endif
 
     /* Close the app */
-    _Exit(0);
+    _Exit(failures ? 1 : 0);
 }
 
 void xscope_fileio_tasks_create(unsigned priority, void* app_data) {
+    // Define the core affinity mask such that this task can only run on a specific core
+    UBaseType_t uxCoreAffinityMask = 0x10;
+
+    /* Tile[1] has a frame for each credit */
+    frame_link_tx_init(&input_link,
+                       intertile_ctx,
+                       appconfEXAMPLE_DATA_PORT,
+                       appconfEXAMPLE_CREDIT_PORT,
+                       sizeof(frame_data_t),
+                       appconfFRAME_POOL_FRAMES,
+                       priority);
+
+    /* Every xscope_fileio call is made by the I/O service task, on the same
+     * core, which runs each of the requests below */
+    xscope_io_service_start(priority,
+                            uxCoreAffinityMask,
+                            RTOS_THREAD_STACK_SIZE(fileio_io_open) +
+                            RTOS_THREAD_STACK_SIZE(fileio_io_write_header) +
+                            RTOS_THREAD_STACK_SIZE(fileio_io_read_frame) +
+                            RTOS_THREAD_STACK_SIZE(fileio_io_write_frame) +
+                            RTOS_THREAD_STACK_SIZE(fileio_io_flush) +
+                            RTOS_THREAD_STACK_SIZE(fileio_io_write_timing) +
+#if (appconfBATCH_MODE == 1)
+                            RTOS_THREAD_STACK_SIZE(fileio_io_read_manifest) +
+#endif
+                            RTOS_THREAD_STACK_SIZE(fileio_io_close_all));
+
     xTaskCreate((TaskFunction_t)xscope_fileio,
                 "xscope_fileio",
                 RTOS_THREAD_STACK_SIZE(xscope_fileio),
                 app_data,
                 priority,
                 &fileio_task_handle);
-    
-    // Define the core affinity mask such that this task can only run on a specific core
-    UBaseType_t uxCoreAffinityMask = 0x10;
-
 
     /* Set the core affinity mask for the task. */
     vTaskCoreAffinitySet( fileio_task_handle, uxCoreAffinityMask );                
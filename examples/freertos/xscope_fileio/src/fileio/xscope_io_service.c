@@ -0,0 +1,68 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "app_conf.h"
+#include "fileio/xscope_io_service.h"
+
+typedef struct {
+    xscope_io_service_fn_t fn;
+    void *arg;
+    TaskHandle_t caller;
+    int result;
+} xscope_io_request_t;
+
+static QueueHandle_t request_queue;
+
+static void xscope_io_service(void *arg)
+{
+    (void) arg;
+
+    for (;;) {
+        xscope_io_request_t *request;
+
+        xQueueReceive(request_queue, &request, portMAX_DELAY);
+        request->result = request->fn(request->arg);
+        xTaskNotifyGive(request->caller);
+    }
+}
+
+void xscope_io_service_start(unsigned priority,
+                             unsigned core_affinity,
+                             size_t fn_stack_words)
+{
+    TaskHandle_t service_task_handle;
+
+    request_queue = xQueueCreate(appconfXSCOPE_IO_SERVICE_QUEUE_LENGTH, sizeof(xscope_io_request_t *));
+    xassert(request_queue);
+
+    xTaskCreate((TaskFunction_t)xscope_io_service,
+                "xscope_io_service",
+                RTOS_THREAD_STACK_SIZE(xscope_io_service) + fn_stack_words,
+                NULL,
+                priority,
+                &service_task_handle);
+
+    vTaskCoreAffinitySet(service_task_handle, core_affinity);
+}
+
+int xscope_io_service_call(xscope_io_service_fn_t fn, void *arg)
+{
+    xscope_io_request_t request = {
+        .fn = fn,
+        .arg = arg,
+        .caller = xTaskGetCurrentTaskHandle(),
+        .result = 0,
+    };
+    xscope_io_request_t *request_ptr = &request;
+
+    xQueueSend(request_queue, &request_ptr, portMAX_DELAY);
+    (void) ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    return request.result;
+}
@@ -0,0 +1,35 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef XSCOPE_IO_SERVICE_H_
+#define XSCOPE_IO_SERVICE_H_
+
+#include <stddef.h>
+
+/* A single task that makes every xscope_fileio call.
+ *
+ * Each xscope_fileio call is a round trip to the host over the xscope
+ * chanend. Rather than mask interrupts for the length of each, with a
+ * critical section, callers queue a request to this task, which owns the
+ * chanend, and block until it has been served. The task is pinned to one
+ * core, so the chanend is only ever waited on from that core, and while
+ * it waits, other tasks, and interrupts, on every core carry on.
+ *
+ * A request is a function, run by the service task, so that a sequence of
+ * calls, such as opening a file and parsing its header, is made as one.
+ */
+
+typedef int (*xscope_io_service_fn_t)(void *arg);
+
+/* Create the service task, at priority, on the cores in core_affinity.
+ * The stack words needed by the request functions, which the task's own
+ * stack size can not account for, are given by fn_stack_words. */
+void xscope_io_service_start(unsigned priority,
+                             unsigned core_affinity,
+                             size_t fn_stack_words);
+
+/* Run fn(arg) on the service task and return its result. Requests are
+ * served one at a time, in the order made. */
+int xscope_io_service_call(xscope_io_service_fn_t fn, void *arg);
+
+#endif /* XSCOPE_IO_SERVICE_H_ */
@@ -21,18 +21,6 @@
 #include "fileio/xscope_fileio_task.h"
 #include "data_pipeline.h"
 
-void data_pipeline_input(
-        void *input_app_data,
-        int8_t **input_data_frame,
-        size_t frame_count)
-{
-    (void) input_app_data;
-    
-#if (DATA_TRANSPORT_METHOD == XSCOPE_FILEIO)
-    xscope_fileio_rx_from_host(input_app_data, input_data_frame, frame_count);
-#endif
-}
-
 int data_pipeline_output(
         void *output_app_data,
         int8_t **output_data_frame,
@@ -44,7 +32,7 @@ int data_pipeline_output(
     (void) xscope_fileio_tx_to_host((uint8_t*)output_data_frame, frame_count);
 #endif
 
-    return DATA_PIPELINE_FREE_FRAME;
+    return DATA_PIPELINE_DONT_FREE_FRAME;
 }
 
 void vApplicationMallocFailedHook(void)
@@ -0,0 +1,235 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#include <stdint.h>
+#include <string.h>
+
+#include "wav_convert.h"
+
+/* Each kernel loops over one channel at a time, so that the stores are
+ * contiguous and the loads have a fixed stride. The kernels are inlined into
+ * a dispatch on the common channel counts, which turns the stride into a
+ * constant that the compiler can vectorise for (e.g. with lane shuffles for
+ * 2 channels). Other channel counts run the same loops with a variable
+ * stride. */
+#if defined(__GNUC__)
+#define KERNEL_INLINE static inline __attribute__((always_inline))
+#else
+#define KERNEL_INLINE static inline
+#endif
+
+#define Q31_SCALE               2147483648.0f
+
+#define CHANNEL_DISPATCH(kernel, num_channels, ...)     \
+    switch (num_channels) {                             \
+    case 1: kernel(__VA_ARGS__, 1); break;              \
+    case 2: kernel(__VA_ARGS__, 2); break;              \
+    case 4: kernel(__VA_ARGS__, 4); break;              \
+    case 8: kernel(__VA_ARGS__, 8); break;              \
+    default: kernel(__VA_ARGS__, num_channels); break;  \
+    }
+
+wav_sample_format_t wav_get_sample_format(int audio_format, int bit_depth)
+{
+    if (audio_format == WAV_FORMAT_PCM) {
+        switch (bit_depth) {
+        case 16: return WAV_SAMPLE_S16;
+        case 24: return WAV_SAMPLE_S24;
+        case 32: return WAV_SAMPLE_S32;
+        default: break;
+        }
+    } else if (audio_format == WAV_FORMAT_IEEE_FLOAT && bit_depth == 32) {
+        return WAV_SAMPLE_F32;
+    }
+
+    return WAV_SAMPLE_UNSUPPORTED;
+}
+
+unsigned wav_get_sample_bytes(wav_sample_format_t format)
+{
+    switch (format) {
+    case WAV_SAMPLE_S16: return 2;
+    case WAV_SAMPLE_S24: return 3;
+    case WAV_SAMPLE_S32: return 4;
+    case WAV_SAMPLE_F32: return 4;
+    default: return 0;
+    }
+}
+
+KERNEL_INLINE void deinterleave_s16(int32_t *dst, size_t dst_stride,
+                                    const uint8_t *src, unsigned num_frames,
+                                    unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        int32_t *restrict d = dst + c * dst_stride;
+        const uint8_t *restrict s = src + c * 2;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            int16_t v;
+            memcpy(&v, s + i * num_channels * 2, sizeof(v));
+            d[i] = (int32_t)((uint32_t)v << 16);
+        }
+    }
+}
+
+KERNEL_INLINE void deinterleave_s24(int32_t *dst, size_t dst_stride,
+                                    const uint8_t *src, unsigned num_frames,
+                                    unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        int32_t *restrict d = dst + c * dst_stride;
+        const uint8_t *restrict s = src + c * 3;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            const uint8_t *p = s + i * num_channels * 3;
+            d[i] = (int32_t)(((uint32_t)p[0] << 8) |
+                             ((uint32_t)p[1] << 16) |
+                             ((uint32_t)p[2] << 24));
+        }
+    }
+}
+
+KERNEL_INLINE void deinterleave_s32(int32_t *dst, size_t dst_stride,
+                                    const uint8_t *src, unsigned num_frames,
+                                    unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        int32_t *restrict d = dst + c * dst_stride;
+        const uint8_t *restrict s = src + c * 4;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            memcpy(&d[i], s + i * num_channels * 4, sizeof(int32_t));
+        }
+    }
+}
+
+KERNEL_INLINE void deinterleave_f32(int32_t *dst, size_t dst_stride,
+                                    const uint8_t *src, unsigned num_frames,
+                                    unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        int32_t *restrict d = dst + c * dst_stride;
+        const uint8_t *restrict s = src + c * 4;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            float v;
+            memcpy(&v, s + i * num_channels * 4, sizeof(v));
+            v *= Q31_SCALE;
+            // Saturate, and map NaN to 0
+            d[i] = (v >= Q31_SCALE) ? INT32_MAX :
+                   (v < -Q31_SCALE) ? INT32_MIN :
+                   (v == v) ? (int32_t)v : 0;
+        }
+    }
+}
+
+KERNEL_INLINE void interleave_s16(uint8_t *dst, const int32_t *src,
+                                  size_t src_stride, unsigned num_frames,
+                                  unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        const int32_t *restrict s = src + c * src_stride;
+        uint8_t *restrict d = dst + c * 2;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            const uint16_t v = (uint16_t)((uint32_t)s[i] >> 16);
+            memcpy(d + i * num_channels * 2, &v, sizeof(v));
+        }
+    }
+}
+
+KERNEL_INLINE void interleave_s24(uint8_t *dst, const int32_t *src,
+                                  size_t src_stride, unsigned num_frames,
+                                  unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        const int32_t *restrict s = src + c * src_stride;
+        uint8_t *restrict d = dst + c * 3;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            const uint32_t v = (uint32_t)s[i];
+            uint8_t *p = d + i * num_channels * 3;
+            p[0] = (uint8_t)(v >> 8);
+            p[1] = (uint8_t)(v >> 16);
+            p[2] = (uint8_t)(v >> 24);
+        }
+    }
+}
+
+KERNEL_INLINE void interleave_s32(uint8_t *dst, const int32_t *src,
+                                  size_t src_stride, unsigned num_frames,
+                                  unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        const int32_t *restrict s = src + c * src_stride;
+        uint8_t *restrict d = dst + c * 4;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            memcpy(d + i * num_channels * 4, &s[i], sizeof(int32_t));
+        }
+    }
+}
+
+KERNEL_INLINE void interleave_f32(uint8_t *dst, const int32_t *src,
+                                  size_t src_stride, unsigned num_frames,
+                                  unsigned num_channels)
+{
+    for (unsigned c = 0; c < num_channels; c++) {
+        const int32_t *restrict s = src + c * src_stride;
+        uint8_t *restrict d = dst + c * 4;
+
+        for (unsigned i = 0; i < num_frames; i++) {
+            const float v = (float)s[i] * (1.0f / Q31_SCALE);
+            memcpy(d + i * num_channels * 4, &v, sizeof(v));
+        }
+    }
+}
+
+void wav_deinterleave_to_s32(int32_t *dst,
+                             size_t dst_stride,
+                             const uint8_t *src,
+                             wav_sample_format_t format,
+                             unsigned num_channels,
+                             unsigned num_frames)
+{
+    switch (format) {
+    case WAV_SAMPLE_S16:
+        CHANNEL_DISPATCH(deinterleave_s16, num_channels, dst, dst_stride, src, num_frames);
+        break;
+    case WAV_SAMPLE_S24:
+        CHANNEL_DISPATCH(deinterleave_s24, num_channels, dst, dst_stride, src, num_frames);
+        break;
+    case WAV_SAMPLE_S32:
+        CHANNEL_DISPATCH(deinterleave_s32, num_channels, dst, dst_stride, src, num_frames);
+        break;
+    case WAV_SAMPLE_F32:
+        CHANNEL_DISPATCH(deinterleave_f32, num_channels, dst, dst_stride, src, num_frames);
+        break;
+    default:
+        break;
+    }
+}
+
+void wav_interleave_from_s32(uint8_t *dst,
+                             wav_sample_format_t format,
+                             const int32_t *src,
+                             size_t src_stride,
+                             unsigned num_channels,
+                             unsigned num_frames)
+{
+    switch (format) {
+    case WAV_SAMPLE_S16:
+        CHANNEL_DISPATCH(interleave_s16, num_channels, dst, src, src_stride, num_frames);
+        break;
+    case WAV_SAMPLE_S24:
+        CHANNEL_DISPATCH(interleave_s24, num_channels, dst, src, src_stride, num_frames);
+        break;
+    case WAV_SAMPLE_S32:
+        CHANNEL_DISPATCH(interleave_s32, num_channels, dst, src, src_stride, num_frames);
+        break;
+    case WAV_SAMPLE_F32:
+        CHANNEL_DISPATCH(interleave_f32, num_channels, dst, src, src_stride, num_frames);
+        break;
+    default:
+        break;
+    }
+}
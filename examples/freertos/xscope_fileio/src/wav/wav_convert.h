@@ -0,0 +1,53 @@
+// Copyright 2022 XMOS LIMITED.
+// This Software is subject to the terms of the XMOS Public Licence: Version 1.
+#ifndef WAV_CONVERT_H
+#define WAV_CONVERT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Conversion between interleaved WAV sample data and the pipeline's planar
+ * int32_t [channel][frame] layout, in which every format is left justified
+ * (Q1.31). Float samples are scaled by 2^31 and saturated.
+ *
+ * Converting back truncates to the sample size, so a frame that passes
+ * through the pipeline unchanged is written out as it was read, except for
+ * float samples of magnitude below 2^-8, which lose their lowest bits.
+ *
+ * These functions have no RTOS dependencies and build on the host.
+ */
+
+#define WAV_FORMAT_PCM          1
+#define WAV_FORMAT_IEEE_FLOAT   3
+
+typedef enum {
+    WAV_SAMPLE_S16,
+    WAV_SAMPLE_S24,
+    WAV_SAMPLE_S32,
+    WAV_SAMPLE_F32,
+    WAV_SAMPLE_UNSUPPORTED
+} wav_sample_format_t;
+
+/* Sample format of a WAV file's audio_format and bit_depth fields */
+wav_sample_format_t wav_get_sample_format(int audio_format, int bit_depth);
+
+unsigned wav_get_sample_bytes(wav_sample_format_t format);
+
+/* De-interleave num_frames frames of num_channels samples at src into
+ * dst[c * dst_stride + i], i.e. channel c of frame i. */
+void wav_deinterleave_to_s32(int32_t *dst,
+                             size_t dst_stride,
+                             const uint8_t *src,
+                             wav_sample_format_t format,
+                             unsigned num_channels,
+                             unsigned num_frames);
+
+/* The inverse of wav_deinterleave_to_s32() */
+void wav_interleave_from_s32(uint8_t *dst,
+                             wav_sample_format_t format,
+                             const int32_t *src,
+                             size_t src_stride,
+                             unsigned num_channels,
+                             unsigned num_frames);
+
+#endif // WAV_CONVERT_H
@@ -2,8 +2,6 @@
 // This Software is subject to the terms of the XMOS Public Licence: Version 1.
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <stdlib.h>
 #include <string.h>
 #include <limits.h>
 
@@ -11,11 +9,17 @@
 #include "FreeRTOS.h"
 
 #include "wav_utils.h"
+#include "wav_convert.h"
 
 
 #define RIFF_SECTION_SIZE (12)
-#define FMT_SUBCHUNK_MIN_SIZE (24)
-#define EXTENDED_FMT_GUID_SIZE (16)
+#define CHUNK_HEADER_SIZE (8)
+#define FMT_CHUNK_MIN_SIZE (16)
+#define FMT_EXTENSIBLE_SIZE (40)
+#define FMT_EXTENSIBLE_GUID_OFFSET (24)
+#define DS64_CHUNK_MIN_SIZE (28)
+#define RF64_SIZE_IN_DS64 (0xFFFFFFFF)
+#define WAV_FORMAT_EXTENSIBLE (0xFFFE)
 static const char wav_default_header[WAV_HEADER_BYTES] = {
         0x52, 0x49, 0x46, 0x46,
         0x00, 0x00, 0x00, 0x00,
@@ -30,75 +34,197 @@ static const char wav_default_header[WAV_HEADER_BYTES] = {
         0x00, 0x00, 0x00, 0x00,
 };
 
-int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *header_size){
-  //Assume file is already open here. First rewind.
-  xscope_fseek(input_file, 0, SEEK_SET);
-  //read riff header section (12 bytes)
-  xscope_fread(input_file, (uint8_t*)(&s->riff_header[0]), RIFF_SECTION_SIZE);
-  if(memcmp(s->riff_header, "RIFF", sizeof(s->riff_header)) != 0)
-  {
-    rtos_printf("Error: couldn't find RIFF: 0x%x, 0x%x, 0x%x, 0x%x\n", s->riff_header[0], s->riff_header[1], s->riff_header[2], s->riff_header[3]);
-    return 1;
-  }
-
-  if(memcmp(s->wave_header, "WAVE", sizeof(s->wave_header)) != 0)
-  {
-    rtos_printf("Error: couldn't find WAVE:, 0x%x, 0x%x, 0x%x, 0x%x\n", s->wave_header[0], s->wave_header[1], s->wave_header[2], s->wave_header[3]);
-    return 1;
-  }
-  
-  xscope_fread(input_file, (uint8_t*)&s->fmt_header[0], FMT_SUBCHUNK_MIN_SIZE);
-  if(memcmp(s->fmt_header, "fmt ", sizeof(s->fmt_header)) != 0)
-  {
-    rtos_printf("Error: couldn't find fmt: 0x%x, 0x%x, 0x%x, 0x%x\n", s->fmt_header[0], s->fmt_header[1], s->fmt_header[2], s->fmt_header[3]);
-    return 1;
-  }
-  
-  unsigned fmt_subchunk_actual_size = s->fmt_chunk_size + sizeof(s->fmt_header) + sizeof(s->fmt_chunk_size); //fmt_chunk_size doesn't include the fmt_header(4) and size(4) bytes
-  unsigned fmt_subchunk_remaining_size = fmt_subchunk_actual_size - FMT_SUBCHUNK_MIN_SIZE;
-  
-  if(s->audio_format == (short)0xfffe)
-  {
-    //seek to the end of fmt subchunk and rewind 16bytes to the beginning of GUID
-    xscope_fseek(input_file, fmt_subchunk_remaining_size - EXTENDED_FMT_GUID_SIZE, SEEK_CUR);
-    //The first 2 bytes of GUID is the audio_format.
-    xscope_fread(input_file, (uint8_t *)&s->audio_format, sizeof(s->audio_format));
-    //skip the rest of GUID
-    xscope_fseek(input_file, EXTENDED_FMT_GUID_SIZE - sizeof(s->audio_format), SEEK_CUR);
-  }
-  else
-  {
-    //go to the end of fmt subchunk
-    xscope_fseek(input_file, fmt_subchunk_remaining_size, SEEK_CUR);
-  }
-  if(s->audio_format != 1)
-  {
-    rtos_printf("Error: audio format(%d) is not PCM\n", s->audio_format);
-    return 1;
-  }
-  
-  //read header (4 bytes) for the next subchunk
-  xscope_fread(input_file, (uint8_t*)&s->data_header[0], sizeof(s->data_header));
-  //if next subchunk is fact, read subchunk size and skip it
-  if(memcmp(s->data_header, "fact", sizeof(s->data_header)) == 0)
-  {
-    uint32_t chunksize;
-    xscope_fread(input_file, (uint8_t *)&chunksize, sizeof(s->data_bytes));
-    xscope_fseek(input_file, chunksize, SEEK_CUR);
-    xscope_fread(input_file, (uint8_t*)(&s->data_header[0]), sizeof(s->data_header));
-  }
-  //only thing expected at this point is the 'data' subchunk. Throw error if not found.
-  if(memcmp(s->data_header, "data", sizeof(s->data_header)) != 0)
-  {
-    rtos_printf("Error: couldn't find data: 0x%x, 0x%x, 0x%x, 0x%x\n", s->data_header[0], s->data_header[1], s->data_header[2], s->data_header[3]);
-    return 1;
-  }
-  //read data subchunk size. 
-  xscope_fread(input_file, (uint8_t *)&s->data_bytes, sizeof(s->data_bytes));
-  *header_size = xscope_ftell(input_file); //total file size should be header_size + data_bytes
-  //No need to close file - handled by caller
-
-  return 0;
+static uint16_t wav_rd16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t wav_rd32(const uint8_t *p)
+{
+    return (uint32_t)wav_rd16(p) | ((uint32_t)wav_rd16(p + 2) << 16);
+}
+
+static uint64_t wav_rd64(const uint8_t *p)
+{
+    return (uint64_t)wav_rd32(p) | ((uint64_t)wav_rd32(p + 4) << 32);
+}
+
+typedef struct {
+    uint64_t next_chunk;        /* File offset of the next chunk header */
+    uint64_t ds64_data_bytes;   /* Data size from the ds64 chunk of an RF64 file */
+    int rf64;
+    int have_fmt;
+    int have_ds64;
+} wav_parse_state_t;
+
+enum {
+    WAV_PARSE_DONE,
+    WAV_PARSE_ERROR,
+    WAV_PARSE_MORE,             /* The next chunk is not wholly in the window */
+};
+
+static int wav_parse_fmt(const uint8_t *body, uint32_t size, wav_header *s)
+{
+    memcpy(s->fmt_header, "fmt ", sizeof(s->fmt_header));
+    s->fmt_chunk_size = size;
+    s->audio_format = wav_rd16(&body[0]);
+    s->num_channels = wav_rd16(&body[2]);
+    s->sample_rate = wav_rd32(&body[4]);
+    s->byte_rate = wav_rd32(&body[8]);
+    s->sample_alignment = wav_rd16(&body[12]);
+    s->bit_depth = wav_rd16(&body[14]);
+
+    if(s->audio_format == (short)WAV_FORMAT_EXTENSIBLE)
+    {
+        if(size < FMT_EXTENSIBLE_SIZE)
+        {
+            rtos_printf("Error: extensible fmt chunk of %u bytes is too short\n", (unsigned)size);
+            return WAV_PARSE_ERROR;
+        }
+        //The first 2 bytes of the GUID are the audio_format
+        s->audio_format = wav_rd16(&body[FMT_EXTENSIBLE_GUID_OFFSET]);
+    }
+    if(s->audio_format != WAV_FORMAT_PCM && s->audio_format != WAV_FORMAT_IEEE_FLOAT)
+    {
+        rtos_printf("Error: audio format(%d) is not PCM or IEEE float\n", s->audio_format);
+        return WAV_PARSE_ERROR;
+    }
+
+    return WAV_PARSE_DONE;
+}
+
+/* Walk the chunks in window, which holds len bytes of the file from offset
+ * window_start, up to the data chunk. The fields of each chunk are used in
+ * place. fact, LIST and any unknown chunks are skipped. */
+static int wav_parse_chunks(const uint8_t *window, size_t len, uint64_t window_start,
+                            wav_parse_state_t *state, wav_header *s, uint64_t *data_offset,
+                            uint64_t *data_bytes)
+{
+    for (;;) {
+        const uint64_t pos = state->next_chunk - window_start;
+        const uint8_t *chunk;
+        uint32_t size;
+        uint64_t avail;
+
+        if (pos + CHUNK_HEADER_SIZE > len) {
+            return WAV_PARSE_MORE;
+        }
+        chunk = &window[pos];
+        size = wav_rd32(&chunk[4]);
+        avail = len - pos - CHUNK_HEADER_SIZE;
+
+        if (memcmp(chunk, "data", 4) == 0) {
+            if (!state->have_fmt || (state->rf64 && !state->have_ds64)) {
+                rtos_printf("Error: couldn't find fmt or ds64 before data\n");
+                return WAV_PARSE_ERROR;
+            }
+            memcpy(s->data_header, "data", sizeof(s->data_header));
+            s->data_bytes = size;
+            *data_offset = state->next_chunk + CHUNK_HEADER_SIZE;
+            *data_bytes = (state->rf64 && size == RF64_SIZE_IN_DS64) ? state->ds64_data_bytes : size;
+            return WAV_PARSE_DONE;
+        } else if (memcmp(chunk, "fmt ", 4) == 0) {
+            const uint32_t needed = (size >= FMT_EXTENSIBLE_SIZE) ? FMT_EXTENSIBLE_SIZE : FMT_CHUNK_MIN_SIZE;
+
+            if (size < FMT_CHUNK_MIN_SIZE) {
+                rtos_printf("Error: fmt chunk of %u bytes is too short\n", (unsigned)size);
+                return WAV_PARSE_ERROR;
+            }
+            if (avail < needed) {
+                return WAV_PARSE_MORE;
+            }
+            if (wav_parse_fmt(&chunk[CHUNK_HEADER_SIZE], size, s) != WAV_PARSE_DONE) {
+                return WAV_PARSE_ERROR;
+            }
+            state->have_fmt = 1;
+        } else if (memcmp(chunk, "ds64", 4) == 0 && state->rf64) {
+            if (size < DS64_CHUNK_MIN_SIZE) {
+                rtos_printf("Error: ds64 chunk of %u bytes is too short\n", (unsigned)size);
+                return WAV_PARSE_ERROR;
+            }
+            if (avail < DS64_CHUNK_MIN_SIZE) {
+                return WAV_PARSE_MORE;
+            }
+            //riffSize(8), dataSize(8), sampleCount(8) and an unused table
+            state->ds64_data_bytes = wav_rd64(&chunk[CHUNK_HEADER_SIZE + 8]);
+            state->have_ds64 = 1;
+        }
+
+        //Chunks are padded to an even size
+        state->next_chunk += CHUNK_HEADER_SIZE + (uint64_t)size + (size & 1);
+    }
+}
+
+int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *header_size, uint64_t *data_bytes){
+    uint8_t window[WAV_HEADER_WINDOW_BYTES];
+    wav_parse_state_t state;
+    uint64_t window_start = 0;
+    uint64_t data_offset = 0;
+    size_t len;
+    int ret;
+
+    memset(&state, 0, sizeof(state));
+
+    //Assume file is already open here. Rewind and read the whole header, normally, in one request.
+    xscope_fseek(input_file, 0, SEEK_SET);
+    len = xscope_fread(input_file, window, sizeof(window));
+    if(len < RIFF_SECTION_SIZE)
+    {
+        rtos_printf("Error: file of %u bytes is too short\n", (unsigned)len);
+        return 1;
+    }
+
+    memcpy(s->riff_header, &window[0], sizeof(s->riff_header));
+    s->wav_size = wav_rd32(&window[4]);
+    memcpy(s->wave_header, &window[8], sizeof(s->wave_header));
+    if(memcmp(s->riff_header, "RIFF", sizeof(s->riff_header)) == 0)
+    {
+        state.rf64 = 0;
+    }
+    else if(memcmp(s->riff_header, "RF64", sizeof(s->riff_header)) == 0)
+    {
+        state.rf64 = 1;
+    }
+    else
+    {
+        rtos_printf("Error: couldn't find RIFF or RF64: 0x%x, 0x%x, 0x%x, 0x%x\n", s->riff_header[0], s->riff_header[1], s->riff_header[2], s->riff_header[3]);
+        return 1;
+    }
+
+    if(memcmp(s->wave_header, "WAVE", sizeof(s->wave_header)) != 0)
+    {
+        rtos_printf("Error: couldn't find WAVE:, 0x%x, 0x%x, 0x%x, 0x%x\n", s->wave_header[0], s->wave_header[1], s->wave_header[2], s->wave_header[3]);
+        return 1;
+    }
+
+    state.next_chunk = RIFF_SECTION_SIZE;
+    while((ret = wav_parse_chunks(window, len, window_start, &state, s, &data_offset, data_bytes)) == WAV_PARSE_MORE)
+    {
+        //The window ends in the next chunk, or before it. Read on from the start of that
+        //chunk, unless the window already started there or was cut short by the end of file.
+        if(state.next_chunk == window_start || len < sizeof(window) || state.next_chunk > INT_MAX)
+        {
+            rtos_printf("Error: couldn't find data\n");
+            return 1;
+        }
+        window_start = state.next_chunk;
+        xscope_fseek(input_file, (int)window_start, SEEK_SET);
+        len = xscope_fread(input_file, window, sizeof(window));
+    }
+    if(ret != WAV_PARSE_DONE)
+    {
+        return 1;
+    }
+
+    if(data_offset > UINT_MAX)
+    {
+        rtos_printf("Error: data starts beyond 4 GB\n");
+        return 1;
+    }
+    *header_size = (unsigned)data_offset; //total file size should be header_size + data_bytes
+    //No need to close file - handled by caller
+
+    return 0;
 }
 
 int wav_form_header(wav_header *header,
@@ -137,3 +263,60 @@ int wav_get_num_frames(const wav_header *s){
 long wav_get_frame_start(const wav_header *s, unsigned frame_number, uint32_t wavheader_size){
     return wavheader_size + frame_number * wav_get_num_bytes_per_frame(s);
 }
+
+static void wav_wr16(uint8_t *p, uint16_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x >> 8);
+}
+
+static void wav_wr32(uint8_t *p, uint32_t x)
+{
+    wav_wr16(p, (uint16_t)x);
+    wav_wr16(p + 2, (uint16_t)(x >> 16));
+}
+
+static void wav_wr64(uint8_t *p, uint64_t x)
+{
+    wav_wr32(p, (uint32_t)x);
+    wav_wr32(p + 4, (uint32_t)(x >> 32));
+}
+
+int wav_form_rf64_header(uint8_t header[WAV_RF64_HEADER_BYTES],
+        short audio_format,
+        short num_channels,
+        int sample_rate,
+        short bit_depth,
+        uint64_t num_frames){
+    const uint64_t data_bytes = num_frames * num_channels * (bit_depth/8);
+    uint8_t *p = header;
+
+    //RIFF section, with the sizes given in the ds64 chunk
+    memcpy(p, "RF64", 4);
+    wav_wr32(p + 4, RF64_SIZE_IN_DS64);
+    memcpy(p + 8, "WAVE", 4);
+    p += RIFF_SECTION_SIZE;
+
+    memcpy(p, "ds64", 4);
+    wav_wr32(p + 4, DS64_CHUNK_MIN_SIZE);
+    wav_wr64(p + 8, data_bytes + WAV_RF64_HEADER_BYTES - 8);
+    wav_wr64(p + 16, data_bytes);
+    wav_wr64(p + 24, num_frames);
+    wav_wr32(p + 32, 0);
+    p += CHUNK_HEADER_SIZE + DS64_CHUNK_MIN_SIZE;
+
+    memcpy(p, "fmt ", 4);
+    wav_wr32(p + 4, FMT_CHUNK_MIN_SIZE);
+    wav_wr16(p + 8, audio_format);
+    wav_wr16(p + 10, num_channels);
+    wav_wr32(p + 12, sample_rate);
+    wav_wr32(p + 16, sample_rate*bit_depth*num_channels/8);
+    wav_wr16(p + 20, num_channels * (bit_depth/8));
+    wav_wr16(p + 22, bit_depth);
+    p += CHUNK_HEADER_SIZE + FMT_CHUNK_MIN_SIZE;
+
+    memcpy(p, "data", 4);
+    wav_wr32(p + 4, RF64_SIZE_IN_DS64);
+
+    return 0;
+}
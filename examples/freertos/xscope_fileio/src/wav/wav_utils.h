@@ -8,6 +8,14 @@
 #include "xscope_io_device.h"
 
 #define WAV_HEADER_BYTES 44
+#define WAV_RF64_HEADER_BYTES 80
+
+/* Bytes of the file read per request by get_wav_header_details(). Headers
+ * whose chunks before the sample data fit in the window are parsed from a
+ * single read. */
+#ifndef WAV_HEADER_WINDOW_BYTES
+#define WAV_HEADER_WINDOW_BYTES 512
+#endif
 
 typedef struct wav_header {
     // RIFF Header
@@ -30,7 +38,13 @@ typedef struct wav_header {
     int data_bytes;         // frame count * num_channels * (bit_depth/8)
 } wav_header;
 
-int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *header_size);
+/* Parse the header of a RIFF or RF64 WAV file. The fmt chunk is returned in
+ * s, in the layout of a canonical 44 byte header, along with the file offset
+ * (header_size) and size of the sample data. The data of an RF64 file may be
+ * larger than 4 GB, so its size is returned in data_bytes, and s->data_bytes
+ * is only valid for a RIFF file. Chunks other than fmt, ds64 and data are
+ * skipped. Returns 0 on success. */
+int get_wav_header_details(xscope_file_t *input_file, wav_header *s, unsigned *header_size, uint64_t *data_bytes);
 
 int wav_form_header(wav_header *header,
         short audio_format,
@@ -39,6 +53,15 @@ int wav_form_header(wav_header *header,
         short bit_depth,
         int num_frames);
 
+/* Form the WAV_RF64_HEADER_BYTES header of an RF64 file, for sample data
+ * larger than a RIFF header can describe */
+int wav_form_rf64_header(uint8_t header[WAV_RF64_HEADER_BYTES],
+        short audio_format,
+        short num_channels,
+        int sample_rate,
+        short bit_depth,
+        uint64_t num_frames);
+
 unsigned wav_get_num_bytes_per_frame(const wav_header *s);
 
 int wav_get_num_frames(const wav_header *s);
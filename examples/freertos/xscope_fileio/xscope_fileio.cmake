@@ -41,6 +41,8 @@ set(APP_LINK_OPTIONS
 
 set(APP_COMMON_LINK_LIBRARIES
     xscope_fileio
+    frame_pool
+    pipeline_timing
     rtos::bsp_config::xcore_ai_explorer
     lib_xcore_math
 )
@@ -0,0 +1,84 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef FRAME_LINK_H_
+#define FRAME_LINK_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "rtos_intertile.h"
+
+#include "frame_pool.h"
+
+/* Pipeline frames sent from one tile to a frame pool on the other.
+ *
+ * Each frame is sent, in an intertile message of its own, from the sender's
+ * buffer and received straight into a frame from the receiver's pool, with
+ * no copy at either end. The sender holds a credit for each frame the
+ * receiver's pool can take, and spends one per frame sent, so it only
+ * sends when the receiver has a frame to receive into. This keeps a sender from holding the intertile link, which
+ * carries one message at a time from each tile, while the receiver waits
+ * for a frame. The receiver returns the credits as the frames are released,
+ * credit_batch at a time, to a task that the sender's end creates.
+ *
+ * The intertile driver pairs each message's length with one transfer of
+ * its data, so frames are not gathered into one message, which would need
+ * them copied into one buffer at each end.
+ */
+
+typedef struct {
+    rtos_intertile_t *ctx;
+    uint8_t data_port;
+    uint8_t credit_port;
+    size_t frame_bytes;
+    SemaphoreHandle_t credits;  /* One for each frame the receiver can take */
+} frame_link_tx_t;
+
+typedef struct {
+    rtos_intertile_t *ctx;
+    uint8_t data_port;
+    uint8_t credit_port;
+    size_t frame_bytes;
+    frame_pool_t *pool;
+    unsigned owner;             /* Of the frames received */
+    unsigned credit_batch;
+    unsigned credits_held;      /* Frames released but not yet credited */
+} frame_link_rx_t;
+
+/* Start the sending end of a link, to data_port on the other tile, with
+ * the credits the receiver's pool has frames for. The credits are returned
+ * on credit_port to a task created at priority. */
+void frame_link_tx_init(frame_link_tx_t *link,
+                        rtos_intertile_t *ctx,
+                        uint8_t data_port,
+                        uint8_t credit_port,
+                        size_t frame_bytes,
+                        unsigned credits,
+                        unsigned priority);
+
+/* Send a frame once the sender has a credit for it. The frame may be
+ * reused once this returns. */
+void frame_link_tx(frame_link_tx_t *link, void *frame);
+
+/* Start the receiving end of a link, which receives into frames from pool,
+ * held by owner, and returns the credits for them credit_batch at a time */
+void frame_link_rx_init(frame_link_rx_t *link,
+                        rtos_intertile_t *ctx,
+                        uint8_t data_port,
+                        uint8_t credit_port,
+                        size_t frame_bytes,
+                        frame_pool_t *pool,
+                        unsigned owner,
+                        unsigned credit_batch);
+
+/* Return the next frame sent, waiting for a message if there is none */
+void *frame_link_rx(frame_link_rx_t *link);
+
+/* Return a received frame, held by owner, to its pool, and its credit to
+ * the sender. May be called by any task on the receiver's tile. */
+void frame_link_rx_release(frame_link_rx_t *link, void *frame, unsigned owner);
+
+#endif /* FRAME_LINK_H_ */
@@ -0,0 +1,87 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef FRAME_POOL_H_
+#define FRAME_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* A fixed pool of equally sized frames, for the frame buffers that pipeline
+ * input callbacks hand on, by pointer, through the pipeline stages, in
+ * place of a pvPortMalloc() per frame and a vPortFree() in the output.
+ *
+ * Getting and releasing a frame take constant time, in a critical section
+ * of a few instructions, so may be done from any task, on any core, or
+ * from an ISR. The free frames are a stack. The xcore has no compare and
+ * exchange, so the stack is guarded by rtos_osal_critical_enter(), which
+ * masks interrupts and takes the kernel's hardware lock, rather than by
+ * atomics.
+ *
+ * Each frame records its owner, and every hand off checks it, so a frame
+ * that is released twice, or by a task that does not hold it, is caught.
+ * Owners are chosen by the application, other than FRAME_POOL_OWNER_FREE.
+ * A frame knows its pool, so it can be released by a task that has no
+ * reference to the pool.
+ *
+ * When the pool is empty frame_pool_get() returns NULL, and counts the
+ * attempt. The counters, and the most frames ever held at once, can be
+ * read at any time, to size the pool.
+ */
+
+#define FRAME_POOL_OWNER_FREE       0
+
+/* The largest number of frames in a pool */
+#define FRAME_POOL_MAX_FRAMES       0xFFFE
+
+/* Bytes kept before each frame, a multiple of 8 so that frames are aligned
+ * as the storage is */
+#define FRAME_POOL_HEADER_BYTES     ((sizeof(frame_pool_header_t) + 7) & ~(size_t)7)
+
+/* Bytes from one frame to the next */
+#define FRAME_POOL_STRIDE_BYTES(frame_bytes) \
+    (FRAME_POOL_HEADER_BYTES + (((size_t)(frame_bytes) + 7) & ~(size_t)7))
+
+/* Declares storage, 8 byte aligned, for count frames of frame_bytes each */
+#define FRAME_POOL_STORAGE(name, frame_bytes, count) \
+    uint64_t name[(FRAME_POOL_STRIDE_BYTES(frame_bytes) * (count)) / sizeof(uint64_t)]
+
+typedef struct frame_pool frame_pool_t;
+
+typedef struct {
+    frame_pool_t *pool;
+    unsigned index;
+    unsigned owner;
+    unsigned next;              /* Index of the next free frame, while free */
+} frame_pool_header_t;
+
+struct frame_pool {
+    uint8_t *storage;
+    size_t stride;
+    unsigned count;
+    unsigned head;              /* Index of the first free frame */
+
+    volatile unsigned in_use;           /* Frames held now */
+    volatile unsigned max_in_use;       /* Most frames ever held at once */
+    volatile unsigned get_count;        /* Frames got */
+    volatile unsigned exhausted_count;  /* Calls to frame_pool_get() that found none free */
+};
+
+/* Make count frames, of frame_bytes each, in storage declared with
+ * FRAME_POOL_STORAGE(), free for frame_pool_get() */
+void frame_pool_init(frame_pool_t *pool,
+                     void *storage,
+                     size_t frame_bytes,
+                     unsigned count);
+
+/* Take a free frame for owner, or return NULL if there are none. Its
+ * contents are left as they were. */
+void *frame_pool_get(frame_pool_t *pool, unsigned owner);
+
+/* Hand a frame held by from on to the owner to */
+void frame_pool_transfer(void *frame, unsigned from, unsigned to);
+
+/* Return a frame held by owner to its pool */
+void frame_pool_release(void *frame, unsigned owner);
+
+#endif /* FRAME_POOL_H_ */
@@ -0,0 +1,136 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <stdint.h>
+#include <stddef.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+
+/* Library headers */
+#include "rtos_osal.h"
+#include "rtos_intertile.h"
+#include "frame_pool.h"
+#include "frame_link.h"
+
+/* Gives the sender a credit for each frame the receiver releases */
+static void frame_link_credit_rx(frame_link_tx_t *link)
+{
+    for (;;) {
+        uint32_t credits;
+        size_t bytes_received;
+
+        bytes_received = rtos_intertile_rx_len(
+                link->ctx,
+                link->credit_port,
+                portMAX_DELAY);
+
+        xassert(bytes_received == sizeof(credits));
+
+        rtos_intertile_rx_data(
+                link->ctx,
+                &credits,
+                bytes_received);
+
+        while (credits-- > 0) {
+            xSemaphoreGive(link->credits);
+        }
+    }
+}
+
+void frame_link_tx_init(frame_link_tx_t *link,
+                        rtos_intertile_t *ctx,
+                        uint8_t data_port,
+                        uint8_t credit_port,
+                        size_t frame_bytes,
+                        unsigned credits,
+                        unsigned priority)
+{
+    link->ctx = ctx;
+    link->data_port = data_port;
+    link->credit_port = credit_port;
+    link->frame_bytes = frame_bytes;
+    link->credits = xSemaphoreCreateCounting(credits, credits);
+    xassert(link->credits);
+
+    xTaskCreate((TaskFunction_t)frame_link_credit_rx,
+                "frame_link_credit_rx",
+                RTOS_THREAD_STACK_SIZE(frame_link_credit_rx),
+                link,
+                priority,
+                NULL);
+}
+
+void frame_link_tx(frame_link_tx_t *link, void *frame)
+{
+    xSemaphoreTake(link->credits, portMAX_DELAY);
+    rtos_intertile_tx(link->ctx, link->data_port, frame, link->frame_bytes);
+}
+
+void frame_link_rx_init(frame_link_rx_t *link,
+                        rtos_intertile_t *ctx,
+                        uint8_t data_port,
+                        uint8_t credit_port,
+                        size_t frame_bytes,
+                        frame_pool_t *pool,
+                        unsigned owner,
+                        unsigned credit_batch)
+{
+    xassert(credit_batch > 0);
+
+    link->ctx = ctx;
+    link->data_port = data_port;
+    link->credit_port = credit_port;
+    link->frame_bytes = frame_bytes;
+    link->pool = pool;
+    link->owner = owner;
+    link->credit_batch = credit_batch;
+    link->credits_held = 0;
+}
+
+void *frame_link_rx(frame_link_rx_t *link)
+{
+    size_t bytes_received;
+    void *frame;
+
+    bytes_received = rtos_intertile_rx_len(
+            link->ctx,
+            link->data_port,
+            portMAX_DELAY);
+
+    xassert(bytes_received == link->frame_bytes);
+
+    /* The sender had a credit for the frame, so there is a free frame to
+     * receive it into, once the release that returned the credit is seen */
+    while ((frame = frame_pool_get(link->pool, link->owner)) == NULL) {
+        vTaskDelay(1);
+    }
+    rtos_intertile_rx_data(link->ctx, frame, bytes_received);
+
+    return frame;
+}
+
+void frame_link_rx_release(frame_link_rx_t *link, void *frame, unsigned owner)
+{
+    uint32_t credits = 0;
+    int state;
+
+    frame_pool_release(frame, owner);
+
+    /* The task whose release makes up a batch sends it */
+    state = rtos_osal_critical_enter();
+    {
+        if (++link->credits_held >= link->credit_batch) {
+            credits = link->credits_held;
+            link->credits_held = 0;
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    if (credits > 0) {
+        rtos_intertile_tx(link->ctx, link->credit_port, &credits, sizeof(credits));
+    }
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <stdint.h>
+#include <stddef.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+
+/* Library headers */
+#include "rtos_osal.h"
+#include "frame_pool.h"
+
+#define FRAME_POOL_NONE     0xFFFF
+
+static frame_pool_header_t *header_at(frame_pool_t *pool, unsigned index)
+{
+    return (frame_pool_header_t *)(pool->storage + index * pool->stride);
+}
+
+static frame_pool_header_t *header_of(void *frame)
+{
+    return (frame_pool_header_t *)((uint8_t *)frame - FRAME_POOL_HEADER_BYTES);
+}
+
+void frame_pool_init(frame_pool_t *pool,
+                     void *storage,
+                     size_t frame_bytes,
+                     unsigned count)
+{
+    xassert(count > 0 && count <= FRAME_POOL_MAX_FRAMES);
+    xassert(((uintptr_t)storage & 7) == 0);
+
+    pool->storage = storage;
+    pool->stride = FRAME_POOL_STRIDE_BYTES(frame_bytes);
+    pool->count = count;
+
+    for (unsigned i = 0; i < count; i++) {
+        frame_pool_header_t *header = header_at(pool, i);
+
+        header->pool = pool;
+        header->index = i;
+        header->owner = FRAME_POOL_OWNER_FREE;
+        header->next = (i + 1 < count) ? i + 1 : FRAME_POOL_NONE;
+    }
+
+    pool->in_use = 0;
+    pool->max_in_use = 0;
+    pool->get_count = 0;
+    pool->exhausted_count = 0;
+    pool->head = 0;
+}
+
+void *frame_pool_get(frame_pool_t *pool, unsigned owner)
+{
+    frame_pool_header_t *header = NULL;
+    int state;
+
+    xassert(owner != FRAME_POOL_OWNER_FREE);
+
+    state = rtos_osal_critical_enter();
+    {
+        if (pool->head != FRAME_POOL_NONE) {
+            header = header_at(pool, pool->head);
+            pool->head = header->next;
+
+            xassert(header->owner == FRAME_POOL_OWNER_FREE);
+            header->owner = owner;
+
+            pool->get_count++;
+            if (++pool->in_use > pool->max_in_use) {
+                pool->max_in_use = pool->in_use;
+            }
+        } else {
+            pool->exhausted_count++;
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    if (header == NULL) {
+        return NULL;
+    }
+
+    return (uint8_t *)header + FRAME_POOL_HEADER_BYTES;
+}
+
+void frame_pool_transfer(void *frame, unsigned from, unsigned to)
+{
+    frame_pool_header_t *header = header_of(frame);
+    unsigned prev_owner;
+    int state;
+
+    xassert(to != FRAME_POOL_OWNER_FREE);
+
+    state = rtos_osal_critical_enter();
+    {
+        prev_owner = header->owner;
+        if (prev_owner == from) {
+            header->owner = to;
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    xassert(prev_owner == from);
+    (void) prev_owner;
+}
+
+void frame_pool_release(void *frame, unsigned owner)
+{
+    frame_pool_header_t *header = header_of(frame);
+    frame_pool_t *pool = header->pool;
+    const unsigned index = header->index;
+    unsigned prev_owner;
+    int state;
+
+    xassert(index < pool->count && header == header_at(pool, index));
+
+    state = rtos_osal_critical_enter();
+    {
+        prev_owner = header->owner;
+        if (prev_owner == owner) {
+            header->owner = FRAME_POOL_OWNER_FREE;
+            header->next = pool->head;
+            pool->head = index;
+            pool->in_use--;
+        }
+    }
+    rtos_osal_critical_exit(state);
+
+    xassert(prev_owner == owner);
+    (void) prev_owner;
+}
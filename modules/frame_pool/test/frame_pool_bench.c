@@ -0,0 +1,189 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Benchmark of getting and releasing pipeline frames by tasks that contend
+ * for them, from the frame pool, from a queue of free frames, as the pool
+ * was before, and from the heap in a critical section, as pvPortMalloc()
+ * and vPortFree() are.
+ *
+ * Each of TASKS tasks gets a frame, marks it as its own, checks the mark
+ * and releases the frame, ITERATIONS times. A frame given to two tasks at
+ * once is reported. The frames are the size of the xscope_fileio example's.
+ *
+ * Usage: frame_pool_bench [ITERATIONS] [MAX_TASKS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+#include "rtos_osal.h"
+#include "xcore/hwtimer.h"
+#include "platform.h"
+
+#include "frame_pool.h"
+
+#define MAX_TASKS       16
+#define FRAMES_PER_TASK 2
+#define NUM_CHANNELS    2
+#define FRAME_ADVANCE   240
+#define TASK_PRIORITY   (configMAX_PRIORITIES - 1)
+
+typedef struct {
+    int32_t data[NUM_CHANNELS][FRAME_ADVANCE];
+    uint32_t owner;
+} bench_frame_t;
+
+enum {
+    OWNER_CONTENDER = 1,
+};
+
+typedef enum {
+    ALLOC_FRAME_POOL,
+    ALLOC_QUEUE,
+    ALLOC_HEAP,
+} bench_alloc_t;
+
+static bench_alloc_t alloc;
+static unsigned iterations;
+static FRAME_POOL_STORAGE(pool_storage, sizeof(bench_frame_t), MAX_TASKS * FRAMES_PER_TASK);
+static frame_pool_t pool;
+static bench_frame_t queue_frames[MAX_TASKS * FRAMES_PER_TASK];
+static QueueHandle_t free_queue;
+static QueueHandle_t done_queue;
+
+static bench_frame_t *frame_get(void)
+{
+    bench_frame_t *frame = NULL;
+
+    switch (alloc) {
+    case ALLOC_FRAME_POOL:
+        while ((frame = frame_pool_get(&pool, OWNER_CONTENDER)) == NULL) {
+        }
+        break;
+    case ALLOC_QUEUE:
+        xQueueReceive(free_queue, &frame, portMAX_DELAY);
+        break;
+    case ALLOC_HEAP: {
+        int state = rtos_osal_critical_enter();
+        {
+            frame = pvPortMalloc(sizeof(bench_frame_t));
+        }
+        rtos_osal_critical_exit(state);
+        break;
+    }
+    }
+
+    return frame;
+}
+
+static void frame_release(bench_frame_t *frame)
+{
+    switch (alloc) {
+    case ALLOC_FRAME_POOL:
+        frame_pool_release(frame, OWNER_CONTENDER);
+        break;
+    case ALLOC_QUEUE:
+        xQueueSend(free_queue, &frame, portMAX_DELAY);
+        break;
+    case ALLOC_HEAP: {
+        int state = rtos_osal_critical_enter();
+        {
+            vPortFree(frame);
+        }
+        rtos_osal_critical_exit(state);
+        break;
+    }
+    }
+}
+
+static void contender(void *arg)
+{
+    const uint32_t id = (uint32_t)(uintptr_t)arg;
+    int collisions = 0;
+
+    for (unsigned i = 0; i < iterations; i++) {
+        bench_frame_t *frame = frame_get();
+
+        frame->owner = id;
+        frame->data[0][0] = i;
+        frame->data[NUM_CHANNELS - 1][FRAME_ADVANCE - 1] = id;
+        collisions += (frame->owner != id) || (frame->data[0][0] != (int32_t)i);
+        frame_release(frame);
+    }
+
+    xQueueSend(done_queue, &collisions, portMAX_DELAY);
+    for (;;) {
+        vTaskDelay(portMAX_DELAY);
+    }
+}
+
+static void run(bench_alloc_t bench_alloc, const char *name, unsigned num_tasks)
+{
+    int collisions = 0;
+    uint32_t time_start;
+    uint32_t ticks;
+
+    alloc = bench_alloc;
+    frame_pool_init(&pool, pool_storage, sizeof(bench_frame_t), MAX_TASKS * FRAMES_PER_TASK);
+    for (int i = 0; i < MAX_TASKS * FRAMES_PER_TASK; i++) {
+        bench_frame_t *frame = &queue_frames[i];
+        xQueueSend(free_queue, &frame, 0);
+    }
+
+    time_start = get_reference_time();
+    for (unsigned i = 0; i < num_tasks; i++) {
+        xTaskCreate(contender, "contender", 0, (void *)(uintptr_t)(i + 1),
+                    TASK_PRIORITY, NULL);
+    }
+    for (unsigned i = 0; i < num_tasks; i++) {
+        int task_collisions;
+        xQueueReceive(done_queue, &task_collisions, portMAX_DELAY);
+        collisions += task_collisions;
+    }
+    ticks = get_reference_time() - time_start;
+
+    while (uxQueueMessagesWaiting(free_queue) > 0) {
+        bench_frame_t *frame;
+        xQueueReceive(free_queue, &frame, 0);
+    }
+
+    printf("%-12s %5u %12.1f %14.0f %10d %10u\n",
+           name, num_tasks,
+           ticks * 1e9 / PLATFORM_REFERENCE_HZ / ((double)iterations * num_tasks),
+           (double)iterations * num_tasks * PLATFORM_REFERENCE_HZ / ticks,
+           collisions,
+           (bench_alloc == ALLOC_FRAME_POOL) ? pool.max_in_use : 0);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned max_tasks;
+
+    iterations = (argc > 1) ? atoi(argv[1]) : 200000;
+    max_tasks = (argc > 2) ? atoi(argv[2]) : 8;
+    if (iterations == 0 || max_tasks == 0 || max_tasks > MAX_TASKS) {
+        fprintf(stderr, "Usage: %s [ITERATIONS] [MAX_TASKS <= %d]\n", argv[0], MAX_TASKS);
+        return 1;
+    }
+
+    host_rtos_tile_set(0);
+    free_queue = xQueueCreate(MAX_TASKS * FRAMES_PER_TASK, sizeof(bench_frame_t *));
+    done_queue = xQueueCreate(MAX_TASKS, sizeof(int));
+
+    printf("%u gets and releases of a %u byte frame per task\n",
+           iterations, (unsigned)sizeof(bench_frame_t));
+    printf("%-12s %5s %12s %14s %10s %10s\n",
+           "frames from", "tasks", "ns/frame", "frames/s", "collisions", "max held");
+    for (unsigned num_tasks = 1; num_tasks <= max_tasks; num_tasks *= 2) {
+        run(ALLOC_FRAME_POOL, "frame pool", num_tasks);
+        run(ALLOC_QUEUE, "queue", num_tasks);
+        run(ALLOC_HEAP, "heap", num_tasks);
+    }
+
+    return 0;
+}
@@ -0,0 +1,112 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the fixed block frame pool.
+ *
+ * A pool is emptied, checking that each frame is aligned, is whole, and
+ * does not overlap another, and that a get from the empty pool is counted.
+ * Frames are handed between owners and released out of order, and then
+ * every frame is got again, to check that none was lost or repeated.
+ *
+ * Usage: frame_pool_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame_pool.h"
+
+#define FRAME_BYTES     1001    /* Not a multiple of 8 */
+#define FRAME_COUNT     7
+
+enum {
+    OWNER_A = 1,
+    OWNER_B,
+};
+
+static FRAME_POOL_STORAGE(storage, FRAME_BYTES, FRAME_COUNT);
+static frame_pool_t pool;
+
+static bool check(bool ok, const char *what)
+{
+    printf("%s: %s\n", what, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+/* Gets every frame, filling each with its own number, and checks they are
+ * all distinct, aligned and unchanged by filling the others */
+static bool get_all(uint8_t *frames[FRAME_COUNT], unsigned owner)
+{
+    bool ok = true;
+
+    for (int i = 0; i < FRAME_COUNT; i++) {
+        frames[i] = frame_pool_get(&pool, owner);
+        ok = ok && (frames[i] != NULL) && (((uintptr_t)frames[i] & 7) == 0);
+        if (frames[i] != NULL) {
+            memset(frames[i], i, FRAME_BYTES);
+        }
+    }
+    for (int i = 0; ok && i < FRAME_COUNT; i++) {
+        for (int j = 0; j < FRAME_BYTES; j++) {
+            ok = ok && (frames[i][j] == i);
+        }
+    }
+
+    return ok;
+}
+
+int main(void)
+{
+    uint8_t *frames[FRAME_COUNT];
+    bool ok = true;
+
+    frame_pool_init(&pool, storage, FRAME_BYTES, FRAME_COUNT);
+
+    ok = check(get_all(frames, OWNER_A), "get every frame") && ok;
+    ok = check(frame_pool_get(&pool, OWNER_A) == NULL &&
+               frame_pool_get(&pool, OWNER_A) == NULL &&
+               pool.exhausted_count == 2, "get from an empty pool") && ok;
+    ok = check(pool.in_use == FRAME_COUNT &&
+               pool.max_in_use == FRAME_COUNT &&
+               pool.get_count == FRAME_COUNT, "counters when empty") && ok;
+
+    /* Hand the odd frames on, then release them all, evens first */
+    for (int i = 1; i < FRAME_COUNT; i += 2) {
+        frame_pool_transfer(frames[i], OWNER_A, OWNER_B);
+    }
+    for (int i = 0; i < FRAME_COUNT; i += 2) {
+        frame_pool_release(frames[i], OWNER_A);
+    }
+    ok = check(pool.in_use == FRAME_COUNT - (FRAME_COUNT + 1) / 2, "in use after release") && ok;
+    for (int i = FRAME_COUNT - 2; i > 0; i -= 2) {
+        frame_pool_release(frames[i], OWNER_B);
+    }
+    ok = check(pool.in_use == 0 && pool.max_in_use == FRAME_COUNT, "counters when full") && ok;
+
+    /* Every frame again, none twice, in whatever order the pool gives them */
+    {
+        uint8_t *again[FRAME_COUNT];
+        bool same = get_all(again, OWNER_B);
+
+        for (int i = 0; same && i < FRAME_COUNT; i++) {
+            int found = 0;
+            for (int j = 0; j < FRAME_COUNT; j++) {
+                found += (again[j] == frames[i]);
+            }
+            same = (found == 1);
+        }
+        ok = check(same, "get every frame again") && ok;
+        for (int i = 0; i < FRAME_COUNT; i++) {
+            frame_pool_release(again[i], OWNER_B);
+        }
+    }
+
+    ok = check(pool.get_count == 2 * FRAME_COUNT && pool.exhausted_count == 2, "counters at end") && ok;
+
+    printf("frame pool: %s\n", ok ? "PASS" : "FAIL");
+
+    return ok ? 0 : 1;
+}
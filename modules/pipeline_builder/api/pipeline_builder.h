@@ -0,0 +1,96 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef PIPELINE_BUILDER_H_
+#define PIPELINE_BUILDER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "generic_pipeline.h"
+
+/* A pipeline of stages, as generic_pipeline_init() makes, laid out on cores
+ * from an estimate of the cycles each stage takes per frame.
+ *
+ * Adjacent light stages are fused into one task, which runs them in turn,
+ * saving the queue between them and a context switch per frame. A stage
+ * is heavy if it takes more than heavy_percent of a core's cycles per
+ * frame, and is given a task of its own, pinned to a core of its own with
+ * vTaskCoreAffinitySet(). Light stages are fused while their total stays
+ * light, and their tasks may run on any of the pipeline's cores that no
+ * heavy stage is pinned to.
+ *
+ * A stage whose task blocks on I/O, such as the first, which runs input,
+ * or the last, which runs output, should set no_fuse. Such a stage is never
+ * fused with its neighbours. Otherwise the task would wait on the I/O and
+ * only then run the other stages, losing the overlap of the two.
+ *
+ * The pipeline has a task for each core in core_mask at most, unless its
+ * no_fuse stages need more. Should the stages need more, they are shared
+ * between that many tasks as evenly as adjacent stages allow. A schedule
+ * whose busiest task takes more than frame_cycles is reported not to fit.
+ *
+ * As with generic_pipeline_init(), the first task gets each frame from
+ * input, the last hands it to output, and frees it if output returns
+ * non-zero.
+ */
+
+/* The most stages in a pipeline */
+#define PIPELINE_BUILDER_MAX_STAGES     16
+
+typedef struct {
+    const char *name;
+    pipeline_stage_t function;
+    uint32_t cycles;            /* Estimated per frame */
+    size_t stack_size;          /* As for generic_pipeline_init(), including
+                                   input or output for the first or last */
+    int no_fuse;                /* Blocks on I/O, so has a task of its own */
+} pipeline_builder_stage_t;
+
+typedef struct {
+    uint32_t frame_cycles;      /* Each core's cycles per frame */
+    uint32_t core_mask;         /* Cores the pipeline may run on */
+    unsigned heavy_percent;     /* Of frame_cycles, above which a stage is pinned */
+    unsigned priority;
+    /* Called, if not NULL, as each stage starts and finishes each frame,
+     * with the stage's number, e.g. to mark the frame's trail */
+    void (*stage_mark)(void *frame, unsigned stage, int finished);
+} pipeline_builder_config_t;
+
+typedef struct {
+    unsigned first_stage;
+    unsigned stage_count;
+    uint32_t cycles;            /* Of all its stages */
+    uint32_t core_mask;         /* Its affinity */
+    int pinned;
+    size_t stack_size;
+} pipeline_builder_task_plan_t;
+
+typedef struct {
+    unsigned task_count;
+    int fits;                   /* Every task within frame_cycles */
+    pipeline_builder_task_plan_t tasks[PIPELINE_BUILDER_MAX_STAGES];
+} pipeline_builder_schedule_t;
+
+/* Lay out stage_count stages on tasks and cores */
+void pipeline_builder_plan(pipeline_builder_schedule_t *schedule,
+                           const pipeline_builder_stage_t *stages,
+                           unsigned stage_count,
+                           const pipeline_builder_config_t *config);
+
+/* Print a schedule with rtos_printf() */
+void pipeline_builder_print(const pipeline_builder_schedule_t *schedule,
+                            const pipeline_builder_stage_t *stages,
+                            const pipeline_builder_config_t *config);
+
+/* Plan, print and start a pipeline. The stages are copied, so need not
+ * outlive the call. */
+void pipeline_builder_init(const pipeline_input_t input,
+                           const pipeline_output_t output,
+                           void * const input_data,
+                           void * const output_data,
+                           const pipeline_builder_stage_t *stages,
+                           unsigned stage_count,
+                           const pipeline_builder_config_t *config);
+
+#endif /* PIPELINE_BUILDER_H_ */
@@ -0,0 +1,287 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <stdint.h>
+#include <stddef.h>
+
+/* FreeRTOS headers */
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+/* Library headers */
+#include "generic_pipeline.h"
+#include "pipeline_builder.h"
+
+/* Frames queued between tasks, as between generic_pipeline's stages */
+#define PIPELINE_BUILDER_QUEUE_LENGTH   2
+
+typedef struct {
+    pipeline_input_t input;
+    pipeline_output_t output;
+    void *input_data;
+    void *output_data;
+    pipeline_stage_t functions[PIPELINE_BUILDER_MAX_STAGES];
+    unsigned first_stage;
+    unsigned stage_count;
+    void (*stage_mark)(void *frame, unsigned stage, int finished);
+    QueueHandle_t input_queue;      /* NULL for the first task */
+    QueueHandle_t output_queue;     /* NULL for the last task */
+} pipeline_builder_task_ctx_t;
+
+static unsigned core_count(uint32_t core_mask)
+{
+    unsigned count = 0;
+
+    for (; core_mask != 0; core_mask &= core_mask - 1) {
+        count++;
+    }
+
+    return count;
+}
+
+static int cycles_heavy(uint64_t cycles, const pipeline_builder_config_t *config)
+{
+    return cycles * 100 > (uint64_t)config->frame_cycles * config->heavy_percent;
+}
+
+/* Whether stage may join the task of the stage before it */
+static int stage_fusable(const pipeline_builder_stage_t *stages, unsigned stage)
+{
+    return (stage > 0) && !stages[stage].no_fuse && !stages[stage - 1].no_fuse;
+}
+
+static void task_add_stage(pipeline_builder_schedule_t *schedule,
+                           const pipeline_builder_stage_t *stages,
+                           unsigned stage,
+                           int new_task)
+{
+    pipeline_builder_task_plan_t *task;
+
+    if (new_task) {
+        task = &schedule->tasks[schedule->task_count++];
+        task->first_stage = stage;
+        task->stage_count = 0;
+        task->cycles = 0;
+        task->stack_size = 0;
+    } else {
+        task = &schedule->tasks[schedule->task_count - 1];
+    }
+
+    task->stage_count++;
+    task->cycles += stages[stage].cycles;
+    if (stages[stage].stack_size > task->stack_size) {
+        task->stack_size = stages[stage].stack_size;
+    }
+}
+
+/* Fuses adjacent light stages, other than no_fuse ones, while they stay light */
+static void plan_fused(pipeline_builder_schedule_t *schedule,
+                       const pipeline_builder_stage_t *stages,
+                       unsigned stage_count,
+                       const pipeline_builder_config_t *config)
+{
+    schedule->task_count = 0;
+
+    for (unsigned i = 0; i < stage_count; i++) {
+        const int fuse = stage_fusable(stages, i) &&
+                !cycles_heavy((uint64_t)schedule->tasks[schedule->task_count - 1].cycles + stages[i].cycles, config);
+
+        task_add_stage(schedule, stages, i, !fuse);
+    }
+}
+
+/* Fuses adjacent stages, other than no_fuse ones, while they take no more
+ * than limit cycles */
+static void plan_limited(pipeline_builder_schedule_t *schedule,
+                         const pipeline_builder_stage_t *stages,
+                         unsigned stage_count,
+                         uint64_t limit)
+{
+    schedule->task_count = 0;
+
+    for (unsigned i = 0; i < stage_count; i++) {
+        const int fuse = stage_fusable(stages, i) &&
+                ((uint64_t)schedule->tasks[schedule->task_count - 1].cycles + stages[i].cycles <= limit);
+
+        task_add_stage(schedule, stages, i, !fuse);
+    }
+}
+
+void pipeline_builder_plan(pipeline_builder_schedule_t *schedule,
+                           const pipeline_builder_stage_t *stages,
+                           unsigned stage_count,
+                           const pipeline_builder_config_t *config)
+{
+    const unsigned cores = core_count(config->core_mask);
+    uint32_t free_cores = config->core_mask;
+    uint32_t light_cores;
+
+    xassert(stage_count > 0 && stage_count <= PIPELINE_BUILDER_MAX_STAGES);
+    xassert(cores > 0 && config->frame_cycles > 0);
+
+    plan_fused(schedule, stages, stage_count, config);
+
+    if (schedule->task_count > cores) {
+        /* Too few cores, so find the least that the busiest of that many
+         * tasks, or of as few as the no_fuse stages allow, can be held to */
+        uint64_t lo = 0;
+        uint64_t hi = 0;
+
+        for (unsigned i = 0; i < stage_count; i++) {
+            lo = (stages[i].cycles > lo) ? stages[i].cycles : lo;
+            hi += stages[i].cycles;
+        }
+        while (lo < hi) {
+            const uint64_t mid = lo + (hi - lo) / 2;
+
+            plan_limited(schedule, stages, stage_count, mid);
+            if (schedule->task_count <= cores) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        plan_limited(schedule, stages, stage_count, lo);
+    }
+
+    /* Each heavy task gets a core of its own, the rest share the others */
+    schedule->fits = 1;
+    for (unsigned t = 0; t < schedule->task_count; t++) {
+        pipeline_builder_task_plan_t *task = &schedule->tasks[t];
+
+        task->pinned = cycles_heavy(task->cycles, config) && (free_cores != 0);
+        if (task->pinned) {
+            task->core_mask = free_cores & -free_cores;
+            free_cores &= ~task->core_mask;
+        }
+        if (task->cycles > config->frame_cycles) {
+            schedule->fits = 0;
+        }
+    }
+
+    light_cores = (free_cores != 0) ? free_cores : config->core_mask;
+    for (unsigned t = 0; t < schedule->task_count; t++) {
+        if (!schedule->tasks[t].pinned) {
+            schedule->tasks[t].core_mask = light_cores;
+        }
+    }
+}
+
+void pipeline_builder_print(const pipeline_builder_schedule_t *schedule,
+                            const pipeline_builder_stage_t *stages,
+                            const pipeline_builder_config_t *config)
+{
+    unsigned stage_count = 0;
+
+    for (unsigned t = 0; t < schedule->task_count; t++) {
+        stage_count += schedule->tasks[t].stage_count;
+    }
+
+    rtos_printf("Pipeline of %u stages in %u tasks, on cores 0x%x, of %u cycles per frame%s\n",
+                stage_count,
+                schedule->task_count,
+                config->core_mask,
+                config->frame_cycles,
+                schedule->fits ? "" : ", does not fit");
+
+    for (unsigned t = 0; t < schedule->task_count; t++) {
+        const pipeline_builder_task_plan_t *task = &schedule->tasks[t];
+
+        rtos_printf("  task %u: ", t);
+        for (unsigned i = 0; i < task->stage_count; i++) {
+            rtos_printf("%s%s", (i > 0) ? "+" : "", stages[task->first_stage + i].name);
+        }
+        rtos_printf(", %u cycles, %u%% of a frame, %s 0x%x\n",
+                    task->cycles,
+                    (unsigned)((uint64_t)task->cycles * 100 / config->frame_cycles),
+                    task->pinned ? "pinned to core" : "on cores",
+                    task->core_mask);
+    }
+}
+
+static void pipeline_builder_task(pipeline_builder_task_ctx_t *ctx)
+{
+    void *data;
+
+    for (;;) {
+        if (ctx->input_queue == NULL) {
+            data = ctx->input(ctx->input_data);
+        } else {
+            xQueueReceive(ctx->input_queue, &data, portMAX_DELAY);
+        }
+
+        for (unsigned i = 0; i < ctx->stage_count; i++) {
+            if (ctx->stage_mark != NULL) {
+                ctx->stage_mark(data, ctx->first_stage + i, 0);
+            }
+            ctx->functions[i](data);
+            if (ctx->stage_mark != NULL) {
+                ctx->stage_mark(data, ctx->first_stage + i, 1);
+            }
+        }
+
+        if (ctx->output_queue == NULL) {
+            if (ctx->output(data, ctx->output_data)) {
+                vPortFree(data);
+            }
+        } else {
+            xQueueSend(ctx->output_queue, &data, portMAX_DELAY);
+        }
+    }
+}
+
+void pipeline_builder_init(const pipeline_input_t input,
+                           const pipeline_output_t output,
+                           void * const input_data,
+                           void * const output_data,
+                           const pipeline_builder_stage_t *stages,
+                           unsigned stage_count,
+                           const pipeline_builder_config_t *config)
+{
+    pipeline_builder_schedule_t schedule;
+    pipeline_builder_task_ctx_t *ctx;
+
+    pipeline_builder_plan(&schedule, stages, stage_count, config);
+    pipeline_builder_print(&schedule, stages, config);
+
+    ctx = pvPortMalloc(schedule.task_count * sizeof(pipeline_builder_task_ctx_t));
+    xassert(ctx != NULL);
+
+    for (unsigned t = 0; t < schedule.task_count; t++) {
+        const pipeline_builder_task_plan_t *task = &schedule.tasks[t];
+
+        ctx[t].input = input;
+        ctx[t].output = output;
+        ctx[t].input_data = input_data;
+        ctx[t].output_data = output_data;
+        ctx[t].first_stage = task->first_stage;
+        ctx[t].stage_count = task->stage_count;
+        ctx[t].stage_mark = config->stage_mark;
+        for (unsigned i = 0; i < task->stage_count; i++) {
+            ctx[t].functions[i] = stages[task->first_stage + i].function;
+        }
+        ctx[t].input_queue = NULL;
+        ctx[t].output_queue = NULL;
+
+        if (t > 0) {
+            ctx[t].input_queue = xQueueCreate(PIPELINE_BUILDER_QUEUE_LENGTH, sizeof(void *));
+            xassert(ctx[t].input_queue != NULL);
+            ctx[t - 1].output_queue = ctx[t].input_queue;
+        }
+    }
+
+    for (unsigned t = 0; t < schedule.task_count; t++) {
+        TaskHandle_t task_handle;
+
+        xTaskCreate((TaskFunction_t)pipeline_builder_task,
+                    stages[schedule.tasks[t].first_stage].name,
+                    schedule.tasks[t].stack_size,
+                    &ctx[t],
+                    config->priority,
+                    &task_handle);
+
+        vTaskCoreAffinitySet(task_handle, schedule.tasks[t].core_mask);
+    }
+}
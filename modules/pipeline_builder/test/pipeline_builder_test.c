@@ -0,0 +1,230 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of the pipeline builder.
+ *
+ * Schedules are planned for light stages, which are fused into one task,
+ * for heavy stages among light ones, which are pinned to cores of their
+ * own, for stages that need more cores than they are given, and for
+ * stages that block on I/O, which are never fused. Then a
+ * pipeline is built, over the host RTOS shim, and frames are passed
+ * through it, checking that every stage ran on every frame, in order,
+ * and that each stage's start and finish were marked around it.
+ *
+ * Usage: pipeline_builder_test
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "queue.h"
+
+#include "pipeline_builder.h"
+
+#define FRAME_CYCLES    1000
+#define RUN_FRAMES      1000
+#define RUN_STAGES      4
+
+typedef struct {
+    unsigned seq;
+    unsigned stages_run;
+    unsigned trail[RUN_STAGES];
+    unsigned marks;             /* Of stages started and finished, in order */
+} test_frame_t;
+
+static QueueHandle_t done_queue;
+static unsigned frames_out;
+static unsigned frames_bad;
+
+static bool check(bool ok, const char *what)
+{
+    printf("%s: %s\n", what, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+static bool task_is(const pipeline_builder_task_plan_t *task,
+                    unsigned first_stage,
+                    unsigned stage_count,
+                    uint32_t cycles,
+                    uint32_t core_mask,
+                    int pinned)
+{
+    return task->first_stage == first_stage &&
+           task->stage_count == stage_count &&
+           task->cycles == cycles &&
+           task->core_mask == core_mask &&
+           task->pinned == pinned;
+}
+
+static void *test_input(void *input_data)
+{
+    static unsigned seq;
+    test_frame_t *frame;
+
+    (void) input_data;
+
+    if (seq == RUN_FRAMES) {
+        for (;;) {
+            vTaskDelay(portMAX_DELAY);
+        }
+    }
+
+    frame = pvPortMalloc(sizeof(test_frame_t));
+    xassert(frame != NULL);
+    frame->seq = seq++;
+    frame->stages_run = 0;
+    frame->marks = 0;
+
+    return frame;
+}
+
+static int test_output(void *data, void *output_data)
+{
+    test_frame_t *frame = data;
+    bool ok = (frame->seq == frames_out) && (frame->stages_run == RUN_STAGES) &&
+              (frame->marks == 2 * RUN_STAGES);
+
+    (void) output_data;
+
+    for (unsigned i = 0; ok && i < RUN_STAGES; i++) {
+        ok = (frame->trail[i] == i);
+    }
+    frames_bad += !ok;
+
+    if (++frames_out == RUN_FRAMES) {
+        int done = 1;
+        xQueueSend(done_queue, &done, portMAX_DELAY);
+    }
+
+    return 1;
+}
+
+#define TEST_STAGE(n) \
+    static void test_stage##n(test_frame_t *frame) \
+    { \
+        frame->trail[frame->stages_run++] = n; \
+    }
+
+/* Counts each start and finish, if it is the next expected */
+static void test_stage_mark(void *data, unsigned stage, int finished)
+{
+    test_frame_t *frame = data;
+
+    if (frame->marks == 2 * stage + (finished ? 1 : 0) &&
+        frame->stages_run == stage + (finished ? 1 : 0)) {
+        frame->marks++;
+    }
+}
+
+TEST_STAGE(0)
+TEST_STAGE(1)
+TEST_STAGE(2)
+TEST_STAGE(3)
+
+int main(void)
+{
+    pipeline_builder_schedule_t schedule;
+    pipeline_builder_config_t config = {
+        .frame_cycles = FRAME_CYCLES,
+        .core_mask = 0x0F,
+        .heavy_percent = 50,
+        .priority = 1,
+    };
+    bool ok = true;
+
+    {
+        const pipeline_builder_stage_t stages[] = {
+            { "a", NULL, 100, 300 },
+            { "b", NULL, 100, 500 },
+            { "c", NULL, 100, 400 },
+        };
+
+        pipeline_builder_plan(&schedule, stages, 3, &config);
+        pipeline_builder_print(&schedule, stages, &config);
+        ok = check(schedule.task_count == 1 && schedule.fits &&
+                   task_is(&schedule.tasks[0], 0, 3, 300, 0x0F, 0) &&
+                   schedule.tasks[0].stack_size == 500, "light stages fused") && ok;
+    }
+
+    {
+        const pipeline_builder_stage_t stages[] = {
+            { "a", NULL, 100, 300 },
+            { "b", NULL, 200, 300 },
+            { "heavy0", NULL, 600, 300 },
+            { "c", NULL, 100, 300 },
+            { "heavy1", NULL, 700, 300 },
+        };
+
+        pipeline_builder_plan(&schedule, stages, 5, &config);
+        pipeline_builder_print(&schedule, stages, &config);
+        ok = check(schedule.task_count == 4 && schedule.fits &&
+                   task_is(&schedule.tasks[0], 0, 2, 300, 0x0C, 0) &&
+                   task_is(&schedule.tasks[1], 2, 1, 600, 0x01, 1) &&
+                   task_is(&schedule.tasks[2], 3, 1, 100, 0x0C, 0) &&
+                   task_is(&schedule.tasks[3], 4, 1, 700, 0x02, 1), "heavy stages pinned") && ok;
+
+        /* On two cores the split with the least busy task is 900 and 800 */
+        config.core_mask = 0x30;
+        pipeline_builder_plan(&schedule, stages, 5, &config);
+        pipeline_builder_print(&schedule, stages, &config);
+        ok = check(schedule.task_count == 2 && schedule.fits &&
+                   task_is(&schedule.tasks[0], 0, 3, 900, 0x10, 1) &&
+                   task_is(&schedule.tasks[1], 3, 2, 800, 0x20, 1), "stages shared by too few cores") && ok;
+
+        config.core_mask = 0x01;
+        pipeline_builder_plan(&schedule, stages, 5, &config);
+        pipeline_builder_print(&schedule, stages, &config);
+        ok = check(schedule.task_count == 1 && !schedule.fits &&
+                   task_is(&schedule.tasks[0], 0, 5, 1700, 0x01, 1), "stages that do not fit") && ok;
+    }
+
+    {
+        const pipeline_builder_stage_t stages[] = {
+            { "in", NULL, 100, 300, 1 },
+            { "a", NULL, 100, 300 },
+            { "b", NULL, 100, 300 },
+            { "out", NULL, 100, 300, 1 },
+        };
+
+        config.core_mask = 0x0F;
+        pipeline_builder_plan(&schedule, stages, 4, &config);
+        pipeline_builder_print(&schedule, stages, &config);
+        ok = check(schedule.task_count == 3 && schedule.fits &&
+                   task_is(&schedule.tasks[0], 0, 1, 100, 0x0F, 0) &&
+                   task_is(&schedule.tasks[1], 1, 2, 200, 0x0F, 0) &&
+                   task_is(&schedule.tasks[2], 3, 1, 100, 0x0F, 0), "I/O stages not fused") && ok;
+
+        /* They keep their own tasks even when there are too few cores */
+        config.core_mask = 0x01;
+        pipeline_builder_plan(&schedule, stages, 4, &config);
+        pipeline_builder_print(&schedule, stages, &config);
+        ok = check(schedule.task_count == 3 && schedule.fits &&
+                   task_is(&schedule.tasks[1], 1, 2, 200, 0x01, 0), "I/O stages not fused on too few cores") && ok;
+    }
+
+    {
+        const pipeline_builder_stage_t stages[RUN_STAGES] = {
+            { "stage0", (pipeline_stage_t)test_stage0, 10, 0 },
+            { "stage1", (pipeline_stage_t)test_stage1, 10, 0 },
+            { "stage2", (pipeline_stage_t)test_stage2, 900, 0 },
+            { "stage3", (pipeline_stage_t)test_stage3, 10, 0 },
+        };
+        int done;
+
+        host_rtos_tile_set(0);
+        done_queue = xQueueCreate(1, sizeof(int));
+        config.core_mask = 0x0F;
+        config.stage_mark = test_stage_mark;
+        pipeline_builder_init(test_input, test_output, NULL, NULL, stages, RUN_STAGES, &config);
+        xQueueReceive(done_queue, &done, portMAX_DELAY);
+        ok = check(frames_out == RUN_FRAMES && frames_bad == 0, "frames through every stage in order") && ok;
+    }
+
+    printf("pipeline builder: %s\n", ok ? "PASS" : "FAIL");
+
+    return ok ? 0 : 1;
+}
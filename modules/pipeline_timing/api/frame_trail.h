@@ -0,0 +1,77 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef FRAME_TRAIL_H_
+#define FRAME_TRAIL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "stage_timing.h"
+
+/* The times a frame passed each point of a pipeline, carried in the frame.
+ *
+ * The application numbers the points a frame passes, e.g. its input, the
+ * start and end of each stage, and its output, and marks each with the
+ * reference timer as the frame passes it. As the reference timer is shared
+ * by the tiles, a trail may cross from one tile to the other with the
+ * frame. A mark is a store of a byte and a word, and a frame marked more
+ * than FRAME_TRAIL_MAX_POINTS times keeps its first marks and is counted
+ * as dropped by the collector.
+ *
+ * A collector takes the trails of frames at the end of the pipeline and
+ * records, in a stage_timing_t for each point, the time from the point
+ * before to that point, so that the time a frame waited before a stage is
+ * told apart from the time the stage took. It also records the time from
+ * the first point to the last.
+ *
+ * These functions have no RTOS dependencies, and take the time as an
+ * argument, so build and can be tested on the host.
+ */
+
+#define FRAME_TRAIL_MAX_POINTS      16
+
+typedef struct {
+    uint32_t count;                         /* Marks made, including any that did not fit */
+    uint8_t point[FRAME_TRAIL_MAX_POINTS];
+    uint32_t time[FRAME_TRAIL_MAX_POINTS];  /* Reference timer ticks */
+} frame_trail_t;
+
+typedef struct {
+    const char *name;
+    unsigned tile;
+} frame_trail_point_t;
+
+typedef struct {
+    unsigned point_count;
+    uint32_t dropped;           /* Trails that overflowed or had an unknown point */
+    stage_timing_t end_to_end;  /* From the first point to the last */
+    stage_timing_t to_point[FRAME_TRAIL_MAX_POINTS];    /* From the point before */
+} frame_trail_collector_t;
+
+static inline void frame_trail_start(frame_trail_t *trail)
+{
+    trail->count = 0;
+}
+
+static inline void frame_trail_mark(frame_trail_t *trail, unsigned point, uint32_t now)
+{
+    if (trail->count < FRAME_TRAIL_MAX_POINTS) {
+        trail->point[trail->count] = point;
+        trail->time[trail->count] = now;
+    }
+    trail->count++;
+}
+
+/* Start a collector for point_count points, named for the report */
+void frame_trail_collector_init(frame_trail_collector_t *collector,
+                                const frame_trail_point_t *points,
+                                unsigned point_count);
+
+/* Clear the samples, keeping the names */
+void frame_trail_collector_reset(frame_trail_collector_t *collector);
+
+/* Record a frame's trail */
+void frame_trail_collect(frame_trail_collector_t *collector, const frame_trail_t *trail);
+
+#endif /* FRAME_TRAIL_H_ */
@@ -0,0 +1,89 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+#ifndef STAGE_TIMING_H_
+#define STAGE_TIMING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* In-memory timing of pipeline stages, one record per frame.
+ *
+ * Each stage_timing_t keeps the count, min, max and total of its samples,
+ * in reference timer ticks, and a histogram from which percentiles are
+ * read. The histogram has 8 bins per power of two, so a bin spans at most
+ * 1/8 of its lower bound and every 32 bit time has a bin. Recording a
+ * sample is a fixed handful of operations, with no division or search.
+ *
+ * The records are written at end of stream in the binary layout below:
+ * a stage_timing_file_header_t, then num_stages stage_timing_t. All fields
+ * are little endian.
+ *
+ * These functions have no RTOS dependencies and build on the host.
+ */
+
+#define STAGE_TIMING_SUB_BINS       8
+#define STAGE_TIMING_BINS           240     /* (32 - 2) * STAGE_TIMING_SUB_BINS */
+#define STAGE_TIMING_NAME_BYTES     32
+
+#define STAGE_TIMING_FILE_MAGIC     0x474D5453  /* "STMG" */
+#define STAGE_TIMING_FILE_VERSION   1
+
+typedef struct {
+    char name[STAGE_TIMING_NAME_BYTES];
+    uint32_t tile;
+    uint32_t count;
+    uint32_t min_ticks;
+    uint32_t max_ticks;
+    uint64_t total_ticks;
+    uint32_t hist[STAGE_TIMING_BINS];
+} stage_timing_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t reference_hz;      /* Ticks per second */
+    uint32_t frame_advance;     /* Samples per channel per frame */
+    uint32_t sample_rate;       /* Of the stream, for the frame budget */
+    uint32_t num_bins;
+    uint32_t num_stages;
+    uint32_t record_bytes;      /* sizeof(stage_timing_t) */
+} stage_timing_file_header_t;
+
+void stage_timing_init(stage_timing_t *timing, const char *name, unsigned tile);
+
+/* Clear the samples, keeping the name and tile */
+void stage_timing_reset(stage_timing_t *timing);
+
+/* Histogram bin of a time in ticks */
+static inline unsigned stage_timing_bin(uint32_t ticks)
+{
+    if (ticks < STAGE_TIMING_SUB_BINS) {
+        return ticks;
+    } else {
+        /* Octave from the leading one, then the next 3 bits */
+        const unsigned msb = 31 - __builtin_clz(ticks);
+        return (msb - 2) * STAGE_TIMING_SUB_BINS + ((ticks >> (msb - 3)) & (STAGE_TIMING_SUB_BINS - 1));
+    }
+}
+
+static inline void stage_timing_record(stage_timing_t *timing, uint32_t ticks)
+{
+    timing->count++;
+    timing->total_ticks += ticks;
+    timing->min_ticks = (ticks < timing->min_ticks) ? ticks : timing->min_ticks;
+    timing->max_ticks = (ticks > timing->max_ticks) ? ticks : timing->max_ticks;
+    timing->hist[stage_timing_bin(ticks)]++;
+}
+
+/* Smallest and largest times, in ticks, that fall in bin */
+uint32_t stage_timing_bin_lower(unsigned bin);
+uint32_t stage_timing_bin_upper(unsigned bin);
+
+/* Upper bound, in ticks, of the permille'th per mille of the samples, e.g.
+ * 990 for the 99th percentile. Never more than the largest sample. */
+uint32_t stage_timing_percentile(const stage_timing_t *timing, unsigned permille);
+
+uint32_t stage_timing_mean(const stage_timing_t *timing);
+
+#endif /* STAGE_TIMING_H_ */
@@ -0,0 +1,55 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <stdint.h>
+
+/* Library headers */
+#include "stage_timing.h"
+#include "frame_trail.h"
+
+void frame_trail_collector_init(frame_trail_collector_t *collector,
+                                const frame_trail_point_t *points,
+                                unsigned point_count)
+{
+    if (point_count > FRAME_TRAIL_MAX_POINTS) {
+        point_count = FRAME_TRAIL_MAX_POINTS;
+    }
+
+    collector->point_count = point_count;
+    collector->dropped = 0;
+    stage_timing_init(&collector->end_to_end, "end to end", 0);
+    for (unsigned i = 0; i < point_count; i++) {
+        stage_timing_init(&collector->to_point[i], points[i].name, points[i].tile);
+    }
+}
+
+void frame_trail_collector_reset(frame_trail_collector_t *collector)
+{
+    collector->dropped = 0;
+    stage_timing_reset(&collector->end_to_end);
+    for (unsigned i = 0; i < collector->point_count; i++) {
+        stage_timing_reset(&collector->to_point[i]);
+    }
+}
+
+void frame_trail_collect(frame_trail_collector_t *collector, const frame_trail_t *trail)
+{
+    if (trail->count == 0 || trail->count > FRAME_TRAIL_MAX_POINTS) {
+        collector->dropped++;
+        return;
+    }
+    for (unsigned i = 0; i < trail->count; i++) {
+        if (trail->point[i] >= collector->point_count) {
+            collector->dropped++;
+            return;
+        }
+    }
+
+    /* Differences of the 32 bit times are right across a wrap */
+    for (unsigned i = 1; i < trail->count; i++) {
+        stage_timing_record(&collector->to_point[trail->point[i]],
+                            trail->time[i] - trail->time[i - 1]);
+    }
+    stage_timing_record(&collector->end_to_end, trail->time[trail->count - 1] - trail->time[0]);
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/* STD headers */
+#include <stdint.h>
+#include <string.h>
+
+/* Library headers */
+#include "stage_timing.h"
+
+void stage_timing_init(stage_timing_t *timing, const char *name, unsigned tile)
+{
+    memset(timing, 0, sizeof(stage_timing_t));
+    strncpy(timing->name, name, STAGE_TIMING_NAME_BYTES - 1);
+    timing->tile = tile;
+    timing->min_ticks = UINT32_MAX;
+}
+
+void stage_timing_reset(stage_timing_t *timing)
+{
+    timing->count = 0;
+    timing->min_ticks = UINT32_MAX;
+    timing->max_ticks = 0;
+    timing->total_ticks = 0;
+    memset(timing->hist, 0, sizeof(timing->hist));
+}
+
+uint32_t stage_timing_bin_lower(unsigned bin)
+{
+    if (bin < STAGE_TIMING_SUB_BINS) {
+        return bin;
+    } else {
+        const unsigned octave = bin / STAGE_TIMING_SUB_BINS;
+        const uint32_t sub_bin = bin % STAGE_TIMING_SUB_BINS;
+        return (STAGE_TIMING_SUB_BINS + sub_bin) << (octave - 1);
+    }
+}
+
+uint32_t stage_timing_bin_upper(unsigned bin)
+{
+    if (bin < STAGE_TIMING_SUB_BINS) {
+        return bin;
+    } else {
+        const unsigned octave = bin / STAGE_TIMING_SUB_BINS;
+        return stage_timing_bin_lower(bin) + ((1u << (octave - 1)) - 1);
+    }
+}
+
+uint32_t stage_timing_percentile(const stage_timing_t *timing, unsigned permille)
+{
+    /* Samples at or below the percentile, rounded up */
+    const uint64_t target = ((uint64_t)timing->count * permille + 999) / 1000;
+    uint64_t seen = 0;
+
+    if (timing->count == 0) {
+        return 0;
+    }
+
+    for (unsigned bin = 0; bin < STAGE_TIMING_BINS; bin++) {
+        seen += timing->hist[bin];
+        if (seen >= target && seen > 0) {
+            const uint32_t upper = stage_timing_bin_upper(bin);
+            return (upper < timing->max_ticks) ? upper : timing->max_ticks;
+        }
+    }
+
+    return timing->max_ticks;
+}
+
+uint32_t stage_timing_mean(const stage_timing_t *timing)
+{
+    if (timing->count == 0) {
+        return 0;
+    }
+
+    return (uint32_t)(timing->total_ticks / timing->count);
+}
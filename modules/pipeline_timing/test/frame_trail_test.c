@@ -0,0 +1,140 @@
+// Copyright (c) 2022 XMOS LIMITED. This Software is subject to the terms of the
+// XMOS Public License: Version 1
+
+/*
+ * Test of frame trails and their collector, on an emulated clock.
+ *
+ * Frames pass an input, the start and end of a stage, an intertile
+ * receive and an output, each a known time after the one before, with one
+ * frame kept waiting before the stage. The clock starts just short of
+ * wrapping, so that the frames' times wrap. The time to each point, and
+ * from end to end, is checked, as is the dropping of a trail that
+ * overflowed or has a point the collector does not know.
+ *
+ * Usage: frame_trail_test
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "stage_timing.h"
+#include "frame_trail.h"
+
+#define FRAMES          100
+#define SLOW_FRAME      42
+
+enum {
+    POINT_INPUT,
+    POINT_STAGE_START,
+    POINT_STAGE_END,
+    POINT_LINK_RX,
+    POINT_OUTPUT,
+    POINT_COUNT
+};
+
+static const frame_trail_point_t points[POINT_COUNT] = {
+    { "input", 1 },
+    { "stage start", 1 },
+    { "stage end", 1 },
+    { "link rx", 0 },
+    { "output", 0 },
+};
+
+/* Ticks from the point before, of every frame but the slow one */
+static const uint32_t ticks_to[POINT_COUNT] = { 0, 100, 200, 300, 50 };
+#define SLOW_WAIT_TICKS 5000
+
+static uint32_t clock_now;
+static frame_trail_collector_t collector;
+
+static bool check(bool ok, const char *what)
+{
+    printf("%s: %s\n", what, ok ? "PASS" : "FAIL");
+    return ok;
+}
+
+static bool timing_is(const stage_timing_t *t, uint32_t count, uint32_t min, uint32_t max)
+{
+    return t->count == count && t->min_ticks == min && t->max_ticks == max;
+}
+
+/* Passes a frame through every point, the emulated clock advancing between
+ * them. After the stage the trail is copied, as the frame link copies the
+ * frame, and the rest of the points are marked on the copy. */
+static void run_frame(unsigned frame)
+{
+    frame_trail_t sent;
+    frame_trail_t received;
+    frame_trail_t *trail = &sent;
+
+    frame_trail_start(trail);
+    for (unsigned p = 0; p < POINT_COUNT; p++) {
+        clock_now += ticks_to[p];
+        if (p == POINT_STAGE_START && frame == SLOW_FRAME) {
+            clock_now += SLOW_WAIT_TICKS - ticks_to[p];
+        }
+        if (p == POINT_LINK_RX) {
+            memcpy(&received, &sent, sizeof(sent));
+            trail = &received;
+        }
+        frame_trail_mark(trail, p, clock_now);
+    }
+
+    frame_trail_collect(&collector, trail);
+}
+
+int main(void)
+{
+    const uint32_t end_to_end = 100 + 200 + 300 + 50;
+    bool ok = true;
+
+    frame_trail_collector_init(&collector, points, POINT_COUNT);
+
+    clock_now = UINT32_MAX - 50000;
+    for (unsigned i = 0; i < FRAMES; i++) {
+        run_frame(i);
+    }
+
+    ok = check(collector.to_point[POINT_INPUT].count == 0 && collector.dropped == 0, "nothing before the first point") && ok;
+    ok = check(timing_is(&collector.to_point[POINT_STAGE_START], FRAMES, 100, SLOW_WAIT_TICKS) &&
+               stage_timing_percentile(&collector.to_point[POINT_STAGE_START], 500) == stage_timing_bin_upper(stage_timing_bin(100)) &&
+               stage_timing_percentile(&collector.to_point[POINT_STAGE_START], 1000) == SLOW_WAIT_TICKS,
+               "waiting before the stage") && ok;
+    ok = check(timing_is(&collector.to_point[POINT_STAGE_END], FRAMES, 200, 200) &&
+               timing_is(&collector.to_point[POINT_LINK_RX], FRAMES, 300, 300) &&
+               timing_is(&collector.to_point[POINT_OUTPUT], FRAMES, 50, 50), "stage, link and output") && ok;
+    ok = check(timing_is(&collector.end_to_end, FRAMES, end_to_end, end_to_end + SLOW_WAIT_TICKS - 100) &&
+               stage_timing_mean(&collector.end_to_end) == end_to_end + (SLOW_WAIT_TICKS - 100) / FRAMES,
+               "end to end across the clock wrapping") && ok;
+    ok = check(strcmp(collector.to_point[POINT_LINK_RX].name, "link rx") == 0 &&
+               collector.to_point[POINT_LINK_RX].tile == 0, "point names and tiles") && ok;
+
+    {
+        frame_trail_t trail;
+
+        frame_trail_start(&trail);
+        for (unsigned i = 0; i <= FRAME_TRAIL_MAX_POINTS; i++) {
+            frame_trail_mark(&trail, POINT_INPUT, i);
+        }
+        frame_trail_collect(&collector, &trail);
+
+        frame_trail_start(&trail);
+        frame_trail_mark(&trail, POINT_INPUT, 0);
+        frame_trail_mark(&trail, POINT_COUNT, 10);
+        frame_trail_collect(&collector, &trail);
+
+        ok = check(collector.dropped == 2 && collector.end_to_end.count == FRAMES &&
+                   collector.to_point[POINT_INPUT].count == 0, "overflowed and unknown trails dropped") && ok;
+    }
+
+    frame_trail_collector_reset(&collector);
+    ok = check(collector.dropped == 0 && collector.end_to_end.count == 0 &&
+               collector.to_point[POINT_OUTPUT].count == 0 &&
+               strcmp(collector.to_point[POINT_OUTPUT].name, "output") == 0, "reset") && ok;
+
+    printf("frame trail: %s\n", ok ? "PASS" : "FAIL");
+
+    return ok ? 0 : 1;
+}
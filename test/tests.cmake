@@ -1,3 +1,9 @@
 if(${CMAKE_SYSTEM_NAME} STREQUAL XCORE_XS3A)
     include(${CMAKE_CURRENT_LIST_DIR}/usb/usb.cmake)
+else()
+    ## Host tests of the modules, run with ctest
+    enable_testing()
+    add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/../modules/frame_pool/test ${CMAKE_BINARY_DIR}/test/frame_pool)
+    add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/../modules/pipeline_builder/test ${CMAKE_BINARY_DIR}/test/pipeline_builder)
+    add_subdirectory(${CMAKE_CURRENT_LIST_DIR}/../modules/pipeline_timing/test ${CMAKE_BINARY_DIR}/test/pipeline_timing)
 endif()
@@ -16,6 +16,8 @@ applications=(
     "datapartition_mkimage      modules/rtos/tools/datapartition_mkimage"
     "xscope_host_endpoint                   modules/xscope_fileio/xscope_fileio/host"
     "xscope2psf                             examples/freertos/tracealyzer/host"
+    "psfcut                                 examples/freertos/tracealyzer/host"
+    "psfcat                                 examples/freertos/tracealyzer/host"
 )
 
 # perform builds
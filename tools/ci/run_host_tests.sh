@@ -0,0 +1,26 @@
+#!/bin/bash
+set -e
+
+XCORE_IOT_ROOT=`git rev-parse --show-toplevel`
+
+source ${XCORE_IOT_ROOT}/tools/ci/helper_functions.sh
+
+# Host tests of the modules, each a CMake project of its own
+tests=(
+    "modules/frame_pool/test"
+    "modules/pipeline_builder/test"
+    "modules/pipeline_timing/test"
+)
+
+# perform builds and run the tests
+echo '******************************************************'
+echo '* Running host tests'
+echo '******************************************************'
+
+for test_path in "${tests[@]}"; do
+    build_dir="${XCORE_IOT_ROOT}/build_host_tests/${test_path//\//_}"
+    rm -rf ${build_dir}
+    log_errors cmake -S ${XCORE_IOT_ROOT}/${test_path} -B ${build_dir}
+    log_errors cmake --build ${build_dir} -j
+    ctest --test-dir ${build_dir} --output-on-failure
+done